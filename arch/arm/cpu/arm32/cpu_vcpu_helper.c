@@ -26,6 +26,7 @@
 #include <vmm_stdio.h>
 #include <vmm_host_aspace.h>
 #include <vmm_manager.h>
+#include <vmm_guest_snapshot.h>
 #include <libs/stringlib.h>
 #include <libs/mathlib.h>
 #include <cpu_defines.h>
@@ -771,6 +772,14 @@ int arch_guest_del_region(struct vmm_guest *guest, struct vmm_region *region)
 	return VMM_OK;
 }
 
+int arch_guest_wrprotect_range(struct vmm_guest *guest,
+			       physical_addr_t gphys_addr,
+			       physical_size_t size)
+{
+	/* Shadow page tables do not support dirty logging */
+	return VMM_ENOTSUPP;
+}
+
 int arch_vcpu_init(struct vmm_vcpu *vcpu)
 {
 	int rc;
@@ -1181,6 +1190,18 @@ void arch_vcpu_regs_dump(struct vmm_chardev *cdev, struct vmm_vcpu *vcpu)
 	cpu_vcpu_cp15_regs_dump(cdev, vcpu);
 }
 
+int arch_vcpu_save(struct vmm_vcpu *vcpu, struct vmm_snapshot_stream *ss)
+{
+	/* For now VCPU snapshot not supported */
+	return VMM_ENOTSUPP;
+}
+
+int arch_vcpu_restore(struct vmm_vcpu *vcpu, struct vmm_snapshot_stream *ss)
+{
+	/* For now VCPU snapshot not supported */
+	return VMM_ENOTSUPP;
+}
+
 void arch_vcpu_stat_dump(struct vmm_chardev *cdev, struct vmm_vcpu *vcpu)
 {
 	/* For now no arch specific stats */
@@ -26,6 +26,7 @@
 #include <vmm_smp.h>
 #include <vmm_stdio.h>
 #include <vmm_scheduler.h>
+#include <vmm_guest_snapshot.h>
 #include <arch_vcpu.h>
 #include <arch_barrier.h>
 #include <libs/stringlib.h>
@@ -459,6 +460,10 @@ int arch_guest_init(struct vmm_guest *guest)
 			/* By default, assume PSCI v0.1 */
 			arm_guest_priv(guest)->psci_version = 1;
 		}
+	} else {
+		/* Start with empty Stage2 after reset */
+		mmu_lpae_unmap_range(arm_guest_priv(guest)->ttbl,
+				     0, TTBL_L1_SPAN_SIZE);
 	}
 
 	return VMM_OK;
@@ -469,6 +474,8 @@ int arch_guest_deinit(struct vmm_guest *guest)
 	int rc;
 
 	if (guest->arch_priv) {
+		mmu_lpae_unmap_range(arm_guest_priv(guest)->ttbl,
+				     0, TTBL_L1_SPAN_SIZE);
 		if ((rc = mmu_lpae_ttbl_free(arm_guest_priv(guest)->ttbl))) {
 			return rc;
 		}
@@ -486,7 +493,22 @@ int arch_guest_add_region(struct vmm_guest *guest, struct vmm_region *region)
 
 int arch_guest_del_region(struct vmm_guest *guest, struct vmm_region *region)
 {
-	return VMM_OK;
+	if (!guest->arch_priv || !(region->flags & VMM_REGION_MEMORY)) {
+		return VMM_OK;
+	}
+
+	/* Drop all Stage2 mappings of region with single TLB flush */
+	return mmu_lpae_unmap_range(arm_guest_priv(guest)->ttbl,
+				    VMM_REGION_GPHYS_START(region),
+				    VMM_REGION_PHYS_SIZE(region));
+}
+
+int arch_guest_wrprotect_range(struct vmm_guest *guest,
+			       physical_addr_t gphys_addr,
+			       physical_size_t size)
+{
+	/* Stage2 write faults are not handled for dirty logging */
+	return VMM_ENOTSUPP;
 }
 
 int arch_vcpu_init(struct vmm_vcpu *vcpu)
@@ -1081,6 +1103,18 @@ void arch_vcpu_regs_dump(struct vmm_chardev *cdev, struct vmm_vcpu *vcpu)
 	cpu_vcpu_cp15_dump(cdev, vcpu);
 }
 
+int arch_vcpu_save(struct vmm_vcpu *vcpu, struct vmm_snapshot_stream *ss)
+{
+	/* For now VCPU snapshot not supported */
+	return VMM_ENOTSUPP;
+}
+
+int arch_vcpu_restore(struct vmm_vcpu *vcpu, struct vmm_snapshot_stream *ss)
+{
+	/* For now VCPU snapshot not supported */
+	return VMM_ENOTSUPP;
+}
+
 void arch_vcpu_stat_dump(struct vmm_chardev *cdev, struct vmm_vcpu *vcpu)
 {
 	/* For now no arch specific stats */
@@ -26,6 +26,7 @@
 #include <vmm_stdio.h>
 #include <vmm_host_irq.h>
 #include <vmm_scheduler.h>
+#include <vmm_vcpu_stats.h>
 #include <cpu_inline_asm.h>
 #include <cpu_vcpu_excep.h>
 #include <cpu_vcpu_emulate.h>
@@ -59,6 +60,41 @@ void do_bad_mode(arch_regs_t *regs, unsigned long mode)
 	vmm_panic("%s: please reboot ...\n", __func__);
 }
 
+static inline u32 cpu_sync_exit_type(u32 ec)
+{
+	switch (ec) {
+	case EC_TRAP_WFI_WFE:
+		return VMM_VCPU_EXIT_WFI_WFE;
+	case EC_TRAP_MCR_MRC_CP15_A32:
+	case EC_TRAP_MCRR_MRRC_CP15_A32:
+	case EC_TRAP_MCR_MRC_CP14_A32:
+	case EC_TRAP_LDC_STC_CP14_A32:
+	case EC_TRAP_MCRR_MRRC_CP14_A32:
+	case EC_TRAP_MSR_MRS_SYSTEM:
+		return VMM_VCPU_EXIT_SYSREG;
+	case EC_SIMD_FPU:
+	case EC_FPEXC_A32:
+	case EC_FPEXC_A64:
+	case EC_TRAP_MRC_VMRS_CP10_A32:
+		return VMM_VCPU_EXIT_FPU;
+	case EC_TRAP_SMC_A32:
+	case EC_TRAP_SMC_A64:
+	case EC_TRAP_HVC_A32:
+	case EC_TRAP_HVC_A64:
+		return VMM_VCPU_EXIT_HYPERCALL;
+	case EC_TRAP_LWREL_INST_ABORT:
+	case EC_TRAP_LWREL_DATA_ABORT:
+		/* Data aborts on emulated regions are
+		 * re-classified as MMIO exits later.
+		 */
+		return VMM_VCPU_EXIT_STAGE2_FAULT;
+	default:
+		break;
+	};
+
+	return VMM_VCPU_EXIT_OTHER;
+}
+
 void do_sync(arch_regs_t *regs, unsigned long mode)
 {
 	int rc = VMM_OK;
@@ -99,6 +135,8 @@ void do_sync(arch_regs_t *regs, unsigned long mode)
 
 	vmm_scheduler_irq_enter(regs, TRUE);
 
+	vmm_vcpu_stats_exit_begin(&vcpu->stats, cpu_sync_exit_type(ec));
+
 	switch (ec) {
 	case EC_UNKNOWN:
 		/* We dont expect to get this trap so error */
@@ -213,15 +251,33 @@ void do_sync(arch_regs_t *regs, unsigned long mode)
 		}
 	}
 
+	vmm_vcpu_stats_exit_end(&vcpu->stats);
+
 	vmm_scheduler_irq_exit(regs);
 }
 
 void do_irq(arch_regs_t *regs)
 {
+	struct vmm_vcpu *vcpu = NULL;
+
 	vmm_scheduler_irq_enter(regs, FALSE);
 
+	if ((regs->pstate & PSR_EL_MASK) != PSR_EL_2) {
+		vcpu = vmm_scheduler_current_vcpu();
+		if (vcpu && vcpu->is_normal) {
+			vmm_vcpu_stats_exit_begin(&vcpu->stats,
+						  VMM_VCPU_EXIT_IRQ);
+		} else {
+			vcpu = NULL;
+		}
+	}
+
 	vmm_host_active_irq_exec(EXC_HYP_IRQ_SPx);
 
+	if (vcpu) {
+		vmm_vcpu_stats_exit_end(&vcpu->stats);
+	}
+
 	vmm_scheduler_irq_exit(regs);
 }
 
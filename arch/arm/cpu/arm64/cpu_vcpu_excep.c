@@ -23,6 +23,7 @@
 
 #include <vmm_error.h>
 #include <vmm_stdio.h>
+#include <vmm_timer.h>
 #include <vmm_host_aspace.h>
 #include <vmm_guest_aspace.h>
 #include <libs/stringlib.h>
@@ -37,9 +38,11 @@
 
 static int cpu_vcpu_stage2_map(struct vmm_vcpu *vcpu,
 			       arch_regs_t *regs,
-			       physical_addr_t fipa)
+			       physical_addr_t fipa,
+			       bool is_write)
 {
 	int rc, rc1;
+	bool dirty_log = FALSE, dirty = FALSE;
 	u32 reg_flags = 0x0, pg_reg_flags = 0x0;
 	struct cpu_page pg;
 	physical_addr_t inaddr, outaddr;
@@ -70,12 +73,22 @@ static int cpu_vcpu_stage2_map(struct vmm_vcpu *vcpu,
 	pg.oa = outaddr;
 	pg_reg_flags = reg_flags;
 
-	if (reg_flags & (VMM_REGION_ISRAM | VMM_REGION_ISROM)) {
+	/* Dirty logged RAM is mapped using pages without write access
+	 * until the page is written by Guest.
+	 */
+	if (reg_flags & VMM_REGION_ISRAM) {
+		dirty_log = (vmm_guest_dirty_log_page(vcpu->guest, inaddr,
+					is_write, &dirty) == VMM_OK);
+	}
+
+	if ((reg_flags & (VMM_REGION_ISRAM | VMM_REGION_ISROM)) &&
+	    !dirty_log) {
 		inaddr = fipa & TTBL_L2_MAP_MASK;
 		size = TTBL_L2_BLOCK_SIZE;
 		rc = vmm_guest_physical_map(vcpu->guest, inaddr, size,
 				    &outaddr, &availsz, &reg_flags);
-		if (!rc && (availsz >= TTBL_L2_BLOCK_SIZE)) {
+		if (!rc && (availsz >= TTBL_L2_BLOCK_SIZE) &&
+		    !(outaddr & (TTBL_L2_BLOCK_SIZE - 1))) {
 			pg.ia = inaddr;
 			pg.sz = size;
 			pg.oa = outaddr;
@@ -85,7 +98,8 @@ static int cpu_vcpu_stage2_map(struct vmm_vcpu *vcpu,
 		size = TTBL_L1_BLOCK_SIZE;
 		rc = vmm_guest_physical_map(vcpu->guest, inaddr, size,
 				    &outaddr, &availsz, &reg_flags);
-		if (!rc && (availsz >= TTBL_L1_BLOCK_SIZE)) {
+		if (!rc && (availsz >= TTBL_L1_BLOCK_SIZE) &&
+		    !(outaddr & (TTBL_L1_BLOCK_SIZE - 1))) {
 			pg.ia = inaddr;
 			pg.sz = size;
 			pg.oa = outaddr;
@@ -96,7 +110,8 @@ static int cpu_vcpu_stage2_map(struct vmm_vcpu *vcpu,
 	if (pg_reg_flags & VMM_REGION_VIRTUAL) {
 		pg.af = 0;
 		pg.ap = TTBL_HAP_NOACCESS;
-	} else if (pg_reg_flags & VMM_REGION_READONLY) {
+	} else if ((pg_reg_flags & VMM_REGION_READONLY) ||
+		   (dirty_log && !dirty)) {
 		pg.af = 1;
 		pg.ap = TTBL_HAP_READONLY;
 	} else {
@@ -138,11 +153,66 @@ static int cpu_vcpu_stage2_map(struct vmm_vcpu *vcpu,
 			return rc1;
 		}
 		rc = VMM_OK;
+	} else if (dirty_log && dirty) {
+		/* Dirty log fetch may have cleared the page after we marked
+		 * it and write-protected before we mapped it writable so
+		 * mark it again (see cpu_vcpu_stage2_wrfault()).
+		 */
+		vmm_guest_dirty_log_page(vcpu->guest, inaddr, TRUE, NULL);
 	}
 
 	return rc;
 }
 
+static int cpu_vcpu_stage2_wrfault(struct vmm_vcpu *vcpu,
+				   arch_regs_t *regs,
+				   physical_addr_t fipa)
+{
+	int rc;
+	u32 reg_flags = 0x0;
+	u64 tstamp = vmm_timer_timestamp();
+	physical_addr_t inaddr, outaddr;
+	physical_size_t availsz;
+
+	inaddr = fipa & TTBL_L3_MAP_MASK;
+	rc = vmm_guest_physical_map(vcpu->guest, inaddr, TTBL_L3_BLOCK_SIZE,
+				    &outaddr, &availsz, &reg_flags);
+	if (rc) {
+		return rc;
+	}
+
+	/* Only RAM pages write-protected for dirty logging are handled */
+	if (!(reg_flags & VMM_REGION_ISRAM) ||
+	    (reg_flags & (VMM_REGION_READONLY | VMM_REGION_VIRTUAL))) {
+		vmm_printf("%s: Unhandled permission fault IPA=0x%lx\n",
+			   __func__, inaddr);
+		return VMM_EFAIL;
+	}
+
+	/* Mark page dirty before Guest is allowed to write it. The page
+	 * is not dirty logged anymore if dirty logging was stopped.
+	 */
+	vmm_guest_dirty_log_page(vcpu->guest, inaddr, TRUE, NULL);
+
+	rc = mmu_lpae_set_page_ap(arm_guest_priv(vcpu->guest)->ttbl,
+				  inaddr, TTBL_HAP_READWRITE);
+	if (rc) {
+		return rc;
+	}
+
+	/* Dirty log fetch clears the bitmap and then write-protects the
+	 * region. If it ran between marking and giving write access then
+	 * the page is now writable with its bit cleared so mark it again.
+	 * A fetch running after this point write-protects the page again.
+	 */
+	vmm_guest_dirty_log_page(vcpu->guest, inaddr, TRUE, NULL);
+
+	vmm_guest_dirty_log_account(vcpu->guest,
+				    vmm_timer_timestamp() - tstamp);
+
+	return VMM_OK;
+}
+
 int cpu_vcpu_inst_abort(struct vmm_vcpu *vcpu,
 			arch_regs_t *regs,
 			u32 il, u32 iss,
@@ -152,7 +222,7 @@ int cpu_vcpu_inst_abort(struct vmm_vcpu *vcpu,
 	case FSC_TRANS_FAULT_LEVEL1:
 	case FSC_TRANS_FAULT_LEVEL2:
 	case FSC_TRANS_FAULT_LEVEL3:
-		return cpu_vcpu_stage2_map(vcpu, regs, fipa);
+		return cpu_vcpu_stage2_map(vcpu, regs, fipa, FALSE);
 	default:
 		break;
 	};
@@ -172,10 +242,17 @@ int cpu_vcpu_data_abort(struct vmm_vcpu *vcpu,
 	case FSC_TRANS_FAULT_LEVEL1:
 	case FSC_TRANS_FAULT_LEVEL2:
 	case FSC_TRANS_FAULT_LEVEL3:
-		return cpu_vcpu_stage2_map(vcpu, regs, fipa);
+		return cpu_vcpu_stage2_map(vcpu, regs, fipa,
+				(iss & ISS_ABORT_WNR_MASK) ? TRUE : FALSE);
+	case FSC_PERM_FAULT_LEVEL1:
+	case FSC_PERM_FAULT_LEVEL2:
+	case FSC_PERM_FAULT_LEVEL3:
+		return cpu_vcpu_stage2_wrfault(vcpu, regs, fipa);
 	case FSC_ACCESS_FAULT_LEVEL1:
 	case FSC_ACCESS_FAULT_LEVEL2:
 	case FSC_ACCESS_FAULT_LEVEL3:
+		/* Access faults are generated only for emulated regions */
+		vmm_vcpu_stats_exit_type(&vcpu->stats, VMM_VCPU_EXIT_MMIO);
 		if (!(iss & ISS_ABORT_ISV_MASK)) {
 			/* Determine instruction physical address */
 			va2pa_at(VA2PA_STAGE1, VA2PA_EL1, VA2PA_RD, regs->pc);
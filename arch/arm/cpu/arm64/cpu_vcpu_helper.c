@@ -25,12 +25,14 @@
 #include <vmm_heap.h>
 #include <vmm_smp.h>
 #include <vmm_stdio.h>
+#include <vmm_guest_snapshot.h>
 #include <arch_barrier.h>
 #include <libs/stringlib.h>
 #include <libs/mathlib.h>
 #include <cpu_inline_asm.h>
 #include <cpu_vcpu_sysregs.h>
 #include <cpu_vcpu_vfp.h>
+#include <cpu_vcpu_vmid.h>
 #include <cpu_vcpu_helper.h>
 
 #include <generic_timer.h>
@@ -320,6 +322,12 @@ int arch_guest_init(struct vmm_guest *guest)
 			/* By default, assume PSCI v0.1 */
 			arm_guest_priv(guest)->psci_version = 1;
 		}
+
+		cpu_vcpu_vmid_guest_init(guest);
+	} else {
+		/* Start with empty Stage2 after reset */
+		mmu_lpae_unmap_range(arm_guest_priv(guest)->ttbl,
+				     0, TTBL_L1_SPAN_SIZE);
 	}
 
 	return VMM_OK;
@@ -330,6 +338,8 @@ int arch_guest_deinit(struct vmm_guest *guest)
 	int rc;
 
 	if (guest->arch_priv) {
+		mmu_lpae_unmap_range(arm_guest_priv(guest)->ttbl,
+				     0, TTBL_L1_SPAN_SIZE);
 		if ((rc = mmu_lpae_ttbl_free(arm_guest_priv(guest)->ttbl))) {
 			return rc;
 		}
@@ -346,7 +356,26 @@ int arch_guest_add_region(struct vmm_guest *guest, struct vmm_region *region)
 
 int arch_guest_del_region(struct vmm_guest *guest, struct vmm_region *region)
 {
-	return VMM_OK;
+	if (!guest->arch_priv || !(region->flags & VMM_REGION_MEMORY)) {
+		return VMM_OK;
+	}
+
+	/* Drop all Stage2 mappings of region with single TLB flush */
+	return mmu_lpae_unmap_range(arm_guest_priv(guest)->ttbl,
+				    VMM_REGION_GPHYS_START(region),
+				    VMM_REGION_PHYS_SIZE(region));
+}
+
+int arch_guest_wrprotect_range(struct vmm_guest *guest,
+			       physical_addr_t gphys_addr,
+			       physical_size_t size)
+{
+	if (!guest->arch_priv) {
+		return VMM_EFAIL;
+	}
+
+	return mmu_lpae_wrprotect_range(arm_guest_priv(guest)->ttbl,
+					gphys_addr, size);
 }
 
 int arch_vcpu_init(struct vmm_vcpu *vcpu)
@@ -562,6 +591,8 @@ int arch_vcpu_init(struct vmm_vcpu *vcpu)
 					HCR_IMO_MASK |
 					HCR_FMO_MASK |
 					HCR_SWIO_MASK |
+					HCR_FB_MASK |
+					HCR_BSU_IS |
 					HCR_VM_MASK);
 		if (!(arm_regs(vcpu)->pstate & PSR_MODE32)) {
 			arm_priv(vcpu)->hcr |= HCR_RW_MASK;
@@ -759,20 +790,10 @@ void arch_vcpu_switch(struct vmm_vcpu *tvcpu,
 		vmm_spin_unlock_irqrestore(&arm_priv(vcpu)->hcr_lock, flags);
 		msr(cptr_el2, arm_priv(vcpu)->cptr);
 		msr(hstr_el2, arm_priv(vcpu)->hstr);
-		/* Update hypervisor Stage2 MMU context */
-		mmu_lpae_stage2_chttbl(vcpu->guest->id,
-			       arm_guest_priv(vcpu->guest)->ttbl);
-		/* Flush TLB if moved to new host CPU */
-		if (arm_priv(vcpu)->last_hcpu != vmm_smp_processor_id()) {
-			/* Invalidate all guest TLB enteries because
-			 * we might have stale guest TLB enteries from
-			 * our previous run on new_hcpu host CPU
-			 */
-			inv_tlb_guest_allis();
-			/* Ensure changes are visible */
-			dsb(sy);
-			isb();
-		}
+		/* Update hypervisor Stage2 MMU context and flush
+		 * stale guest TLB enteries of this host CPU (if any)
+		 */
+		cpu_vcpu_vmid_switch(vcpu);
 	}
 	/* Clear exclusive monitor */
 	clrex();
@@ -860,6 +881,105 @@ void arch_vcpu_regs_dump(struct vmm_chardev *cdev, struct vmm_vcpu *vcpu)
 	cpu_vcpu_sysregs_dump(cdev, vcpu);
 }
 
+int arch_vcpu_save(struct vmm_vcpu *vcpu, struct vmm_snapshot_stream *ss)
+{
+	int rc;
+	u64 hcr;
+	irq_flags_t flags;
+	struct arm_priv *p;
+	struct generic_timer_state gt;
+
+	if (!vcpu || !ss || !vcpu->is_normal) {
+		return VMM_EINVALID;
+	}
+	p = arm_priv(vcpu);
+
+	/* Core registers */
+	rc = vmm_snapshot_write(ss, arm_regs(vcpu), sizeof(arch_regs_t));
+	if (rc) {
+		return rc;
+	}
+
+	/* Hypervisor configuration (holds virtual IRQ/FIQ lines) */
+	vmm_spin_lock_irqsave(&p->hcr_lock, flags);
+	hcr = p->hcr;
+	vmm_spin_unlock_irqrestore(&p->hcr_lock, flags);
+	rc = vmm_snapshot_write(ss, &hcr, sizeof(hcr));
+	if (rc) {
+		return rc;
+	}
+
+	/* EL1/EL0 sysregs and VFP context (saved at VCPU switch-out) */
+	rc = vmm_snapshot_write(ss, &p->sysregs, sizeof(p->sysregs));
+	if (rc) {
+		return rc;
+	}
+	rc = vmm_snapshot_write(ss, &p->vfp, sizeof(p->vfp));
+	if (rc) {
+		return rc;
+	}
+
+	/* Generic timer context */
+	memset(&gt, 0, sizeof(gt));
+	generic_timer_vcpu_state_get(vcpu, arm_gentimer_context(vcpu), &gt);
+
+	return vmm_snapshot_write(ss, &gt, sizeof(gt));
+}
+
+int arch_vcpu_restore(struct vmm_vcpu *vcpu, struct vmm_snapshot_stream *ss)
+{
+	int rc;
+	u64 hcr;
+	irq_flags_t flags;
+	struct arm_priv *p;
+	arch_regs_t regs;
+	struct generic_timer_state gt;
+
+	if (!vcpu || !ss || !vcpu->is_normal) {
+		return VMM_EINVALID;
+	}
+	p = arm_priv(vcpu);
+
+	/* Note: on failure sysregs and VFP context can be partially
+	 * updated so caller is expected to reset the guest.
+	 */
+	rc = vmm_snapshot_read(ss, &regs, sizeof(regs));
+	if (rc) {
+		return rc;
+	}
+	rc = vmm_snapshot_read(ss, &hcr, sizeof(hcr));
+	if (rc) {
+		return rc;
+	}
+	rc = vmm_snapshot_read(ss, &p->sysregs, sizeof(p->sysregs));
+	if (rc) {
+		return rc;
+	}
+	rc = vmm_snapshot_read(ss, &p->vfp, sizeof(p->vfp));
+	if (rc) {
+		return rc;
+	}
+	rc = vmm_snapshot_read(ss, &gt, sizeof(gt));
+	if (rc) {
+		return rc;
+	}
+
+	memcpy(arm_regs(vcpu), &regs, sizeof(regs));
+
+	vmm_spin_lock_irqsave(&p->hcr_lock, flags);
+	p->hcr = hcr;
+	vmm_spin_unlock_irqrestore(&p->hcr_lock, flags);
+
+	generic_timer_vcpu_state_set(vcpu, arm_gentimer_context(vcpu), &gt);
+
+	/* Restored VCPU may run on any host CPU hence flush
+	 * stale dcache lines like a freshly reset VCPU.
+	 */
+	vmm_cpumask_setall(&p->dflush_needed);
+
+	return VMM_OK;
+}
+
 void arch_vcpu_stat_dump(struct vmm_chardev *cdev, struct vmm_vcpu *vcpu)
 {
 	/* For now no arch specific stats */
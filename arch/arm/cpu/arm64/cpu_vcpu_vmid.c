@@ -0,0 +1,235 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file cpu_vcpu_vmid.c
+ * @author agent (agent@local)
+ * @brief Source file for VMID allocation and guest TLB tracking
+ *
+ * VMIDs are allocated lazily using a generation counter in the upper
+ * bits of a 64bit VMID value. When VMID space is exhausted we bump the
+ * generation, keep the VMIDs active on each host CPU reserved, and ask
+ * every host CPU to invalidate all guest TLB entries on its next VCPU
+ * switch. This allows more guests than hardware VMIDs and avoids
+ * broadcast TLB invalidation on every VCPU migration.
+ */
+
+#include <vmm_error.h>
+#include <vmm_smp.h>
+#include <vmm_percpu.h>
+#include <vmm_cpumask.h>
+#include <vmm_spinlocks.h>
+#include <arch_atomic64.h>
+#include <arch_barrier.h>
+#include <arch_regs.h>
+#include <cpu_inline_asm.h>
+#include <cpu_vcpu_vmid.h>
+#include <mmu_lpae.h>
+#include <libs/bitops.h>
+#include <libs/bitmap.h>
+
+#define VMID_BITS			8
+#define VMID_COUNT			(1UL << VMID_BITS)
+#define VMID_MASK			(VMID_COUNT - 1)
+#define VMID_FIRST_GENERATION		((u64)VMID_COUNT)
+
+#define vmid_generation_match(vmid, gen)	\
+			(!(((vmid) ^ (gen)) >> VMID_BITS))
+
+struct cpu_vmid_ctrl {
+	atomic64_t active;
+	u64 reserved;
+};
+
+static DEFINE_PER_CPU(struct cpu_vmid_ctrl, vmidctrl);
+
+static DEFINE_SPINLOCK(vmid_lock);
+static atomic64_t vmid_generation =
+			ARCH_ATOMIC64_INITIALIZER(VMID_FIRST_GENERATION);
+static unsigned long vmid_map[BITS_TO_LONGS(VMID_COUNT)];
+static u32 vmid_next;
+static vmm_cpumask_t vmid_flush_pending;
+
+static u64 vmid_xchg_active(u32 cpu, u64 newval)
+{
+	u64 oldval;
+	atomic64_t *active = &per_cpu(vmidctrl, cpu).active;
+
+	do {
+		oldval = arch_atomic64_read(active);
+	} while (arch_atomic64_cmpxchg(active, oldval, newval) != oldval);
+
+	return oldval;
+}
+
+/* Must be called with vmid_lock held */
+static void vmid_flush_context(void)
+{
+	u32 c;
+	u64 vmid;
+
+	bitmap_zero(vmid_map, VMID_COUNT);
+
+	for_each_possible_cpu(c) {
+		vmid = vmid_xchg_active(c, 0);
+		/*
+		 * If this CPU has already been through a rollover
+		 * without running any VCPU then preserve its
+		 * reserved VMID because that is what is still
+		 * loaded in VTTBR_EL2 and cached in TLBs.
+		 */
+		if (vmid == 0) {
+			vmid = per_cpu(vmidctrl, c).reserved;
+		}
+		__set_bit(vmid & VMID_MASK, vmid_map);
+		per_cpu(vmidctrl, c).reserved = vmid;
+	}
+
+	/* Queue full guest TLB invalidation on all host CPUs */
+	vmm_cpumask_setall(&vmid_flush_pending);
+}
+
+/* Must be called with vmid_lock held */
+static bool vmid_check_update_reserved(u64 vmid, u64 newvmid)
+{
+	u32 c;
+	bool hit = FALSE;
+
+	/*
+	 * Iterate over the set of reserved VMIDs looking for a match
+	 * and update to use newvmid. There can be more than one match
+	 * if multiple VCPUs of same guest were running at rollover.
+	 */
+	for_each_possible_cpu(c) {
+		if (per_cpu(vmidctrl, c).reserved == vmid) {
+			hit = TRUE;
+			per_cpu(vmidctrl, c).reserved = newvmid;
+		}
+	}
+
+	return hit;
+}
+
+/* Must be called with vmid_lock held */
+static u64 vmid_new(u64 vmid)
+{
+	u64 newvmid, gen = arch_atomic64_read(&vmid_generation);
+	u32 idx;
+
+	if (vmid != 0) {
+		newvmid = gen | (vmid & VMID_MASK);
+
+		/* Reuse reserved VMID if it was active during rollover */
+		if (vmid_check_update_reserved(vmid, newvmid)) {
+			return newvmid;
+		}
+
+		/* Try to re-allocate old VMID in new generation */
+		if (!__test_and_set_bit(vmid & VMID_MASK, vmid_map)) {
+			return newvmid;
+		}
+	}
+
+	idx = find_next_zero_bit(vmid_map, VMID_COUNT, vmid_next);
+	if (idx != VMID_COUNT) {
+		goto set_vmid;
+	}
+
+	/* We are out of VMIDs so increment generation */
+	gen = arch_atomic64_add_return(&vmid_generation,
+				       VMID_FIRST_GENERATION);
+	vmid_flush_context();
+
+	/* There will always be a free VMID after flush */
+	idx = find_next_zero_bit(vmid_map, VMID_COUNT, 0);
+
+set_vmid:
+	__set_bit(idx, vmid_map);
+	vmid_next = idx;
+	return gen | idx;
+}
+
+void cpu_vcpu_vmid_guest_init(struct vmm_guest *guest)
+{
+	u32 c;
+	struct arm_guest_priv *gp = arm_guest_priv(guest);
+
+	ARCH_ATOMIC64_INIT(&gp->vmid, 0);
+	for (c = 0; c < CONFIG_CPU_COUNT; c++) {
+		gp->last_vcpu_ran[c] = VMID_INVALID_VCPU;
+	}
+}
+
+void cpu_vcpu_vmid_switch(struct vmm_vcpu *vcpu)
+{
+	bool flush_all = FALSE;
+	u64 vmid, old_active;
+	irq_flags_t flags;
+	u32 cpu = vmm_smp_processor_id();
+	struct arm_guest_priv *gp = arm_guest_priv(vcpu->guest);
+	struct cpu_vmid_ctrl *vctrl = &this_cpu(vmidctrl);
+
+	/*
+	 * Fast path: VMID belongs to current generation and no
+	 * rollover happened since this host CPU last switched.
+	 */
+	vmid = arch_atomic64_read(&gp->vmid);
+	old_active = arch_atomic64_read(&vctrl->active);
+	if (old_active &&
+	    vmid_generation_match(vmid,
+				  arch_atomic64_read(&vmid_generation)) &&
+	    (arch_atomic64_cmpxchg(&vctrl->active,
+				   old_active, vmid) == old_active)) {
+		goto switch_vmid;
+	}
+
+	vmm_spin_lock_irqsave_lite(&vmid_lock, flags);
+
+	vmid = arch_atomic64_read(&gp->vmid);
+	if (!vmid_generation_match(vmid,
+				   arch_atomic64_read(&vmid_generation))) {
+		vmid = vmid_new(vmid);
+		arch_atomic64_write(&gp->vmid, vmid);
+	}
+
+	if (vmm_cpumask_test_and_clear_cpu(cpu, &vmid_flush_pending)) {
+		flush_all = TRUE;
+	}
+
+	arch_atomic64_write(&vctrl->active, vmid);
+
+	vmm_spin_unlock_irqrestore_lite(&vmid_lock, flags);
+
+switch_vmid:
+	mmu_lpae_stage2_chttbl(vmid & VMID_MASK, gp->ttbl);
+	isb();
+
+	if (flush_all) {
+		/* VMID rollover so drop all stale guest TLB entries */
+		inv_tlb_guest_all_local();
+	} else if (gp->last_vcpu_ran[cpu] != vcpu->subid) {
+		/*
+		 * Some other VCPU of this guest (or nobody) last ran
+		 * on this host CPU so guest TLB entries tagged with our
+		 * VMID can be stale. Guest broadcast TLB maintenance
+		 * (HCR_EL2.FB) takes care of all other cases.
+		 */
+		inv_tlb_guest_cur_local();
+	}
+
+	gp->last_vcpu_ran[cpu] = vcpu->subid;
+}
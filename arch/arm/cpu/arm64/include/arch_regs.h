@@ -146,6 +146,10 @@ struct arm_priv {
 struct arm_guest_priv {
 	/* Stage2 table */
 	struct cpu_ttbl *ttbl;
+	/* VMID with generation in upper bits */
+	atomic64_t vmid;
+	/* Last VCPU subid which ran on each host CPU */
+	u32 last_vcpu_ran[CONFIG_CPU_COUNT];
 	/* PSCI version
 	 * Bits[31:16] = Major number
 	 * Bits[15:0] = Minor number
@@ -386,6 +386,7 @@
 #define HCR_DC_SHIFT					12
 #define HCR_BSU_MASK					0x000000C00
 #define HCR_BSU_SHIFT					10
+#define HCR_BSU_IS					0x000000400
 #define HCR_FB_MASK					0x000000200
 #define HCR_FB_SHIFT					9
 #define HCR_VSE_MASK					0x000000100
@@ -0,0 +1,43 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file cpu_vcpu_vmid.h
+ * @author agent (agent@local)
+ * @brief Header file for VMID allocation and guest TLB tracking
+ */
+#ifndef _CPU_VCPU_VMID_H__
+#define _CPU_VCPU_VMID_H__
+
+#include <vmm_types.h>
+#include <vmm_manager.h>
+
+/** Invalid value for last VCPU which ran on a host CPU */
+#define VMID_INVALID_VCPU		0xFFFFFFFF
+
+/** Initialize VMID context for given guest */
+void cpu_vcpu_vmid_guest_init(struct vmm_guest *guest);
+
+/** Load Stage2 context of given VCPU on current host CPU
+ *
+ *  This validates (and if required re-allocates) the VMID of
+ *  the guest and does VMID scoped local TLB invalidation only
+ *  when current host CPU can have stale guest TLB entries.
+ */
+void cpu_vcpu_vmid_switch(struct vmm_vcpu *vcpu);
+
+#endif /* _CPU_VCPU_VMID_H__ */
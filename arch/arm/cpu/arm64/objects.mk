@@ -40,6 +40,7 @@ cpu-objs-y+= cpu_init.o
 cpu-objs-y+= cpu_delay.o
 cpu-objs-y+= cpu_memcpy.o
 cpu-objs-y+= cpu_memset.o
+cpu-objs-y+= cpu_memmove.o
 cpu-objs-$(CONFIG_MODULES)+= cpu_elf.o
 cpu-objs-$(CONFIG_ARM64_STACKTRACE)+= cpu_stacktrace.o
 cpu-objs-$(CONFIG_SMP)+= cpu_locks.o
@@ -54,6 +55,7 @@ cpu-objs-y+= cpu_vcpu_inject.o
 cpu-objs-y+= cpu_vcpu_emulate.o
 cpu-objs-y+= cpu_vcpu_mem.o
 cpu-objs-y+= cpu_vcpu_vfp.o
+cpu-objs-y+= cpu_vcpu_vmid.o
 cpu-objs-y+= cpu_vcpu_sysregs.o
 cpu-objs-y+= cpu_vcpu_irq.o
 
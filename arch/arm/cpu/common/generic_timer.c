@@ -34,6 +34,7 @@
 #include <vmm_devemu.h>
 #include <generic_timer.h>
 #include <cpu_generic_timer.h>
+#include <libs/stringlib.h>
 #include <libs/mathlib.h>
 
 #undef DEBUG
@@ -609,3 +610,52 @@ void generic_timer_vcpu_context_post_restore(void *vcpu_ptr, void *context)
 	generic_timer_reg_write(GENERIC_TIMER_REG_VIRT_CTRL, cntx->cntvctl);
 #endif
 }
+
+void generic_timer_vcpu_state_get(void *vcpu_ptr, void *context,
+				  struct generic_timer_state *state)
+{
+	struct generic_timer_context *cntx = context;
+
+	if (!cntx || !state) {
+		return;
+	}
+
+	memset(state, 0, sizeof(*state));
+	if (cntx->cntvoff) {
+		state->cntvct = generic_timer_pcounter_read() - cntx->cntvoff;
+	}
+	state->cntpcval = cntx->cntpcval;
+	state->cntvcval = cntx->cntvcval;
+	state->cntkctl = cntx->cntkctl;
+	state->cntpctl = cntx->cntpctl;
+	state->cntvctl = cntx->cntvctl;
+}
+
+void generic_timer_vcpu_state_set(void *vcpu_ptr, void *context,
+				  struct generic_timer_state *state)
+{
+	struct generic_timer_context *cntx = context;
+
+	if (!cntx || !state) {
+		return;
+	}
+
+	vmm_timer_event_stop(&cntx->phys_ev);
+	vmm_timer_event_stop(&cntx->virt_ev);
+
+	/* Zero cntvoff means VCPU never ran so keep it zero and let
+	 * generic_timer_vcpu_context_restore() compute it.
+	 */
+	cntx->cntvoff = 0;
+	if (state->cntvct) {
+		cntx->cntvoff = generic_timer_pcounter_read() - state->cntvct;
+		if (!cntx->cntvoff) {
+			cntx->cntvoff = 1;
+		}
+	}
+	cntx->cntpcval = state->cntpcval;
+	cntx->cntvcval = state->cntvcval;
+	cntx->cntkctl = state->cntkctl;
+	cntx->cntpctl = state->cntpctl;
+	cntx->cntvctl = state->cntvctl;
+}
@@ -75,6 +75,20 @@ struct generic_timer_context {
 	struct vmm_timer_event phys_ev;
 }__packed;
 
+/* Portable timer state of a VCPU used for snapshot save/restore
+ * Note: virtual counter value is saved instead of cntvoff so that
+ * guest virtual time continues from the same point after restore.
+ */
+struct generic_timer_state {
+	u64 cntvct;
+	u64 cntpcval;
+	u64 cntvcval;
+	u32 cntkctl;
+	u32 cntpctl;
+	u32 cntvctl;
+	u32 reserved;
+}__packed;
+
 int generic_timer_vcpu_context_init(void *vcpu_ptr,
 				    void **context,
 				    u32 phys_irq, u32 virt_irq);
@@ -87,6 +101,12 @@ void generic_timer_vcpu_context_restore(void *vcpu_ptr, void *context);
 
 void generic_timer_vcpu_context_post_restore(void *vcpu_ptr, void *context);
 
+void generic_timer_vcpu_state_get(void *vcpu_ptr, void *context,
+				  struct generic_timer_state *state);
+
+void generic_timer_vcpu_state_set(void *vcpu_ptr, void *context,
+				  struct generic_timer_state *state);
+
 #endif /* __ASSEMBLY__ */
 
 #endif /* __GENERIC_TIMER_H__ */
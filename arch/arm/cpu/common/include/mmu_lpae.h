@@ -85,6 +85,26 @@ int mmu_lpae_unmap_page(struct cpu_ttbl *ttbl, struct cpu_page *pg);
 /** Map a page under a given translation table */
 int mmu_lpae_map_page(struct cpu_ttbl *ttbl, struct cpu_page *pg);
 
+/** Unmap all pages/blocks overlapping an input address range from
+ *  given translation table in a single walk. Empty child tables are
+ *  freed and only one TLB invalidation is done at the end.
+ */
+int mmu_lpae_unmap_range(struct cpu_ttbl *ttbl,
+			 physical_addr_t ia, physical_size_t sz);
+
+/** Update access permissions of the page/block mapping an input
+ *  address in given translation table.
+ */
+int mmu_lpae_set_page_ap(struct cpu_ttbl *ttbl,
+			 physical_addr_t ia, u32 ap);
+
+/** Write-protect all pages overlapping an input address range of
+ *  given Stage2 translation table in a single walk. Blocks are
+ *  unmapped so that they are re-created as pages on next access.
+ */
+int mmu_lpae_wrprotect_range(struct cpu_ttbl *ttbl,
+			     physical_addr_t ia, physical_size_t sz);
+
 /** Get page from a given virtual address */
 int mmu_lpae_get_hypervisor_page(virtual_addr_t va, struct cpu_page *pg);
 
@@ -132,6 +152,8 @@ int mmu_lpae_stage2_chttbl(u8 vmid, struct cpu_ttbl *ttbl);
 #define TTBL_L1_INDEX_SHIFT				30
 #define TTBL_L1_BLOCK_SIZE				0x0000000040000000ULL
 #define TTBL_L1_MAP_MASK				(~(TTBL_L1_BLOCK_SIZE - 1))
+#define TTBL_L1_SPAN_SIZE				(TTBL_L1_BLOCK_SIZE * \
+							 TTBL_TABLE_ENTCNT)
 /* L2 index Bit[29:21] */
 #define TTBL_L2_INDEX_MASK				0x000000003FE00000ULL
 #define TTBL_L2_INDEX_SHIFT				21
@@ -612,9 +612,12 @@ int mmu_lpae_map_page(struct cpu_ttbl *ttbl, struct cpu_page *pg)
 
 	cpu_mmu_sync_tte(&tte[index]);
 
-	if (ttbl->stage == TTBL_STAGE2) {
-		cpu_invalid_ipa_guest_tlb((pg->ia));
-	} else {
+	/*
+	 * Stage2 translation faults are never cached in TLBs so no
+	 * TLB invalidation is required when filling an invalid Stage2
+	 * entry whereas hypervisor mappings are always invalidated.
+	 */
+	if (ttbl->stage != TTBL_STAGE2) {
 		cpu_invalid_va_hypervisor_tlb(((virtual_addr_t)pg->ia));
 	}
 
@@ -625,6 +628,325 @@ int mmu_lpae_map_page(struct cpu_ttbl *ttbl, struct cpu_page *pg)
 	return VMM_OK;
 }
 
+/*
+ * Detach child table from its parent and defer freeing it till TLBs
+ * are invalidated because table walkers on other CPUs can still be
+ * using the child table.
+ */
+static void mmu_lpae_ttbl_defer_free(struct cpu_ttbl *child,
+				     struct dlist *free_list)
+{
+	if (mmu_lpae_ttbl_isattached(child)) {
+		mmu_lpae_ttbl_deattach(child);
+	}
+	list_add_tail(&child->head, free_list);
+}
+
+static void mmu_lpae_ttbl_unmap_range(struct cpu_ttbl *ttbl,
+				      physical_addr_t ia,
+				      physical_addr_t end,
+				      struct dlist *free_list,
+				      bool *flush)
+{
+	int index;
+	u64 *tte, tte_val;
+	irq_flags_t flags;
+	struct cpu_ttbl *child;
+	physical_addr_t next, span_end;
+	physical_size_t blksz = mmu_lpae_level_block_size(ttbl->level);
+
+	/* Never walk beyond the input address span of this table */
+	span_end = (ttbl->map_ia & ~((blksz * TTBL_TABLE_ENTCNT) - 1)) +
+		   (blksz * TTBL_TABLE_ENTCNT);
+	if ((ttbl->map_ia < span_end) && (span_end < end)) {
+		end = span_end;
+	}
+
+	tte = (u64 *)ttbl->tbl_va;
+
+	while ((ia < end) && ttbl->tte_cnt) {
+		next = (ia & mmu_lpae_level_map_mask(ttbl->level)) + blksz;
+		if ((next <= ia) || (end < next)) {
+			next = end;
+		}
+		index = mmu_lpae_level_index(ia, ttbl->level);
+
+		vmm_spin_lock_irqsave_lite(&ttbl->tbl_lock, flags);
+		tte_val = tte[index];
+		vmm_spin_unlock_irqrestore_lite(&ttbl->tbl_lock, flags);
+
+		if (!(tte_val & TTBL_VALID_MASK)) {
+			ia = next;
+			continue;
+		}
+
+		if ((ttbl->level < TTBL_LAST_LEVEL) &&
+		    (tte_val & TTBL_TABLE_MASK)) {
+			child = mmu_lpae_ttbl_find(tte_val & TTBL_OUTADDR_MASK);
+			if (!child || (child->parent != ttbl)) {
+				ia = next;
+				continue;
+			}
+			/* Only descend if child table is partially covered */
+			if (((next - ia) != blksz) || (ia & (blksz - 1))) {
+				mmu_lpae_ttbl_unmap_range(child, ia, next,
+							  free_list, flush);
+			}
+			if (((next - ia) == blksz) || !child->tte_cnt) {
+				mmu_lpae_ttbl_defer_free(child, free_list);
+				*flush = TRUE;
+			}
+			ia = next;
+			continue;
+		}
+
+		/*
+		 * Blocks partially covered by the range are unmapped
+		 * completely. This is fine for Stage2 tables because
+		 * Stage2 mappings are re-created on demand.
+		 */
+		vmm_spin_lock_irqsave_lite(&ttbl->tbl_lock, flags);
+		if (tte[index] & TTBL_VALID_MASK) {
+			tte[index] = 0x0;
+			cpu_mmu_sync_tte(&tte[index]);
+			ttbl->tte_cnt--;
+			*flush = TRUE;
+		}
+		vmm_spin_unlock_irqrestore_lite(&ttbl->tbl_lock, flags);
+
+		ia = next;
+	}
+}
+
+int mmu_lpae_unmap_range(struct cpu_ttbl *ttbl,
+			 physical_addr_t ia, physical_size_t sz)
+{
+	int stage;
+	bool flush = FALSE;
+	physical_addr_t end;
+	struct dlist *l;
+	struct cpu_ttbl *child;
+	LIST_HEAD(free_list);
+
+	if (!ttbl) {
+		return VMM_EFAIL;
+	}
+	if (!sz) {
+		return VMM_OK;
+	}
+
+	ia &= TTBL_L3_MAP_MASK;
+	end = ia + sz;
+	if (end < ia) {
+		end = ~((physical_addr_t)0) & TTBL_L3_MAP_MASK;
+	}
+
+	/* Table itself can be freed below so save its stage */
+	stage = ttbl->stage;
+
+	mmu_lpae_ttbl_unmap_range(ttbl, ia, end, &free_list, &flush);
+
+	/* Free the table itself if it is an empty child table */
+	if ((ttbl->tte_cnt == 0) && (ttbl->level > TTBL_FIRST_LEVEL)) {
+		mmu_lpae_ttbl_defer_free(ttbl, &free_list);
+		flush = TRUE;
+	}
+
+	/*
+	 * Single TLB invalidation for the whole range
+	 * Note: TLB invalidation macros complete with DSB so no
+	 * table walker can use freed tables after this point.
+	 */
+	if (flush) {
+		if (stage == TTBL_STAGE2) {
+			cpu_invalid_ipa_guest_tlb(ia);
+		} else {
+			cpu_invalid_all_tlbs();
+		}
+		dsb(ish);
+	}
+
+	/* Now it is safe to free the unlinked tables */
+	while (!list_empty(&free_list)) {
+		l = list_pop(&free_list);
+		child = list_entry(l, struct cpu_ttbl, head);
+		mmu_lpae_ttbl_free(child);
+	}
+
+	return VMM_OK;
+}
+
+int mmu_lpae_set_page_ap(struct cpu_ttbl *ttbl,
+			 physical_addr_t ia, u32 ap)
+{
+	int index;
+	u64 *tte, ap_mask, ap_val;
+	irq_flags_t flags;
+	struct cpu_ttbl *child;
+
+	if (!ttbl) {
+		return VMM_EFAIL;
+	}
+
+	index = mmu_lpae_level_index(ia, ttbl->level);
+	tte = (u64 *)ttbl->tbl_va;
+
+	vmm_spin_lock_irqsave_lite(&ttbl->tbl_lock, flags);
+
+	if (!(tte[index] & TTBL_VALID_MASK)) {
+		vmm_spin_unlock_irqrestore_lite(&ttbl->tbl_lock, flags);
+		return VMM_EFAIL;
+	}
+	if ((ttbl->level == TTBL_LAST_LEVEL) &&
+	    !(tte[index] & TTBL_TABLE_MASK)) {
+		vmm_spin_unlock_irqrestore_lite(&ttbl->tbl_lock, flags);
+		return VMM_EFAIL;
+	}
+
+	if ((ttbl->level < TTBL_LAST_LEVEL) &&
+	    (tte[index] & TTBL_TABLE_MASK)) {
+		vmm_spin_unlock_irqrestore_lite(&ttbl->tbl_lock, flags);
+		child = mmu_lpae_ttbl_get_child(ttbl, ia, FALSE);
+		if (!child) {
+			return VMM_EFAIL;
+		}
+		return mmu_lpae_set_page_ap(child, ia, ap);
+	}
+
+	if (ttbl->stage == TTBL_STAGE2) {
+		ap_mask = TTBL_STAGE2_LOWER_HAP_MASK;
+		ap_val = ((u64)ap << TTBL_STAGE2_LOWER_HAP_SHIFT) & ap_mask;
+	} else {
+		ap_mask = TTBL_STAGE1_LOWER_AP_MASK;
+		ap_val = ((u64)ap << TTBL_STAGE1_LOWER_AP_SHIFT) & ap_mask;
+	}
+
+	/* Permission changes do not need break-before-make */
+	if ((tte[index] & ap_mask) != ap_val) {
+		tte[index] = (tte[index] & ~ap_mask) | ap_val;
+		cpu_mmu_sync_tte(&tte[index]);
+		if (ttbl->stage == TTBL_STAGE2) {
+			cpu_invalid_ipa_guest_tlb(ia);
+		} else {
+			cpu_invalid_va_hypervisor_tlb(((virtual_addr_t)ia));
+		}
+	}
+
+	vmm_spin_unlock_irqrestore_lite(&ttbl->tbl_lock, flags);
+
+	return VMM_OK;
+}
+
+static void mmu_lpae_ttbl_wrprotect_range(struct cpu_ttbl *ttbl,
+					  physical_addr_t ia,
+					  physical_addr_t end,
+					  bool *flush)
+{
+	int index;
+	u64 *tte, tte_val, rw_val, ro_val;
+	irq_flags_t flags;
+	struct cpu_ttbl *child;
+	physical_addr_t next, span_end;
+	physical_size_t blksz = mmu_lpae_level_block_size(ttbl->level);
+
+	/* Never walk beyond the input address span of this table */
+	span_end = (ttbl->map_ia & ~((blksz * TTBL_TABLE_ENTCNT) - 1)) +
+		   (blksz * TTBL_TABLE_ENTCNT);
+	if ((ttbl->map_ia < span_end) && (span_end < end)) {
+		end = span_end;
+	}
+
+	tte = (u64 *)ttbl->tbl_va;
+	rw_val = ((u64)TTBL_HAP_READWRITE << TTBL_STAGE2_LOWER_HAP_SHIFT) &
+		 TTBL_STAGE2_LOWER_HAP_MASK;
+	ro_val = ((u64)TTBL_HAP_READONLY << TTBL_STAGE2_LOWER_HAP_SHIFT) &
+		 TTBL_STAGE2_LOWER_HAP_MASK;
+
+	while ((ia < end) && ttbl->tte_cnt) {
+		next = (ia & mmu_lpae_level_map_mask(ttbl->level)) + blksz;
+		if ((next <= ia) || (end < next)) {
+			next = end;
+		}
+		index = mmu_lpae_level_index(ia, ttbl->level);
+
+		vmm_spin_lock_irqsave_lite(&ttbl->tbl_lock, flags);
+		tte_val = tte[index];
+		vmm_spin_unlock_irqrestore_lite(&ttbl->tbl_lock, flags);
+
+		if (!(tte_val & TTBL_VALID_MASK)) {
+			ia = next;
+			continue;
+		}
+
+		if ((ttbl->level < TTBL_LAST_LEVEL) &&
+		    (tte_val & TTBL_TABLE_MASK)) {
+			child = mmu_lpae_ttbl_find(tte_val & TTBL_OUTADDR_MASK);
+			if (child && (child->parent == ttbl)) {
+				mmu_lpae_ttbl_wrprotect_range(child,
+							ia, next, flush);
+			}
+			ia = next;
+			continue;
+		}
+
+		vmm_spin_lock_irqsave_lite(&ttbl->tbl_lock, flags);
+		if (!(tte[index] & TTBL_VALID_MASK)) {
+			/* Raced with unmap so nothing to do */
+		} else if (ttbl->level < TTBL_LAST_LEVEL) {
+			/*
+			 * Blocks are unmapped instead of being write
+			 * protected so that they are re-created on demand
+			 * as pages and write faults are tracked per-page.
+			 */
+			tte[index] = 0x0;
+			cpu_mmu_sync_tte(&tte[index]);
+			ttbl->tte_cnt--;
+			*flush = TRUE;
+		} else if ((tte[index] & TTBL_STAGE2_LOWER_HAP_MASK) ==
+			   rw_val) {
+			tte[index] &= ~TTBL_STAGE2_LOWER_HAP_MASK;
+			tte[index] |= ro_val;
+			cpu_mmu_sync_tte(&tte[index]);
+			*flush = TRUE;
+		}
+		vmm_spin_unlock_irqrestore_lite(&ttbl->tbl_lock, flags);
+
+		ia = next;
+	}
+}
+
+int mmu_lpae_wrprotect_range(struct cpu_ttbl *ttbl,
+			     physical_addr_t ia, physical_size_t sz)
+{
+	bool flush = FALSE;
+	physical_addr_t end;
+
+	if (!ttbl) {
+		return VMM_EFAIL;
+	}
+	if (ttbl->stage != TTBL_STAGE2) {
+		return VMM_EINVALID;
+	}
+	if (!sz) {
+		return VMM_OK;
+	}
+
+	ia &= TTBL_L3_MAP_MASK;
+	end = ia + sz;
+	if (end < ia) {
+		end = ~((physical_addr_t)0) & TTBL_L3_MAP_MASK;
+	}
+
+	mmu_lpae_ttbl_wrprotect_range(ttbl, ia, end, &flush);
+
+	/* Single TLB invalidation for the whole range */
+	if (flush) {
+		cpu_invalid_ipa_guest_tlb(ia);
+	}
+
+	return VMM_OK;
+}
+
 int mmu_lpae_get_hypervisor_page(virtual_addr_t va, struct cpu_page *pg)
 {
 	return mmu_lpae_get_page(mmuctrl.hyp_ttbl, va, pg);
@@ -34,8 +34,10 @@
 #include <vmm_vcpu_irq.h>
 #include <vmm_guest_aspace.h>
 #include <vmm_devemu.h>
+#include <vmm_guest_snapshot.h>
 #include <vmm_modules.h>
 #include <arch_regs.h>
+#include <libs/stringlib.h>
 #include <libs/bitmap.h>
 
 #include <vgic.h>
@@ -341,6 +343,8 @@ static bool __vgic_queue_sgi(struct vgic_guest_state *s,
 		}
 		if (__vgic_queue_irq(s, vs, c, irq)) {
 			source &= ~(1 << c);
+			vmm_vcpu_stats_event(&vs->vcpu->stats,
+					     VMM_VCPU_EVENT_IPI);
 		}
 	}
 
@@ -732,6 +736,8 @@ static vmm_irq_return_t vgic_maint_irq(int irq_no, void *dev)
 	BUG_ON(!vcpu->is_normal);
 	BUG_ON(!arm_vgic_avail(vcpu));
 
+	vmm_vcpu_stats_event(&vcpu->stats, VMM_VCPU_EVENT_VGIC_MAINT);
+
 	/* Get VGIC state pointers */
 	s = arm_vgic_priv(vcpu);
 	vs = &s->vstate[vcpu->subid];
@@ -1383,6 +1389,235 @@ static int vgic_dist_emulator_reset(struct vmm_emudev *edev)
 	return VMM_OK;
 }
 
+#define VGIC_SNAPSHOT_MAGIC		0x43494756 /* "VGIC" */
+#define VGIC_SNAPSHOT_VERSION		1
+
+static int vgic_snapshot_xfer(struct vmm_snapshot_stream *ss,
+			      void *buf, u32 len, bool save)
+{
+	return (save) ? vmm_snapshot_write(ss, buf, len) :
+			vmm_snapshot_read(ss, buf, len);
+}
+
+static int vgic_snapshot_xfer_hw(struct vmm_snapshot_stream *ss,
+				 struct vgic_hw_state *hw, bool save)
+{
+	int rc;
+	u32 lr_cnt = vgich.params.lr_cnt;
+
+	if (vgich.params.type == VGIC_V3) {
+		rc = vgic_snapshot_xfer(ss, &hw->v3.hcr,
+					sizeof(hw->v3.hcr), save);
+		if (!rc)
+			rc = vgic_snapshot_xfer(ss, &hw->v3.vmcr,
+						sizeof(hw->v3.vmcr), save);
+		if (!rc)
+			rc = vgic_snapshot_xfer(ss, hw->v3.ap0r,
+						sizeof(hw->v3.ap0r), save);
+		if (!rc)
+			rc = vgic_snapshot_xfer(ss, hw->v3.ap1r,
+						sizeof(hw->v3.ap1r), save);
+		if (!rc)
+			rc = vgic_snapshot_xfer(ss, hw->v3.lr,
+						lr_cnt * sizeof(u64), save);
+	} else {
+		rc = vgic_snapshot_xfer(ss, &hw->v2.hcr,
+					sizeof(hw->v2.hcr), save);
+		if (!rc)
+			rc = vgic_snapshot_xfer(ss, &hw->v2.vmcr,
+						sizeof(hw->v2.vmcr), save);
+		if (!rc)
+			rc = vgic_snapshot_xfer(ss, &hw->v2.apr,
+						sizeof(hw->v2.apr), save);
+		if (!rc)
+			rc = vgic_snapshot_xfer(ss, hw->v2.lr,
+						lr_cnt * sizeof(u32), save);
+	}
+
+	return rc;
+}
+
+/* Serialize VGIC state field by field so that snapshot format
+ * does not depend on layout of in-memory structures. The same
+ * field list is used for save and restore.
+ */
+static int vgic_snapshot_xfer_state(struct vmm_snapshot_stream *ss,
+				    struct vgic_guest_state *t, bool save)
+{
+	int rc;
+	u32 i, j, val[4];
+	u32 ncpu = VGIC_NUM_CPU(t), nirq = VGIC_NUM_IRQ(t);
+	u32 lr_words = (vgich.params.lr_cnt + 31) / 32;
+
+	rc = vgic_snapshot_xfer(ss, &t->enabled, sizeof(t->enabled), save);
+	if (rc)
+		return rc;
+
+	for (i = 0; i < nirq; i++) {
+		val[0] = t->irq_state[i].active;
+		val[1] = t->irq_state[i].level;
+		val[2] = t->irq_state[i].model;
+		val[3] = t->irq_state[i].trigger;
+		rc = vgic_snapshot_xfer(ss, val, sizeof(val), save);
+		if (!rc)
+			rc = vgic_snapshot_xfer(ss, &t->irq_target[i],
+						sizeof(t->irq_target[i]), save);
+		if (rc)
+			return rc;
+		t->irq_state[i].active = val[0];
+		t->irq_state[i].level = val[1];
+		t->irq_state[i].model = val[2];
+		t->irq_state[i].trigger = val[3];
+		if (i < 32) {
+			rc = vgic_snapshot_xfer(ss, t->priority1[i],
+						ncpu * sizeof(u32), save);
+		} else {
+			rc = vgic_snapshot_xfer(ss, &t->priority2[i - 32],
+						sizeof(u32), save);
+		}
+		if (rc)
+			return rc;
+	}
+
+	for (i = 0; i < ncpu; i++) {
+		rc = vgic_snapshot_xfer(ss, t->sgi_source[i],
+					sizeof(t->sgi_source[i]), save);
+		if (!rc)
+			rc = vgic_snapshot_xfer(ss, t->irq_enabled[i],
+					(nirq / 32) * sizeof(u32), save);
+		if (!rc)
+			rc = vgic_snapshot_xfer(ss, t->irq_pending[i],
+					(nirq / 32) * sizeof(u32), save);
+		if (!rc)
+			rc = vgic_snapshot_xfer_hw(ss, &t->vstate[i].hw, save);
+		if (!rc)
+			rc = vgic_snapshot_xfer(ss, &t->vstate[i].lr_used_count,
+					sizeof(t->vstate[i].lr_used_count),
+					save);
+		if (!rc)
+			rc = vgic_snapshot_xfer(ss, t->vstate[i].lr_used,
+					lr_words * sizeof(u32), save);
+		for (j = 0; !rc && (j < nirq); j++) {
+			rc = vgic_snapshot_xfer(ss, t->vstate[i].irq_lr[j],
+						ncpu, save);
+		}
+		if (rc)
+			return rc;
+	}
+
+	return VMM_OK;
+}
+
+static int vgic_dist_emulator_save(struct vmm_emudev *edev,
+				   struct vmm_snapshot_stream *ss)
+{
+	int rc;
+	irq_flags_t flags;
+	struct vgic_guest_state *t, *s = edev->priv;
+
+	/* Take a consistent copy so that we don't write
+	 * to snapshot stream with distributor lock held.
+	 */
+	t = vmm_malloc(sizeof(*t));
+	if (!t) {
+		return VMM_ENOMEM;
+	}
+
+	vmm_spin_lock_irqsave_lite(&s->dist_lock, flags);
+	memcpy(t, s, sizeof(*t));
+	vmm_spin_unlock_irqrestore_lite(&s->dist_lock, flags);
+
+	rc = vmm_snapshot_write_tag(ss, VGIC_SNAPSHOT_MAGIC,
+				    VGIC_SNAPSHOT_VERSION);
+	if (!rc)
+		rc = vmm_snapshot_write_u32(ss, VGIC_NUM_CPU(t));
+	if (!rc)
+		rc = vmm_snapshot_write_u32(ss, VGIC_NUM_IRQ(t));
+	if (!rc)
+		rc = vmm_snapshot_write_u32(ss, vgich.params.type);
+	if (!rc)
+		rc = vmm_snapshot_write_u32(ss, vgich.params.lr_cnt);
+	if (!rc)
+		rc = vgic_snapshot_xfer_state(ss, t, TRUE);
+
+	vmm_free(t);
+
+	return rc;
+}
+
+static int vgic_dist_emulator_restore(struct vmm_emudev *edev,
+				      struct vmm_snapshot_stream *ss)
+{
+	int rc;
+	u32 i, cfg[4];
+	irq_flags_t flags;
+	struct vgic_guest_state *t, *s = edev->priv;
+
+	rc = vmm_snapshot_read_tag(ss, VGIC_SNAPSHOT_MAGIC,
+				   VGIC_SNAPSHOT_VERSION);
+	if (!rc)
+		rc = vmm_snapshot_read(ss, cfg, sizeof(cfg));
+	if (rc) {
+		return rc;
+	}
+	if ((cfg[0] != VGIC_NUM_CPU(s)) || (cfg[1] != VGIC_NUM_IRQ(s)) ||
+	    (cfg[2] != vgich.params.type) || (cfg[3] != vgich.params.lr_cnt)) {
+		return VMM_EINVALID;
+	}
+
+	t = vmm_zalloc(sizeof(*t));
+	if (!t) {
+		return VMM_ENOMEM;
+	}
+	t->num_cpu = VGIC_NUM_CPU(s);
+	t->num_irq = VGIC_NUM_IRQ(s);
+
+	rc = vgic_snapshot_xfer_state(ss, t, FALSE);
+	if (rc) {
+		vmm_free(t);
+		return rc;
+	}
+
+	vmm_spin_lock_irqsave_lite(&s->dist_lock, flags);
+
+	s->enabled = t->enabled;
+	for (i = 0; i < VGIC_NUM_IRQ(s); i++) {
+		/* Host IRQ routing is owned by this host so keep it */
+		s->irq_state[i].active = t->irq_state[i].active;
+		s->irq_state[i].level = t->irq_state[i].level;
+		s->irq_state[i].model = t->irq_state[i].model;
+		s->irq_state[i].trigger = t->irq_state[i].trigger;
+		s->irq_target[i] = t->irq_target[i];
+	}
+	memcpy(s->sgi_source, t->sgi_source, sizeof(s->sgi_source));
+	memcpy(s->priority1, t->priority1, sizeof(s->priority1));
+	memcpy(s->priority2, t->priority2, sizeof(s->priority2));
+	memcpy(s->irq_enabled, t->irq_enabled, sizeof(s->irq_enabled));
+	memcpy(s->irq_pending, t->irq_pending, sizeof(s->irq_pending));
+	for (i = 0; i < VGIC_NUM_CPU(s); i++) {
+		s->vstate[i].hw = t->vstate[i].hw;
+		s->vstate[i].lr_used_count = t->vstate[i].lr_used_count;
+		memcpy(s->vstate[i].lr_used, t->vstate[i].lr_used,
+		       sizeof(s->vstate[i].lr_used));
+		memcpy(s->vstate[i].irq_lr, t->vstate[i].irq_lr,
+		       sizeof(s->vstate[i].irq_lr));
+	}
+
+	for (i = 0; i < VGIC_NUM_IRQ(s); i++) {
+		if (VGIC_TEST_ENABLED(s, i, VGIC_ALL_CPU_MASK(s))) {
+			vmm_devemu_notify_irq_enabled(s->guest, i, -1);
+		} else {
+			vmm_devemu_notify_irq_disabled(s->guest, i, -1);
+		}
+	}
+
+	vmm_spin_unlock_irqrestore_lite(&s->dist_lock, flags);
+
+	vmm_free(t);
+
+	return VMM_OK;
+}
+
 static struct vmm_devemu_irqchip vgic_irqchip = {
 	.name = "VGIC",
 	.handle = vgic_irq_handle,
@@ -1540,6 +1775,8 @@ static struct vmm_emulator vgic_dist_emulator = {
 	.probe = vgic_dist_emulator_probe,
 	.remove = vgic_dist_emulator_remove,
 	.reset = vgic_dist_emulator_reset,
+	.save = vgic_dist_emulator_save,
+	.restore = vgic_dist_emulator_restore,
 	.read8 = vgic_dist_emulator_read8,
 	.write8 = vgic_dist_emulator_write8,
 	.read16 = vgic_dist_emulator_read16,
@@ -1554,6 +1791,20 @@ static int vgic_cpu_emulator_reset(struct vmm_emudev *edev)
 	return VMM_OK;
 }
 
+static int vgic_cpu_emulator_save(struct vmm_emudev *edev,
+				  struct vmm_snapshot_stream *ss)
+{
+	/* CPU interface state is part of vgic-dist snapshot */
+	return VMM_OK;
+}
+
+static int vgic_cpu_emulator_restore(struct vmm_emudev *edev,
+				     struct vmm_snapshot_stream *ss)
+{
+	/* CPU interface state is part of vgic-dist snapshot */
+	return VMM_OK;
+}
+
 static int vgic_cpu_emulator_probe(struct vmm_guest *guest,
 				   struct vmm_emudev *edev,
 				   const struct vmm_devtree_nodeid *eid)
@@ -1596,6 +1847,8 @@ static struct vmm_emulator vgic_cpu_emulator = {
 	.probe = vgic_cpu_emulator_probe,
 	.remove = vgic_cpu_emulator_remove,
 	.reset = vgic_cpu_emulator_reset,
+	.save = vgic_cpu_emulator_save,
+	.restore = vgic_cpu_emulator_restore,
 };
 
 static void vgic_enable_maint_irq(void *arg0, void *arg1, void *arg3)
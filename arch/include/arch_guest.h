@@ -57,4 +57,22 @@ int arch_guest_add_region(struct vmm_guest *guest, struct vmm_region *region);
  */
 int arch_guest_del_region(struct vmm_guest *guest, struct vmm_region *region);
 
+/** Architecture specific callback to write-protect guest RAM
+ *
+ * Remove write access from all stage2 (or nested page table)
+ * mappings of a guest physical address range within a guest RAM
+ * region so that next write to each page of the range traps to
+ * hypervisor. This is used by the core code for guest dirty page
+ * logging and dirty tracking of ranges.
+ *
+ * @param guest Guest to which the range belongs.
+ * @param gphys_addr Guest physical address of the range (page aligned).
+ * @param size Size of the range (multiple of page size).
+ * @return This function should return VMM_OK on success or
+ * appropriate error code otherwise.
+ */
+int arch_guest_wrprotect_range(struct vmm_guest *guest,
+			       physical_addr_t gphys_addr,
+			       physical_size_t size);
+
 #endif
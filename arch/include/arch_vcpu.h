@@ -27,6 +27,8 @@
 #include <vmm_chardev.h>
 #include <vmm_manager.h>
 
+struct vmm_snapshot_stream;
+
 /** Architecture specific VCPU Initialization */
 int arch_vcpu_init(struct vmm_vcpu *vcpu);
 
@@ -65,6 +67,12 @@ void arch_vcpu_preempt_orphan(void);
 /** Print architecture specific registers of a VCPU */
 void arch_vcpu_regs_dump(struct vmm_chardev *cdev, struct vmm_vcpu *vcpu);
 
+/** Save architecture specific state of a non-running VCPU */
+int arch_vcpu_save(struct vmm_vcpu *vcpu, struct vmm_snapshot_stream *ss);
+
+/** Restore architecture specific state of a non-running VCPU */
+int arch_vcpu_restore(struct vmm_vcpu *vcpu, struct vmm_snapshot_stream *ss);
+
 /** Print architecture specific stats for a VCPU */
 void arch_vcpu_stat_dump(struct vmm_chardev *cdev, struct vmm_vcpu *vcpu);
 
@@ -136,6 +136,9 @@ enum {
 	CPUID_FEAT_EDX_PBE          = 1 << 31
 };
 
+/* Structured extended feature flags (CPUID_BASE_FEAT_FLAGS, subleaf 0) */
+#define CPUID_FEAT7_EBX_ERMS		(1 << 9) /* Enhanced REP MOVSB/STOSB */
+
 enum cpuid_requests {
 	CPUID_BASE_VENDORSTRING,
 	CPUID_BASE_FEATURES,
@@ -122,6 +122,17 @@ int arch_guest_del_region(struct vmm_guest *guest, struct vmm_region *region)
 	return VMM_OK;
 }
 
+int arch_guest_wrprotect_range(struct vmm_guest *guest,
+			       physical_addr_t gphys_addr,
+			       physical_size_t size)
+{
+	/*
+	 * Guest RAM is mapped using per-VCPU shadow page tables
+	 * which do not track write faults for dirty logging.
+	 */
+	return VMM_ENOTSUPP;
+}
+
 static void guest_cmos_init(struct vmm_guest *guest)
 {
 	int val;
@@ -22,10 +22,98 @@
  */
 
 #include <vmm_types.h>
+#include <vmm_compiler.h>
+#include <cpu_features.h>
+#include <libs/stringlib.h>
+
+/*
+ * Copies below this size are done using REP MOVSQ plus a short
+ * REP MOVSB tail even on CPUs with enhanced REP MOVSB (ERMS) because
+ * REP MOVSB has a higher startup cost for small sizes.
+ *
+ * Note: We don't use SSE/AVX here because guest FPU/vector state is
+ * not saved when we enter hypervisor hence it cannot be clobbered.
+ */
+#define REP_MOVSB_THRESHOLD	256
+
+static int rep_good = -1;
+
+static bool cpu_has_erms(void)
+{
+	u32 a, b, c, d;
+
+	if (likely(rep_good >= 0)) {
+		return (rep_good) ? TRUE : FALSE;
+	}
+
+	cpuid(CPUID_BASE_VENDORSTRING, &a, &b, &c, &d);
+	if (a >= CPUID_BASE_FEAT_FLAGS) {
+		asm volatile("cpuid\n\t"
+			     :"=a"(a), "=b"(b), "=c"(c), "=d"(d)
+			     :"0"(CPUID_BASE_FEAT_FLAGS), "2"(0));
+		rep_good = (b & CPUID_FEAT7_EBX_ERMS) ? 1 : 0;
+	} else {
+		rep_good = 0;
+	}
+
+	return (rep_good) ? TRUE : FALSE;
+}
 
 void *memcpy(void *dest, const void *src, size_t count)
 {
-	int d0, d1, d2;
+	long d0, d1, d2;
+
+	if ((count >= REP_MOVSB_THRESHOLD) && cpu_has_erms()) {
+		asm volatile("rep ; movsb\n\t"
+			     :"=&c"(d0), "=&D"(d1), "=&S"(d2)
+			     :"0"(count), "1"((long)dest), "2"((long)src)
+			     :"memory");
+		return dest;
+	}
+
+	asm volatile("rep ; movsq\n\t"
+		     "movq %4, %%rcx\n\t"
+		     "andq $7, %%rcx\n\t"
+		     "jz 1f\n\t"
+		     "rep ; movsb\n\t"
+		     "1:"
+		     :"=&c"(d0), "=&D"(d1), "=&S"(d2)
+		     :"0"(count / 8), "g"(count), "1"((long)dest), "2"((long)src)
+		     :"memory");
+
+	return dest;
+}
+
+void *memset(void *dest, int c, size_t count)
+{
+	long d0, d1;
+	u64 val = 0x0101010101010101ULL * (u8)c;
+
+	if ((count >= REP_MOVSB_THRESHOLD) && cpu_has_erms()) {
+		asm volatile("rep ; stosb\n\t"
+			     :"=&c"(d0), "=&D"(d1)
+			     :"0"(count), "1"((long)dest), "a"(val)
+			     :"memory");
+		return dest;
+	}
+
+	asm volatile("rep ; stosq\n\t"
+		     "movq %3, %%rcx\n\t"
+		     "andq $7, %%rcx\n\t"
+		     "jz 1f\n\t"
+		     "rep ; stosb\n\t"
+		     "1:"
+		     :"=&c"(d0), "=&D"(d1)
+		     :"0"(count / 8), "g"(count), "1"((long)dest), "a"(val)
+		     :"memory");
+
+	return dest;
+}
+
+/* Previous memcpy (REP MOVSL) kept as baseline for memory bench */
+void *memcpy_baseline(void *dest, const void *src, size_t count)
+{
+	long d0, d1, d2;
 
 	asm volatile("rep ; movsl\n\t"
 		     "movl %4, %%ecx\n\t"
@@ -34,8 +122,15 @@ void *memcpy(void *dest, const void *src, size_t count)
 		     "rep ; movsb\n\t"
 		     "1:"
 		     :"=&c"(d0), "=&D"(d1), "=&S"(d2)
-		     :""(count/4), "g"(count), "1"((long)dest), "2"((long)src)
+		     :"0"(count / 4), "g"(count),
+		      "1"((long)dest), "2"((long)src)
 		     :"memory");
 
 	return dest;
 }
+
+/* Previous memset was the generic one */
+void *memset_baseline(void *dest, int c, size_t count)
+{
+	return memset_generic(dest, c, count);
+}
@@ -27,6 +27,7 @@
 #include <vmm_manager.h>
 #include <vmm_host_aspace.h>
 #include <vmm_guest_aspace.h>
+#include <vmm_guest_snapshot.h>
 #include <cpu_mmu.h>
 #include <cpu_features.h>
 #include <cpu_vm.h>
@@ -300,6 +301,18 @@ void dump_vcpu_regs(arch_regs_t *regs)
 	__dump_vcpu_regs(NULL, regs);
 }
 
+int arch_vcpu_save(struct vmm_vcpu *vcpu, struct vmm_snapshot_stream *ss)
+{
+	/* For now VCPU snapshot not supported */
+	return VMM_ENOTSUPP;
+}
+
+int arch_vcpu_restore(struct vmm_vcpu *vcpu, struct vmm_snapshot_stream *ss)
+{
+	/* For now VCPU snapshot not supported */
+	return VMM_ENOTSUPP;
+}
+
 void arch_vcpu_stat_dump(struct vmm_chardev *cdev, struct vmm_vcpu *vcpu)
 {
 	/* For now no arch specific stats */
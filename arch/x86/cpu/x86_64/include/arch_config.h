@@ -28,5 +28,8 @@
 
 #define ARCH_HAS_EXTABLE
 #define ARCH_HAS_MEMCPY
+#define ARCH_HAS_MEMSET
+#define ARCH_HAS_MEMCPY_BASELINE
+#define ARCH_HAS_MEMSET_BASELINE
 
 #endif /* _ARCH_CONFIG_H__ */
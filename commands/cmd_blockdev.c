@@ -29,6 +29,7 @@
 #include <vmm_heap.h>
 #include <block/vmm_blockdev.h>
 #include <libs/stringlib.h>
+#include <libs/mathlib.h>
 
 #define MODULE_DESC			"Command blockdev"
 #define MODULE_AUTHOR			"Anup Patel"
@@ -43,6 +44,7 @@ static void cmd_blockdev_usage(struct vmm_chardev *cdev)
 	vmm_cprintf(cdev, "   blockdev help\n");
 	vmm_cprintf(cdev, "   blockdev list\n");
 	vmm_cprintf(cdev, "   blockdev info <name>\n");
+	vmm_cprintf(cdev, "   blockdev stats <name>\n");
 	vmm_cprintf(cdev, "   blockdev dump8 <name> [length] [offset]\n");
 }
 
@@ -58,10 +60,72 @@ static int cmd_blockdev_info(struct vmm_chardev *cdev,
 	vmm_cprintf(cdev, "Start LBA  : %"PRIu64"\n", bdev->start_lba);
 	vmm_cprintf(cdev, "Block Size : %"PRIu32"\n", bdev->block_size);
 	vmm_cprintf(cdev, "Block Count: %"PRIu64"\n", bdev->num_blocks);
+	vmm_cprintf(cdev, "Discard    : %"PRIu32" blocks max\n",
+		    vmm_blockdev_max_discard_blocks(bdev));
+	vmm_cprintf(cdev, "WriteZeroes: %"PRIu32" blocks max\n",
+		    vmm_blockdev_max_write_zeroes_blocks(bdev));
 
 	return VMM_OK;
 }
 
+static int cmd_blockdev_stats(struct vmm_chardev *cdev,
+			      struct vmm_blockdev *bdev)
+{
+	int b, rc;
+	u32 pending, backlog;
+	struct vmm_request_queue_stats *stats;
+
+	stats = vmm_zalloc(sizeof(*stats));
+	if (!stats) {
+		return VMM_ENOMEM;
+	}
+
+	rc = vmm_blockdev_get_stats(bdev, stats, &pending, &backlog);
+	if (rc) {
+		vmm_cprintf(cdev, "Error: no request queue for %s\n",
+			    bdev->name);
+		goto done;
+	}
+
+	vmm_cprintf(cdev, "Name          : %s\n", bdev->name);
+	vmm_cprintf(cdev, "Submitted     : %"PRIu64"\n", stats->submitted);
+	vmm_cprintf(cdev, "Completed     : %"PRIu64"\n", stats->completed);
+	vmm_cprintf(cdev, "Failed        : %"PRIu64"\n", stats->failed);
+	vmm_cprintf(cdev, "Dispatched    : %"PRIu64"\n", stats->dispatched);
+	vmm_cprintf(cdev, "Merged        : %"PRIu64" (%"PRIu64"%%)\n",
+		    stats->merged, (stats->submitted) ?
+		    udiv64(stats->merged * 100, stats->submitted) : 0);
+	vmm_cprintf(cdev, "Queue Depth   : cur %"PRIu32" (backlog %"PRIu32") "
+		    "avg %"PRIu64" max %"PRIu32"\n", pending + backlog,
+		    backlog, (stats->submitted) ?
+		    udiv64(stats->depth_sum, stats->submitted) : 0,
+		    stats->depth_max);
+
+	vmm_cprintf(cdev, "Latency (ns)  :\n");
+	for (b = 0; b < VMM_REQUEST_LAT_BUCKETS; b++) {
+		if (!stats->lat_hist[b]) {
+			continue;
+		}
+		if (b == 0) {
+			vmm_cprintf(cdev, "  %10s - %-10u : ", "0",
+				    (1U << VMM_REQUEST_LAT_SHIFT) - 1);
+		} else if (b == (VMM_REQUEST_LAT_BUCKETS - 1)) {
+			vmm_cprintf(cdev, "  %10u - %-10s : ",
+				    1U << (b - 1 + VMM_REQUEST_LAT_SHIFT),
+				    "inf");
+		} else {
+			vmm_cprintf(cdev, "  %10u - %-10u : ",
+				    1U << (b - 1 + VMM_REQUEST_LAT_SHIFT),
+				    (1U << (b + VMM_REQUEST_LAT_SHIFT)) - 1);
+		}
+		vmm_cprintf(cdev, "%"PRIu64"\n", stats->lat_hist[b]);
+	}
+
+done:
+	vmm_free(stats);
+	return rc;
+}
+
 static int cmd_blockdev_list_iter(struct vmm_blockdev *bdev, void *data)
 {
 	struct vmm_chardev *cdev = data;
@@ -164,6 +228,8 @@ static int cmd_blockdev_exec(struct vmm_chardev *cdev, int argc, char **argv)
 
 		if (strcmp(argv[1], "info") == 0) {
 			return cmd_blockdev_info(cdev, bdev);
+		} else if (strcmp(argv[1], "stats") == 0) {
+			return cmd_blockdev_stats(cdev, bdev);
 		} else if (strcmp(argv[1], "dump8") == 0) {
 			return cmd_blockdev_dump8(cdev, bdev,
 						 argc - 3, argv + 3);
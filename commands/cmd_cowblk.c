@@ -0,0 +1,198 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file cmd_cowblk.c
+ * @author agent (agent@local)
+ * @brief Implementation of cowblk command
+ */
+
+#include <vmm_error.h>
+#include <vmm_stdio.h>
+#include <vmm_modules.h>
+#include <vmm_cmdmgr.h>
+#include <libs/stringlib.h>
+#include <drv/cowblk.h>
+
+#define MODULE_DESC			"Command cowblk"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		0
+#define	MODULE_INIT			cmd_cowblk_init
+#define	MODULE_EXIT			cmd_cowblk_exit
+
+static void cmd_cowblk_usage(struct vmm_chardev *cdev)
+{
+	vmm_cprintf(cdev, "Usage:\n");
+	vmm_cprintf(cdev, "   cowblk help\n");
+	vmm_cprintf(cdev, "   cowblk list\n");
+	vmm_cprintf(cdev, "   cowblk format <base_bdev> <layer_bdev> "
+			  "[<cluster_bits>]\n");
+	vmm_cprintf(cdev, "   cowblk create <name> <base_bdev> "
+			  "<layer_bdev>\n");
+	vmm_cprintf(cdev, "   cowblk destroy <name>\n");
+	vmm_cprintf(cdev, "Note:\n");
+	vmm_cprintf(cdev, "   format erases overlay state of write layer "
+			  "<layer_bdev>\n");
+	vmm_cprintf(cdev, "   <cluster_bits> is from %d to %d "
+			  "(default %d)\n",
+			  COWBLK_MIN_CLUSTER_BITS,
+			  COWBLK_MAX_CLUSTER_BITS,
+			  COWBLK_DEF_CLUSTER_BITS);
+}
+
+static int cmd_cowblk_list(struct vmm_chardev *cdev)
+{
+	int num, count;
+	char used[32];
+	struct cowblk *cb;
+
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "----------------------------------------\n");
+	vmm_cprintf(cdev, " %-16s %-16s %-16s %-8s %-18s\n",
+			  "Name", "Base", "Write Layer", "Cluster",
+			  "Used Clusters");
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "----------------------------------------\n");
+	count = cowblk_count();
+	for (num = 0; num < count; num++) {
+		cb = cowblk_get(num);
+		if (!cb) {
+			break;
+		}
+		vmm_snprintf(used, sizeof(used), "%d/%d",
+			     cb->used_slots, cb->max_slots);
+		vmm_cprintf(cdev, " %-16s %-16s %-16s %-8d %-18s\n",
+			    cb->bdev->name,
+			    (cb->base) ? cb->base_name : "---",
+			    (cb->layer) ? cb->layer_name : "---",
+			    cowblk_cluster_size(cb), used);
+	}
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "----------------------------------------\n");
+
+	return VMM_OK;
+}
+
+static int cmd_cowblk_format(struct vmm_chardev *cdev,
+			     const char *base_name,
+			     const char *layer_name,
+			     u32 cluster_bits)
+{
+	int rc;
+
+	rc = cowblk_format(base_name, layer_name, cluster_bits);
+	if (rc) {
+		vmm_cprintf(cdev, "Failed to format %s for overlay of %s "
+			    "(error %d)\n", layer_name, base_name, rc);
+		return rc;
+	}
+
+	vmm_cprintf(cdev, "Formatted %s for overlay of %s\n",
+		    layer_name, base_name);
+
+	return VMM_OK;
+}
+
+static int cmd_cowblk_create(struct vmm_chardev *cdev, const char *name,
+			     const char *base_name, const char *layer_name)
+{
+	struct cowblk *cb;
+
+	cb = cowblk_create(name, base_name, layer_name);
+	if (!cb) {
+		vmm_cprintf(cdev, "Failed to create %s COWBLK instance\n",
+			    name);
+		return VMM_EFAIL;
+	}
+
+	vmm_cprintf(cdev, "Created %s COWBLK instance\n", name);
+
+	return VMM_OK;
+}
+
+static int cmd_cowblk_destroy(struct vmm_chardev *cdev, const char *name)
+{
+	struct cowblk *cb = cowblk_find(name);
+
+	if (!cb) {
+		vmm_cprintf(cdev, "Failed to find %s COWBLK instance\n",
+			    name);
+		return VMM_ENOTAVAIL;
+	}
+
+	cowblk_destroy(cb);
+
+	vmm_cprintf(cdev, "Destroyed %s COWBLK instance\n", name);
+
+	return VMM_OK;
+}
+
+static int cmd_cowblk_exec(struct vmm_chardev *cdev, int argc, char **argv)
+{
+	u32 cluster_bits = 0;
+
+	if (argc <= 1) {
+		goto fail;
+	}
+
+	if (strcmp(argv[1], "help") == 0) {
+		cmd_cowblk_usage(cdev);
+		return VMM_OK;
+	} else if ((strcmp(argv[1], "list") == 0) && (argc == 2)) {
+		return cmd_cowblk_list(cdev);
+	} else if ((strcmp(argv[1], "format") == 0) &&
+		   ((argc == 4) || (argc == 5))) {
+		if (argc == 5) {
+			cluster_bits = strtoul(argv[4], NULL, 0);
+		}
+		return cmd_cowblk_format(cdev, argv[2], argv[3],
+					 cluster_bits);
+	} else if ((strcmp(argv[1], "create") == 0) && (argc == 5)) {
+		return cmd_cowblk_create(cdev, argv[2], argv[3], argv[4]);
+	} else if ((strcmp(argv[1], "destroy") == 0) && (argc == 3)) {
+		return cmd_cowblk_destroy(cdev, argv[2]);
+	}
+
+fail:
+	cmd_cowblk_usage(cdev);
+	return VMM_EFAIL;
+}
+
+static struct vmm_cmd cmd_cowblk = {
+	.name = "cowblk",
+	.desc = "copy-on-write overlay block device commands",
+	.usage = cmd_cowblk_usage,
+	.exec = cmd_cowblk_exec,
+};
+
+static int __init cmd_cowblk_init(void)
+{
+	return vmm_cmdmgr_register_cmd(&cmd_cowblk);
+}
+
+static void __exit cmd_cowblk_exit(void)
+{
+	vmm_cmdmgr_unregister_cmd(&cmd_cowblk);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+			MODULE_AUTHOR,
+			MODULE_LICENSE,
+			MODULE_IPRIORITY,
+			MODULE_INIT,
+			MODULE_EXIT);
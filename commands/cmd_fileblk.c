@@ -0,0 +1,200 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file cmd_fileblk.c
+ * @author agent (agent@local)
+ * @brief Implementation of fileblk command
+ */
+
+#include <vmm_error.h>
+#include <vmm_stdio.h>
+#include <vmm_modules.h>
+#include <vmm_cmdmgr.h>
+#include <libs/stringlib.h>
+#include <drv/fileblk.h>
+
+#define MODULE_DESC			"Command fileblk"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		0
+#define	MODULE_INIT			cmd_fileblk_init
+#define	MODULE_EXIT			cmd_fileblk_exit
+
+static void cmd_fileblk_usage(struct vmm_chardev *cdev)
+{
+	vmm_cprintf(cdev, "Usage:\n");
+	vmm_cprintf(cdev, "   fileblk help\n");
+	vmm_cprintf(cdev, "   fileblk list\n");
+	vmm_cprintf(cdev, "   fileblk format <path> <size> "
+			  "[<cluster_bits>]\n");
+	vmm_cprintf(cdev, "   fileblk create <name> <path> [ro]\n");
+	vmm_cprintf(cdev, "   fileblk destroy <name>\n");
+	vmm_cprintf(cdev, "Note:\n");
+	vmm_cprintf(cdev, "   format creates a sparse image whereas "
+			  "create accepts raw or sparse image\n");
+	vmm_cprintf(cdev, "   <cluster_bits> is from %d to %d "
+			  "(default %d)\n",
+			  FILEBLK_SPARSE_MIN_CLUSTER_BITS,
+			  FILEBLK_SPARSE_MAX_CLUSTER_BITS,
+			  FILEBLK_SPARSE_DEF_CLUSTER_BITS);
+}
+
+static int cmd_fileblk_list(struct vmm_chardev *cdev)
+{
+	int num, count;
+	char size[32], used[32];
+	struct fileblk *fb;
+
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "----------------------------------------\n");
+	vmm_cprintf(cdev, " %-16s %-6s %-3s %-12s %-12s %-24s\n",
+			  "Name", "Type", "RO", "Size", "Used", "Path");
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "----------------------------------------\n");
+	count = fileblk_count();
+	for (num = 0; num < count; num++) {
+		fb = fileblk_get(num);
+		if (!fb) {
+			break;
+		}
+		vmm_snprintf(size, sizeof(size), "%"PRIu64"K",
+			     fb->size >> 10);
+		vmm_snprintf(used, sizeof(used), "%"PRIu64"K",
+			     fb->file_size >> 10);
+		vmm_cprintf(cdev, " %-16s %-6s %-3s %-12s %-12s %-24s\n",
+			    fb->bdev->name,
+			    (fileblk_is_sparse(fb)) ? "sparse" : "raw",
+			    (fb->read_only) ? "yes" : "no",
+			    size, used, fb->path);
+	}
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "----------------------------------------\n");
+
+	return VMM_OK;
+}
+
+static int cmd_fileblk_format(struct vmm_chardev *cdev, const char *path,
+			      u64 size, u32 cluster_bits)
+{
+	int rc;
+
+	rc = fileblk_format_sparse(path, size, cluster_bits);
+	if (rc) {
+		vmm_cprintf(cdev, "Failed to format %s (error %d)\n",
+			    path, rc);
+		return rc;
+	}
+
+	vmm_cprintf(cdev, "Formatted %s as %"PRIu64" bytes sparse image\n",
+		    path, size);
+
+	return VMM_OK;
+}
+
+static int cmd_fileblk_create(struct vmm_chardev *cdev, const char *name,
+			      const char *path, bool read_only)
+{
+	struct fileblk *fb;
+
+	fb = fileblk_create(name, path, read_only);
+	if (!fb) {
+		vmm_cprintf(cdev, "Failed to create %s FILEBLK instance\n",
+			    name);
+		return VMM_EFAIL;
+	}
+
+	vmm_cprintf(cdev, "Created %s FILEBLK instance\n", name);
+
+	return VMM_OK;
+}
+
+static int cmd_fileblk_destroy(struct vmm_chardev *cdev, const char *name)
+{
+	struct fileblk *fb = fileblk_find(name);
+
+	if (!fb) {
+		vmm_cprintf(cdev, "Failed to find %s FILEBLK instance\n",
+			    name);
+		return VMM_ENOTAVAIL;
+	}
+
+	fileblk_destroy(fb);
+
+	vmm_cprintf(cdev, "Destroyed %s FILEBLK instance\n", name);
+
+	return VMM_OK;
+}
+
+static int cmd_fileblk_exec(struct vmm_chardev *cdev, int argc, char **argv)
+{
+	u64 size;
+	u32 cluster_bits = 0;
+
+	if (argc <= 1) {
+		goto fail;
+	}
+
+	if (strcmp(argv[1], "help") == 0) {
+		cmd_fileblk_usage(cdev);
+		return VMM_OK;
+	} else if ((strcmp(argv[1], "list") == 0) && (argc == 2)) {
+		return cmd_fileblk_list(cdev);
+	} else if ((strcmp(argv[1], "format") == 0) &&
+		   ((argc == 4) || (argc == 5))) {
+		size = strtoull(argv[3], NULL, 0);
+		if (argc == 5) {
+			cluster_bits = strtoul(argv[4], NULL, 0);
+		}
+		return cmd_fileblk_format(cdev, argv[2], size, cluster_bits);
+	} else if ((strcmp(argv[1], "create") == 0) && (argc == 4)) {
+		return cmd_fileblk_create(cdev, argv[2], argv[3], FALSE);
+	} else if ((strcmp(argv[1], "create") == 0) && (argc == 5) &&
+		   (strcmp(argv[4], "ro") == 0)) {
+		return cmd_fileblk_create(cdev, argv[2], argv[3], TRUE);
+	} else if ((strcmp(argv[1], "destroy") == 0) && (argc == 3)) {
+		return cmd_fileblk_destroy(cdev, argv[2]);
+	}
+
+fail:
+	cmd_fileblk_usage(cdev);
+	return VMM_EFAIL;
+}
+
+static struct vmm_cmd cmd_fileblk = {
+	.name = "fileblk",
+	.desc = "file backed block device commands",
+	.usage = cmd_fileblk_usage,
+	.exec = cmd_fileblk_exec,
+};
+
+static int __init cmd_fileblk_init(void)
+{
+	return vmm_cmdmgr_register_cmd(&cmd_fileblk);
+}
+
+static void __exit cmd_fileblk_exit(void)
+{
+	vmm_cmdmgr_unregister_cmd(&cmd_fileblk);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+			MODULE_AUTHOR,
+			MODULE_LICENSE,
+			MODULE_IPRIORITY,
+			MODULE_INIT,
+			MODULE_EXIT);
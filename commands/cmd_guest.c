@@ -30,7 +30,13 @@
 #include <vmm_modules.h>
 #include <vmm_cmdmgr.h>
 #include <vmm_devemu.h>
+#include <vmm_heap.h>
+#include <vmm_guest_snapshot.h>
 #include <libs/stringlib.h>
+#include <libs/mathlib.h>
+#if IS_ENABLED(CONFIG_VFS)
+#include <libs/vfs.h>
+#endif
 
 #define MODULE_DESC			"Command guest"
 #define MODULE_AUTHOR			"Anup Patel"
@@ -55,9 +61,23 @@ static void cmd_guest_usage(struct vmm_chardev *cdev)
 			  "[mem_sz]\n");
 	vmm_cprintf(cdev, "   guest region_list <guest_name>\n");
 	vmm_cprintf(cdev, "   guest region  <guest_name> <gphys_addr>\n");
+	vmm_cprintf(cdev, "   guest ram_blocks <guest_name>\n");
+	vmm_cprintf(cdev, "   guest dirty_log <guest_name> "
+			  "start|stop|show|fetch\n");
+	vmm_cprintf(cdev, "   guest stats   <guest_name>\n");
+	vmm_cprintf(cdev, "   guest stats_reset <guest_name>\n");
+#if IS_ENABLED(CONFIG_VFS)
+	vmm_cprintf(cdev, "   guest snapshot <guest_name> <path_to_file> "
+			  "[compress]\n");
+	vmm_cprintf(cdev, "   guest restore <guest_name> <path_to_file>\n");
+#endif
 	vmm_cprintf(cdev, "Note:\n");
 	vmm_cprintf(cdev, "   <guest_name> = node name under /guests "
 			  "device tree node\n");
+#if IS_ENABLED(CONFIG_VFS)
+	vmm_cprintf(cdev, "   snapshot and restore require guest to be "
+			  "paused or reset\n");
+#endif
 }
 
 static int guest_list_iter(struct vmm_guest *guest, void *priv)
@@ -377,6 +397,359 @@ static int cmd_guest_region(struct vmm_chardev *cdev, const char *name,
 	return VMM_OK;
 }
 
+static int cmd_guest_ram_blocks(struct vmm_chardev *cdev, const char *name)
+{
+	char str[16];
+	physical_size_t total;
+	struct vmm_guest_ram_blocks blks;
+	struct vmm_guest *guest = vmm_manager_guest_find(name);
+
+	if (!guest) {
+		vmm_cprintf(cdev, "Failed to find guest\n");
+		return VMM_ENOTAVAIL;
+	}
+
+	vmm_guest_ram_block_usage(guest, &blks);
+	total = blks.size_1g + blks.size_2m + blks.size_page;
+
+	str[0] = '\0';
+	u64_to_size_str(total, str, sizeof(str));
+	vmm_cprintf(cdev, "Guest RAM total              : %s\n", str);
+
+	str[0] = '\0';
+	u64_to_size_str(blks.size_1g, str, sizeof(str));
+	vmm_cprintf(cdev, "Guest RAM with 1GB blocks    : %s (%"PRIu64"%%)\n",
+		    str, (total) ? udiv64(blks.size_1g * 100, total) : 0);
+
+	str[0] = '\0';
+	u64_to_size_str(blks.size_2m, str, sizeof(str));
+	vmm_cprintf(cdev, "Guest RAM with 2MB blocks    : %s (%"PRIu64"%%)\n",
+		    str, (total) ? udiv64(blks.size_2m * 100, total) : 0);
+
+	str[0] = '\0';
+	u64_to_size_str(blks.size_page, str, sizeof(str));
+	vmm_cprintf(cdev, "Guest RAM with pages         : %s (%"PRIu64"%%)\n",
+		    str, (total) ? udiv64(blks.size_page * 100, total) : 0);
+
+	return VMM_OK;
+}
+
+struct cmd_guest_dirty_log_priv {
+	struct vmm_chardev *cdev;
+	bool clear;
+	u32 total_pages;
+	u32 dirty_pages;
+};
+
+static void cmd_guest_dirty_log_iter(struct vmm_guest *guest,
+				     struct vmm_region *reg,
+				     void *priv)
+{
+	int rc;
+	u32 pages, dirty = 0;
+	struct cmd_guest_dirty_log_priv *p = priv;
+
+	rc = vmm_guest_dirty_log_fetch(guest, reg, NULL, p->clear, &dirty);
+	if (rc == VMM_ENOENT) {
+		return;
+	}
+	pages = vmm_guest_dirty_log_pages(reg);
+
+	vmm_cprintf(p->cdev, " %-16s 0x%"PRIPADDR" %-10d %-10d",
+		    VMM_REGION_NAME(reg), VMM_REGION_GPHYS_START(reg),
+		    pages, dirty);
+	if (rc) {
+		vmm_cprintf(p->cdev, " (error %d)", rc);
+	}
+	vmm_cprintf(p->cdev, "\n");
+
+	p->total_pages += pages;
+	p->dirty_pages += dirty;
+}
+
+static int cmd_guest_dirty_log(struct vmm_chardev *cdev, const char *name,
+			       const char *action)
+{
+	int rc;
+	u64 elapsed_msecs;
+	struct cmd_guest_dirty_log_priv p;
+	struct vmm_guest_dirty_log_stats stats;
+	struct vmm_guest *guest = vmm_manager_guest_find(name);
+
+	if (!guest) {
+		vmm_cprintf(cdev, "Failed to find guest\n");
+		return VMM_ENOTAVAIL;
+	}
+
+	if (strcmp(action, "start") == 0) {
+		rc = vmm_guest_dirty_log_start(guest);
+		if (rc) {
+			vmm_cprintf(cdev, "%s: Failed to start dirty logging "
+				    "(error %d)\n", guest->name, rc);
+		}
+		return rc;
+	} else if (strcmp(action, "stop") == 0) {
+		rc = vmm_guest_dirty_log_stop(guest);
+		if (rc) {
+			vmm_cprintf(cdev, "%s: Failed to stop dirty logging "
+				    "(error %d)\n", guest->name, rc);
+		}
+		return rc;
+	} else if ((strcmp(action, "show") != 0) &&
+		   (strcmp(action, "fetch") != 0)) {
+		cmd_guest_usage(cdev);
+		return VMM_EFAIL;
+	}
+
+	vmm_guest_dirty_log_stats(guest, &stats);
+	if (!stats.enabled) {
+		vmm_cprintf(cdev, "%s: Dirty logging not started\n",
+			    guest->name);
+		return VMM_EINVALID;
+	}
+
+	p.cdev = cdev;
+	p.clear = (strcmp(action, "fetch") == 0) ? TRUE : FALSE;
+	p.total_pages = 0;
+	p.dirty_pages = 0;
+
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "--------------------\n");
+	vmm_cprintf(cdev, " %-16s %-18s %-10s %-10s\n",
+		    "Region", "Guest Physical", "Pages", "Dirty");
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "--------------------\n");
+	vmm_guest_iterate_region(guest, VMM_REGION_MEMORY,
+				 cmd_guest_dirty_log_iter, &p);
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "--------------------\n");
+
+	elapsed_msecs = udiv64(stats.elapsed_nsecs, 1000000ULL);
+	vmm_cprintf(cdev, "Dirty pages         : %d of %d\n",
+		    p.dirty_pages, p.total_pages);
+	vmm_cprintf(cdev, "Logging duration    : %"PRIu64" ms\n",
+		    elapsed_msecs);
+	vmm_cprintf(cdev, "Write faults        : %"PRIu64" (%"PRIu64
+		    " per second)\n", stats.faults,
+		    (elapsed_msecs) ?
+		    udiv64(stats.faults * 1000ULL, elapsed_msecs) : 0);
+	vmm_cprintf(cdev, "Write fault overhead: %"PRIu64" ns average, "
+		    "%"PRIu64" us total\n",
+		    (stats.faults) ?
+		    udiv64(stats.fault_nsecs, stats.faults) : 0,
+		    udiv64(stats.fault_nsecs, 1000ULL));
+
+	return VMM_OK;
+}
+
+static void cmd_guest_stats_iter(struct vmm_guest *guest,
+				 struct vmm_region *reg,
+				 void *priv)
+{
+	struct vmm_chardev *cdev = priv;
+	struct vmm_emudev *edev = reg->devemu_priv;
+
+	if (!(reg->flags & VMM_REGION_VIRTUAL) || !edev || !edev->emu) {
+		return;
+	}
+
+	vmm_cprintf(cdev, " %-16s %-16s %16"PRIu64" %16"PRIu64"\n",
+		    VMM_REGION_NAME(reg), edev->emu->name,
+		    arch_atomic64_read(&edev->read_count),
+		    arch_atomic64_read(&edev->write_count));
+}
+
+static void cmd_guest_stats_reset_iter(struct vmm_guest *guest,
+				       struct vmm_region *reg,
+				       void *priv)
+{
+	struct vmm_emudev *edev = reg->devemu_priv;
+
+	if (!(reg->flags & VMM_REGION_VIRTUAL) || !edev) {
+		return;
+	}
+
+	arch_atomic64_write(&edev->read_count, 0);
+	arch_atomic64_write(&edev->write_count, 0);
+}
+
+static int cmd_guest_stats(struct vmm_chardev *cdev, const char *name,
+			   bool reset)
+{
+	struct vmm_vcpu *vcpu;
+	struct vmm_vcpu_stats *stats;
+	struct vmm_guest *guest = vmm_manager_guest_find(name);
+
+	if (!guest) {
+		vmm_cprintf(cdev, "Failed to find guest\n");
+		return VMM_ENOTAVAIL;
+	}
+
+	if (reset) {
+		vmm_manager_for_each_guest_vcpu(vcpu, guest) {
+			vmm_vcpu_stats_reset(&vcpu->stats);
+		}
+		vmm_guest_iterate_region(guest, 0x0,
+					 cmd_guest_stats_reset_iter, NULL);
+		return VMM_OK;
+	}
+
+	stats = vmm_zalloc(sizeof(*stats));
+	if (!stats) {
+		return VMM_ENOMEM;
+	}
+
+	vmm_manager_for_each_guest_vcpu(vcpu, guest) {
+		vmm_vcpu_stats_accumulate(stats, &vcpu->stats);
+	}
+
+	vmm_cprintf(cdev, "Guest: %s (all vcpus)\n", guest->name);
+	vmm_vcpu_stats_dump(cdev, stats);
+	vmm_free(stats);
+
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "--------------------------------------\n");
+	vmm_cprintf(cdev, " %-16s %-16s %16s %16s\n",
+		    "Region", "Emulator", "MMIO Reads", "MMIO Writes");
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "--------------------------------------\n");
+	vmm_guest_iterate_region(guest, 0x0, cmd_guest_stats_iter, cdev);
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "--------------------------------------\n");
+
+	return VMM_OK;
+}
+
+#if IS_ENABLED(CONFIG_VFS)
+static int cmd_guest_snapshot_write(struct vmm_snapshot_stream *ss,
+				    const void *buf, u32 len)
+{
+	size_t cnt;
+	int fd = (int)(unsigned long)ss->priv;
+	const u8 *ptr = buf;
+
+	while (len) {
+		cnt = vfs_write(fd, (void *)ptr, len);
+		if (cnt < 1) {
+			return VMM_EIO;
+		}
+		ptr += cnt;
+		len -= cnt;
+	}
+
+	return VMM_OK;
+}
+
+static int cmd_guest_snapshot_read(struct vmm_snapshot_stream *ss,
+				   void *buf, u32 len)
+{
+	size_t cnt;
+	int fd = (int)(unsigned long)ss->priv;
+	u8 *ptr = buf;
+
+	while (len) {
+		cnt = vfs_read(fd, ptr, len);
+		if (cnt < 1) {
+			return VMM_EIO;
+		}
+		ptr += cnt;
+		len -= cnt;
+	}
+
+	return VMM_OK;
+}
+
+static void cmd_guest_snapshot_stats(struct vmm_chardev *cdev,
+				     struct vmm_guest *guest, bool save,
+				     struct vmm_guest_snapshot_stats *stats)
+{
+	vmm_cprintf(cdev, "%s: %s %"PRIu64" bytes of RAM "
+			  "(%"PRIu64" zero bytes) %s %"PRIu64" bytes "
+			  "in %"PRIu64" ms\n", guest->name,
+			  (save) ? "Saved" : "Restored",
+			  stats->ram_bytes, stats->zero_bytes,
+			  (save) ? "as" : "from", stats->stream_bytes,
+			  udiv64(stats->nsecs, 1000000ULL));
+}
+
+static int cmd_guest_snapshot(struct vmm_chardev *cdev, const char *name,
+			      const char *path, u32 flags)
+{
+	int fd, rc;
+	struct vmm_snapshot_stream ss;
+	struct vmm_guest_snapshot_stats stats;
+	struct vmm_guest *guest = vmm_manager_guest_find(name);
+
+	if (!guest) {
+		vmm_cprintf(cdev, "Failed to find guest\n");
+		return VMM_ENOTAVAIL;
+	}
+
+	fd = vfs_open(path, O_WRONLY | O_CREAT | O_TRUNC,
+		      S_IRUSR | S_IWUSR);
+	if (fd < 0) {
+		vmm_cprintf(cdev, "Failed to open %s\n", path);
+		return fd;
+	}
+
+	ss.write = cmd_guest_snapshot_write;
+	ss.read = NULL;
+	ss.priv = (void *)(unsigned long)fd;
+	rc = vmm_guest_snapshot_save(guest, &ss, flags, &stats);
+	if (rc) {
+		vmm_cprintf(cdev, "%s: Failed to save snapshot (error %d)\n",
+			    guest->name, rc);
+		vfs_close(fd);
+		return rc;
+	}
+
+	rc = vfs_close(fd);
+	if (rc) {
+		vmm_cprintf(cdev, "Failed to close %s\n", path);
+		return rc;
+	}
+
+	cmd_guest_snapshot_stats(cdev, guest, TRUE, &stats);
+
+	return VMM_OK;
+}
+
+static int cmd_guest_restore(struct vmm_chardev *cdev, const char *name,
+			     const char *path)
+{
+	int fd, rc;
+	struct vmm_snapshot_stream ss;
+	struct vmm_guest_snapshot_stats stats;
+	struct vmm_guest *guest = vmm_manager_guest_find(name);
+
+	if (!guest) {
+		vmm_cprintf(cdev, "Failed to find guest\n");
+		return VMM_ENOTAVAIL;
+	}
+
+	fd = vfs_open(path, O_RDONLY, 0);
+	if (fd < 0) {
+		vmm_cprintf(cdev, "Failed to open %s\n", path);
+		return fd;
+	}
+
+	ss.write = NULL;
+	ss.read = cmd_guest_snapshot_read;
+	ss.priv = (void *)(unsigned long)fd;
+	rc = vmm_guest_snapshot_restore(guest, &ss, &stats);
+	vfs_close(fd);
+	if (rc) {
+		vmm_cprintf(cdev, "%s: Failed to restore snapshot "
+			    "(error %d)\n", guest->name, rc);
+		return rc;
+	}
+
+	cmd_guest_snapshot_stats(cdev, guest, FALSE, &stats);
+
+	return VMM_OK;
+}
+#endif
+
 static int cmd_guest_param(struct vmm_chardev *cdev, int argc, char **argv,
 			   physical_addr_t *src_addr, u32 *size)
 {
@@ -433,8 +806,29 @@ static int cmd_guest_exec(struct vmm_chardev *cdev, int argc, char **argv)
 			return ret;
 		}
 		return cmd_guest_dumpmem(cdev, argv[2], src_addr, size);
+	} else if (strcmp(argv[1], "stats") == 0) {
+		return cmd_guest_stats(cdev, argv[2], FALSE);
+	} else if (strcmp(argv[1], "stats_reset") == 0) {
+		return cmd_guest_stats(cdev, argv[2], TRUE);
 	} else if (strcmp(argv[1], "region_list") == 0) {
 		return cmd_guest_region_list(cdev, argv[2]);
+	} else if (strcmp(argv[1], "ram_blocks") == 0) {
+		return cmd_guest_ram_blocks(cdev, argv[2]);
+	} else if (strcmp(argv[1], "dirty_log") == 0) {
+		if (argc < 4) {
+			cmd_guest_usage(cdev);
+			return VMM_EFAIL;
+		}
+		return cmd_guest_dirty_log(cdev, argv[2], argv[3]);
+#if IS_ENABLED(CONFIG_VFS)
+	} else if ((strcmp(argv[1], "snapshot") == 0) &&
+		   ((argc == 4) ||
+		    ((argc == 5) && !strcmp(argv[4], "compress")))) {
+		return cmd_guest_snapshot(cdev, argv[2], argv[3],
+			(argc == 5) ? VMM_GUEST_SNAPSHOT_COMPRESS : 0x0);
+	} else if ((strcmp(argv[1], "restore") == 0) && (argc == 4)) {
+		return cmd_guest_restore(cdev, argv[2], argv[3]);
+#endif
 	} else if (strcmp(argv[1], "region") == 0) {
 		ret = cmd_guest_param(cdev, argc, argv, &src_addr, &size);
 		if (VMM_OK != ret) {
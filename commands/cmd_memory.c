@@ -25,9 +25,11 @@
 #include <vmm_error.h>
 #include <vmm_stdio.h>
 #include <vmm_host_aspace.h>
+#include <vmm_timer.h>
 #include <vmm_modules.h>
 #include <vmm_cmdmgr.h>
 #include <libs/stringlib.h>
+#include <libs/mathlib.h>
 
 #if CONFIG_CRYPTO_HASH_MD5
 #include <libs/md5.h>
@@ -112,6 +114,7 @@ static void cmd_memory_usage(struct vmm_chardev *cdev)
 						"<val0> <val1> ...\n");
 	vmm_cprintf(cdev, "   memory copy     <phys_addr> <src_phys_addr> "
 						"<byte_count>\n");
+	vmm_cprintf(cdev, "   memory bench    [<bytes_per_size>]\n");
 }
 
 static int cmd_memory_dump(struct vmm_chardev *cdev,
@@ -444,6 +447,108 @@ static int cmd_memory_copy(struct vmm_chardev *cdev,
 	return VMM_OK;
 }
 
+#define CMD_MEMORY_BENCH_MIN_SIZE	8
+#define CMD_MEMORY_BENCH_MAX_SIZE	(1024 * 1024)
+#define CMD_MEMORY_BENCH_BYTES		(16 * 1024 * 1024)
+
+enum cmd_memory_bench_op {
+	CMD_MEMORY_BENCH_MEMCPY,
+	CMD_MEMORY_BENCH_UNALIGNED,
+	CMD_MEMORY_BENCH_MEMMOVE,
+	CMD_MEMORY_BENCH_MEMZERO,
+	CMD_MEMORY_BENCH_MAX
+};
+
+/* Returns throughput in MB/s of current (or baseline) implementation */
+static u64 cmd_memory_bench_one(int op, bool baseline,
+				u8 *buf, u32 size, u32 iters)
+{
+	u32 i;
+	u64 tstamp;
+	u8 *dst = buf;
+	u8 *src = buf + CMD_MEMORY_BENCH_MAX_SIZE + VMM_PAGE_SIZE;
+
+	tstamp = vmm_timer_timestamp();
+	for (i = 0; i < iters; i++) {
+		switch (op) {
+		case CMD_MEMORY_BENCH_MEMCPY:
+			if (baseline) {
+				memcpy_baseline(dst, src, size);
+			} else {
+				memcpy(dst, src, size);
+			}
+			break;
+		case CMD_MEMORY_BENCH_UNALIGNED:
+			if (baseline) {
+				memcpy_baseline(dst + 1, src + 3, size);
+			} else {
+				memcpy(dst + 1, src + 3, size);
+			}
+			break;
+		case CMD_MEMORY_BENCH_MEMMOVE:
+			/* Overlapping backward move */
+			if (baseline) {
+				memmove_generic(dst + 64, dst, size);
+			} else {
+				memmove(dst + 64, dst, size);
+			}
+			break;
+		case CMD_MEMORY_BENCH_MEMZERO:
+			if (baseline) {
+				memset_baseline(dst, 0, size);
+			} else {
+				memset(dst, 0, size);
+			}
+			break;
+		};
+	}
+	tstamp = vmm_timer_timestamp() - tstamp;
+
+	return udiv64((u64)size * iters * 1000, (tstamp) ? tstamp : 1);
+}
+
+static int cmd_memory_bench(struct vmm_chardev *cdev, u32 total)
+{
+	int op;
+	u64 cur, base;
+	u32 size, iters, page_count;
+	virtual_addr_t va;
+
+	page_count = VMM_SIZE_TO_PAGE(2 * (CMD_MEMORY_BENCH_MAX_SIZE +
+					   VMM_PAGE_SIZE));
+	va = vmm_host_alloc_pages(page_count, VMM_MEMORY_FLAGS_NORMAL);
+	if (!va) {
+		vmm_cprintf(cdev, "Failed to allocate benchmark buffers\n");
+		return VMM_ENOMEM;
+	}
+	memset((void *)va, 0xa5, page_count * VMM_PAGE_SIZE);
+
+	vmm_cprintf(cdev, "Throughput in MB/s as current/baseline where "
+		    "baseline is previous implementation\n");
+	vmm_cprintf(cdev, "%-10s %-15s %-15s %-15s %-15s\n",
+		    "Size", "memcpy", "unaligned", "memmove", "memzero");
+	for (size = CMD_MEMORY_BENCH_MIN_SIZE;
+	     size <= CMD_MEMORY_BENCH_MAX_SIZE; size *= 2) {
+		iters = total / size;
+		if (!iters) {
+			iters = 1;
+		}
+		vmm_cprintf(cdev, "%-10d", size);
+		for (op = 0; op < CMD_MEMORY_BENCH_MAX; op++) {
+			cur = cmd_memory_bench_one(op, FALSE, (u8 *)va,
+						   size, iters);
+			base = cmd_memory_bench_one(op, TRUE, (u8 *)va,
+						    size, iters);
+			vmm_cprintf(cdev, " %7"PRIu64"/%-7"PRIu64, cur, base);
+		}
+		vmm_cprintf(cdev, "\n");
+	}
+
+	vmm_host_free_pages(va, page_count);
+
+	return VMM_OK;
+}
+
 static int cmd_memory_exec(struct vmm_chardev *cdev, int argc, char **argv)
 {
 	u32 tmp;
@@ -452,7 +557,11 @@ static int cmd_memory_exec(struct vmm_chardev *cdev, int argc, char **argv)
 		cmd_memory_usage(cdev);
 		return VMM_EFAIL;
 	} else {
-		if (argc == 2) {
+		if (strcmp(argv[1], "bench") == 0) {
+			tmp = (argc > 2) ? strtoul(argv[2], NULL, 0) :
+					   CMD_MEMORY_BENCH_BYTES;
+			return cmd_memory_bench(cdev, tmp);
+		} else if (argc == 2) {
 			if (strcmp(argv[1], "help") == 0) {
 				cmd_memory_usage(cdev);
 				return VMM_OK;
@@ -45,6 +45,7 @@ static void cmd_net_usage(struct vmm_chardev *cdev)
 	vmm_cprintf(cdev, "Usage:\n");
 	vmm_cprintf(cdev, "   net help\n");
 	vmm_cprintf(cdev, "   net ports\n");
+	vmm_cprintf(cdev, "   net stats\n");
 	vmm_cprintf(cdev, "   net switches\n");
 }
 
@@ -98,6 +99,43 @@ static int cmd_net_port_list(struct vmm_chardev *cdev,
 	return VMM_OK;
 }
 
+static int cmd_net_port_stats_iter(struct vmm_netport *port, void *data)
+{
+	struct cmd_net_list_priv *p = data;
+
+	vmm_cprintf(p->cdev, " %-5d %-19s %-10"PRIu64" %-8"PRIu64
+		    " %-8"PRIu64" %4d/%-4d %-8"PRIu64"\n",
+		    p->num++, port->name, port->stats.tx_packets,
+		    port->stats.tx_queued, port->stats.tx_dropped,
+		    port->txq_len, port->txq_depth, port->stats.throttled);
+
+	return VMM_OK;
+}
+
+static int cmd_net_port_stats(struct vmm_chardev *cdev,
+			      int argc, char **argv)
+{
+	struct cmd_net_list_priv p = { .num = 0, .cdev = cdev };
+
+	if (argc != 2) {
+		cmd_net_usage(cdev);
+		return VMM_EINVALID;
+	}
+
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "------------------------------\n");
+	vmm_cprintf(cdev, " %-5s %-19s %-10s %-8s %-8s %-9s %-8s\n",
+		    "Num#", "Port", "TX", "Queued", "Dropped",
+		    "Queue", "Throttle");
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "------------------------------\n");
+	vmm_netport_iterate(NULL, &p, cmd_net_port_stats_iter);
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "------------------------------\n");
+
+	return VMM_OK;
+}
+
 static int cmd_net_switch_list_iter(struct vmm_netswitch *nsw, void *data)
 {
 	u32 pos = 0;
@@ -159,6 +197,8 @@ static int cmd_net_exec(struct vmm_chardev *cdev, int argc, char **argv)
 		return VMM_OK;
 	} else if (strcmp(argv[1], "ports") == 0) {
 		return cmd_net_port_list(cdev, argc, argv);
+	} else if (strcmp(argv[1], "stats") == 0) {
+		return cmd_net_port_stats(cdev, argc, argv);
 	} else if (strcmp(argv[1], "switches") == 0) {
 		return cmd_net_switch_list(cdev, argc, argv);
 	}
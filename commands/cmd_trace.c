@@ -0,0 +1,259 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file cmd_trace.c
+ * @author agent (agent@local)
+ * @brief Implementation of trace command
+ */
+
+#include <vmm_error.h>
+#include <vmm_stdio.h>
+#include <vmm_cpumask.h>
+#include <vmm_host_aspace.h>
+#include <vmm_trace.h>
+#include <vmm_modules.h>
+#include <vmm_cmdmgr.h>
+#include <libs/stringlib.h>
+
+#define MODULE_DESC			"Command trace"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		0
+#define	MODULE_INIT			cmd_trace_init
+#define	MODULE_EXIT			cmd_trace_exit
+
+static void cmd_trace_usage(struct vmm_chardev *cdev)
+{
+	u32 cat;
+
+	vmm_cprintf(cdev, "Usage:\n");
+	vmm_cprintf(cdev, "   trace help\n");
+	vmm_cprintf(cdev, "   trace status\n");
+	vmm_cprintf(cdev, "   trace enable  all|<category> [<category> ...]\n");
+	vmm_cprintf(cdev, "   trace disable all|<category> [<category> ...]\n");
+	vmm_cprintf(cdev, "   trace clear\n");
+	vmm_cprintf(cdev, "   trace dump [<hcpu>]\n");
+	vmm_cprintf(cdev, "Note:\n");
+	vmm_cprintf(cdev, "   <category> =");
+	for (cat = 0; cat < VMM_TRACE_CAT_MAX; cat++) {
+		vmm_cprintf(cdev, " %s", vmm_trace_category_name(cat));
+	}
+	vmm_cprintf(cdev, "\n");
+	vmm_cprintf(cdev, "   Output of dump can be converted to Chrome "
+			  "trace JSON using\n");
+	vmm_cprintf(cdev, "   tools/scripts/trace2json.py\n");
+}
+
+static int cmd_trace_help(struct vmm_chardev *cdev, int argc, char **argv)
+{
+	cmd_trace_usage(cdev);
+	return VMM_OK;
+}
+
+static int cmd_trace_status(struct vmm_chardev *cdev, int argc, char **argv)
+{
+	u32 cat, mask = vmm_trace_enabled();
+
+	vmm_cprintf(cdev, "Ring buffer entries per host CPU: %d\n",
+		    vmm_trace_ring_size());
+	for (cat = 0; cat < VMM_TRACE_CAT_MAX; cat++) {
+		vmm_cprintf(cdev, "  %-10s: %s\n",
+			    vmm_trace_category_name(cat),
+			    (mask & (1U << cat)) ? "enabled" : "disabled");
+	}
+
+	return VMM_OK;
+}
+
+static int cmd_trace_parse_mask(struct vmm_chardev *cdev,
+				int argc, char **argv, u32 *mask)
+{
+	int i, cat;
+
+	*mask = 0;
+	for (i = 0; i < argc; i++) {
+		if (!strcmp(argv[i], "all")) {
+			*mask |= (1U << VMM_TRACE_CAT_MAX) - 1;
+			continue;
+		}
+		cat = vmm_trace_category_find(argv[i]);
+		if (cat < 0) {
+			vmm_cprintf(cdev, "Unknown category %s\n", argv[i]);
+			return VMM_EINVALID;
+		}
+		*mask |= (1U << cat);
+	}
+
+	return VMM_OK;
+}
+
+static int cmd_trace_enable(struct vmm_chardev *cdev, int argc, char **argv)
+{
+	int rc;
+	u32 mask;
+
+	rc = cmd_trace_parse_mask(cdev, argc, argv, &mask);
+	if (rc) {
+		return rc;
+	}
+
+	rc = vmm_trace_enable(mask);
+	if (rc) {
+		vmm_cprintf(cdev, "Failed to enable tracing (error %d)\n", rc);
+	}
+
+	return rc;
+}
+
+static int cmd_trace_disable(struct vmm_chardev *cdev, int argc, char **argv)
+{
+	int rc;
+	u32 mask;
+
+	rc = cmd_trace_parse_mask(cdev, argc, argv, &mask);
+	if (rc) {
+		return rc;
+	}
+
+	vmm_trace_disable(mask);
+
+	return VMM_OK;
+}
+
+static int cmd_trace_clear(struct vmm_chardev *cdev, int argc, char **argv)
+{
+	vmm_trace_clear();
+	return VMM_OK;
+}
+
+static void cmd_trace_dump_cpu(struct vmm_chardev *cdev, u32 cpu,
+			       struct vmm_trace_entry *entries, u32 count)
+{
+	u32 i;
+	struct vmm_trace_entry *e;
+
+	count = vmm_trace_read(cpu, entries, count);
+	for (i = 0; i < count; i++) {
+		e = &entries[i];
+		vmm_cprintf(cdev, "%d %"PRIu64" %s %u 0x%"PRIx64
+			    " 0x%"PRIx64"\n", e->cpu, e->tstamp,
+			    vmm_trace_event_name(e->event), e->arg0,
+			    e->arg1, e->arg2);
+	}
+}
+
+static int cmd_trace_dump(struct vmm_chardev *cdev, int argc, char **argv)
+{
+	u32 cpu, mask, count, page_count;
+	virtual_addr_t va;
+
+	count = vmm_trace_ring_size();
+	page_count = VMM_SIZE_TO_PAGE(count * sizeof(struct vmm_trace_entry));
+	va = vmm_host_alloc_pages(page_count, VMM_MEMORY_FLAGS_NORMAL);
+	if (!va) {
+		return VMM_ENOMEM;
+	}
+
+	/* Stop recording while taking snapshot of ring buffers */
+	mask = vmm_trace_enabled();
+	vmm_trace_disable(mask);
+
+	vmm_cprintf(cdev, "# xvisor-trace v1: "
+			  "<hcpu> <nsecs> <event> <arg0> <arg1> <arg2>\n");
+	if (argc) {
+		cpu = atoi(argv[0]);
+		if (vmm_cpu_possible(cpu)) {
+			cmd_trace_dump_cpu(cdev, cpu,
+				(struct vmm_trace_entry *)va, count);
+		}
+	} else {
+		for_each_possible_cpu(cpu) {
+			cmd_trace_dump_cpu(cdev, cpu,
+				(struct vmm_trace_entry *)va, count);
+		}
+	}
+
+	if (mask) {
+		vmm_trace_enable(mask);
+	}
+
+	vmm_host_free_pages(va, page_count);
+
+	return VMM_OK;
+}
+
+static const struct {
+	char *name;
+	int (*function) (struct vmm_chardev *, int, char **);
+	int argc;
+} command[] = {
+	{"help", cmd_trace_help, 0},
+	{"status", cmd_trace_status, 0},
+	{"enable", cmd_trace_enable, 1},
+	{"disable", cmd_trace_disable, 1},
+	{"clear", cmd_trace_clear, 0},
+	{"dump", cmd_trace_dump, 0},
+	{NULL, NULL, 0},
+};
+
+static int cmd_trace_exec(struct vmm_chardev *cdev, int argc, char **argv)
+{
+	int index = 0;
+
+	if (argc <= 1) {
+		cmd_trace_usage(cdev);
+		return VMM_EFAIL;
+	}
+
+	while (command[index].name) {
+		if ((strcmp(argv[1], command[index].name) == 0) &&
+		    ((argc - 2) >= command[index].argc)) {
+			return command[index].function(cdev,
+						argc - 2, &argv[2]);
+		}
+		index++;
+	}
+
+	cmd_trace_usage(cdev);
+
+	return VMM_EFAIL;
+}
+
+static struct vmm_cmd cmd_trace = {
+	.name = "trace",
+	.desc = "hypervisor tracepoint commands",
+	.usage = cmd_trace_usage,
+	.exec = cmd_trace_exec,
+};
+
+static int __init cmd_trace_init(void)
+{
+	return vmm_cmdmgr_register_cmd(&cmd_trace);
+}
+
+static void __exit cmd_trace_exit(void)
+{
+	vmm_cmdmgr_unregister_cmd(&cmd_trace);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+		   MODULE_AUTHOR,
+		   MODULE_LICENSE,
+		   MODULE_IPRIORITY,
+		   MODULE_INIT,
+		   MODULE_EXIT);
@@ -61,6 +61,8 @@ static void cmd_vcpu_usage(struct vmm_chardev *cdev)
 			  "<hcpu0> <hcpu1> <hcpu2> ...\n");
 	vmm_cprintf(cdev, "   vcpu dumpreg <vcpu_id>\n");
 	vmm_cprintf(cdev, "   vcpu dumpstat <vcpu_id>\n");
+	vmm_cprintf(cdev, "   vcpu stats <vcpu_id>\n");
+	vmm_cprintf(cdev, "   vcpu stats_reset <vcpu_id>\n");
 }
 
 static int cmd_vcpu_help(struct vmm_chardev *cdev,
@@ -625,6 +627,63 @@ static int cmd_vcpu_dumpstat(struct vmm_chardev *cdev,
 	return ret;
 }
 
+static int cmd_vcpu_stats(struct vmm_chardev *cdev,
+			  int argc, char **argv)
+{
+	int id;
+	struct vmm_vcpu *vcpu;
+
+	if (!argc) {
+		vmm_cprintf(cdev, "Must provide vcpu ID\n");
+		cmd_vcpu_usage(cdev);
+		return VMM_EINVALID;
+	}
+	id = atoi(argv[0]);
+
+	vcpu = vmm_manager_vcpu(id);
+	if (!vcpu) {
+		vmm_cprintf(cdev, "Failed to find vcpu\n");
+		return VMM_EFAIL;
+	}
+
+	if (!vcpu->is_normal) {
+		vmm_cprintf(cdev, "Stats available only for normal vcpu\n");
+		return VMM_EINVALID;
+	}
+
+	vmm_cprintf(cdev, "Name: %s\n", vcpu->name);
+	vmm_vcpu_stats_dump(cdev, &vcpu->stats);
+
+	return VMM_OK;
+}
+
+static int cmd_vcpu_stats_reset(struct vmm_chardev *cdev,
+				int argc, char **argv)
+{
+	int id;
+	struct vmm_vcpu *vcpu;
+
+	if (!argc) {
+		vmm_cprintf(cdev, "Must provide vcpu ID\n");
+		cmd_vcpu_usage(cdev);
+		return VMM_EINVALID;
+	}
+	id = atoi(argv[0]);
+
+	vcpu = vmm_manager_vcpu(id);
+	if (!vcpu) {
+		vmm_cprintf(cdev, "Failed to find vcpu\n");
+		return VMM_EFAIL;
+	}
+
+	/* Note: Counters are updated without locks by the host CPU
+	 * running the vcpu so reset of a running vcpu is best-effort.
+	 */
+	vmm_vcpu_stats_reset(&vcpu->stats);
+
+	return VMM_OK;
+}
+
 static const struct {
 	char *name;
 	int (*function) (struct vmm_chardev *, int, char **);
@@ -644,6 +703,8 @@ static const struct {
 	{"set_affinity", cmd_vcpu_set_affinity, 2},
 	{"dumpreg", cmd_vcpu_dumpreg, 1},
 	{"dumpstat", cmd_vcpu_dumpstat, 1},
+	{"stats", cmd_vcpu_stats, 1},
+	{"stats_reset", cmd_vcpu_stats_reset, 1},
 	{NULL, NULL, 0},
 };
 	
@@ -28,6 +28,9 @@
 #include <vmm_cmdmgr.h>
 #include <vio/vmm_vdisk.h>
 #include <libs/stringlib.h>
+#if IS_ENABLED(CONFIG_BLOCK_COW)
+#include <drv/cowblk.h>
+#endif
 
 #define MODULE_DESC			"Command vdisk"
 #define MODULE_AUTHOR			"Anup Patel"
@@ -46,16 +49,39 @@ static void cmd_vdisk_usage(struct vmm_chardev *cdev)
 	vmm_cprintf(cdev, "   vdisk attach <vdisk_name> <block_device_name>\n");
 }
 
+/* Format copy-on-write overlay usage of attached block device */
+static int cmd_vdisk_overlay_usage(const char *bname, char *buf, u32 len)
+{
+#if IS_ENABLED(CONFIG_BLOCK_COW)
+	u64 used, total;
+	struct cowblk *cb = cowblk_find(bname);
+
+	if (cb) {
+		used = (u64)cb->used_slots * cowblk_cluster_size(cb);
+		total = (u64)cb->max_slots * cowblk_cluster_size(cb);
+		vmm_snprintf(buf, len, "%"PRIu64"K/%"PRIu64"K",
+			     used >> 10, total >> 10);
+		return VMM_OK;
+	}
+#endif
+
+	return VMM_ENOTAVAIL;
+}
+
 static int cmd_vdisk_list_iter(struct vmm_vdisk *vdisk, void *data)
 {
 	int rc;
-	char bname[VMM_FIELD_NAME_SIZE];
+	char bname[VMM_FIELD_NAME_SIZE], usage[32];
 	struct vmm_chardev *cdev = data;
 
 	rc = vmm_vdisk_current_block_device(vdisk, bname, sizeof(bname));
-	vmm_cprintf(cdev, " %-30s %-17d %-30s\n",
+	if ((rc != VMM_OK) ||
+	    cmd_vdisk_overlay_usage(bname, usage, sizeof(usage))) {
+		strcpy(usage, "---");
+	}
+	vmm_cprintf(cdev, " %-24s %-11d %-20s %-20s\n",
 		    vmm_vdisk_name(vdisk),  vmm_vdisk_block_size(vdisk),
-		    (rc == VMM_OK) ? bname : "---");
+		    (rc == VMM_OK) ? bname : "---", usage);
 
 	return VMM_OK;
 }
@@ -64,8 +90,9 @@ static void cmd_vdisk_list(struct vmm_chardev *cdev)
 {
 	vmm_cprintf(cdev, "----------------------------------------"
 			  "----------------------------------------\n");
-	vmm_cprintf(cdev, " %-30s %-17s %-30s\n",
-			  "Name", "Block Size", "Attached Block Device");
+	vmm_cprintf(cdev, " %-24s %-11s %-20s %-20s\n",
+			  "Name", "Block Size", "Block Device",
+			  "Overlay Usage");
 	vmm_cprintf(cdev, "----------------------------------------"
 			  "----------------------------------------\n");
 	vmm_vdisk_iterate(NULL, cdev, cmd_vdisk_list_iter);
@@ -76,6 +103,7 @@ static void cmd_vdisk_list(struct vmm_chardev *cdev)
 static int cmd_vdisk_info(struct vmm_chardev *cdev,
 			  const char *vdisk_name)
 {
+	char bname[VMM_FIELD_NAME_SIZE], usage[32];
 	struct vmm_vdisk *vdisk = vmm_vdisk_find(vdisk_name);
 	if (!vdisk) {
 		vmm_cprintf(cdev, "Failed to find virtual disk\n");
@@ -92,6 +120,11 @@ static int cmd_vdisk_info(struct vmm_chardev *cdev,
 		vdisk->blk_factor, vmm_vdisk_capacity(vdisk),
 		vdisk->blk ? vdisk->blk->name : "NONE");
 
+	if (!vmm_vdisk_current_block_device(vdisk, bname, sizeof(bname)) &&
+	    !cmd_vdisk_overlay_usage(bname, usage, sizeof(usage))) {
+		vmm_cprintf(cdev, "Overlay     : %s used\n", usage);
+	}
+
 	return VMM_OK;
 }
 
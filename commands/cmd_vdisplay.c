@@ -22,12 +22,14 @@
  */
 
 #include <vmm_error.h>
+#include <vmm_heap.h>
 #include <vmm_stdio.h>
 #include <vmm_devtree.h>
 #include <vmm_modules.h>
 #include <vmm_cmdmgr.h>
 #include <vio/vmm_vdisplay.h>
 #include <libs/stringlib.h>
+#include <libs/mathlib.h>
 
 #define MODULE_DESC			"Command vdisplay"
 #define MODULE_AUTHOR			"Anup Patel"
@@ -41,6 +43,7 @@ static void cmd_vdisplay_usage(struct vmm_chardev *cdev)
 	vmm_cprintf(cdev, "Usage:\n");
 	vmm_cprintf(cdev, "   vdisplay help\n");
 	vmm_cprintf(cdev, "   vdisplay list\n");
+	vmm_cprintf(cdev, "   vdisplay stats <vdisplay_name>\n");
 }
 
 static int cmd_vdisplay_list_iter(struct vmm_vdisplay *vdis, void *data)
@@ -61,6 +64,101 @@ static void cmd_vdisplay_list(struct vmm_chardev *cdev)
 	vmm_cprintf(cdev, "----------------------------------------\n");
 }
 
+struct cmd_vdisplay_surface_stats {
+	char name[VMM_FIELD_NAME_SIZE];
+	struct vmm_surface_stats stats;
+};
+
+struct cmd_vdisplay_stats_buf {
+	u32 count;
+	u32 max;
+	struct cmd_vdisplay_surface_stats *ent;
+};
+
+/* Note: Called with surface list spinlock held so only copy stats */
+static int cmd_vdisplay_stats_iter(struct vmm_vdisplay *vdis,
+				   struct vmm_surface *s, void *data)
+{
+	struct cmd_vdisplay_stats_buf *buf = data;
+
+	if (buf->count < buf->max) {
+		strlcpy(buf->ent[buf->count].name, s->name,
+			sizeof(buf->ent[buf->count].name));
+		memcpy(&buf->ent[buf->count].stats, &s->stats,
+		       sizeof(s->stats));
+	}
+	buf->count++;
+
+	return VMM_OK;
+}
+
+static void cmd_vdisplay_stats_print(struct vmm_chardev *cdev,
+				     struct cmd_vdisplay_surface_stats *e)
+{
+	u64 total, saved = 0;
+
+	total = e->stats.bytes_converted + e->stats.bytes_skipped;
+	if (total) {
+		saved = udiv64(e->stats.bytes_skipped * 100, total);
+	}
+
+	vmm_cprintf(cdev, "Surface %s\n", e->name);
+	vmm_cprintf(cdev, "  Updates         : %"PRIu64"\n",
+		    e->stats.updates);
+	vmm_cprintf(cdev, "  Rows clean      : %"PRIu64"\n",
+		    e->stats.rows_clean);
+	vmm_cprintf(cdev, "  Rows checked    : %"PRIu64"\n",
+		    e->stats.rows_checked);
+	vmm_cprintf(cdev, "  Rows dirty      : %"PRIu64"\n",
+		    e->stats.rows_dirty);
+	vmm_cprintf(cdev, "  Bytes read      : %"PRIu64"\n",
+		    e->stats.bytes_read);
+	vmm_cprintf(cdev, "  Bytes converted : %"PRIu64"\n",
+		    e->stats.bytes_converted);
+	vmm_cprintf(cdev, "  Bytes skipped   : %"PRIu64" (%"PRIu64"%% saved)\n",
+		    e->stats.bytes_skipped, saved);
+}
+
+static int cmd_vdisplay_stats(struct vmm_chardev *cdev, const char *name)
+{
+	int rc;
+	u32 i;
+	struct cmd_vdisplay_stats_buf buf;
+	struct vmm_vdisplay *vdis = vmm_vdisplay_find(name);
+
+	if (!vdis) {
+		vmm_cprintf(cdev, "Failed to find vdisplay %s\n", name);
+		return VMM_ENOTAVAIL;
+	}
+
+	/* Count surfaces and then copy their stats so that printing
+	 * (which can sleep) is done without surface list lock.
+	 */
+	memset(&buf, 0, sizeof(buf));
+	rc = vmm_vdisplay_surface_iterate(vdis, &buf,
+					  cmd_vdisplay_stats_iter);
+	if (rc || !buf.count) {
+		return rc;
+	}
+
+	buf.max = buf.count;
+	buf.count = 0;
+	buf.ent = vmm_zalloc(buf.max * sizeof(*buf.ent));
+	if (!buf.ent) {
+		return VMM_ENOMEM;
+	}
+	rc = vmm_vdisplay_surface_iterate(vdis, &buf,
+					  cmd_vdisplay_stats_iter);
+	if (!rc) {
+		for (i = 0; (i < buf.count) && (i < buf.max); i++) {
+			cmd_vdisplay_stats_print(cdev, &buf.ent[i]);
+		}
+	}
+	vmm_free(buf.ent);
+
+	return rc;
+}
+
 static int cmd_vdisplay_exec(struct vmm_chardev *cdev, int argc, char **argv)
 {
 	if (argc == 2) {
@@ -71,6 +169,8 @@ static int cmd_vdisplay_exec(struct vmm_chardev *cdev, int argc, char **argv)
 			cmd_vdisplay_list(cdev);
 			return VMM_OK;
 		}
+	} else if ((argc == 3) && (strcmp(argv[1], "stats") == 0)) {
+		return cmd_vdisplay_stats(cdev, argv[2]);
 	}
 	cmd_vdisplay_usage(cdev);
 	return VMM_EFAIL;
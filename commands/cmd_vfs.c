@@ -33,8 +33,10 @@
 #include <vmm_modules.h>
 #include <vmm_cmdmgr.h>
 #include <vmm_delay.h>
+#include <vmm_timer.h>
 #include <libs/libfdt.h>
 #include <libs/stringlib.h>
+#include <libs/mathlib.h>
 #include <libs/vfs.h>
 
 #if CONFIG_CRYPTO_HASH_MD5
@@ -1001,6 +1003,7 @@ static int cmd_vfs_load(struct vmm_chardev *cdev,
 			const char *path, u32 off, u32 len)
 {
 	int fd, rc;
+	u64 tstamp;
 	loff_t rd_off;
 	physical_addr_t wr_pa;
 	size_t buf_wr, buf_rd, buf_count, wr_count;
@@ -1028,6 +1031,7 @@ static int cmd_vfs_load(struct vmm_chardev *cdev,
 	rd_off = 0;
 	wr_count = 0;
 	wr_pa = pa;
+	tstamp = vmm_timer_timestamp();
 	while (len) {
 		buf_rd = (len < VFS_LOAD_BUF_SZ) ? len : VFS_LOAD_BUF_SZ;
 		buf_count = vfs_read(fd, buf, buf_rd);
@@ -1056,10 +1060,13 @@ static int cmd_vfs_load(struct vmm_chardev *cdev,
 		wr_count += buf_wr;
 		wr_pa += buf_wr;
 	}
+	tstamp = vmm_timer_timestamp() - tstamp;
 
-	vmm_cprintf(cdev, "%s: Loaded 0x%"PRIPADDR" with %zu bytes\n",
-			  (guest) ? (guest->name) : "host",
-			  pa, wr_count);
+	vmm_cprintf(cdev, "%s: Loaded 0x%"PRIPADDR" with %zu bytes "
+			  "(%"PRIu64" KB/s)\n",
+			  (guest) ? (guest->name) : "host", pa, wr_count,
+			  udiv64((u64)wr_count * 1000000000ULL,
+				 ((tstamp) ? tstamp : 1) * 1024));
 
 	vmm_free(buf);
 	rc = vfs_close(fd);
@@ -26,7 +26,10 @@
 #include <vmm_version.h>
 #include <vmm_modules.h>
 #include <vmm_cmdmgr.h>
+#include <vmm_timer.h>
+#include <vmm_delay.h>
 #include <vio/vmm_vmsg.h>
+#include <libs/mathlib.h>
 #include <libs/stringlib.h>
 
 #define MODULE_DESC			"Command vmsg"
@@ -44,6 +47,17 @@ static void cmd_vmsg_usage(struct vmm_chardev *cdev)
 	vmm_cprintf(cdev, "   vmsg domain_create <domain_name>\n");
 	vmm_cprintf(cdev, "   vmsg domain_destroy <domain_name>\n");
 	vmm_cprintf(cdev, "   vmsg domain_list\n");
+	vmm_cprintf(cdev, "   vmsg bench <domain_name> <msg_count> "
+			  "<msg_len>\n");
+	vmm_cprintf(cdev, "   vmsg bench_guest <tx_node_name> "
+			  "<rx_node_name> <msecs>\n");
+	vmm_cprintf(cdev, "Note:\n");
+	vmm_cprintf(cdev, "   bench sends messages between two "
+			  "hypervisor nodes\n");
+	vmm_cprintf(cdev, "   bench_guest measures messages which guests "
+			  "exchange through their\n");
+	vmm_cprintf(cdev, "   nodes (e.g. virtio_rpmsg) so traffic must be "
+			  "generated by guests\n");
 }
 
 struct cmd_vmsg_list_priv {
@@ -186,8 +200,191 @@ static int cmd_vmsg_domain_destroy(struct vmm_chardev *cdev, const char *name)
 	return ret;
 }
 
+#define CMD_VMSG_BENCH_TIMEOUT_NSECS	10000000000ULL
+#define CMD_VMSG_BENCH_MAX_COUNT	10000000
+#define CMD_VMSG_BENCH_MAX_LEN		65536
+#define CMD_VMSG_BENCH_MAX_MSECS	60000
+
+struct cmd_vmsg_bench {
+	u32 count;
+	u32 received;
+	struct vmm_completion done;
+};
+
+static void cmd_vmsg_bench_recv_msg(struct vmm_vmsg_node *node,
+				    struct vmm_vmsg *msg)
+{
+	struct cmd_vmsg_bench *b = vmm_vmsg_node_priv(node);
+
+	b->received++;
+	if (b->received == b->count) {
+		vmm_completion_complete(&b->done);
+	}
+}
+
+static struct vmm_vmsg_node_ops cmd_vmsg_bench_ops = {
+	.recv_msg = cmd_vmsg_bench_recv_msg,
+};
+
+static int cmd_vmsg_bench(struct vmm_chardev *cdev, const char *name,
+			  u32 count, u32 len)
+{
+	int ret = VMM_OK;
+	u32 i;
+	u64 tstamp, nsecs, timeout;
+	u64 works, wakeups, works1, wakeups1;
+	struct cmd_vmsg_bench b;
+	struct vmm_vmsg *msg;
+	struct vmm_vmsg_node *tx, *rx;
+	struct vmm_vmsg_domain *domain = vmm_vmsg_domain_find(name);
+
+	if (!domain) {
+		vmm_cprintf(cdev, "Failed to find domain\n");
+		return VMM_ENOTAVAIL;
+	}
+	if (!count || !len) {
+		vmm_cprintf(cdev, "Invalid message count or length\n");
+		return VMM_EINVALID;
+	}
+
+	b.count = count;
+	b.received = 0;
+	INIT_COMPLETION(&b.done);
+
+	tx = vmm_vmsg_node_create("vmsg_bench_tx", VMM_VMSG_NODE_ADDR_ANY,
+				  &cmd_vmsg_bench_ops, domain, &b);
+	rx = vmm_vmsg_node_create("vmsg_bench_rx", VMM_VMSG_NODE_ADDR_ANY,
+				  &cmd_vmsg_bench_ops, domain, &b);
+	if (!tx || !rx) {
+		vmm_cprintf(cdev, "Failed to create bench nodes\n");
+		ret = VMM_EFAIL;
+		goto done;
+	}
+	vmm_vmsg_node_ready(tx);
+	vmm_vmsg_node_ready(rx);
+
+	vmm_vmsg_domain_get_stats(domain, &works, &wakeups);
+	tstamp = vmm_timer_timestamp();
+
+	for (i = 0; i < count; i++) {
+		msg = vmm_vmsg_node_alloc(tx, vmm_vmsg_node_get_addr(rx),
+					  vmm_vmsg_node_get_addr(tx), len);
+		if (!msg) {
+			ret = VMM_ENOMEM;
+			break;
+		}
+		ret = vmm_vmsg_node_send(tx, msg);
+		vmm_vmsg_dref(msg);
+		if (ret) {
+			break;
+		}
+	}
+	if (ret) {
+		vmm_cprintf(cdev, "Failed to send message %d (error %d)\n",
+			    i, ret);
+		goto done;
+	}
+
+	timeout = CMD_VMSG_BENCH_TIMEOUT_NSECS;
+	ret = vmm_completion_wait_timeout(&b.done, &timeout);
+	nsecs = vmm_timer_timestamp() - tstamp;
+	vmm_vmsg_domain_get_stats(domain, &works1, &wakeups1);
+	if (ret) {
+		vmm_cprintf(cdev, "Timeout after receiving %d of %d "
+			    "messages\n", b.received, count);
+		goto done;
+	}
+
+	vmm_cprintf(cdev, "Messages  : %d x %d bytes\n", count, len);
+	vmm_cprintf(cdev, "Time      : %"PRIu64" usecs\n",
+		    udiv64(nsecs, 1000));
+	vmm_cprintf(cdev, "Rate      : %"PRIu64" msgs/sec\n",
+		    (nsecs) ? udiv64((u64)count * 1000000000ULL, nsecs) : 0);
+	vmm_cprintf(cdev, "Batching  : %"PRIu64" works in %"PRIu64
+		    " wakeups\n", works1 - works, wakeups1 - wakeups);
+
+done:
+	if (rx) {
+		vmm_vmsg_node_destroy(rx);
+	}
+	if (tx) {
+		vmm_vmsg_node_destroy(tx);
+	}
+
+	return ret;
+}
+
+static int cmd_vmsg_bench_guest(struct vmm_chardev *cdev,
+				const char *tx_name, const char *rx_name,
+				u32 msecs)
+{
+	u64 tstamp, nsecs;
+	u64 tx_msgs, rx_msgs, rx_bytes, tx_msgs1, rx_msgs1, rx_bytes1;
+	struct vmm_vmsg_node *tx = vmm_vmsg_node_find(tx_name);
+	struct vmm_vmsg_node *rx = vmm_vmsg_node_find(rx_name);
+
+	if (!tx || !rx || (tx == rx)) {
+		vmm_cprintf(cdev, "Failed to find two distinct nodes\n");
+		return VMM_ENOTAVAIL;
+	}
+	if (vmm_vmsg_node_get_domain(tx) != vmm_vmsg_node_get_domain(rx)) {
+		vmm_cprintf(cdev, "Nodes are not in same domain\n");
+		return VMM_EINVALID;
+	}
+
+	/* Messages received by tx node are replies sent by rx node */
+	vmm_vmsg_node_get_stats(tx, &tx_msgs, NULL);
+	vmm_vmsg_node_get_stats(rx, &rx_msgs, &rx_bytes);
+	tstamp = vmm_timer_timestamp();
+
+	vmm_msleep(msecs);
+
+	vmm_vmsg_node_get_stats(tx, &tx_msgs1, NULL);
+	vmm_vmsg_node_get_stats(rx, &rx_msgs1, &rx_bytes1);
+	nsecs = vmm_timer_timestamp() - tstamp;
+
+	rx_msgs = rx_msgs1 - rx_msgs;
+	rx_bytes = rx_bytes1 - rx_bytes;
+	tx_msgs = tx_msgs1 - tx_msgs;
+
+	vmm_cprintf(cdev, "Time      : %"PRIu64" usecs\n",
+		    udiv64(nsecs, 1000));
+	vmm_cprintf(cdev, "%-10s: %"PRIu64" msgs (%"PRIu64" msgs/sec, "
+		    "%"PRIu64" bytes/sec)\n", rx_name, rx_msgs,
+		    udiv64(rx_msgs * 1000000000ULL, nsecs),
+		    udiv64(rx_bytes * 1000000000ULL, nsecs));
+	vmm_cprintf(cdev, "%-10s: %"PRIu64" msgs (%"PRIu64" msgs/sec)\n",
+		    tx_name, tx_msgs,
+		    udiv64(tx_msgs * 1000000000ULL, nsecs));
+	if (!rx_msgs) {
+		vmm_cprintf(cdev, "No messages seen, are guests sending "
+			    "to %s?\n", rx_name);
+	}
+
+	return VMM_OK;
+}
+
+static int cmd_vmsg_parse_u32(struct vmm_chardev *cdev, const char *str,
+			      const char *what, u32 min, u32 max, u32 *out)
+{
+	char *end = NULL;
+	unsigned long val;
+
+	val = strtoul(str, &end, 0);
+	if ((end == str) || *end || (val < min) || (val > max)) {
+		vmm_cprintf(cdev, "Invalid %s %s (expected %d to %d)\n",
+			    what, str, min, max);
+		return VMM_EINVALID;
+	}
+	*out = val;
+
+	return VMM_OK;
+}
+
 static int cmd_vmsg_exec(struct vmm_chardev *cdev, int argc, char **argv)
 {
+	u32 num1, num2;
+
 	if (argc <= 1) {
 		goto fail;
 	}
@@ -203,6 +400,20 @@ static int cmd_vmsg_exec(struct vmm_chardev *cdev, int argc, char **argv)
 		return cmd_vmsg_domain_create(cdev, argv[2]);
 	} else if (strcmp(argv[1], "domain_destroy") == 0 && (argc == 3)) {
 		return cmd_vmsg_domain_destroy(cdev, argv[2]);
+	} else if (strcmp(argv[1], "bench") == 0 && (argc == 5)) {
+		if (cmd_vmsg_parse_u32(cdev, argv[3], "message count",
+				       1, CMD_VMSG_BENCH_MAX_COUNT, &num1) ||
+		    cmd_vmsg_parse_u32(cdev, argv[4], "message length",
+				       1, CMD_VMSG_BENCH_MAX_LEN, &num2)) {
+			return VMM_EINVALID;
+		}
+		return cmd_vmsg_bench(cdev, argv[2], num1, num2);
+	} else if (strcmp(argv[1], "bench_guest") == 0 && (argc == 5)) {
+		if (cmd_vmsg_parse_u32(cdev, argv[4], "duration",
+				       1, CMD_VMSG_BENCH_MAX_MSECS, &num1)) {
+			return VMM_EINVALID;
+		}
+		return cmd_vmsg_bench_guest(cdev, argv[2], argv[3], num1);
 	}
 
 fail:
@@ -26,11 +26,14 @@
 #include <vmm_stdio.h>
 #include <vmm_modules.h>
 #include <vmm_scheduler.h>
+#include <vmm_timer.h>
 #include <vmm_devdrv.h>
 #include <vmm_completion.h>
 #include <block/vmm_blockdev.h>
 #include <libs/stringlib.h>
 #include <libs/mathlib.h>
+#include <libs/bitops.h>
+#include <libs/scatterlist.h>
 
 #define MODULE_DESC			"Block Device Framework"
 #define MODULE_AUTHOR			"Anup Patel"
@@ -53,6 +56,87 @@ int vmm_blockdev_unregister_client(struct vmm_notifier_block *nb)
 }
 VMM_EXPORT_SYMBOL(vmm_blockdev_unregister_client);
 
+u32 vmm_request_copy_to_buf(struct vmm_request *r, void *buf, u32 len)
+{
+	u32 sz = vmm_request_data_size(r);
+
+	if (!buf || !sz) {
+		return 0;
+	}
+	len = (len < sz) ? len : sz;
+
+	if (r->sgl) {
+		return sg_copy_to_buffer(r->sgl, r->sg_nents, buf, len);
+	}
+
+	memcpy(buf, r->data, len);
+
+	return len;
+}
+VMM_EXPORT_SYMBOL(vmm_request_copy_to_buf);
+
+u32 vmm_request_copy_from_buf(struct vmm_request *r,
+			      const void *buf, u32 len)
+{
+	u32 sz = vmm_request_data_size(r);
+
+	if (!buf || !sz) {
+		return 0;
+	}
+	len = (len < sz) ? len : sz;
+
+	if (r->sgl) {
+		return sg_copy_from_buffer(r->sgl, r->sg_nents,
+					   (void *)buf, len);
+	}
+
+	memcpy(r->data, buf, len);
+
+	return len;
+}
+VMM_EXPORT_SYMBOL(vmm_request_copy_from_buf);
+
+void *vmm_request_map_data(struct vmm_request *r)
+{
+	void *buf;
+	u32 sz = vmm_request_data_size(r);
+
+	if (!sz) {
+		return NULL;
+	}
+
+	if (!r->sgl) {
+		return r->data;
+	}
+
+	buf = vmm_malloc(sz);
+	if (!buf) {
+		return NULL;
+	}
+
+	if (r->type == VMM_REQUEST_WRITE) {
+		vmm_request_copy_to_buf(r, buf, sz);
+	}
+
+	return buf;
+}
+VMM_EXPORT_SYMBOL(vmm_request_map_data);
+
+void vmm_request_unmap_data(struct vmm_request *r, void *buf,
+			    bool copy_back)
+{
+	if (!r || !buf || !r->sgl) {
+		return;
+	}
+
+	if (copy_back && (r->type == VMM_REQUEST_READ)) {
+		vmm_request_copy_from_buf(r, buf, vmm_request_data_size(r));
+	}
+
+	vmm_free(buf);
+}
+VMM_EXPORT_SYMBOL(vmm_request_unmap_data);
+
 static int __blockdev_make_request(struct vmm_blockdev *bdev,
 				   struct vmm_request *r,
 				   bool append_backlog)
@@ -86,11 +170,37 @@ static int __blockdev_make_request(struct vmm_blockdev *bdev,
 	return rc;
 }
 
-static void __blockdev_done_request(struct vmm_request_queue *rq)
+static int __blockdev_lat_bucket(struct vmm_request *r)
+{
+	int b;
+	u64 nsecs, tstamp = vmm_timer_timestamp();
+
+	nsecs = (tstamp > r->tstamp) ? (tstamp - r->tstamp) : 0;
+	if (nsecs >> VMM_REQUEST_LAT_SHIFT) {
+		b = fls64(nsecs) - VMM_REQUEST_LAT_SHIFT;
+		if (b >= VMM_REQUEST_LAT_BUCKETS) {
+			b = VMM_REQUEST_LAT_BUCKETS - 1;
+		}
+	} else {
+		b = 0;
+	}
+
+	return b;
+}
+
+static void __blockdev_done_request(struct vmm_request_queue *rq,
+				    bool failed, int lat_bucket)
 {
 	int rc = VMM_OK;
 	struct vmm_request *r;
 
+	if (failed) {
+		rq->stats.failed++;
+	} else {
+		rq->stats.completed++;
+	}
+	rq->stats.lat_hist[lat_bucket]++;
+
 	if (rq->pending_count) {
 		rq->pending_count--;
 	}
@@ -113,6 +223,7 @@ static void __blockdev_done_request(struct vmm_request_queue *rq)
 
 int vmm_blockdev_complete_request(struct vmm_request *r)
 {
+	int b;
 	irq_flags_t flags;
 	struct vmm_request_queue *rq;
 
@@ -120,12 +231,13 @@ int vmm_blockdev_complete_request(struct vmm_request *r)
 		return VMM_EINVALID;
 	}
 	rq = r->bdev->rq;
+	b = __blockdev_lat_bucket(r);
 
 	if (r->completed) {
 		r->completed(r);
 	}
 	vmm_spin_lock_irqsave(&rq->lock, flags);
-	__blockdev_done_request(rq);
+	__blockdev_done_request(rq, FALSE, b);
 	vmm_spin_unlock_irqrestore(&rq->lock, flags);
 	r->bdev = NULL;
 
@@ -135,6 +247,7 @@ VMM_EXPORT_SYMBOL(vmm_blockdev_complete_request);
 
 int vmm_blockdev_fail_request(struct vmm_request *r)
 {
+	int b;
 	irq_flags_t flags;
 	struct vmm_request_queue *rq;
 
@@ -142,12 +255,13 @@ int vmm_blockdev_fail_request(struct vmm_request *r)
 		return VMM_EINVALID;
 	}
 	rq = r->bdev->rq;
+	b = __blockdev_lat_bucket(r);
 
 	if (r->failed) {
 		r->failed(r);
 	}
 	vmm_spin_lock_irqsave(&rq->lock, flags);
-	__blockdev_done_request(rq);
+	__blockdev_done_request(rq, TRUE, b);
 	vmm_spin_unlock_irqrestore(&rq->lock, flags);
 	r->bdev = NULL;
 
@@ -159,7 +273,10 @@ int vmm_blockdev_submit_request(struct vmm_blockdev *bdev,
 				struct vmm_request *r)
 {
 	int rc;
+	u64 len;
+	u32 i, depth;
 	irq_flags_t flags;
+	struct scatterlist *sg;
 	struct vmm_request_queue *rq;
 
 	if (!bdev || !r || !bdev->rq) {
@@ -168,10 +285,50 @@ int vmm_blockdev_submit_request(struct vmm_blockdev *bdev,
 	}
 	rq = bdev->rq;
 
-	if ((r->type == VMM_REQUEST_WRITE) &&
-	   !(bdev->flags & VMM_BLOCKDEV_RW)) {
+	switch (r->type) {
+	case VMM_REQUEST_READ:
+		break;
+	case VMM_REQUEST_WRITE:
+		if (!(bdev->flags & VMM_BLOCKDEV_RW)) {
+			rc = VMM_EINVALID;
+			goto failed;
+		}
+		break;
+	case VMM_REQUEST_DISCARD:
+	case VMM_REQUEST_WRITE_ZEROES:
+		if (!(bdev->flags & VMM_BLOCKDEV_RW) || r->sgl) {
+			rc = VMM_EINVALID;
+			goto failed;
+		}
+		len = (r->type == VMM_REQUEST_DISCARD) ?
+			rq->max_discard_blocks : rq->max_write_zeroes_blocks;
+		if (!len) {
+			rc = VMM_ENOTSUPP;
+			goto failed;
+		}
+		if (len < r->bcnt) {
+			rc = VMM_ERANGE;
+			goto failed;
+		}
+		break;
+	default:
 		rc = VMM_EINVALID;
 		goto failed;
+	};
+
+	if (r->sgl && (!r->sg_nents || !rq->sg_capable)) {
+		rc = VMM_ENOTSUPP;
+		goto failed;
+	}
+	if (r->sgl) {
+		len = 0;
+		for_each_sg(r->sgl, sg, r->sg_nents, i) {
+			len += sg->length;
+		}
+		if (len != ((u64)r->bcnt * bdev->block_size)) {
+			rc = VMM_EINVALID;
+			goto failed;
+		}
 	}
 
 	if (bdev->num_blocks < r->bcnt) {
@@ -189,8 +346,17 @@ int vmm_blockdev_submit_request(struct vmm_blockdev *bdev,
 	}
 
 	if (rq->make_request) {
+		r->tstamp = vmm_timer_timestamp();
 		vmm_spin_lock_irqsave(&rq->lock, flags);
 		rc = __blockdev_make_request(bdev, r, TRUE);
+		if (!rc) {
+			depth = rq->pending_count + rq->backlog_count;
+			rq->stats.submitted++;
+			rq->stats.depth_sum += depth;
+			if (rq->stats.depth_max < depth) {
+				rq->stats.depth_max = depth;
+			}
+		}
 		vmm_spin_unlock_irqrestore(&rq->lock, flags);
 		if (rc) {
 			return rc;
@@ -210,23 +376,47 @@ VMM_EXPORT_SYMBOL(vmm_blockdev_submit_request);
 
 int vmm_blockdev_abort_request(struct vmm_request *r)
 {
-	int rc;
+	int rc = VMM_OK;
 	irq_flags_t flags;
+	bool backlog = FALSE;
+	struct vmm_request *br;
 	struct vmm_blockdev *bdev;
+	struct vmm_request_queue *rq;
 
 	if (!r || !r->bdev || !r->bdev->rq) {
 		return VMM_EFAIL;
 	}
 	bdev = r->bdev;
+	rq = bdev->rq;
 
-	if (bdev->rq->abort_request) {
-		vmm_spin_lock_irqsave(&bdev->rq->lock, flags);
-		rc = bdev->rq->abort_request(bdev->rq, r);
-		vmm_spin_unlock_irqrestore(&bdev->rq->lock, flags);
-		if (rc) {
-			return rc;
+	vmm_spin_lock_irqsave(&rq->lock, flags);
+	list_for_each_entry(br, &rq->backlog_list, head) {
+		if (br == r) {
+			backlog = TRUE;
+			break;
 		}
 	}
+	if (backlog) {
+		list_del(&r->head);
+		rq->backlog_count--;
+	} else if (rq->abort_request) {
+		rc = rq->abort_request(rq, r);
+	}
+	vmm_spin_unlock_irqrestore(&rq->lock, flags);
+	if (rc) {
+		return rc;
+	}
+
+	/* Backlog request never reached request queue
+	 * so it is not accounted in pending count.
+	 */
+	if (backlog) {
+		if (r->failed) {
+			r->failed(r);
+		}
+		r->bdev = NULL;
+		return VMM_OK;
+	}
 
 	return vmm_blockdev_fail_request(r);
 }
@@ -254,6 +444,58 @@ int vmm_blockdev_flush_cache(struct vmm_blockdev *bdev)
 }
 VMM_EXPORT_SYMBOL(vmm_blockdev_flush_cache);
 
+void vmm_blockdev_plug(struct vmm_blockdev *bdev)
+{
+	irq_flags_t flags;
+
+	if (!bdev || !bdev->rq || !bdev->rq->plug) {
+		return;
+	}
+
+	vmm_spin_lock_irqsave(&bdev->rq->lock, flags);
+	bdev->rq->plug(bdev->rq);
+	vmm_spin_unlock_irqrestore(&bdev->rq->lock, flags);
+}
+VMM_EXPORT_SYMBOL(vmm_blockdev_plug);
+
+void vmm_blockdev_unplug(struct vmm_blockdev *bdev)
+{
+	irq_flags_t flags;
+
+	if (!bdev || !bdev->rq || !bdev->rq->unplug) {
+		return;
+	}
+
+	vmm_spin_lock_irqsave(&bdev->rq->lock, flags);
+	bdev->rq->unplug(bdev->rq);
+	vmm_spin_unlock_irqrestore(&bdev->rq->lock, flags);
+}
+VMM_EXPORT_SYMBOL(vmm_blockdev_unplug);
+
+int vmm_blockdev_get_stats(struct vmm_blockdev *bdev,
+			   struct vmm_request_queue_stats *stats,
+			   u32 *pending, u32 *backlog)
+{
+	irq_flags_t flags;
+
+	if (!bdev || !bdev->rq || !stats) {
+		return VMM_EINVALID;
+	}
+
+	vmm_spin_lock_irqsave(&bdev->rq->lock, flags);
+	memcpy(stats, &bdev->rq->stats, sizeof(*stats));
+	if (pending) {
+		*pending = bdev->rq->pending_count;
+	}
+	if (backlog) {
+		*backlog = bdev->rq->backlog_count;
+	}
+	vmm_spin_unlock_irqrestore(&bdev->rq->lock, flags);
+
+	return VMM_OK;
+}
+VMM_EXPORT_SYMBOL(vmm_blockdev_get_stats);
+
 struct blockdev_rw {
 	bool failed;
 	struct vmm_request req;
@@ -286,7 +528,8 @@ static void blockdev_rw_failed(struct vmm_request *req)
 
 static int blockdev_rw_blocks(struct vmm_blockdev *bdev,
 				enum vmm_request_type type,
-				u8 *buf, u64 lba, u64 bcnt)
+				u8 *buf, struct scatterlist *sgl, u32 sg_nents,
+				u64 lba, u64 bcnt)
 {
 	int rc;
 	struct blockdev_rw rw;
@@ -296,6 +539,8 @@ static int blockdev_rw_blocks(struct vmm_blockdev *bdev,
 	rw.req.lba = bdev->start_lba + lba;
 	rw.req.bcnt = bcnt;
 	rw.req.data = buf;
+	rw.req.sgl = sgl;
+	rw.req.sg_nents = sg_nents;
 	rw.req.priv = &rw;
 	rw.req.completed = blockdev_rw_completed;
 	rw.req.failed = blockdev_rw_failed;
@@ -318,10 +563,10 @@ u64 vmm_blockdev_rw(struct vmm_blockdev *bdev,
 			enum vmm_request_type type,
 			u8 *buf, u64 off, u64 len)
 {
-	u8 *tbuf = NULL;
-	u64 tmp, first_lba, first_off, first_len;
-	u64 middle_lba, middle_len;
-	u64 last_lba, last_len;
+	u8 *tbuf, *tail_buf;
+	u32 nents, bsize;
+	u64 tmp, lba, bcnt, head, tail;
+	struct scatterlist sg[3];
 
 	BUG_ON(!vmm_scheduler_orphan_context());
 
@@ -340,97 +585,76 @@ u64 vmm_blockdev_rw(struct vmm_blockdev *bdev,
 	}
 
 	tmp = bdev->num_blocks * bdev->block_size;
-	if ((off >= tmp) || ((off + len) > tmp)) {
+	if ((off >= tmp) || ((off + len) > tmp) || (len > U32_MAX)) {
 		return 0;
 	}
 
-	first_lba = udiv64(off, bdev->block_size);
-	first_off = off - first_lba * bdev->block_size;
-	if (first_off) {
-		first_len = bdev->block_size - first_off;
-		first_len = (first_len < len) ? first_len : len;
-	} else {
-		if (len < bdev->block_size) {
-			first_len = len;
-		} else {
-			first_len = 0;
-		}
-	}
-
-	off += first_len;
-	len -= first_len;
-
-	middle_lba = udiv64(off, bdev->block_size);
-	middle_len = udiv64(len, bdev->block_size) * bdev->block_size;
-
-	off += middle_len;
-	len -= middle_len;
-
-	last_lba = udiv64(off, bdev->block_size);
-	last_len = len;
+	/* Work out blocks covered by given range and number of
+	 * bytes before and after given range in these blocks.
+	 */
+	bsize = bdev->block_size;
+	lba = udiv64(off, bsize);
+	head = off - lba * bsize;
+	bcnt = udiv64(head + len + bsize - 1, bsize);
+	tail = bcnt * bsize - head - len;
 
-	if (first_len || last_len) {
-		tbuf = vmm_malloc(bdev->block_size);
-		if (!tbuf) {
+	if (!head && !tail) {
+		if (blockdev_rw_blocks(bdev, type, buf, NULL, 0, lba, bcnt)) {
 			return 0;
 		}
+		return len;
+	}
+
+	/* Partial first and/or last block are handled using a
+	 * temporary buffer of two blocks. For read, we simply
+	 * discard unwanted bytes into temporary buffer whereas
+	 * for write, we first read partial blocks in temporary
+	 * buffer. This way the whole range is transferred using
+	 * one scatter-gather request.
+	 */
+	tbuf = vmm_malloc(2 * bsize);
+	if (!tbuf) {
+		return 0;
 	}
+	tail_buf = (bcnt == 1) ? &tbuf[head + len] : &tbuf[2 * bsize - tail];
 
 	tmp = 0;
 
-	if (first_len) {
-		if (blockdev_rw_blocks(bdev, VMM_REQUEST_READ,
-					tbuf, first_lba, 1)) {
-			goto done;
+	if (type == VMM_REQUEST_WRITE) {
+		if (head || (bcnt == 1)) {
+			if (blockdev_rw_blocks(bdev, VMM_REQUEST_READ,
+					       tbuf, NULL, 0, lba, 1)) {
+				goto done;
+			}
 		}
-
-		if (type == VMM_REQUEST_WRITE) {
-			memcpy(&tbuf[first_off], buf, first_len);
-			if (blockdev_rw_blocks(bdev, VMM_REQUEST_WRITE,
-					tbuf, first_lba, 1)) {
+		if (tail && (1 < bcnt)) {
+			if (blockdev_rw_blocks(bdev, VMM_REQUEST_READ,
+					       &tbuf[bsize], NULL, 0,
+					       lba + bcnt - 1, 1)) {
 				goto done;
 			}
-		} else {
-			memcpy(buf, &tbuf[first_off], first_len);
 		}
-
-		buf += first_len;
-		tmp += first_len;
 	}
 
-	if (middle_len) {
-		if (blockdev_rw_blocks(bdev, type,
-		buf, middle_lba, udiv64(middle_len, bdev->block_size))) {
-			goto done;
-		}
-
-		buf += middle_len;
-		tmp += middle_len;
+	nents = 1;
+	nents += (head) ? 1 : 0;
+	nents += (tail) ? 1 : 0;
+	sg_init_table(sg, nents);
+	nents = 0;
+	if (head) {
+		sg_set_buf(&sg[nents++], tbuf, head);
+	}
+	sg_set_buf(&sg[nents++], buf, len);
+	if (tail) {
+		sg_set_buf(&sg[nents++], tail_buf, tail);
 	}
 
-	if (last_len) {
-		if (blockdev_rw_blocks(bdev, VMM_REQUEST_READ,
-					tbuf, last_lba, 1)) {
-			goto done;
-		}
-
-		if (type == VMM_REQUEST_WRITE) {
-			memcpy(&tbuf[0], buf, last_len);
-			if (blockdev_rw_blocks(bdev, VMM_REQUEST_WRITE,
-					tbuf, last_lba, 1)) {
-				goto done;
-			}
-		} else {
-			memcpy(buf, &tbuf[0], last_len);
-		}
-
-		tmp += last_len;
+	if (!blockdev_rw_blocks(bdev, type, NULL, sg, nents, lba, bcnt)) {
+		tmp = len;
 	}
 
 done:
-	if (first_len || last_len) {
-		vmm_free(tbuf);
-	}
+	vmm_free(tbuf);
 
 	return tmp;
 }
@@ -26,9 +26,22 @@
 #include <vmm_limits.h>
 #include <vmm_heap.h>
 #include <vmm_stdio.h>
+#include <vmm_timer.h>
 #include <vmm_modules.h>
 #include <vmm_host_aspace.h>
 #include <block/vmm_blockrq.h>
+#include <libs/stringlib.h>
+#include <libs/mathlib.h>
+#include <libs/scatterlist.h>
+
+/* Number of queued entries which forces dispatch of plugged queue */
+#define BLOCKRQ_UNPLUG_THRESHOLD(brq)	((brq)->max_pending / 2)
+
+/* Deadline elevator tunables */
+#define DEADLINE_READ_EXPIRE_NSECS	(500ULL * 1000000ULL)
+#define DEADLINE_WRITE_EXPIRE_NSECS	(5000ULL * 1000000ULL)
+#define DEADLINE_FIFO_BATCH		16
+#define DEADLINE_WRITES_STARVED		2
 
 struct blockrq_work {
 	struct vmm_blockrq *brq;
@@ -46,8 +59,389 @@ struct blockrq_work {
 		} w;
 	} d;
 	bool is_free;
+
+	/* Scheduling state of read/write work.
+	 * Requests merged together are linked on merge_list of the
+	 * owner work (in LBA order) and only owner work has valid
+	 * elevator entry.
+	 */
+	struct vmm_blockrq_entry e;
+	struct blockrq_work *owner;
+	struct dlist merge_list;
+	struct dlist merge_head;
+	bool dispatched;
+	struct vmm_request mreq;
+	u8 *bounce;
+	struct scatterlist *sgl;
+};
+
+/* ===== noop elevator ===== */
+
+struct blockrq_noop {
+	struct dlist fifo;
+};
+
+static void *blockrq_noop_init(struct vmm_blockrq *brq)
+{
+	struct blockrq_noop *nd = vmm_zalloc(sizeof(*nd));
+
+	if (nd) {
+		INIT_LIST_HEAD(&nd->fifo);
+	}
+
+	return nd;
+}
+
+static void blockrq_noop_exit(struct vmm_blockrq *brq, void *priv)
+{
+	vmm_free(priv);
+}
+
+static void blockrq_noop_add(struct vmm_blockrq *brq,
+			     struct vmm_blockrq_entry *e)
+{
+	struct blockrq_noop *nd = brq->elv_priv;
+
+	list_add_tail(&e->fifo_head, &nd->fifo);
+}
+
+static void blockrq_noop_remove(struct vmm_blockrq *brq,
+				struct vmm_blockrq_entry *e)
+{
+	list_del(&e->fifo_head);
+}
+
+static struct vmm_blockrq_entry *blockrq_noop_find_merge(
+					struct vmm_blockrq *brq,
+					enum vmm_request_type type,
+					u64 lba, u32 bcnt,
+					u32 max_bcnt, bool *front)
+{
+	struct vmm_blockrq_entry *e;
+	struct blockrq_noop *nd = brq->elv_priv;
+
+	/* Only try last queued entry so that FIFO order is preserved */
+	if (list_empty(&nd->fifo)) {
+		return NULL;
+	}
+	e = list_last_entry(&nd->fifo, struct vmm_blockrq_entry, fifo_head);
+	if ((e->type != type) || (max_bcnt < (e->bcnt + bcnt))) {
+		return NULL;
+	}
+
+	if ((e->lba + e->bcnt) == lba) {
+		*front = FALSE;
+		return e;
+	}
+	if ((lba + bcnt) == e->lba) {
+		*front = TRUE;
+		return e;
+	}
+
+	return NULL;
+}
+
+static struct vmm_blockrq_entry *blockrq_noop_dispatch(
+					struct vmm_blockrq *brq)
+{
+	struct vmm_blockrq_entry *e;
+	struct blockrq_noop *nd = brq->elv_priv;
+
+	if (list_empty(&nd->fifo)) {
+		return NULL;
+	}
+
+	e = list_first_entry(&nd->fifo, struct vmm_blockrq_entry, fifo_head);
+	list_del(&e->fifo_head);
+
+	return e;
+}
+
+static const struct vmm_blockrq_elevator blockrq_noop = {
+	.name = "noop",
+	.init = blockrq_noop_init,
+	.exit = blockrq_noop_exit,
+	.add = blockrq_noop_add,
+	.remove = blockrq_noop_remove,
+	.find_merge = blockrq_noop_find_merge,
+	.dispatch = blockrq_noop_dispatch,
+};
+
+/* ===== deadline elevator =====
+ *
+ * Entries are kept in LBA sorted list and in FIFO list per direction.
+ * Entries are dispatched in LBA order in batches of DEADLINE_FIFO_BATCH
+ * and reads are preferred over writes unless writes were starved for
+ * DEADLINE_WRITES_STARVED batches. A new batch starts from oldest entry
+ * if it has exceeded its deadline.
+ */
+
+enum blockrq_deadline_dir {
+	DEADLINE_READ=0,
+	DEADLINE_WRITE=1,
+	DEADLINE_DIR_MAX=2
+};
+
+struct blockrq_deadline {
+	struct dlist sort[DEADLINE_DIR_MAX];
+	struct dlist fifo[DEADLINE_DIR_MAX];
+	struct vmm_blockrq_entry *next[DEADLINE_DIR_MAX];
+	enum blockrq_deadline_dir dir;
+	u32 batching;
+	u32 starved;
+};
+
+static inline enum blockrq_deadline_dir blockrq_deadline_dir(
+					enum vmm_request_type type)
+{
+	return (type == VMM_REQUEST_READ) ? DEADLINE_READ : DEADLINE_WRITE;
+}
+
+static void *blockrq_deadline_init(struct vmm_blockrq *brq)
+{
+	int dir;
+	struct blockrq_deadline *dd = vmm_zalloc(sizeof(*dd));
+
+	if (!dd) {
+		return NULL;
+	}
+
+	for (dir = 0; dir < DEADLINE_DIR_MAX; dir++) {
+		INIT_LIST_HEAD(&dd->sort[dir]);
+		INIT_LIST_HEAD(&dd->fifo[dir]);
+		dd->next[dir] = NULL;
+	}
+	dd->dir = DEADLINE_READ;
+
+	return dd;
+}
+
+static void blockrq_deadline_exit(struct vmm_blockrq *brq, void *priv)
+{
+	vmm_free(priv);
+}
+
+static void blockrq_deadline_add(struct vmm_blockrq *brq,
+				 struct vmm_blockrq_entry *e)
+{
+	struct vmm_blockrq_entry *pos;
+	struct blockrq_deadline *dd = brq->elv_priv;
+	enum blockrq_deadline_dir dir = blockrq_deadline_dir(e->type);
+
+	/* Sequential streams mostly append so search from tail */
+	list_for_each_entry_reverse(pos, &dd->sort[dir], sort_head) {
+		if (pos->lba <= e->lba) {
+			break;
+		}
+	}
+	list_add(&e->sort_head, &pos->sort_head);
+
+	list_add_tail(&e->fifo_head, &dd->fifo[dir]);
+}
+
+static struct vmm_blockrq_entry *blockrq_deadline_next(
+					struct blockrq_deadline *dd,
+					enum blockrq_deadline_dir dir,
+					struct vmm_blockrq_entry *e)
+{
+	if (list_is_last(&e->sort_head, &dd->sort[dir])) {
+		return NULL;
+	}
+
+	return list_next_entry(e, sort_head);
+}
+
+static void blockrq_deadline_remove(struct vmm_blockrq *brq,
+				    struct vmm_blockrq_entry *e)
+{
+	struct blockrq_deadline *dd = brq->elv_priv;
+	enum blockrq_deadline_dir dir = blockrq_deadline_dir(e->type);
+
+	if (dd->next[dir] == e) {
+		dd->next[dir] = blockrq_deadline_next(dd, dir, e);
+	}
+	list_del(&e->sort_head);
+	list_del(&e->fifo_head);
+}
+
+static struct vmm_blockrq_entry *blockrq_deadline_find_merge(
+					struct vmm_blockrq *brq,
+					enum vmm_request_type type,
+					u64 lba, u32 bcnt,
+					u32 max_bcnt, bool *front)
+{
+	struct vmm_blockrq_entry *e;
+	struct blockrq_deadline *dd = brq->elv_priv;
+	enum blockrq_deadline_dir dir = blockrq_deadline_dir(type);
+
+	list_for_each_entry(e, &dd->sort[dir], sort_head) {
+		if ((lba + bcnt) < e->lba) {
+			break;
+		}
+		if ((e->type != type) || (max_bcnt < (e->bcnt + bcnt))) {
+			continue;
+		}
+		if ((e->lba + e->bcnt) == lba) {
+			*front = FALSE;
+			return e;
+		}
+		if ((lba + bcnt) == e->lba) {
+			*front = TRUE;
+			return e;
+		}
+	}
+
+	return NULL;
+}
+
+static struct vmm_blockrq_entry *blockrq_deadline_dispatch(
+					struct vmm_blockrq *brq)
+{
+	u64 expire;
+	bool reads, writes;
+	enum blockrq_deadline_dir dir;
+	struct vmm_blockrq_entry *e, *fe;
+	struct blockrq_deadline *dd = brq->elv_priv;
+
+	reads = !list_empty(&dd->fifo[DEADLINE_READ]);
+	writes = !list_empty(&dd->fifo[DEADLINE_WRITE]);
+	if (!reads && !writes) {
+		return NULL;
+	}
+
+	/* Continue current batch in LBA order if possible */
+	dir = dd->dir;
+	e = dd->next[dir];
+	if (e && (dd->batching < DEADLINE_FIFO_BATCH)) {
+		goto found;
+	}
+
+	/* Start new batch preferring reads over writes */
+	if (reads && (!writes || (dd->starved < DEADLINE_WRITES_STARVED))) {
+		if (writes) {
+			dd->starved++;
+		}
+		dir = DEADLINE_READ;
+		expire = DEADLINE_READ_EXPIRE_NSECS;
+	} else {
+		dd->starved = 0;
+		dir = DEADLINE_WRITE;
+		expire = DEADLINE_WRITE_EXPIRE_NSECS;
+	}
+
+	fe = list_first_entry(&dd->fifo[dir],
+			      struct vmm_blockrq_entry, fifo_head);
+	e = dd->next[dir];
+	if (!e || ((fe->tstamp + expire) <= vmm_timer_timestamp())) {
+		e = fe;
+	}
+	dd->dir = dir;
+	dd->batching = 0;
+
+found:
+	dd->batching++;
+	dd->next[dir] = blockrq_deadline_next(dd, dir, e);
+	list_del(&e->sort_head);
+	list_del(&e->fifo_head);
+
+	return e;
+}
+
+static const struct vmm_blockrq_elevator blockrq_deadline = {
+	.name = "deadline",
+	.init = blockrq_deadline_init,
+	.exit = blockrq_deadline_exit,
+	.add = blockrq_deadline_add,
+	.remove = blockrq_deadline_remove,
+	.find_merge = blockrq_deadline_find_merge,
+	.dispatch = blockrq_deadline_dispatch,
+};
+
+static const struct vmm_blockrq_elevator *blockrq_elevators[] = {
+	&blockrq_deadline,
+	&blockrq_noop,
 };
 
+/* ===== request queue ===== */
+
+/* Note: Must be called with wq_lock held */
+static void blockrq_kick(struct vmm_blockrq *brq)
+{
+	if (!brq->wq_queued_count) {
+		return;
+	}
+
+	if (brq->wq_plug_count &&
+	    (brq->wq_queued_count < BLOCKRQ_UNPLUG_THRESHOLD(brq))) {
+		return;
+	}
+
+	vmm_workqueue_schedule_work(brq->wq, &brq->wq_dispatch_work);
+}
+
+/* Note: Must be called with wq_lock held */
+static void blockrq_elv_add(struct vmm_blockrq *brq,
+			    struct blockrq_work *bwork)
+{
+	struct vmm_request *r = bwork->d.rw.r;
+
+	bwork->owner = bwork;
+	INIT_LIST_HEAD(&bwork->merge_list);
+	list_add_tail(&bwork->merge_head, &bwork->merge_list);
+
+	bwork->e.type = r->type;
+	bwork->e.lba = r->lba;
+	bwork->e.bcnt = r->bcnt;
+	bwork->e.tstamp = (r->tstamp) ? r->tstamp : vmm_timer_timestamp();
+	brq->elv->add(brq, &bwork->e);
+	brq->wq_queued_count++;
+}
+
+/* Note: Must be called with wq_lock held */
+static bool blockrq_elv_merge(struct vmm_blockrq *brq,
+			      struct blockrq_work *bwork)
+{
+	u32 max_bcnt;
+	bool front = FALSE;
+	struct vmm_blockrq_entry *e;
+	struct blockrq_work *owner;
+	struct vmm_request *r = bwork->d.rw.r;
+
+	if (!brq->max_seg_size || !r->bdev || !r->bdev->block_size) {
+		return FALSE;
+	}
+	if ((r->type != VMM_REQUEST_READ) && (r->type != VMM_REQUEST_WRITE)) {
+		return FALSE;
+	}
+
+	max_bcnt = udiv32(brq->max_seg_size, r->bdev->block_size);
+	if (max_bcnt <= r->bcnt) {
+		return FALSE;
+	}
+
+	e = brq->elv->find_merge(brq, r->type, r->lba, r->bcnt,
+				 max_bcnt, &front);
+	if (!e) {
+		return FALSE;
+	}
+	owner = container_of(e, struct blockrq_work, e);
+
+	bwork->owner = owner;
+	INIT_LIST_HEAD(&bwork->merge_list);
+	if (front) {
+		list_add(&bwork->merge_head, &owner->merge_list);
+		e->lba = r->lba;
+	} else {
+		list_add_tail(&bwork->merge_head, &owner->merge_list);
+	}
+	e->bcnt += r->bcnt;
+
+	/* Note: We are called from make_request() with rq lock held */
+	brq->rq.stats.merged++;
+
+	return TRUE;
+}
+
 static int blockrq_queue_rw(struct vmm_blockrq *brq,
 			    struct vmm_request *r)
 {
@@ -67,16 +461,19 @@ static int blockrq_queue_rw(struct vmm_blockrq *brq,
 	list_del(&bwork->head);
 	bwork->is_rw = TRUE;
 	bwork->d.rw.r = r;
-	if (r) {
-		bwork->d.rw.priv = r->priv;
-		r->priv = bwork;
-	} else {
-		bwork->d.rw.priv = NULL;
-	}
+	bwork->d.rw.priv = r->priv;
+	r->priv = bwork;
 	bwork->is_free = FALSE;
+	bwork->dispatched = FALSE;
+	bwork->bounce = NULL;
+	bwork->sgl = NULL;
 	list_add_tail(&bwork->head, &brq->wq_pending_list);
 
-	vmm_workqueue_schedule_work(brq->wq, &bwork->work);
+	if (!blockrq_elv_merge(brq, bwork)) {
+		blockrq_elv_add(brq, bwork);
+	}
+
+	blockrq_kick(brq);
 
 done:
 	vmm_spin_unlock_irqrestore(&brq->wq_lock, flags);
@@ -116,13 +513,11 @@ done:
 	return rc;
 }
 
-static void blockrq_dequeue_work(struct blockrq_work *bwork)
+/* Note: Must be called with wq_lock held */
+static void __blockrq_dequeue_work(struct blockrq_work *bwork)
 {
-	irq_flags_t flags;
 	struct vmm_blockrq *brq = bwork->brq;
 
-	vmm_spin_lock_irqsave(&brq->wq_lock, flags);
-
 	list_del(&bwork->head);
 	bwork->is_free = TRUE;
 	if (bwork->is_rw) {
@@ -137,7 +532,15 @@ static void blockrq_dequeue_work(struct blockrq_work *bwork)
 		bwork->d.w.priv = NULL;
 		list_add_tail(&bwork->head, &brq->wq_w_free_list);
 	}
+}
+
+static void blockrq_dequeue_work(struct blockrq_work *bwork)
+{
+	irq_flags_t flags;
+	struct vmm_blockrq *brq = bwork->brq;
 
+	vmm_spin_lock_irqsave(&brq->wq_lock, flags);
+	__blockrq_dequeue_work(bwork);
 	vmm_spin_unlock_irqrestore(&brq->wq_lock, flags);
 }
 
@@ -145,21 +548,52 @@ static int blockrq_abort_rw(struct vmm_blockrq *brq,
 			    struct vmm_request *r)
 {
 	int rc = VMM_OK;
-	struct blockrq_work *bwork;
+	irq_flags_t flags;
+	struct dlist group;
+	struct blockrq_work *bwork, *owner, *m, *n;
 
-	if (!brq || !r || !r->priv) {
+	if (!brq || !r) {
 		return VMM_EINVALID;
 	}
+	INIT_LIST_HEAD(&group);
+
+	vmm_spin_lock_irqsave(&brq->wq_lock, flags);
+
+	/* Request without work is being completed by blockrq_rw_done()
+	 * so caller will get completed() or failed() callback shortly.
+	 */
 	bwork = r->priv;
+	if (!bwork || bwork->is_free || !bwork->is_rw ||
+	    (bwork->d.rw.r != r)) {
+		vmm_spin_unlock_irqrestore(&brq->wq_lock, flags);
+		return VMM_EBUSY;
+	}
 
-	rc = vmm_workqueue_stop_work(&bwork->work);
-	if (rc) {
-		return rc;
+	/* Request (alone or merged) handed over to driver can't be
+	 * taken back because driver still owns its data buffer and
+	 * its work will be released by blockrq_rw_done().
+	 */
+	if (bwork->dispatched) {
+		vmm_spin_unlock_irqrestore(&brq->wq_lock, flags);
+		return VMM_EBUSY;
 	}
 
-	if (!bwork->is_free) {
-		blockrq_dequeue_work(bwork);
+	/* Take merged group out of elevator and put back
+	 * remaining requests individually.
+	 */
+	owner = bwork->owner;
+	brq->elv->remove(brq, &owner->e);
+	brq->wq_queued_count--;
+	list_splice_init(&owner->merge_list, &group);
+	list_for_each_entry_safe(m, n, &group, merge_head) {
+		list_del(&m->merge_head);
+		if (m != bwork) {
+			blockrq_elv_add(brq, m);
+		}
 	}
+	__blockrq_dequeue_work(bwork);
+
+	vmm_spin_unlock_irqrestore(&brq->wq_lock, flags);
 
 	if (brq->abort) {
 		rc = brq->abort(brq, r, brq->priv);
@@ -168,66 +602,336 @@ static int blockrq_abort_rw(struct vmm_blockrq *brq,
 	return rc;
 }
 
-void blockrq_rw_done(struct blockrq_work *bwork, int error)
+static void blockrq_rw_done(struct blockrq_work *bwork,
+			    struct vmm_request *r, int error)
 {
-	struct vmm_request *r;
+	irq_flags_t flags;
+	struct dlist done_list;
+	struct blockrq_work *m, *n;
+	struct vmm_blockrq *brq;
 
-	if (!bwork || !bwork->is_rw) {
+	if (!bwork || !bwork->is_rw || !r) {
 		return;
 	}
-	if (!bwork->d.rw.r || !bwork->d.rw.r->priv) {
+	brq = bwork->brq;
+
+	/* Single request completion */
+	if (r != &bwork->mreq) {
+		if (!bwork->d.rw.r || !bwork->d.rw.r->priv) {
+			return;
+		}
+		blockrq_dequeue_work(bwork);
+		if (error) {
+			vmm_blockdev_fail_request(r);
+		} else {
+			vmm_blockdev_complete_request(r);
+		}
 		return;
 	}
-	r = bwork->d.rw.r;
 
-	blockrq_dequeue_work(bwork);
-	if (error) {
-		vmm_blockdev_fail_request(r);
-	} else {
-		vmm_blockdev_complete_request(r);
+	/* Merged (or linearized) request completion */
+	if (bwork->bounce) {
+		if (!error && (r->type == VMM_REQUEST_READ)) {
+			u8 *src = bwork->bounce;
+
+			list_for_each_entry(m, &bwork->merge_list, merge_head) {
+				src += vmm_request_copy_from_buf(m->d.rw.r, src,
+					vmm_request_data_size(m->d.rw.r));
+			}
+		}
+		vmm_free(bwork->bounce);
+		bwork->bounce = NULL;
+	}
+	if (bwork->sgl) {
+		vmm_free(bwork->sgl);
+		bwork->sgl = NULL;
 	}
-}
 
-static void blockrq_work_func(struct vmm_work *work)
-{
-	int rc = VMM_OK;
-	void *w_priv;
-	void (*w_func)(struct vmm_blockrq *, void *);
-	struct blockrq_work *bwork =
-		container_of(work, struct blockrq_work, work);
-	struct vmm_blockrq *brq = bwork->brq;
+	INIT_LIST_HEAD(&done_list);
+	vmm_spin_lock_irqsave(&brq->wq_lock, flags);
+	list_splice_init(&bwork->merge_list, &done_list);
+	vmm_spin_unlock_irqrestore(&brq->wq_lock, flags);
 
-	if (!bwork->is_rw) {
-		w_func = bwork->d.w.func;
-		w_priv = bwork->d.w.priv;
-		blockrq_dequeue_work(bwork);
-		if (w_func) {
-			w_func(brq, w_priv);
+	list_for_each_entry_safe(m, n, &done_list, merge_head) {
+		r = m->d.rw.r;
+		list_del(&m->merge_head);
+		blockrq_dequeue_work(m);
+		if (error) {
+			vmm_blockdev_fail_request(r);
+		} else {
+			vmm_blockdev_complete_request(r);
 		}
-		return;
 	}
+}
+
+static int blockrq_do_rw(struct vmm_blockrq *brq, struct vmm_request *r)
+{
+	int rc;
 
-	switch (bwork->d.rw.r->type) {
+	switch (r->type) {
 	case VMM_REQUEST_READ:
 		if (brq->read) {
-			rc = brq->read(brq, bwork->d.rw.r, brq->priv);
+			rc = brq->read(brq, r, brq->priv);
 		} else {
 			rc = VMM_EIO;
 		}
 		break;
 	case VMM_REQUEST_WRITE:
 		if (brq->write) {
-			rc = brq->write(brq, bwork->d.rw.r, brq->priv);
+			rc = brq->write(brq, r, brq->priv);
 		} else {
 			rc = VMM_EIO;
 		}
 		break;
+	case VMM_REQUEST_DISCARD:
+		if (brq->discard) {
+			rc = brq->discard(brq, r, brq->priv);
+		} else {
+			rc = VMM_ENOTSUPP;
+		}
+		break;
+	case VMM_REQUEST_WRITE_ZEROES:
+		if (brq->write_zeroes) {
+			rc = brq->write_zeroes(brq, r, brq->priv);
+		} else {
+			rc = VMM_ENOTSUPP;
+		}
+		break;
 	default:
 		rc = VMM_EINVALID;
 		break;
 	};
-	if (!brq->async_rw) {
-		blockrq_rw_done(bwork, rc);
+
+	return rc;
+}
+
+/* Check whether read/write callbacks can take given request as-is */
+static bool blockrq_sg_acceptable(struct vmm_blockrq *brq,
+				  struct vmm_request *r)
+{
+	u32 i;
+	struct scatterlist *sg;
+
+	if (!r->sgl) {
+		return TRUE;
+	}
+	if (!brq->max_sg_nents || (brq->max_sg_nents < r->sg_nents)) {
+		return FALSE;
+	}
+	if (brq->sg_block_aligned) {
+		for_each_sg(r->sgl, sg, r->sg_nents, i) {
+			if (umod32(sg->length, r->bdev->block_size)) {
+				return FALSE;
+			}
+		}
+	}
+
+	return TRUE;
+}
+
+static void blockrq_dispatch_single(struct vmm_blockrq *brq,
+				    struct blockrq_work *bwork)
+{
+	int rc;
+	struct vmm_request *r = bwork->d.rw.r;
+
+	if (blockrq_sg_acceptable(brq, r)) {
+		rc = blockrq_do_rw(brq, r);
+	} else {
+		rc = VMM_ENOMEM;
+	}
+	if (!brq->async_rw || rc) {
+		blockrq_rw_done(bwork, r, rc);
+	}
+}
+
+/* Build scatter-gather list covering all requests of a merged group
+ * Note: Returns number of entries or zero when not possible.
+ */
+static u32 blockrq_build_sgl(struct vmm_blockrq *brq,
+			     struct blockrq_work *owner)
+{
+	u32 i, nents = 0;
+	struct vmm_request *r;
+	struct blockrq_work *m;
+	struct scatterlist *sg, *dsg;
+
+	list_for_each_entry(m, &owner->merge_list, merge_head) {
+		nents += (m->d.rw.r->sgl) ? m->d.rw.r->sg_nents : 1;
+	}
+	if (!brq->max_sg_nents || (brq->max_sg_nents < nents)) {
+		return 0;
+	}
+
+	owner->sgl = vmm_malloc(nents * sizeof(*owner->sgl));
+	if (!owner->sgl) {
+		return 0;
+	}
+	sg_init_table(owner->sgl, nents);
+
+	dsg = owner->sgl;
+	list_for_each_entry(m, &owner->merge_list, merge_head) {
+		r = m->d.rw.r;
+		if (!r->sgl) {
+			sg_set_buf(dsg, r->data, vmm_request_data_size(r));
+			dsg++;
+			continue;
+		}
+		for_each_sg(r->sgl, sg, r->sg_nents, i) {
+			sg_set_page(dsg, sg_page(sg), sg->length, sg->offset);
+			dsg++;
+		}
+	}
+	owner->mreq.sgl = owner->sgl;
+	owner->mreq.sg_nents = nents;
+
+	if (!blockrq_sg_acceptable(brq, &owner->mreq)) {
+		owner->mreq.sgl = NULL;
+		owner->mreq.sg_nents = 0;
+		vmm_free(owner->sgl);
+		owner->sgl = NULL;
+		return 0;
+	}
+
+	return nents;
+}
+
+static void blockrq_dispatch_owner(struct vmm_blockrq *brq,
+				   struct blockrq_work *owner)
+{
+	int rc;
+	u8 *dst, *expect;
+	u32 count = 0;
+	irq_flags_t flags;
+	bool contiguous = TRUE;
+	struct blockrq_work *m, *n, *first;
+	struct vmm_request *r, *mreq = &owner->mreq;
+
+	list_for_each_entry(m, &owner->merge_list, merge_head) {
+		count++;
+	}
+
+	vmm_spin_lock_irqsave(&brq->rq.lock, flags);
+	brq->rq.stats.dispatched++;
+	vmm_spin_unlock_irqrestore(&brq->rq.lock, flags);
+
+	if ((count == 1) && blockrq_sg_acceptable(brq, owner->d.rw.r)) {
+		blockrq_dispatch_single(brq, owner);
+		return;
+	}
+
+	first = list_first_entry(&owner->merge_list,
+				 struct blockrq_work, merge_head);
+	r = first->d.rw.r;
+
+	/* Use caller buffers directly if they are back to back */
+	expect = r->data;
+	list_for_each_entry(m, &owner->merge_list, merge_head) {
+		if (m->d.rw.r->sgl || ((u8 *)m->d.rw.r->data != expect)) {
+			contiguous = FALSE;
+			break;
+		}
+		expect += vmm_request_data_size(m->d.rw.r);
+	}
+
+	INIT_LIST_HEAD(&mreq->head);
+	mreq->bdev = r->bdev;
+	mreq->type = owner->e.type;
+	mreq->lba = owner->e.lba;
+	mreq->bcnt = owner->e.bcnt;
+	mreq->data = NULL;
+	mreq->sgl = NULL;
+	mreq->sg_nents = 0;
+	mreq->completed = NULL;
+	mreq->failed = NULL;
+	mreq->priv = owner;
+	mreq->tstamp = owner->e.tstamp;
+	owner->bounce = NULL;
+	owner->sgl = NULL;
+
+	if (contiguous) {
+		mreq->data = r->data;
+	} else if (!blockrq_build_sgl(brq, owner)) {
+		owner->bounce = vmm_malloc(vmm_request_data_size(mreq));
+		if (!owner->bounce) {
+			/* No memory for bounce buffer so issue requests
+			 * one by one. Note: Next member is not dispatched
+			 * yet hence it is safe to look at after issuing
+			 * current member.
+			 */
+			list_for_each_entry_safe(m, n, &owner->merge_list,
+						 merge_head) {
+				blockrq_dispatch_single(brq, m);
+			}
+			return;
+		}
+		mreq->data = owner->bounce;
+		if (mreq->type == VMM_REQUEST_WRITE) {
+			dst = owner->bounce;
+			list_for_each_entry(m, &owner->merge_list, merge_head) {
+				dst += vmm_request_copy_to_buf(m->d.rw.r, dst,
+					vmm_request_data_size(m->d.rw.r));
+			}
+		}
+	}
+
+	rc = blockrq_do_rw(brq, mreq);
+	if (!brq->async_rw || rc) {
+		blockrq_rw_done(owner, mreq, rc);
+	}
+}
+
+static void blockrq_dispatch(struct vmm_blockrq *brq, bool force)
+{
+	irq_flags_t flags;
+	struct vmm_blockrq_entry *e;
+	struct blockrq_work *owner, *m;
+
+	while (1) {
+		vmm_spin_lock_irqsave(&brq->wq_lock, flags);
+		if (!force && brq->wq_plug_count &&
+		    (brq->wq_queued_count < BLOCKRQ_UNPLUG_THRESHOLD(brq))) {
+			e = NULL;
+		} else {
+			e = brq->elv->dispatch(brq);
+		}
+		if (!e) {
+			vmm_spin_unlock_irqrestore(&brq->wq_lock, flags);
+			break;
+		}
+		brq->wq_queued_count--;
+		owner = container_of(e, struct blockrq_work, e);
+		list_for_each_entry(m, &owner->merge_list, merge_head) {
+			m->dispatched = TRUE;
+		}
+		vmm_spin_unlock_irqrestore(&brq->wq_lock, flags);
+
+		blockrq_dispatch_owner(brq, owner);
+	}
+}
+
+static void blockrq_dispatch_work(struct vmm_work *work)
+{
+	blockrq_dispatch(container_of(work, struct vmm_blockrq,
+				      wq_dispatch_work), FALSE);
+}
+
+static void blockrq_work_func(struct vmm_work *work)
+{
+	void *w_priv;
+	void (*w_func)(struct vmm_blockrq *, void *);
+	struct blockrq_work *bwork =
+		container_of(work, struct blockrq_work, work);
+	struct vmm_blockrq *brq = bwork->brq;
+
+	/* Custom work is ordered after all queued read/write requests */
+	blockrq_dispatch(brq, TRUE);
+
+	w_func = bwork->d.w.func;
+	w_priv = bwork->d.w.priv;
+	blockrq_dequeue_work(bwork);
+	if (w_func) {
+		w_func(brq, w_priv);
 	}
 }
 
@@ -256,6 +960,161 @@ static int blockrq_flush_cache(struct vmm_request_queue *rq)
 				  blockrq_flush_work, NULL);
 }
 
+static void blockrq_plug(struct vmm_request_queue *rq)
+{
+	irq_flags_t flags;
+	struct vmm_blockrq *brq = vmm_blockrq_from_rq(rq);
+
+	vmm_spin_lock_irqsave(&brq->wq_lock, flags);
+	brq->wq_plug_count++;
+	vmm_spin_unlock_irqrestore(&brq->wq_lock, flags);
+}
+
+static void blockrq_unplug(struct vmm_request_queue *rq)
+{
+	irq_flags_t flags;
+	struct vmm_blockrq *brq = vmm_blockrq_from_rq(rq);
+
+	vmm_spin_lock_irqsave(&brq->wq_lock, flags);
+	if (brq->wq_plug_count) {
+		brq->wq_plug_count--;
+	}
+	blockrq_kick(brq);
+	vmm_spin_unlock_irqrestore(&brq->wq_lock, flags);
+}
+
+const struct vmm_blockrq_elevator *vmm_blockrq_elevator_find(
+							const char *name)
+{
+	u32 i;
+
+	if (!name) {
+		return NULL;
+	}
+
+	for (i = 0; i < array_size(blockrq_elevators); i++) {
+		if (!strcmp(blockrq_elevators[i]->name, name)) {
+			return blockrq_elevators[i];
+		}
+	}
+
+	return NULL;
+}
+VMM_EXPORT_SYMBOL(vmm_blockrq_elevator_find);
+
+int vmm_blockrq_set_elevator(struct vmm_blockrq *brq,
+			     const struct vmm_blockrq_elevator *elv)
+{
+	void *priv, *old_priv;
+	irq_flags_t flags;
+	struct dlist moved;
+	struct vmm_blockrq_entry *e, *ne;
+	const struct vmm_blockrq_elevator *old;
+
+	if (!brq || !elv || !elv->init || !elv->exit || !elv->add ||
+	    !elv->remove || !elv->find_merge || !elv->dispatch) {
+		return VMM_EINVALID;
+	}
+
+	priv = elv->init(brq);
+	if (!priv) {
+		return VMM_ENOMEM;
+	}
+
+	INIT_LIST_HEAD(&moved);
+
+	vmm_spin_lock_irqsave(&brq->wq_lock, flags);
+
+	old = brq->elv;
+	old_priv = brq->elv_priv;
+	if (old) {
+		while ((e = old->dispatch(brq))) {
+			list_add_tail(&e->fifo_head, &moved);
+		}
+	}
+
+	brq->elv = elv;
+	brq->elv_priv = priv;
+	list_for_each_entry_safe(e, ne, &moved, fifo_head) {
+		list_del(&e->fifo_head);
+		elv->add(brq, e);
+	}
+
+	vmm_spin_unlock_irqrestore(&brq->wq_lock, flags);
+
+	if (old) {
+		old->exit(brq, old_priv);
+	}
+
+	return VMM_OK;
+}
+VMM_EXPORT_SYMBOL(vmm_blockrq_set_elevator);
+
+void vmm_blockrq_set_max_seg_size(struct vmm_blockrq *brq, u32 max_seg_size)
+{
+	irq_flags_t flags;
+
+	if (!brq) {
+		return;
+	}
+
+	vmm_spin_lock_irqsave(&brq->wq_lock, flags);
+	brq->max_seg_size = max_seg_size;
+	vmm_spin_unlock_irqrestore(&brq->wq_lock, flags);
+}
+VMM_EXPORT_SYMBOL(vmm_blockrq_set_max_seg_size);
+
+void vmm_blockrq_set_sg_limits(struct vmm_blockrq *brq,
+			       u32 max_sg_nents, bool block_aligned)
+{
+	irq_flags_t flags;
+
+	if (!brq) {
+		return;
+	}
+
+	vmm_spin_lock_irqsave(&brq->wq_lock, flags);
+	brq->max_sg_nents = max_sg_nents;
+	brq->sg_block_aligned = block_aligned;
+	vmm_spin_unlock_irqrestore(&brq->wq_lock, flags);
+}
+VMM_EXPORT_SYMBOL(vmm_blockrq_set_sg_limits);
+
+void vmm_blockrq_set_discard(struct vmm_blockrq *brq,
+	int (*discard)(struct vmm_blockrq *, struct vmm_request *, void *),
+	u32 max_blocks)
+{
+	irq_flags_t flags;
+
+	if (!brq) {
+		return;
+	}
+
+	vmm_spin_lock_irqsave(&brq->rq.lock, flags);
+	brq->discard = discard;
+	brq->rq.max_discard_blocks = (discard) ? max_blocks : 0;
+	vmm_spin_unlock_irqrestore(&brq->rq.lock, flags);
+}
+VMM_EXPORT_SYMBOL(vmm_blockrq_set_discard);
+
+void vmm_blockrq_set_write_zeroes(struct vmm_blockrq *brq,
+	int (*write_zeroes)(struct vmm_blockrq *,
+			    struct vmm_request *, void *),
+	u32 max_blocks)
+{
+	irq_flags_t flags;
+
+	if (!brq) {
+		return;
+	}
+
+	vmm_spin_lock_irqsave(&brq->rq.lock, flags);
+	brq->write_zeroes = write_zeroes;
+	brq->rq.max_write_zeroes_blocks = (write_zeroes) ? max_blocks : 0;
+	vmm_spin_unlock_irqrestore(&brq->rq.lock, flags);
+}
+VMM_EXPORT_SYMBOL(vmm_blockrq_set_write_zeroes);
+
 void vmm_blockrq_async_done(struct vmm_blockrq *brq,
 			    struct vmm_request *r, int error)
 {
@@ -266,7 +1125,7 @@ void vmm_blockrq_async_done(struct vmm_blockrq *brq,
 	}
 	bwork = r->priv;
 
-	blockrq_rw_done(bwork, error);
+	blockrq_rw_done(bwork, r, error);
 }
 VMM_EXPORT_SYMBOL(vmm_blockrq_async_done);
 
@@ -295,6 +1154,8 @@ int vmm_blockrq_destroy(struct vmm_blockrq *brq)
 		return rc;
 	}
 
+	brq->elv->exit(brq, brq->elv_priv);
+
 	vmm_host_free_pages(brq->wq_page_va, brq->wq_page_count);
 
 	vmm_free(brq);
@@ -334,7 +1195,12 @@ struct vmm_blockrq *vmm_blockrq_create(
 	brq->write = write;
 	brq->abort = abort;
 	brq->flush = flush;
+	brq->discard = NULL;
+	brq->write_zeroes = NULL;
 	brq->priv = priv;
+	brq->max_seg_size = VMM_BLOCKRQ_DEF_MAX_SEG_SIZE;
+	brq->max_sg_nents = 0;
+	brq->sg_block_aligned = FALSE;
 
 	brq->wq_page_count =
 		VMM_SIZE_TO_PAGE(max_pending * sizeof(*bwork) * 2);
@@ -344,6 +1210,9 @@ struct vmm_blockrq *vmm_blockrq_create(
 	INIT_LIST_HEAD(&brq->wq_rw_free_list);
 	INIT_LIST_HEAD(&brq->wq_w_free_list);
 	INIT_LIST_HEAD(&brq->wq_pending_list);
+	brq->wq_queued_count = 0;
+	brq->wq_plug_count = 0;
+	INIT_WORK(&brq->wq_dispatch_work, blockrq_dispatch_work);
 
 	for (i = 0; i < brq->max_pending; i++) {
 		bwork = (struct blockrq_work *)(brq->wq_page_va +
@@ -371,9 +1240,13 @@ struct vmm_blockrq *vmm_blockrq_create(
 		list_add_tail(&bwork->head, &brq->wq_w_free_list);
 	}
 
+	if (vmm_blockrq_set_elevator(brq, &blockrq_deadline)) {
+		goto fail_free_pages;
+	}
+
 	brq->wq = vmm_workqueue_create(name, VMM_THREAD_DEF_PRIORITY);
 	if (!brq->wq) {
-		goto fail_free_pages;
+		goto fail_free_elv;
 	}
 
 	INIT_REQUEST_QUEUE(&brq->rq,
@@ -382,9 +1255,14 @@ struct vmm_blockrq *vmm_blockrq_create(
 			   blockrq_abort_request,
 			   blockrq_flush_cache,
 			   brq);
+	brq->rq.plug = blockrq_plug;
+	brq->rq.unplug = blockrq_unplug;
+	brq->rq.sg_capable = TRUE;
 
 	return brq;
 
+fail_free_elv:
+	brq->elv->exit(brq, brq->elv_priv);
 fail_free_pages:
 	vmm_host_free_pages(brq->wq_page_va, brq->wq_page_count);
 fail_free_brq:
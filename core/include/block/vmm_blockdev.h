@@ -34,11 +34,15 @@
 #define VMM_BLOCKDEV_CLASS_NAME				"block"
 #define VMM_BLOCKDEV_CLASS_IPRIORITY			1
 
+struct scatterlist;
+
 /** Types of block IO request */
 enum vmm_request_type {
 	VMM_REQUEST_UNKNOWN=0,
 	VMM_REQUEST_READ=1,
-	VMM_REQUEST_WRITE=2
+	VMM_REQUEST_WRITE=2,
+	VMM_REQUEST_DISCARD=3,
+	VMM_REQUEST_WRITE_ZEROES=4
 };
 
 /** Representation of a block IO request */
@@ -52,11 +56,43 @@ struct vmm_request {
 	enum vmm_request_type type;
 	u64 lba;
 	u32 bcnt;
-	void *data;
+	void *data; /* Not used by DISCARD and WRITE_ZEROES requests */
+	struct scatterlist *sgl; /* Optional scatter-gather list.
+				  * If set then data is ignored and sg_nents
+				  * entries of sgl describe bcnt blocks.
+				  */
+	u32 sg_nents;
 
 	void (*completed)(struct vmm_request *);
 	void (*failed)(struct vmm_request *);
 	void *priv;
+
+	u64 tstamp; /* No need to set this field.
+		     * submit_request() will set this field.
+		     */
+};
+
+/** Request latency histogram
+ *  Bucket 0 counts requests completed in less than 2^LAT_SHIFT nanoseconds,
+ *  bucket N counts requests completed in [2^(N-1+LAT_SHIFT), 2^(N+LAT_SHIFT))
+ *  nanoseconds and the last bucket counts everything slower.
+ */
+#define VMM_REQUEST_LAT_SHIFT				10
+#define VMM_REQUEST_LAT_BUCKETS				22
+
+/** Statistics of a block IO request queue */
+struct vmm_request_queue_stats {
+	/* Updated by block device framework */
+	u64 submitted;
+	u64 completed;
+	u64 failed;
+	u64 depth_sum;
+	u32 depth_max;
+	u64 lat_hist[VMM_REQUEST_LAT_BUCKETS];
+
+	/* Updated by request queue implementation (optional) */
+	u64 dispatched;
+	u64 merged;
 };
 
 /** Representation of a block IO request queue */
@@ -88,7 +124,9 @@ struct vmm_request_queue {
 			    struct vmm_request *r);
 
 	/* Note: abort_request will be called for successfully
-	 * submited request only
+	 * submited request only. It returns VMM_EBUSY when request
+	 * can't be taken back in which case request will be completed
+	 * or failed later as usual.
 	 */
 	int (*abort_request)(struct vmm_request_queue *rq, 
 			    struct vmm_request *r);
@@ -98,6 +136,25 @@ struct vmm_request_queue {
 	 */
 	int (*flush_cache)(struct vmm_request_queue *rq);
 
+	/* Note: These are optional callbacks used to hint the request
+	 * queue that a batch of requests is about to be submitted so
+	 * that it can hold them back for merging till unplug.
+	 */
+	void (*plug)(struct vmm_request_queue *rq);
+	void (*unplug)(struct vmm_request_queue *rq);
+
+	/* Request queue can take scatter-gather requests */
+	bool sg_capable;
+
+	/* Max blocks in one DISCARD or WRITE_ZEROES request
+	 * where zero means request type is not supported
+	 */
+	u32 max_discard_blocks;
+	u32 max_write_zeroes_blocks;
+
+	/* Request queue statistics */
+	struct vmm_request_queue_stats stats;
+
 	void *priv;
 };
 
@@ -112,6 +169,12 @@ struct vmm_request_queue {
 		(__rq)->make_request = (__make_request); \
 		(__rq)->abort_request = (__abort_request); \
 		(__rq)->flush_cache = (__flush_request); \
+		(__rq)->plug = NULL; \
+		(__rq)->unplug = NULL; \
+		(__rq)->sg_capable = FALSE; \
+		(__rq)->max_discard_blocks = 0; \
+		(__rq)->max_write_zeroes_blocks = 0; \
+		memset(&(__rq)->stats, 0, sizeof((__rq)->stats)); \
 		(__rq)->priv = (__priv); \
 	} while (0)
 
@@ -172,6 +235,58 @@ static inline u64 vmm_blockdev_total_size(struct vmm_blockdev *bdev)
 	return (bdev) ? bdev->num_blocks * bdev->block_size : 0;
 }
 
+/** Check whether block IO request type carries data */
+static inline bool vmm_request_has_data(struct vmm_request *r)
+{
+	return (r && ((r->type == VMM_REQUEST_READ) ||
+		      (r->type == VMM_REQUEST_WRITE))) ? TRUE : FALSE;
+}
+
+/** Size of block IO request data in bytes */
+static inline u32 vmm_request_data_size(struct vmm_request *r)
+{
+	return (vmm_request_has_data(r) && r->bdev) ?
+		r->bcnt * r->bdev->block_size : 0;
+}
+
+/** Max blocks in one DISCARD request (zero means not supported) */
+static inline u32 vmm_blockdev_max_discard_blocks(struct vmm_blockdev *bdev)
+{
+	return (bdev && bdev->rq) ? bdev->rq->max_discard_blocks : 0;
+}
+
+/** Max blocks in one WRITE_ZEROES request (zero means not supported) */
+static inline u32 vmm_blockdev_max_write_zeroes_blocks(
+					struct vmm_blockdev *bdev)
+{
+	return (bdev && bdev->rq) ? bdev->rq->max_write_zeroes_blocks : 0;
+}
+
+/** Copy block IO request data to a linear buffer
+ *  Note: Works for both linear and scatter-gather requests
+ */
+u32 vmm_request_copy_to_buf(struct vmm_request *r, void *buf, u32 len);
+
+/** Copy linear buffer to block IO request data
+ *  Note: Works for both linear and scatter-gather requests
+ */
+u32 vmm_request_copy_from_buf(struct vmm_request *r,
+			      const void *buf, u32 len);
+
+/** Get linear data buffer of block IO request
+ *  Note: For scatter-gather request this allocates a bounce buffer
+ *  and for write request fills it with request data.
+ *  Note: Returns NULL upon failure.
+ */
+void *vmm_request_map_data(struct vmm_request *r);
+
+/** Release linear data buffer of block IO request
+ *  Note: For scatter-gather read request the bounce buffer is
+ *  copied back to request data when copy_back is TRUE.
+ */
+void vmm_request_unmap_data(struct vmm_request *r, void *buf,
+			    bool copy_back);
+
 /** Generic block IO complete request */
 int vmm_blockdev_complete_request(struct vmm_request *r);
 
@@ -182,7 +297,11 @@ int vmm_blockdev_fail_request(struct vmm_request *r);
 int vmm_blockdev_submit_request(struct vmm_blockdev *bdev,
 				struct vmm_request *r);
 
-/** Generic block IO abort request */
+/** Generic block IO abort request
+ *  Note: Returns VMM_EBUSY for request already in-flight. Such
+ *  request is still owned by block device and caller must wait for
+ *  its completed() or failed() callback before reusing it.
+ */
 int vmm_blockdev_abort_request(struct vmm_request *r);
 
 /** Generic block IO flush cached data 
@@ -192,6 +311,24 @@ int vmm_blockdev_abort_request(struct vmm_request *r);
  */
 int vmm_blockdev_flush_cache(struct vmm_blockdev *bdev);
 
+/** Generic block IO plug request queue
+ *  Note: Requests submitted till vmm_blockdev_unplug() might be
+ *  held back by request queue so that they can be merged.
+ *  Note: Calls to plug and unplug must be balanced.
+ */
+void vmm_blockdev_plug(struct vmm_blockdev *bdev);
+
+/** Generic block IO unplug request queue */
+void vmm_blockdev_unplug(struct vmm_blockdev *bdev);
+
+/** Generic block IO request queue statistics
+ *  Note: Child block devices share request queue of their parent
+ *  hence they will report statistics of parent request queue.
+ */
+int vmm_blockdev_get_stats(struct vmm_blockdev *bdev,
+			   struct vmm_request_queue_stats *stats,
+			   u32 *pending, u32 *backlog);
+
 /** Generic block IO read/write
  *  Note: This is a blocking API hence must be 
  *  called from Orphan (or Thread) Context
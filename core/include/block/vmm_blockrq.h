@@ -31,11 +31,59 @@
 #include <block/vmm_blockdev.h>
 #include <libs/list.h>
 
+/** Default upper limit on size of merged request in bytes */
+#define VMM_BLOCKRQ_DEF_MAX_SEG_SIZE	(128 * 1024)
+
+/** Elevator entry of a queued read/write request
+ *  Note: One elevator entry can represent multiple merged requests
+ *  in which case lba and bcnt describe the whole merged range.
+ */
+struct vmm_blockrq_entry {
+	struct dlist fifo_head;
+	struct dlist sort_head;
+	enum vmm_request_type type;
+	u64 lba;
+	u32 bcnt;
+	u64 tstamp;
+};
+
+struct vmm_blockrq;
+
+/** Representation of request queue elevator (or I/O scheduler)
+ *  Note: All callbacks except init() and exit() are called with
+ *  request queue wq_lock held so they must not sleep. The private
+ *  data returned by init() is available as elv_priv.
+ */
+struct vmm_blockrq_elevator {
+	const char *name;
+	/* Allocate elevator private data (or NULL on failure) */
+	void *(*init)(struct vmm_blockrq *brq);
+	/* Free elevator private data */
+	void (*exit)(struct vmm_blockrq *brq, void *priv);
+	/* Insert a new entry */
+	void (*add)(struct vmm_blockrq *brq, struct vmm_blockrq_entry *e);
+	/* Remove an entry which was not yet dispatched */
+	void (*remove)(struct vmm_blockrq *brq, struct vmm_blockrq_entry *e);
+	/* Find an entry which is contiguous with given range such that
+	 * merged size does not exceed max_bcnt. The front flag is set
+	 * when given range goes before the entry.
+	 */
+	struct vmm_blockrq_entry *(*find_merge)(struct vmm_blockrq *brq,
+						enum vmm_request_type type,
+						u64 lba, u32 bcnt,
+						u32 max_bcnt, bool *front);
+	/* Remove and return next entry to be dispatched */
+	struct vmm_blockrq_entry *(*dispatch)(struct vmm_blockrq *brq);
+};
+
 /** Representation of generic request queue */
 struct vmm_blockrq {
 	char name[VMM_FIELD_NAME_SIZE];
 	u32 max_pending;
 	bool async_rw;
+	u32 max_seg_size;
+	u32 max_sg_nents;
+	bool sg_block_aligned;
 
 	int (*read)(struct vmm_blockrq *brq,
 		    struct vmm_request *r, void *priv);
@@ -44,6 +92,10 @@ struct vmm_blockrq {
 	int (*abort)(struct vmm_blockrq *brq,
 		     struct vmm_request *r, void *priv);
 	void (*flush)(struct vmm_blockrq *brq, void *priv);
+	int (*discard)(struct vmm_blockrq *brq,
+		       struct vmm_request *r, void *priv);
+	int (*write_zeroes)(struct vmm_blockrq *brq,
+			    struct vmm_request *r, void *priv);
 	void *priv;
 
 	u32 wq_page_count;
@@ -52,6 +104,12 @@ struct vmm_blockrq {
 	struct dlist wq_rw_free_list;
 	struct dlist wq_w_free_list;
 	struct dlist wq_pending_list;
+	u32 wq_queued_count;
+	u32 wq_plug_count;
+	struct vmm_work wq_dispatch_work;
+
+	const struct vmm_blockrq_elevator *elv;
+	void *elv_priv;
 
 	struct vmm_workqueue *wq;
 
@@ -74,6 +132,53 @@ static inline struct vmm_request_queue *vmm_blockrq_to_rq(
 	return &brq->rq;
 }
 
+/** Find built-in elevator by name ("noop" or "deadline") */
+const struct vmm_blockrq_elevator *vmm_blockrq_elevator_find(
+							const char *name);
+
+/** Change elevator of generic blockdev request queue
+ *  Note: This function should be called from Orphan (or Thread) context.
+ */
+int vmm_blockrq_set_elevator(struct vmm_blockrq *brq,
+			     const struct vmm_blockrq_elevator *elv);
+
+/** Set upper limit on size of merged request in bytes
+ *  Note: Zero will disable merging of requests.
+ */
+void vmm_blockrq_set_max_seg_size(struct vmm_blockrq *brq, u32 max_seg_size);
+
+/** Set scatter-gather limits of read/write callbacks
+ *  Note: By default read/write callbacks only get linear requests
+ *  (i.e. max_sg_nents is zero) and requests with scatter-gather list
+ *  are linearized using bounce buffer. If max_sg_nents is non-zero
+ *  then read/write callbacks get requests with upto max_sg_nents
+ *  entries in scatter-gather list and merged requests are also
+ *  passed as scatter-gather list instead of bounce buffer.
+ *  Note: If block_aligned is TRUE then length of each scatter-gather
+ *  entry must be multiple of block size.
+ */
+void vmm_blockrq_set_sg_limits(struct vmm_blockrq *brq,
+			       u32 max_sg_nents, bool block_aligned);
+
+/** Set DISCARD callback of generic blockdev request queue
+ *  Note: DISCARD requests are never merged and they are completed
+ *  same way as read/write requests (i.e. vmm_blockrq_async_done()
+ *  for async request queue).
+ *  Note: max_blocks is upper limit on blocks in one DISCARD request
+ *  and NULL callback will disable DISCARD requests.
+ */
+void vmm_blockrq_set_discard(struct vmm_blockrq *brq,
+	int (*discard)(struct vmm_blockrq *, struct vmm_request *, void *),
+	u32 max_blocks);
+
+/** Set WRITE_ZEROES callback of generic blockdev request queue
+ *  Note: Same rules as vmm_blockrq_set_discard() apply here.
+ */
+void vmm_blockrq_set_write_zeroes(struct vmm_blockrq *brq,
+	int (*write_zeroes)(struct vmm_blockrq *,
+			    struct vmm_request *, void *),
+	u32 max_blocks);
+
 /** Mark async request done */
 void vmm_blockrq_async_done(struct vmm_blockrq *brq,
 			    struct vmm_request *r, int error);
@@ -111,6 +111,10 @@ struct m_hdr {
  */
 struct m_pkthdr {
 	int	len;			/* total packet length */
+	u16	csum_start;		/* checksum start (M_CSUM_PARTIAL) */
+	u16	csum_offset;		/* checksum field offset from start */
+	u16	gso_size;		/* segment payload size (M_GSO_xxx) */
+	u8	gso_type;		/* segmentation type; see below */
 };
 
 struct m_ext {
@@ -151,6 +155,12 @@ struct vmm_mbuf {
 
 /* mbuf flags */
 #define	M_PKTHDR	0x00001	/* start of record */
+#define	M_CSUM_PARTIAL	0x00002	/* L4 checksum to be completed on egress */
+
+/* segmentation types for m_pkthdr.gso_type */
+#define	M_GSO_NONE	0	/* not a large send frame */
+#define	M_GSO_TCPV4	1	/* TCP over IPv4 to be segmented on egress */
+#define	M_GSO_TCPV6	2	/* TCP over IPv6 to be segmented on egress */
 
 /* additional flags for M_EXT mbufs */
 #define	M_EXT_FLAGS	0xff000000
@@ -162,7 +172,7 @@ struct vmm_mbuf {
 #define	M_EXT_DMA	0x20000000	/* ext storage is dma heap alloced */
 
 /* flags copied when copying m_pkthdr */
-#define	M_COPYFLAGS	(M_PKTHDR)
+#define	M_COPYFLAGS	(M_PKTHDR|M_CSUM_PARTIAL)
 
 /* flag copied when shallow-copying external storage */
 #define	M_EXTCOPYFLAGS	(M_EXT_FLAGS)
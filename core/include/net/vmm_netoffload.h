@@ -0,0 +1,70 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vmm_netoffload.h
+ * @author agent (agent@local)
+ * @brief Software fallback for checksum and segmentation offloads.
+ */
+
+#ifndef __VMM_NETOFFLOAD_H_
+#define __VMM_NETOFFLOAD_H_
+
+#include <vmm_types.h>
+#include <net/vmm_mbuf.h>
+#include <net/vmm_netport.h>
+
+/** Maximum size of an unsegmented large send frame */
+#define VMM_NETOFFLOAD_GSO_MAX_LEN	(65535 + 14)
+
+/** Check whether mbuf carries offloads not accepted by given features */
+static inline bool vmm_netoffload_needed(struct vmm_mbuf *m, u32 features)
+{
+	switch (m->m_pkthdr.gso_type) {
+	case M_GSO_TCPV4:
+		if (!(features & VMM_NETPORT_FEAT_TSO4))
+			return TRUE;
+		break;
+	case M_GSO_TCPV6:
+		if (!(features & VMM_NETPORT_FEAT_TSO6))
+			return TRUE;
+		break;
+	default:
+		break;
+	};
+
+	return ((m->m_flags & M_CSUM_PARTIAL) &&
+		!(features & VMM_NETPORT_FEAT_CSUM)) ? TRUE : FALSE;
+}
+
+/** Complete partial checksum of a linear frame in-place
+ *  Note: checksum is computed from csum_start till end of frame
+ *  and stored at (csum_start + csum_offset).
+ */
+void vmm_netoffload_csum(u8 *frame, u32 len, u16 csum_start, u16 csum_offset);
+
+/** Resolve offloads of an mbuf in software
+ *  Note: The mbuf is never modified because it may be shared by
+ *  multiple ports. New fully checksummed (and segmented if required)
+ *  mbufs are created and handed over to xmit() one after another.
+ *  The xmit() callback owns the mbuf passed to it.
+ */
+int vmm_netoffload_resolve(struct vmm_mbuf *m,
+			   int (*xmit)(void *, struct vmm_mbuf *),
+			   void *xmit_arg);
+
+#endif /* __VMM_NETOFFLOAD_H_ */
@@ -28,6 +28,7 @@
 #include <vmm_types.h>
 #include <vmm_devdrv.h>
 #include <vmm_spinlocks.h>
+#include <vmm_timer.h>
 #include <libs/list.h>
 
 #define VMM_NETPORT_CLASS_NAME		"netport"
@@ -35,12 +36,26 @@
 /* Port Flags (should be defined as bits) */
 #define VMM_NETPORT_LINK_UP		1	/* If this bit is set link is up */
 
+/* Port Offload Features (what the port can accept from switch) */
+#define VMM_NETPORT_FEAT_CSUM		0x1	/* Frames with partial csum */
+#define VMM_NETPORT_FEAT_TSO4		0x2	/* Unsegmented TCP/IPv4 frames */
+#define VMM_NETPORT_FEAT_TSO6		0x4	/* Unsegmented TCP/IPv6 frames */
+
 /* Default per-port queue size */
 #define VMM_NETPORT_MAX_QUEUE_SIZE	256
 
 /* Default per-port queue size */
 #define VMM_NETPORT_DEF_QUEUE_SIZE	(VMM_NETPORT_MAX_QUEUE_SIZE / 4)
 
+/* Max frames queued by switch for a port. The queue shares xfer pool
+ * of the port with its own port to switch xfers so it never takes
+ * more than half of the pool.
+ */
+#define VMM_NETPORT_MAX_TXQ_DEPTH(port)	((port)->queue_size / 2)
+
+/* Max time for which lazy xfers of a port are throttled */
+#define VMM_NETPORT_THROTTLE_NSECS	1000000ULL
+
 struct vmm_netswitch;
 struct vmm_netport;
 struct vmm_mbuf;
@@ -61,11 +76,19 @@ struct vmm_netport_xfer {
 	void (*lazy_xfer)(struct vmm_netport *, void *, int);
 };
 
+struct vmm_netport_stats {
+	u64 tx_packets;		/* Frames given to port by switch */
+	u64 tx_queued;		/* Frames queued because port was busy */
+	u64 tx_dropped;		/* Frames dropped by switch for port */
+	u64 throttled;		/* Times lazy xfers of port were throttled */
+};
+
 struct vmm_netport {
 	struct dlist head;
 	char name[VMM_FIELD_NAME_SIZE];
 	u32 queue_size;
 	int flags;
+	u32 features;
 	int mtu;
 	u8 macaddr[6];
 	struct vmm_netswitch *nsw;
@@ -84,9 +107,28 @@ struct vmm_netport {
 	void (*link_changed) (struct vmm_netport *);
 	/* Callback to determine if the port can RX */
 	int (*can_receive) (struct vmm_netport *);
+	/* Callback to determine if the port has room to RX right now
+	 * (optional). If not then frames are queued by netswitch until
+	 * port calls vmm_switch2port_xfer_resume().
+	 */
+	int (*can_xfer) (struct vmm_netport *);
 	/* Handle RX from switch to port */
 	vmm_spinlock_t switch2port_xfer_lock;
 	int (*switch2port_xfer) (struct vmm_netport *, struct vmm_mbuf *);
+	/* Switch to port queue (protected by switch2port_xfer_lock) */
+	u32 txq_depth;
+	u32 txq_len;
+	struct dlist txq;
+	struct vmm_netport_stats stats;
+	/* Ports throttled by this port (protected by switch2port_xfer_lock) */
+	struct dlist throttle_list;
+	/* Flow control of lazy xfers from port to switch */
+	vmm_spinlock_t throttle_lock;
+	bool throttled;
+	struct vmm_netport *throttle_dst;
+	struct dlist throttle_head;
+	struct vmm_netport_xfer *throttle_xfer;
+	struct vmm_timer_event throttle_ev;
 	/* Port private data */
 	void *priv;
 };
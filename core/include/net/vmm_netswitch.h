@@ -73,6 +73,12 @@ int vmm_switch2port_xfer_mbuf(struct vmm_netswitch *nsw,
 			      struct vmm_netport *dst,
 			      struct vmm_mbuf *mbuf);
 
+/** Resume transfers from switch to port
+ *  Note: Ports having can_xfer() callback must call this when
+ *  they have room to RX again.
+ */
+int vmm_switch2port_xfer_resume(struct vmm_netport *dst);
+
 /** Allocate new network switch
  *  @name name of the network switch
  */
@@ -57,7 +57,9 @@ struct vmm_vdisk;
 enum vmm_vdisk_request_type {
 	VMM_VDISK_REQUEST_UNKNOWN=0,
 	VMM_VDISK_REQUEST_READ=1,
-	VMM_VDISK_REQUEST_WRITE=2
+	VMM_VDISK_REQUEST_WRITE=2,
+	VMM_VDISK_REQUEST_DISCARD=3,
+	VMM_VDISK_REQUEST_WRITE_ZEROES=4
 };
 
 /** Representation of a virtual disk request  */
@@ -80,6 +82,7 @@ struct vmm_vdisk {
 	vmm_spinlock_t blk_lock; /* Protect blk pointer */
 	struct vmm_blockdev *blk;
 	u32 blk_factor;
+	struct vmm_blockdev *plug_blk; /* Block device we have plugged */
 
 	void *priv;
 };
@@ -177,13 +180,42 @@ int vmm_vdisk_submit_request(struct vmm_vdisk *vdisk,
 			     enum vmm_vdisk_request_type type,
 			     u64 lba, void *data, u32 data_len);
 
-/* Abort IO request from virtual disk */
+/** Submit scatter-gather IO request to virtual disk
+ *  NOTE: The scatterlist must stay valid until request completes
+ */
+int vmm_vdisk_submit_request_sg(struct vmm_vdisk *vdisk,
+				struct vmm_vdisk_request *vreq,
+				enum vmm_vdisk_request_type type,
+				u64 lba, struct scatterlist *sgl,
+				u32 sg_nents, u32 data_len);
+
+/** Submit IO request without data (DISCARD or WRITE_ZEROES) to
+ *  virtual disk where data_len is size of block range in bytes
+ */
+int vmm_vdisk_submit_request_nodata(struct vmm_vdisk *vdisk,
+				    struct vmm_vdisk_request *vreq,
+				    enum vmm_vdisk_request_type type,
+				    u64 lba, u32 data_len);
+
+/* Abort IO request from virtual disk
+ * Note: Returns VMM_EBUSY for request already in-flight which
+ * will be completed or failed later as usual.
+ */
 int vmm_vdisk_abort_request(struct vmm_vdisk *vdisk,
 			    struct vmm_vdisk_request *vreq);
 
 /** Flush cached IO from virtual disk */
 int vmm_vdisk_flush_cache(struct vmm_vdisk *vdisk);
 
+/** Hint that a batch of IO requests will be submitted to virtual disk
+ *  Note: Requests submitted till vmm_vdisk_unplug() might be held
+ *  back by underlying block device so that they can be merged.
+ */
+void vmm_vdisk_plug(struct vmm_vdisk *vdisk);
+
+/** Hint that a batch of IO requests was submitted to virtual disk */
+void vmm_vdisk_unplug(struct vmm_vdisk *vdisk);
+
 /** Name of virtual disk */
 static inline const char *vmm_vdisk_name(struct vmm_vdisk *vdisk)
 {
@@ -199,6 +231,16 @@ static inline u32 vmm_vdisk_block_size(struct vmm_vdisk *vdisk)
 /** Block count of virtual disk based on attached block device */
 u64 vmm_vdisk_capacity(struct vmm_vdisk *vdisk);
 
+/** Max virtual disk blocks in one DISCARD request based on
+ *  attached block device (zero means not supported)
+ */
+u32 vmm_vdisk_max_discard_blocks(struct vmm_vdisk *vdisk);
+
+/** Max virtual disk blocks in one WRITE_ZEROES request based on
+ *  attached block device (zero means not supported)
+ */
+u32 vmm_vdisk_max_write_zeroes_blocks(struct vmm_vdisk *vdisk);
+
 /** Current block device attached to virtual disk */
 int vmm_vdisk_current_block_device(struct vmm_vdisk *vdisk,
 				   char *buf, u32 buf_len);
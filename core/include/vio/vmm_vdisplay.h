@@ -44,6 +44,7 @@
 #include <vmm_types.h>
 #include <vmm_notifier.h>
 #include <vmm_manager.h>
+#include <vmm_guest_aspace.h>
 #include <libs/list.h>
 
 #define VMM_VDISPLAY_IPRIORITY			0
@@ -97,8 +98,8 @@ struct vmm_surface_ops {
 	u8   (*read8)(struct vmm_surface *s, u8 *src);
 	void (*write16)(struct vmm_surface *s, u16 *dst, u16 val);
 	u16  (*read16)(struct vmm_surface *s, u16 *src);
-	void (*write32)(struct vmm_surface *s, u32 *dst, u16 val);
-	u16  (*read32)(struct vmm_surface *s, u32 *src);
+	void (*write32)(struct vmm_surface *s, u32 *dst, u32 val);
+	u32  (*read32)(struct vmm_surface *s, u32 *src);
 
 	void (*refresh)(struct vmm_surface *s);
 
@@ -123,6 +124,40 @@ struct vmm_surface_ops {
 #define VMM_SURFACE_BIG_ENDIAN_FLAG 		0x01
 #define VMM_SURFACE_ALLOCED_FLAG		0x02
 
+/** Shadow of guest framebuffer used by vmm_surface_update() to
+ *  find dirty rows (Note: Guest pages of framebuffer are dirty tracked
+ *  when possible so that clean rows are not read at all)
+ */
+struct vmm_surface_dirty {
+	bool valid;
+	struct vmm_guest *guest;
+	physical_addr_t gphys;
+	int cols;
+	int rows;
+	int src_width;
+	void (*fn)(struct vmm_surface *s,
+		   void *priv, u8 *dst, const u8 *src,
+		   int width, int deststep);
+	void *fn_priv;
+	virtual_addr_t shadow_va;
+	u32 shadow_page_count;
+	u8 *row_buf;
+	bool tracking;
+	struct vmm_guest_dirty_range track;
+	unsigned long *track_bmap;
+};
+
+/** Statistics of surface updates */
+struct vmm_surface_stats {
+	u64 updates;
+	u64 rows_clean;
+	u64 rows_checked;
+	u64 rows_dirty;
+	u64 bytes_read;
+	u64 bytes_converted;
+	u64 bytes_skipped;
+};
+
 /** Representation of a surface */
 struct vmm_surface {
 	struct dlist head;
@@ -134,6 +169,8 @@ struct vmm_surface {
 	u32 flags;
 	struct vmm_pixelformat pf;
 	const struct vmm_surface_ops *ops;
+	struct vmm_surface_dirty dirty;
+	struct vmm_surface_stats stats;
 	void *priv;
 };
 
@@ -184,7 +221,7 @@ static inline u16 vmm_surface_read16(struct vmm_surface *s, u16 *src)
 }
 
 /** Write 32bit to surface data */
-static inline void vmm_surface_write32(struct vmm_surface *s, u32 *dst, u16 v)
+static inline void vmm_surface_write32(struct vmm_surface *s, u32 *dst, u32 v)
 {
 	if (s && s->ops && s->ops->write32) {
 		s->ops->write32(s, dst, v);
@@ -219,6 +256,13 @@ void vmm_surface_update(struct vmm_surface *s,
 			int *first_row, /* Input and output. */
 			int *last_row); /* Output only. */
 
+/** Force next surface update to convert all rows
+ *  Note: vmm_surface_update() only converts rows whose guest
+ *  content changed since previous update and it returns -1 in
+ *  first_row if no row changed.
+ */
+void vmm_surface_invalidate(struct vmm_surface *s);
+
 /** Initialize a surface */
 int vmm_surface_init(struct vmm_surface *s,
 		     const char *name,
@@ -363,6 +407,13 @@ int vmm_vdisplay_add_surface(struct vmm_vdisplay *vdis,
 int vmm_vdisplay_del_surface(struct vmm_vdisplay *vdis,
 			     struct vmm_surface *s);
 
+/** Iterate over each surface of a virtual display
+ *  Note: fn is called with surface list spinlock held so it must not sleep
+ */
+int vmm_vdisplay_surface_iterate(struct vmm_vdisplay *vdis, void *data,
+		int (*fn)(struct vmm_vdisplay *vdis,
+			  struct vmm_surface *s, void *data));
+
 /** Create a virtual display */
 struct vmm_vdisplay *vmm_vdisplay_create(const char *name,
 					 const struct vmm_vdisplay_ops *ops,
@@ -39,6 +39,7 @@
 
 struct vmm_guest;
 struct vmm_virtio_device;
+struct vmm_snapshot_stream;
 
 struct vmm_virtio_iovec {
 	/* Address (guest-physical). */
@@ -55,6 +56,11 @@ struct vmm_virtio_queue {
 	u16			last_avail_idx;
 	u16			last_used_signalled;
 
+	/* Used elements added by vmm_virtio_queue_add_used() which
+	   are not yet visible to guest (i.e. used->idx not updated). */
+	u16			used_idx;
+	u16			used_pending;
+
 	struct vmm_vring	vring;
 
 	struct vmm_guest	*guest;
@@ -119,6 +125,10 @@ struct vmm_virtio_emulator {
 	int  (*connect)(struct vmm_virtio_device *dev,
 			struct vmm_virtio_emulator *emu);
 	void (*disconnect)(struct vmm_virtio_device *dev);
+	int (*save)(struct vmm_virtio_device *dev,
+		    struct vmm_snapshot_stream *ss);
+	int (*restore)(struct vmm_virtio_device *dev,
+		       struct vmm_snapshot_stream *ss);
 
 	struct dlist node;
 };
@@ -200,6 +210,26 @@ void vmm_virtio_queue_set_avail_event(struct vmm_virtio_queue *vq);
 void vmm_virtio_queue_set_used_elem(struct vmm_virtio_queue *vq,
 				    u32 head, u32 len);
 
+/** Add used element in vring without updating used index
+ *  Note: works only after queue setup is done
+ *  Note: added elements are visible to guest only after
+ *  vmm_virtio_queue_flush_used() hence this allows batching
+ */
+void vmm_virtio_queue_add_used(struct vmm_virtio_queue *vq,
+			       u32 head, u32 len);
+
+/** Number of used elements added but not yet flushed */
+static inline u32 vmm_virtio_queue_used_pending(struct vmm_virtio_queue *vq)
+{
+	return (vq) ? vq->used_pending : 0;
+}
+
+/** Publish used elements added using vmm_virtio_queue_add_used()
+ *  by updating used index in vring only once
+ *  Note: works only after queue setup is done
+ */
+void vmm_virtio_queue_flush_used(struct vmm_virtio_queue *vq);
+
 /** Check whether queue setup is done by guest or not */
 bool vmm_virtio_queue_setup_done(struct vmm_virtio_queue *vq);
 
@@ -217,6 +247,17 @@ int vmm_virtio_queue_setup(struct vmm_virtio_queue *vq,
 			   physical_size_t guest_page_size,
 			   u32 desc_count, u32 align);
 
+/** Save state of the queue to snapshot stream */
+int vmm_virtio_queue_save(struct vmm_virtio_queue *vq,
+			  struct vmm_snapshot_stream *ss);
+
+/** Restore state of the queue from snapshot stream
+ *  Note: If queue was setup when saved then it will be setup again.
+ */
+int vmm_virtio_queue_restore(struct vmm_virtio_queue *vq,
+			     struct vmm_guest *guest,
+			     struct vmm_snapshot_stream *ss);
+
 /** Get guest IO vectors based on given head
  *  Note: works only after queue setup is done
  */
@@ -259,6 +300,14 @@ int vmm_virtio_config_write(struct vmm_virtio_device *dev,
 /** Reset VirtIO device */
 int vmm_virtio_reset(struct vmm_virtio_device *dev);
 
+/** Save VirtIO device emulator state to snapshot stream */
+int vmm_virtio_save(struct vmm_virtio_device *dev,
+		    struct vmm_snapshot_stream *ss);
+
+/** Restore VirtIO device emulator state from snapshot stream */
+int vmm_virtio_restore(struct vmm_virtio_device *dev,
+		       struct vmm_snapshot_stream *ss);
+
 /** Register VirtIO device */
 int vmm_virtio_register_device(struct vmm_virtio_device *dev);
 
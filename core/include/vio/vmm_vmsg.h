@@ -57,6 +57,14 @@
 #define VMM_VMSG_NODE_ADDR_MIN			1024
 #define VMM_VMSG_NODE_ADDR_ANY			0xFFFFFFFF
 
+/* Number of preallocated messages in message pool of each node */
+#define VMM_VMSG_NODE_POOL_COUNT		128
+/* Size of data buffer of each message in message pool of each node */
+#define VMM_VMSG_NODE_POOL_BUF_SIZE		512
+
+/* Maximum number of free work items cached by each domain */
+#define VMM_VMSG_DOMAIN_WORK_CACHE		256
+
 /* Notifier event when virtual messaging domain is created */
 #define VMM_VMSG_EVENT_CREATE_DOMAIN		0x01
 /* Notifier event when virtual messaging domain is destroyed */
@@ -77,12 +85,24 @@ int vmm_vmsg_register_client(struct vmm_notifier_block *nb);
 /** Unregister a notifier client to not receive virtual messaging events */
 int vmm_vmsg_unregister_client(struct vmm_notifier_block *nb);
 
-/** Representation of a virtual message */
+struct vmm_guest;
+
+/** Representation of a virtual message
+ *  Note: Message data is either in host memory pointed by 'data' or
+ *  in guest memory at 'gphys' of 'guest' when 'guest' is not NULL.
+ *  Consumers should use vmm_vmsg_read() or vmm_vmsg_copy_to_guest()
+ *  to access message data so that both kinds of messages work. The
+ *  'release' callback is called when last reference is dropped which
+ *  tells producer of a guest memory message that it can reuse the
+ *  guest buffer.
+ */
 struct vmm_vmsg {
 	atomic_t ref_count;
 	u32 dst;
 	u32 src;
 	void *data;
+	struct vmm_guest *guest;
+	physical_addr_t gphys;
 	size_t len;
 	void *priv;
 	void (*release) (struct vmm_vmsg *);
@@ -94,11 +114,41 @@ struct vmm_vmsg {
 		(__msg)->dst = (__dst);					\
 		(__msg)->src = (__src);					\
 		(__msg)->data = (__data);				\
+		(__msg)->guest = NULL;					\
+		(__msg)->gphys = 0;					\
 		(__msg)->len = (__len);					\
 		(__msg)->priv = (__priv);				\
 		(__msg)->release = (__rel);				\
 	} while (0)
 
+#define INIT_VMSG_GUEST(__msg, __dst, __src, __guest, __gphys,		\
+			__len, __priv, __rel)				\
+	do {								\
+		arch_atomic_write(&(__msg)->ref_count, 1);		\
+		(__msg)->dst = (__dst);					\
+		(__msg)->src = (__src);					\
+		(__msg)->data = NULL;					\
+		(__msg)->guest = (__guest);				\
+		(__msg)->gphys = (__gphys);				\
+		(__msg)->len = (__len);					\
+		(__msg)->priv = (__priv);				\
+		(__msg)->release = (__rel);				\
+	} while (0)
+
+/** Representation of a pool of preallocated virtual messages
+ *  Note: Messages allocated from a pool are returned to the pool
+ *  when their ref count drops to zero. The pool itself is freed
+ *  after it is destroyed and all its messages are released.
+ */
+struct vmm_vmsg_pool {
+	atomic_t ref_count;
+	vmm_spinlock_t lock;
+	struct dlist free_list;
+	u32 count;
+	size_t buf_size;
+	void *mem;
+};
+
 /** Representation of a virtual messaging domain */
 struct vmm_vmsg_domain {
 	struct dlist head;
@@ -108,6 +158,10 @@ struct vmm_vmsg_domain {
 	struct vmm_completion work_avail;
 	vmm_spinlock_t work_lock;
 	struct dlist work_list;
+	struct dlist work_free_list;
+	u32 work_free_count;
+	u64 work_count;
+	u64 wakeup_count;
 	struct vmm_mutex node_lock;
 	struct dlist node_list;
 };
@@ -121,6 +175,8 @@ struct vmm_vmsg_node_ops {
 	void (*peer_down) (struct vmm_vmsg_node *node,
 			   const char *peer_name, u32 peer_addr);
 	void (*recv_msg) (struct vmm_vmsg_node *node, struct vmm_vmsg *msg);
+	/* Called once after a batch of recv_msg() calls (optional) */
+	void (*recv_done) (struct vmm_vmsg_node *node);
 };
 
 /** Representation of a virtual messaging node */
@@ -131,6 +187,10 @@ struct vmm_vmsg_node {
 	char name[VMM_FIELD_NAME_SIZE];
 	void *priv;
 	atomic_t is_ready;
+	bool recv_pending;
+	u64 rx_msgs;
+	u64 rx_bytes;
+	struct vmm_vmsg_pool *pool;
 	struct vmm_vmsg_domain *domain;
 	struct vmm_vmsg_node_ops *ops;
 };
@@ -141,6 +201,41 @@ void vmm_vmsg_ref(struct vmm_vmsg *msg);
 /** Decrement ref count of virtual message */
 void vmm_vmsg_dref(struct vmm_vmsg *msg);
 
+/** Get a reference to virtual message */
+static inline struct vmm_vmsg *vmm_vmsg_get(struct vmm_vmsg *msg)
+{
+	vmm_vmsg_ref(msg);
+	return msg;
+}
+
+/** Put a reference to virtual message
+ *  Note: The release callback of message is called when last
+ *  reference is put.
+ */
+static inline void vmm_vmsg_put(struct vmm_vmsg *msg)
+{
+	vmm_vmsg_dref(msg);
+}
+
+/** Check whether virtual message data is in guest memory */
+static inline bool vmm_vmsg_is_guest(struct vmm_vmsg *msg)
+{
+	return (msg && msg->guest) ? TRUE : FALSE;
+}
+
+/** Read 'len' bytes of virtual message data at offset 'off' into
+ *  host buffer 'buf' and return number of bytes read
+ */
+size_t vmm_vmsg_read(struct vmm_vmsg *msg, size_t off,
+		     void *buf, size_t len);
+
+/** Copy 'len' bytes of virtual message data at offset 'off' into
+ *  guest memory at 'gphys' of 'guest' and return number of bytes copied
+ */
+size_t vmm_vmsg_copy_to_guest(struct vmm_vmsg *msg, size_t off,
+			      struct vmm_guest *guest,
+			      physical_addr_t gphys, size_t len);
+
 /** Allocate new virtual message */
 struct vmm_vmsg *vmm_vmsg_alloc(u32 dst, u32 src, size_t len);
 
@@ -150,6 +245,19 @@ static inline void vmm_vmsg_free(struct vmm_vmsg *msg)
 	vmm_vmsg_dref(msg);
 }
 
+/** Create a pool of 'count' virtual messages having 'buf_size' bytes */
+struct vmm_vmsg_pool *vmm_vmsg_pool_create(u32 count, size_t buf_size);
+
+/** Destroy a pool of virtual messages */
+void vmm_vmsg_pool_destroy(struct vmm_vmsg_pool *pool);
+
+/** Allocate virtual message from a pool
+ *  Note: This falls back to vmm_vmsg_alloc() when the pool is
+ *  exhausted or 'len' is more than buffer size of pool.
+ */
+struct vmm_vmsg *vmm_vmsg_pool_alloc(struct vmm_vmsg_pool *pool,
+				     u32 dst, u32 src, size_t len);
+
 /** Create a virtual messaging domain */
 struct vmm_vmsg_domain *vmm_vmsg_domain_create(const char *name, void *priv);
 
@@ -174,6 +282,12 @@ int vmm_vmsg_domain_node_iterate(struct vmm_vmsg_domain *domain,
 /** Get name of virtual messaging domain */
 const char *vmm_vmsg_domain_get_name(struct vmm_vmsg_domain *domain);
 
+/** Get count of processed work items and worker wakeups of
+ *  virtual messaging domain
+ */
+void vmm_vmsg_domain_get_stats(struct vmm_vmsg_domain *domain,
+			       u64 *work_count, u64 *wakeup_count);
+
 /**
  * Create a virtual messaging node
  *
@@ -204,6 +318,15 @@ struct vmm_vmsg_node *vmm_vmsg_node_find(const char *name);
 /** Count of available virtual messaging nodes */
 u32 vmm_vmsg_node_count(void);
 
+/** Allocate virtual message from message pool of a node */
+static inline struct vmm_vmsg *vmm_vmsg_node_alloc(struct vmm_vmsg_node *node,
+						   u32 dst, u32 src,
+						   size_t len)
+{
+	return (node) ? vmm_vmsg_pool_alloc(node->pool, dst, src, len) :
+			vmm_vmsg_alloc(dst, src, len);
+}
+
 /** Send message from virtual messaging node */
 int vmm_vmsg_node_send(struct vmm_vmsg_node *node, struct vmm_vmsg *msg);
 
@@ -235,5 +358,9 @@ u32 vmm_vmsg_node_get_addr(struct vmm_vmsg_node *node);
 /** Get domain of virtual messaging node */
 struct vmm_vmsg_domain *vmm_vmsg_node_get_domain(struct vmm_vmsg_node *node);
 
+/** Get count of messages and bytes delivered to virtual messaging node */
+void vmm_vmsg_node_get_stats(struct vmm_vmsg_node *node,
+			     u64 *rx_msgs, u64 *rx_bytes);
+
 #endif /* __VMM_VMSG_H__ */
 
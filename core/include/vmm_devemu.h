@@ -30,6 +30,7 @@
 
 struct vmm_emudev;
 struct vmm_emulator;
+struct vmm_snapshot_stream;
 
 enum vmm_devemu_endianness {
 	VMM_DEVEMU_UNKNOWN_ENDIAN=0,
@@ -51,6 +52,10 @@ struct vmm_emulator {
 	int (*reset) (struct vmm_emudev *edev);
 	int (*sync) (struct vmm_emudev *edev,
 		     unsigned long val, void *v);
+	int (*save) (struct vmm_emudev *edev,
+		     struct vmm_snapshot_stream *ss);
+	int (*restore) (struct vmm_emudev *edev,
+			struct vmm_snapshot_stream *ss);
 	int (*read8) (struct vmm_emudev *edev,
 		      physical_addr_t offset,
 		      u8 *dst);
@@ -104,9 +109,14 @@ int vmm_devemu_simple_write16(struct vmm_emudev *edev,
 int vmm_devemu_simple_write32(struct vmm_emudev *edev,
 			      physical_addr_t offset,
 			      u32 src);
-
-#define VMM_DECLARE_EMULATOR_SIMPLE(EMU, NAME, MATCH, ENDIAN, PROBE,	\
-				    REMOVE, RESET, SYNC, READ, WRITE)	\
+int vmm_devemu_stateless_save(struct vmm_emudev *edev,
+			      struct vmm_snapshot_stream *ss);
+int vmm_devemu_stateless_restore(struct vmm_emudev *edev,
+				 struct vmm_snapshot_stream *ss);
+
+#define __VMM_DECLARE_EMULATOR_SIMPLE(EMU, NAME, MATCH, ENDIAN, PROBE,	\
+				      REMOVE, RESET, SYNC, SAVE,	\
+				      RESTORE, READ, WRITE)		\
 	static struct vmm_emulator EMU = {				\
 		.name = NAME,						\
 		.match_table = MATCH,					\
@@ -114,6 +124,8 @@ int vmm_devemu_simple_write32(struct vmm_emudev *edev,
 		.probe = PROBE,						\
 		.reset = RESET,						\
 		.sync = SYNC,						\
+		.save = SAVE,						\
+		.restore = RESTORE,					\
 		.remove = REMOVE,					\
 		.read8 = vmm_devemu_simple_read8,			\
 		.write8 = vmm_devemu_simple_write8,			\
@@ -127,6 +139,25 @@ int vmm_devemu_simple_write32(struct vmm_emudev *edev,
 		.write_simple = WRITE,					\
 	}
 
+#define VMM_DECLARE_EMULATOR_SIMPLE(EMU, NAME, MATCH, ENDIAN, PROBE,	\
+				    REMOVE, RESET, SYNC, READ, WRITE)	\
+	__VMM_DECLARE_EMULATOR_SIMPLE(EMU, NAME, MATCH, ENDIAN, PROBE,	\
+				      REMOVE, RESET, SYNC, NULL, NULL,	\
+				      READ, WRITE)
+
+/** Declare simple emulator which has no runtime state
+ *  Note: All registers of such emulator are read-only or derived
+ *  from device tree at probe time so snapshot of such emulator
+ *  is empty.
+ */
+#define VMM_DECLARE_EMULATOR_STATELESS(EMU, NAME, MATCH, ENDIAN, PROBE,	\
+				       REMOVE, RESET, SYNC, READ, WRITE) \
+	__VMM_DECLARE_EMULATOR_SIMPLE(EMU, NAME, MATCH, ENDIAN, PROBE,	\
+				      REMOVE, RESET, SYNC,		\
+				      vmm_devemu_stateless_save,	\
+				      vmm_devemu_stateless_restore,	\
+				      READ, WRITE)
+
 struct vmm_emudev {
 	vmm_spinlock_t lock;
 	struct vmm_devtree_node *node;
@@ -137,6 +168,8 @@ struct vmm_emudev {
 	vmm_rwlock_t child_list_lock;
 	struct dlist child_list;
 	void *priv;
+	atomic64_t read_count;
+	atomic64_t write_count;
 #ifdef CONFIG_DEVEMU_DEBUG
 	u32 debug_info;
 #endif
@@ -275,6 +308,16 @@ int vmm_devemu_reset_context(struct vmm_guest *guest);
 int vmm_devemu_reset_region(struct vmm_guest *guest,
 			    struct vmm_region *reg);
 
+/** Save state of emulators for given region to snapshot stream */
+int vmm_devemu_save_region(struct vmm_guest *guest,
+			   struct vmm_region *reg,
+			   struct vmm_snapshot_stream *ss);
+
+/** Restore state of emulators for given region from snapshot stream */
+int vmm_devemu_restore_region(struct vmm_guest *guest,
+			      struct vmm_region *reg,
+			      struct vmm_snapshot_stream *ss);
+
 /** Remove emulator for given region */
 int vmm_devemu_remove_region(struct vmm_guest *guest,
 			     struct vmm_region *reg);
@@ -115,6 +115,7 @@
 #define VMM_DEVTREE_NUM_COLORS_ATTR_NAME	"num_colors"
 #define VMM_DEVTREE_SHARED_MEM_ATTR_NAME	"shared_mem"
 #define VMM_DEVTREE_MAP_ORDER_ATTR_NAME		"map_order"
+#define VMM_DEVTREE_HUGE_PAGES_ATTR_NAME	"huge_pages"
 #define VMM_DEVTREE_SWITCH_ATTR_NAME		"switch"
 #define VMM_DEVTREE_DOMAIN_ATTR_NAME		"domain"
 #define VMM_DEVTREE_NODE_ADDR_ATTR_NAME		"node_addr"
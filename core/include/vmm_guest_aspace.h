@@ -25,6 +25,7 @@
 
 #include <vmm_manager.h>
 #include <vmm_notifier.h>
+#include <vmm_host_aspace.h>
 
 /* Notifier event when guest aspace is initialized */
 #define VMM_GUEST_ASPACE_EVENT_INIT		0x01
@@ -77,6 +78,107 @@ void vmm_guest_iterate_mapping(struct vmm_guest *guest,
 					     void *priv),
 				void *priv);
 
+/** Host contiguity of guest RAM in terms of stage2 block sizes */
+struct vmm_guest_ram_blocks {
+	physical_size_t size_1g;
+	physical_size_t size_2m;
+	physical_size_t size_page;
+};
+
+/** Compute how much guest RAM can be mapped using 1GB blocks,
+ *  2MB blocks, and pages based on host physical contiguity.
+ */
+void vmm_guest_ram_block_usage(struct vmm_guest *guest,
+			       struct vmm_guest_ram_blocks *blks);
+
+/** Dirty logging statistics of a guest */
+struct vmm_guest_dirty_log_stats {
+	bool enabled;
+	u64 elapsed_nsecs;
+	u64 faults;
+	u64 fault_nsecs;
+};
+
+/** Number of pages (i.e. bits in dirty bitmap) of a guest region */
+static inline u32 vmm_guest_dirty_log_pages(struct vmm_region *reg)
+{
+	return (reg) ? (u32)(reg->phys_size >> VMM_PAGE_SHIFT) : 0;
+}
+
+/** Start dirty logging for all RAM regions of a guest
+ *  Note: RAM regions are write-protected in stage2 and write faults
+ *  are recorded in a per-region dirty bitmap.
+ */
+int vmm_guest_dirty_log_start(struct vmm_guest *guest);
+
+/** Stop dirty logging and free dirty bitmaps of a guest */
+int vmm_guest_dirty_log_stop(struct vmm_guest *guest);
+
+/** Fetch dirty bitmap of a guest RAM region and optionally clear it
+ *  Note: bmap (if not NULL) must have space for
+ *  vmm_guest_dirty_log_pages(reg) bits.
+ */
+int vmm_guest_dirty_log_fetch(struct vmm_guest *guest,
+			      struct vmm_region *reg,
+			      unsigned long *bmap, bool clear,
+			      u32 *dirty_pages);
+
+/** Check and optionally mark a guest page as dirty
+ *  Note: This is called by arch code upon stage2 faults and returns
+ *  VMM_ENOENT if the page is neither in a dirty logged region nor in
+ *  a dirty tracked range. The page is reported dirty only if it is
+ *  marked dirty for dirty logging and all dirty tracked ranges.
+ */
+int vmm_guest_dirty_log_page(struct vmm_guest *guest,
+			     physical_addr_t gphys_addr,
+			     bool mark, bool *dirty);
+
+/** Account time taken by arch code to handle a dirty logging fault */
+void vmm_guest_dirty_log_account(struct vmm_guest *guest, u64 fault_nsecs);
+
+/** Get dirty logging statistics of a guest */
+int vmm_guest_dirty_log_stats(struct vmm_guest *guest,
+			      struct vmm_guest_dirty_log_stats *stats);
+
+/** Dirty tracking of a guest physical address range
+ *  Note: Unlike dirty logging, any number of ranges can be tracked
+ *  independently (e.g. by display emulators for framebuffers).
+ */
+struct vmm_guest_dirty_range {
+	struct dlist head;
+	struct vmm_guest *guest;
+	struct vmm_region *reg;
+	u32 first_page;
+	u32 pages;
+	unsigned long *bmap;
+};
+
+/** Number of pages (i.e. bits in dirty bitmap) of a dirty tracked range */
+static inline u32 vmm_guest_dirty_range_pages(
+					struct vmm_guest_dirty_range *dr)
+{
+	return (dr) ? dr->pages : 0;
+}
+
+/** Start dirty tracking of a guest physical address range
+ *  Note: The range must be within one RAM region and bit N of dirty
+ *  bitmap represents N-th page starting from page of gphys_addr.
+ */
+int vmm_guest_dirty_range_start(struct vmm_guest *guest,
+				struct vmm_guest_dirty_range *dr,
+				physical_addr_t gphys_addr,
+				physical_size_t size);
+
+/** Stop dirty tracking of a guest physical address range */
+void vmm_guest_dirty_range_stop(struct vmm_guest_dirty_range *dr);
+
+/** Fetch and clear dirty bitmap of a dirty tracked range
+ *  Note: bmap (if not NULL) must have space for
+ *  vmm_guest_dirty_range_pages(dr) bits.
+ */
+int vmm_guest_dirty_range_fetch(struct vmm_guest_dirty_range *dr,
+				unsigned long *bmap, u32 *dirty_pages);
+
 /** Overwrite real device region mapping */
 int vmm_guest_overwrite_real_device_mapping(struct vmm_guest *guest,
 					    struct vmm_region *reg,
@@ -0,0 +1,143 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vmm_guest_snapshot.h
+ * @author agent (agent@local)
+ * @brief header file for guest snapshot save/restore
+ */
+#ifndef _VMM_GUEST_SNAPSHOT_H__
+#define _VMM_GUEST_SNAPSHOT_H__
+
+#include <vmm_error.h>
+#include <vmm_types.h>
+#include <vmm_manager.h>
+
+/** Compress guest RAM pages while saving snapshot */
+#define VMM_GUEST_SNAPSHOT_COMPRESS		0x00000001
+
+/** Byte stream used to save/restore guest snapshot
+ *  Note: write() and read() must transfer all len bytes or
+ *  return an error code.
+ */
+struct vmm_snapshot_stream {
+	int (*write)(struct vmm_snapshot_stream *ss,
+		     const void *buf, u32 len);
+	int (*read)(struct vmm_snapshot_stream *ss,
+		    void *buf, u32 len);
+	void *priv;
+};
+
+/** Write bytes to snapshot stream */
+static inline int vmm_snapshot_write(struct vmm_snapshot_stream *ss,
+				     const void *buf, u32 len)
+{
+	return (ss && ss->write) ? ss->write(ss, buf, len) : VMM_EINVALID;
+}
+
+/** Read bytes from snapshot stream */
+static inline int vmm_snapshot_read(struct vmm_snapshot_stream *ss,
+				    void *buf, u32 len)
+{
+	return (ss && ss->read) ? ss->read(ss, buf, len) : VMM_EINVALID;
+}
+
+/** Write a 32-bit value to snapshot stream */
+static inline int vmm_snapshot_write_u32(struct vmm_snapshot_stream *ss,
+					 u32 val)
+{
+	return vmm_snapshot_write(ss, &val, sizeof(val));
+}
+
+/** Read a 32-bit value from snapshot stream */
+static inline int vmm_snapshot_read_u32(struct vmm_snapshot_stream *ss,
+					u32 *val)
+{
+	return vmm_snapshot_read(ss, val, sizeof(*val));
+}
+
+/** Write a 64-bit value to snapshot stream */
+static inline int vmm_snapshot_write_u64(struct vmm_snapshot_stream *ss,
+					 u64 val)
+{
+	return vmm_snapshot_write(ss, &val, sizeof(val));
+}
+
+/** Read a 64-bit value from snapshot stream */
+static inline int vmm_snapshot_read_u64(struct vmm_snapshot_stream *ss,
+					u64 *val)
+{
+	return vmm_snapshot_read(ss, val, sizeof(*val));
+}
+
+/** Write tag identifying format and version of emulator state
+ *  Note: Emulators must save their state field by field after
+ *  the tag and bump the version whenever the set of fields changes.
+ */
+static inline int vmm_snapshot_write_tag(struct vmm_snapshot_stream *ss,
+					 u32 magic, u32 version)
+{
+	int rc = vmm_snapshot_write_u32(ss, magic);
+
+	return (rc) ? rc : vmm_snapshot_write_u32(ss, version);
+}
+
+/** Read tag of emulator state and check format and version */
+static inline int vmm_snapshot_read_tag(struct vmm_snapshot_stream *ss,
+					u32 magic, u32 version)
+{
+	int rc;
+	u32 val[2];
+
+	rc = vmm_snapshot_read(ss, val, sizeof(val));
+	if (rc) {
+		return rc;
+	}
+
+	return ((val[0] == magic) && (val[1] == version)) ?
+						VMM_OK : VMM_EINVALID;
+}
+
+/** Statistics of guest snapshot save/restore */
+struct vmm_guest_snapshot_stats {
+	u64 ram_bytes;
+	u64 zero_bytes;
+	u64 stream_bytes;
+	u64 nsecs;
+};
+
+/** Save state of a paused (or never kicked) guest to a stream
+ *  Note: This saves architecture specific VCPU state, state of
+ *  each device emulator, and content of guest RAM regions.
+ *  Note: Returns VMM_ENOTSUPP if architecture (only arm64 for now)
+ *  or any device emulator of the guest does not support snapshot.
+ *  Note: Returns VMM_EBUSY if an emulator has IO in flight, in
+ *  which case caller can retry later.
+ */
+int vmm_guest_snapshot_save(struct vmm_guest *guest,
+			    struct vmm_snapshot_stream *ss, u32 flags,
+			    struct vmm_guest_snapshot_stats *stats);
+
+/** Restore state of a paused (or never kicked) guest from a stream
+ *  Note: The guest must be created from the same device tree as
+ *  the guest for which snapshot was saved.
+ */
+int vmm_guest_snapshot_restore(struct vmm_guest *guest,
+			       struct vmm_snapshot_stream *ss,
+			       struct vmm_guest_snapshot_stats *stats);
+
+#endif
@@ -32,6 +32,7 @@
 #include <vmm_devtree.h>
 #include <vmm_cpumask.h>
 #include <vmm_shmem.h>
+#include <vmm_vcpu_stats.h>
 #include <libs/list.h>
 #include <libs/rbtree.h>
 
@@ -52,6 +53,7 @@ enum vmm_region_flags {
 	VMM_REGION_ISCOLORED=0x00002000,
 	VMM_REGION_ISSHARED=0x00004000,
 	VMM_REGION_ISDYNAMIC=0x00008000,
+	VMM_REGION_ISHUGEPAGE=0x00010000,
 };
 
 #define VMM_REGION_MANIFEST_MASK	(VMM_REGION_REAL | \
@@ -72,6 +74,7 @@ struct vmm_guest;
 struct vmm_region_mapping {
 	physical_addr_t hphys_addr;
 	u32 flags;
+	u32 contig_order;
 };
 
 struct vmm_region {
@@ -90,6 +93,7 @@ struct vmm_region {
 	u32 map_order;
 	u32 maps_count;
 	struct vmm_region_mapping *maps;
+	unsigned long *dirty_bmap;
 	void *devemu_priv;
 	void *priv;
 };
@@ -115,6 +119,12 @@ struct vmm_guest_aspace {
 	vmm_rwlock_t reg_memtree_lock;
 	struct rb_root reg_memtree;
 	struct dlist reg_memprobe_list;
+	vmm_spinlock_t dirty_lock;
+	struct dlist dirty_ranges;
+	bool dirty_log;
+	u64 dirty_log_tstamp;
+	u64 dirty_faults;
+	u64 dirty_fault_nsecs;
 	void *devemu_priv;
 };
 
@@ -248,6 +258,9 @@ struct vmm_vcpu {
 	/* Virtual IRQ context */
 	struct vmm_vcpu_irqs irqs;
 
+	/* Exit and event statistics */
+	struct vmm_vcpu_stats stats;
+
 	/* Resources acquired */
 	vmm_spinlock_t res_lock;
 	struct dlist res_head;
@@ -84,6 +84,12 @@ int vmm_timer_event_restart(struct vmm_timer_event *ev);
 /** Stop a timer event */
 int vmm_timer_event_stop(struct vmm_timer_event *ev);
 
+/** Stop a timer event and wait for its handler to finish if it is
+ *  running on another host CPU. Must not be called with locks which
+ *  the event handler also takes.
+ */
+int vmm_timer_event_stop_sync(struct vmm_timer_event *ev);
+
 /** Current global timestamp (nanoseconds elapsed) */
 u64 vmm_timer_timestamp(void);
 
@@ -0,0 +1,145 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vmm_trace.h
+ * @author agent (agent@local)
+ * @brief header file for hypervisor tracepoints
+ *
+ * Tracepoints record fixed size entries in per-CPU ring buffers. Each
+ * tracepoint belongs to a category and a tracepoint costs one load and
+ * a predicted branch when its category is disabled. When the category
+ * is enabled, the entry is written to the ring buffer of current host
+ * CPU with local interrupts disabled so no locks are required. Old
+ * entries are overwritten when a ring buffer is full.
+ */
+#ifndef _VMM_TRACE_H__
+#define _VMM_TRACE_H__
+
+#include <vmm_types.h>
+#include <vmm_compiler.h>
+
+/** Tracepoint categories */
+enum vmm_trace_category {
+	VMM_TRACE_CAT_SCHED=0,
+	VMM_TRACE_CAT_TIMER,
+	VMM_TRACE_CAT_IRQ,
+	VMM_TRACE_CAT_VIRTIO,
+	VMM_TRACE_CAT_NET,
+	VMM_TRACE_CAT_MAX
+};
+
+/** Tracepoint events
+ *  Note: Keep this in-sync with the event table in vmm_trace.c
+ */
+enum vmm_trace_event {
+	/* arg0 = prev vcpu id, arg1 = next vcpu id */
+	VMM_TRACE_SCHED_SWITCH=0,
+	/* arg0 = 0, arg1 = timer event, arg2 = duration nsecs */
+	VMM_TRACE_TIMER_START,
+	/* arg0 = 0, arg1 = timer event, arg2 = handler */
+	VMM_TRACE_TIMER_EXPIRE_ENTER,
+	/* arg0 = 0, arg1 = timer event */
+	VMM_TRACE_TIMER_EXPIRE_EXIT,
+	/* arg0 = host irq number */
+	VMM_TRACE_HOST_IRQ_ENTER,
+	/* arg0 = host irq number */
+	VMM_TRACE_HOST_IRQ_EXIT,
+	/* arg0 = vcpu id, arg1 = guest irq number, arg2 = reason */
+	VMM_TRACE_VCPU_IRQ_ASSERT,
+	/* arg0 = head, arg1 = virtio queue */
+	VMM_TRACE_VIRTIO_POP,
+	/* arg0 = head, arg1 = virtio queue, arg2 = length */
+	VMM_TRACE_VIRTIO_PUSH,
+	/* arg0 = packet length, arg1 = source port, arg2 = switch */
+	VMM_TRACE_NET_PORT2SWITCH,
+	/* arg0 = packet length, arg1 = destination port, arg2 = switch */
+	VMM_TRACE_NET_SWITCH2PORT,
+	VMM_TRACE_EVENT_MAX
+};
+
+/** Trace entry as stored in ring buffer (trace dump prints it as text) */
+struct vmm_trace_entry {
+	u64 tstamp;
+	u16 event;
+	u16 cpu;
+	u32 arg0;
+	u64 arg1;
+	u64 arg2;
+} __packed;
+
+#ifdef CONFIG_TRACE
+
+/** Bitmap of enabled categories (Note: Use vmm_trace_enable()) */
+extern u32 vmm_trace_mask;
+
+/** Record trace entry on current host CPU (Note: Use vmm_trace()) */
+void __vmm_trace(u32 event, u32 arg0, u64 arg1, u64 arg2);
+
+/** Tracepoint */
+#define vmm_trace(cat, event, arg0, arg1, arg2)				\
+do {									\
+	if (unlikely(vmm_trace_mask & (1U << (cat)))) {			\
+		__vmm_trace((event), (u32)(arg0),			\
+			    (u64)(arg1), (u64)(arg2));			\
+	}								\
+} while (0)
+
+#else
+
+#define vmm_trace(cat, event, arg0, arg1, arg2)	do { } while (0)
+
+#endif
+
+/** Name of tracepoint category */
+const char *vmm_trace_category_name(u32 cat);
+
+/** Find tracepoint category by name */
+int vmm_trace_category_find(const char *name);
+
+/** Name of tracepoint event */
+const char *vmm_trace_event_name(u32 event);
+
+/** Category of tracepoint event */
+u32 vmm_trace_event_category(u32 event);
+
+/** Retrieve bitmap of enabled categories */
+u32 vmm_trace_enabled(void);
+
+/** Enable categories in given bitmap
+ *  Note: Ring buffers are allocated on first call so this must
+ *  be called from thread context.
+ */
+int vmm_trace_enable(u32 cat_mask);
+
+/** Disable categories in given bitmap */
+void vmm_trace_disable(u32 cat_mask);
+
+/** Discard all recorded entries */
+void vmm_trace_clear(void);
+
+/** Number of entries in ring buffer of each host CPU */
+u32 vmm_trace_ring_size(void);
+
+/** Retrieve recorded entries of given host CPU in oldest first order
+ *  Note: Entries overwritten while copying are not reported and
+ *  categories should be disabled for a consistent snapshot.
+ *  Returns number of entries copied to given buffer.
+ */
+u32 vmm_trace_read(u32 cpu, struct vmm_trace_entry *entries, u32 count);
+
+#endif
@@ -0,0 +1,113 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vmm_vcpu_stats.h
+ * @author agent (agent@local)
+ * @brief header file for VCPU exit and event statistics
+ */
+#ifndef _VMM_VCPU_STATS_H__
+#define _VMM_VCPU_STATS_H__
+
+#include <vmm_types.h>
+
+struct vmm_chardev;
+
+/** Types of VCPU exits (i.e. traps from guest into hypervisor) */
+enum vmm_vcpu_exit_type {
+	VMM_VCPU_EXIT_OTHER=0,
+	VMM_VCPU_EXIT_STAGE2_FAULT,
+	VMM_VCPU_EXIT_MMIO,
+	VMM_VCPU_EXIT_SYSREG,
+	VMM_VCPU_EXIT_WFI_WFE,
+	VMM_VCPU_EXIT_HYPERCALL,
+	VMM_VCPU_EXIT_FPU,
+	VMM_VCPU_EXIT_IRQ,
+	VMM_VCPU_EXIT_MAX
+};
+
+/** Types of VCPU events which are not exits by themselves */
+enum vmm_vcpu_event_type {
+	VMM_VCPU_EVENT_VGIC_MAINT=0,
+	VMM_VCPU_EVENT_IPI,
+	VMM_VCPU_EVENT_MAX
+};
+
+/** Exit handling time histogram
+ *  Bucket 0 counts exits handled in less than 2^HIST_SHIFT nanoseconds,
+ *  bucket N counts exits handled in [2^(N-1+HIST_SHIFT), 2^(N+HIST_SHIFT))
+ *  nanoseconds and the last bucket also counts all slower exits.
+ */
+#define VMM_VCPU_STATS_HIST_SHIFT	7
+#define VMM_VCPU_STATS_HIST_BUCKETS	16
+
+/** Per-VCPU statistics
+ *  Note: Counters are only updated by the host CPU running the VCPU
+ *  so updates are plain increments without any locking.
+ */
+struct vmm_vcpu_stats {
+	/* Exit currently being handled */
+	u32 exit_type;
+	u64 exit_tstamp;
+	/* Counters */
+	u64 exit_count[VMM_VCPU_EXIT_MAX];
+	u64 exit_nsecs[VMM_VCPU_EXIT_MAX];
+	u64 exit_hist[VMM_VCPU_EXIT_MAX][VMM_VCPU_STATS_HIST_BUCKETS];
+	u64 event_count[VMM_VCPU_EVENT_MAX];
+	u64 reset_tstamp;
+};
+
+/** Start accounting of an exit from current VCPU */
+void vmm_vcpu_stats_exit_begin(struct vmm_vcpu_stats *stats, u32 type);
+
+/** Change type of exit being accounted (e.g. stage2 fault to MMIO) */
+static inline void vmm_vcpu_stats_exit_type(struct vmm_vcpu_stats *stats,
+					    u32 type)
+{
+	stats->exit_type = type;
+}
+
+/** Finish accounting of an exit from current VCPU */
+void vmm_vcpu_stats_exit_end(struct vmm_vcpu_stats *stats);
+
+/** Count an event for current VCPU */
+static inline void vmm_vcpu_stats_event(struct vmm_vcpu_stats *stats,
+					u32 event)
+{
+	if (event < VMM_VCPU_EVENT_MAX) {
+		stats->event_count[event]++;
+	}
+}
+
+/** Clear all counters */
+void vmm_vcpu_stats_reset(struct vmm_vcpu_stats *stats);
+
+/** Add counters of one statistics instance to another */
+void vmm_vcpu_stats_accumulate(struct vmm_vcpu_stats *dst,
+			       const struct vmm_vcpu_stats *src);
+
+/** Name of exit type */
+const char *vmm_vcpu_stats_exit_name(u32 type);
+
+/** Name of event type */
+const char *vmm_vcpu_stats_event_name(u32 event);
+
+/** Print statistics on a character device */
+void vmm_vcpu_stats_dump(struct vmm_chardev *cdev,
+			 const struct vmm_vcpu_stats *stats);
+
+#endif
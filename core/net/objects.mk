@@ -26,6 +26,7 @@ core-objs-$(CONFIG_NET)+= net/vmm_netcore.o
 vmm_netcore-y += vmm_mbuf.o
 vmm_netcore-y += vmm_net.o
 vmm_netcore-y += vmm_netswitch.o
+vmm_netcore-y += vmm_netoffload.o
 vmm_netcore-y += vmm_netport.o
 vmm_netcore-y += vmm_hub.o
 vmm_netcore-y += vmm_bridge.o
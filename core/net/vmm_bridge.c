@@ -26,6 +26,7 @@
 #include <vmm_stdio.h>
 #include <vmm_timer.h>
 #include <vmm_devdrv.h>
+#include <arch_barrier.h>
 #include <net/vmm_protocol.h>
 #include <net/vmm_mbuf.h>
 #include <net/vmm_netswitch.h>
@@ -41,39 +42,162 @@
 #define DPRINTF(fmt, ...) do {} while(0)
 #endif
 
-#define BRIDGE_MAC_TABLE_SZ	32
+#define BRIDGE_MAC_HASH_BITS	8
+#define BRIDGE_MAC_HASH_SZ	(1 << BRIDGE_MAC_HASH_BITS)
+#define BRIDGE_MAC_BUCKET_WAYS	4
 #define BRIDGE_MAC_EXPIRY	30000000000LLU
+#define BRIDGE_MAC_AGE_TICKS	4
+#define BRIDGE_MAC_AGE_PERIOD	(BRIDGE_MAC_EXPIRY / BRIDGE_MAC_AGE_TICKS)
 
-/* We maintain a table of learned mac addresses 
+/* We maintain a hash table of learned mac addresses 
  * (please note that the mac of the immediate netports are not 
- * kept in this table) */
+ * kept in this table)
+ *
+ * Each hash bucket holds few entries inline so that lookups touch
+ * only one bucket. Lookups are lock-less and use per-bucket sequence
+ * counter to detect concurrent updates. Updaters are serialized by
+ * per-bucket spinlock. Ageing is done in terms of ageing epochs
+ * (advanced by bridge timer) instead of timestamps so that fast path
+ * never reads timer.
+ */
 struct bridge_mac_entry {
 	struct vmm_netport *port;
 	u8 macaddr[6];
-	u64 timestamp;
+	u32 epoch;
+};
+
+struct bridge_mac_bucket {
+	u32 seq;
+	vmm_spinlock_t lock;
+	struct bridge_mac_entry ent[BRIDGE_MAC_BUCKET_WAYS];
 };
 
 struct bridge_ctrl {
 	struct vmm_netswitch *nsw;
 	struct vmm_timer_event ev;
-	vmm_rwlock_t mac_table_lock;
+	u32 epoch;
 	u32 mac_table_sz;
-	struct bridge_mac_entry *mac_table;
+	struct bridge_mac_bucket *mac_table;
 };
 
+static inline struct bridge_mac_bucket *bridge_mac_bucket(
+					struct bridge_ctrl *br, const u8 *mac)
+{
+	u32 h;
+
+	/* Vendor part of mac is mostly same so mix in all bytes */
+	h = ((u32)mac[2] << 24) | ((u32)mac[3] << 16) |
+	    ((u32)mac[4] << 8) | mac[5];
+	h ^= ((u32)mac[0] << 8) | mac[1];
+	h *= 0x9e370001UL;
+
+	return &br->mac_table[h >> (32 - BRIDGE_MAC_HASH_BITS)];
+}
+
+static inline u32 bridge_mac_read_begin(struct bridge_mac_bucket *b)
+{
+	u32 seq;
+
+	while ((seq = *(volatile u32 *)&b->seq) & 1) ;
+	arch_smp_rmb();
+
+	return seq;
+}
+
+static inline bool bridge_mac_read_retry(struct bridge_mac_bucket *b, u32 seq)
+{
+	arch_smp_rmb();
+
+	return (*(volatile u32 *)&b->seq != seq) ? TRUE : FALSE;
+}
+
+static inline void bridge_mac_write_begin(struct bridge_mac_bucket *b)
+{
+	b->seq++;
+	arch_smp_wmb();
+}
+
+static inline void bridge_mac_write_end(struct bridge_mac_bucket *b)
+{
+	arch_smp_wmb();
+	b->seq++;
+}
+
+/* Note: Must be called with bucket sequence read section */
+static struct bridge_mac_entry *bridge_mac_find(struct bridge_mac_bucket *b,
+						const u8 *mac)
+{
+	u32 i;
+
+	for (i = 0; i < BRIDGE_MAC_BUCKET_WAYS; i++) {
+		if (b->ent[i].port &&
+		    !compare_ether_addr(b->ent[i].macaddr, mac)) {
+			return &b->ent[i];
+		}
+	}
+
+	return NULL;
+}
+
 static void bridge_mactable_cleanup_port(struct bridge_ctrl *br,
 					 struct vmm_netport *port)
 {
-	u32 m;
+	u32 b, i;
+	irq_flags_t f;
+	struct bridge_mac_bucket *bkt;
+
+	for (b = 0; b < br->mac_table_sz; b++) {
+		bkt = &br->mac_table[b];
+		vmm_spin_lock_irqsave_lite(&bkt->lock, f);
+		bridge_mac_write_begin(bkt);
+		for (i = 0; i < BRIDGE_MAC_BUCKET_WAYS; i++) {
+			if (bkt->ent[i].port == port) {
+				bkt->ent[i].port = NULL;
+			}
+		}
+		bridge_mac_write_end(bkt);
+		vmm_spin_unlock_irqrestore_lite(&bkt->lock, f);
+	}
+}
+
+static void bridge_mactable_learn(struct bridge_ctrl *br,
+				  const u8 *srcmac,
+				  struct vmm_netport *src)
+{
+	u32 i, epoch = br->epoch;
 	irq_flags_t f;
+	struct bridge_mac_entry *m, *victim;
+	struct bridge_mac_bucket *b = bridge_mac_bucket(br, srcmac);
 
-	vmm_write_lock_irqsave_lite(&br->mac_table_lock, f);
-	for (m = 0; m < br->mac_table_sz; m++) {
-		if (br->mac_table[m].port == port) {
-			br->mac_table[m].port = NULL;
+	vmm_spin_lock_irqsave_lite(&b->lock, f);
+
+	/* If mac entry already exist then update it otherwise
+	 * use a free entry or replace least recently seen entry
+	 * of the bucket.
+	 */
+	m = bridge_mac_find(b, srcmac);
+	if (!m) {
+		victim = &b->ent[0];
+		for (i = 0; i < BRIDGE_MAC_BUCKET_WAYS; i++) {
+			m = &b->ent[i];
+			if (!m->port) {
+				victim = m;
+				break;
+			}
+			if ((epoch - m->epoch) > (epoch - victim->epoch)) {
+				victim = m;
+			}
 		}
+		m = victim;
 	}
-	vmm_write_unlock_irqrestore_lite(&br->mac_table_lock, f);
+
+	bridge_mac_write_begin(b);
+	m->port = src;
+	memcpy(m->macaddr, srcmac, 6);
+	m->epoch = epoch;
+	bridge_mac_write_end(b);
+
+	vmm_spin_unlock_irqrestore_lite(&b->lock, f);
 }
 
 static struct vmm_netport *bridge_mactable_learn_find(struct bridge_ctrl *br,
@@ -81,93 +205,37 @@ static struct vmm_netport *bridge_mactable_learn_find(struct bridge_ctrl *br,
 						      const u8 *srcmac,
 						      struct vmm_netport *src)
 {
-	u32 i;
-	u64 tstamp;
-	irq_flags_t f;
-	bool learn, update, found;
+	u32 seq, epoch = br->epoch;
+	bool learn, refresh;
 	struct vmm_netport *dst;
 	struct bridge_mac_entry *m;
+	struct bridge_mac_bucket *b;
 
-	/* Acquire read lock */
-	vmm_read_lock_irqsave_lite(&br->mac_table_lock, f);
-
-	/* Check for for dstmac and whether we need
-	 * to Learn (srcmac, src) mapping ??
-	 */
-	learn = TRUE;
-	dst = NULL;
-	for (i = 0; i < br->mac_table_sz; i++) {
-		m = &br->mac_table[i];
-		/* If mac table entry is unused then continue */
-		if (!m->port) {
-			continue;
-		}
-		/* Match (srcmac, srcport) */
-		if (learn &&
-		    !compare_ether_addr(m->macaddr, srcmac) &&
-		    (m->port == src)) {
-			learn = FALSE;
-		}
-		/* Match (dstmac) */
-		if (!dst &&
-		    !compare_ether_addr(m->macaddr, dstmac)) {
-			dst = m->port;
-		}
-		/* If no need to learn and found
-		 * destination port then break
-		 */
-		if (!learn && dst) {
-			break;
-		}
-	}
-
-	/* Release read lock */
-	vmm_read_unlock_irqrestore_lite(&br->mac_table_lock, f);
+	/* Check whether we need to Learn (srcmac, src) mapping ?? */
+	b = bridge_mac_bucket(br, srcmac);
+	do {
+		seq = bridge_mac_read_begin(b);
+		m = bridge_mac_find(b, srcmac);
+		learn = (!m || (m->port != src)) ? TRUE : FALSE;
+		refresh = (m && (m->epoch != epoch)) ? TRUE : FALSE;
+	} while (bridge_mac_read_retry(b, seq));
 
-	/* If leaning required then update mac table */
 	if (learn) {
-		/* Retrive current timestamp */
-		tstamp = vmm_timer_timestamp();
-
-		/* Acquire write lock */
-		vmm_write_lock_irqsave_lite(&br->mac_table_lock, f);
-
-		/* If mac entry already exist then
-		 * update only port and timestamp
-		 */
-		update = TRUE;
-		for (i = 0; i < br->mac_table_sz; i++) {
-			m = &br->mac_table[i];
-			if (!compare_ether_addr(m->macaddr, srcmac)) {
-				m->port = src;
-				m->timestamp = tstamp;
-				update = FALSE;
-				break;
-			}
-		}
-
-		/* If mac entry does not exist then
-		 * save (mac, port, timestamp) in a
-		 * free mac table entry.
-		 */
-		if (update) {
-			found = FALSE;
-			for (i = 0; i < br->mac_table_sz; i++) {
-				m = &br->mac_table[i];
-				if (m->port == NULL) {
-					found = TRUE;
-					break;
-				}
-			}
-			if (found) {
-				m->port = src;
-				memcpy(m->macaddr, srcmac, 6);
-				m->timestamp = tstamp;
-			}
-		}
+		bridge_mactable_learn(br, srcmac, src);
+	} else if (refresh) {
+		/* Racing with updater only affects ageing of one entry */
+		m->epoch = epoch;
+	}
 
-		/* Release write lock */
-		vmm_write_unlock_irqrestore_lite(&br->mac_table_lock, f);
+	/* Check for for dstmac */
+	dst = NULL;
+	if (!is_broadcast_ether_addr(dstmac)) {
+		b = bridge_mac_bucket(br, dstmac);
+		do {
+			seq = bridge_mac_read_begin(b);
+			m = bridge_mac_find(b, dstmac);
+			dst = (m) ? m->port : NULL;
+		} while (bridge_mac_read_retry(b, seq));
 	}
 
 	return dst;
@@ -175,39 +243,39 @@ static struct vmm_netport *bridge_mactable_learn_find(struct bridge_ctrl *br,
 
 static void bridge_timer_event(struct vmm_timer_event *ev)
 {
-	u32 i;
-	u64 tstamp;
+	u32 b, i, epoch;
 	irq_flags_t f;
 	struct bridge_ctrl *br = ev->priv;
+	struct bridge_mac_bucket *bkt;
 	struct bridge_mac_entry *m;
 
 	DPRINTF("%s: bridge expiry event nsw=%s\n",
 		__func__, br->nsw->name);
 
-	/* Retrive current timestamp */
-	tstamp = vmm_timer_timestamp();
-
-	/* Acquire write lock */
-	vmm_write_lock_irqsave_lite(&br->mac_table_lock, f);
-
-	/* Purge old enteries */
-	for (i = 0; i < br->mac_table_sz; i++) {
-		m = &br->mac_table[i];
-		if (m->port &&
-		    ((m->timestamp - tstamp) > BRIDGE_MAC_EXPIRY)) {
-			DPRINTF("%s: purge port=%s\n",
-				__func__, m->port->name);
-			m->port = NULL;
-			memset(m->macaddr, 0, 6);
-			m->timestamp = 0;
+	/* Advance ageing epoch */
+	epoch = ++br->epoch;
+
+	/* Purge old enteries one bucket at a time */
+	for (b = 0; b < br->mac_table_sz; b++) {
+		bkt = &br->mac_table[b];
+		vmm_spin_lock_irqsave_lite(&bkt->lock, f);
+		for (i = 0; i < BRIDGE_MAC_BUCKET_WAYS; i++) {
+			m = &bkt->ent[i];
+			if (m->port &&
+			    ((epoch - m->epoch) >= BRIDGE_MAC_AGE_TICKS)) {
+				DPRINTF("%s: purge port=%s\n",
+					__func__, m->port->name);
+				bridge_mac_write_begin(bkt);
+				m->port = NULL;
+				memset(m->macaddr, 0, 6);
+				bridge_mac_write_end(bkt);
+			}
 		}
+		vmm_spin_unlock_irqrestore_lite(&bkt->lock, f);
 	}
 
-	/* Release write lock */
-	vmm_write_unlock_irqrestore_lite(&br->mac_table_lock, f);
-
 	/* Again start the bridge timer event */
-	vmm_timer_event_start(&br->ev, BRIDGE_MAC_EXPIRY);
+	vmm_timer_event_start(&br->ev, BRIDGE_MAC_AGE_PERIOD);
 }
 
 /**
@@ -288,6 +356,7 @@ static int bridge_probe(struct vmm_device *dev,
 			const struct vmm_devtree_nodeid *nid)
 {
 	int rc = VMM_OK;
+	u32 i;
 	struct bridge_ctrl *br;
 	struct vmm_netswitch *nsw = NULL;
 
@@ -310,25 +379,28 @@ static int bridge_probe(struct vmm_device *dev,
 
 	br->nsw = nsw;
 	INIT_TIMER_EVENT(&br->ev, bridge_timer_event, br);
-	INIT_RW_LOCK(&br->mac_table_lock);
-	br->mac_table_sz = BRIDGE_MAC_TABLE_SZ;
-	br->mac_table = vmm_zalloc(sizeof(struct bridge_mac_entry) *
+	br->mac_table_sz = BRIDGE_MAC_HASH_SZ;
+	br->mac_table = vmm_zalloc(sizeof(struct bridge_mac_bucket) *
 				   br->mac_table_sz);
 	if (!br->mac_table) {
 		rc = VMM_ENOMEM;
 		goto bridge_alloc_mac_table_fail;
 	}
+	for (i = 0; i < br->mac_table_sz; i++) {
+		INIT_SPIN_LOCK(&br->mac_table[i].lock);
+	}
 
 	rc = vmm_netswitch_register(nsw, dev, br);
 	if (rc) {
 		goto bridge_netswitch_register_fail;
 	}
 
-	vmm_timer_event_start(&br->ev, BRIDGE_MAC_EXPIRY);
+	vmm_timer_event_start(&br->ev, BRIDGE_MAC_AGE_PERIOD);
 
 	return VMM_OK;
 
 bridge_netswitch_register_fail:
+	vmm_free(br->mac_table);
 bridge_alloc_mac_table_fail:
 	vmm_free(br);
 bridge_alloc_failed:
@@ -0,0 +1,268 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vmm_netoffload.c
+ * @author agent (agent@local)
+ * @brief Software fallback for checksum and segmentation offloads.
+ *
+ * Frames with partial checksum or unsegmented TCP payload are passed
+ * as-is between ports which can handle them (e.g. between two virtio
+ * net ports). Only when such a frame egresses to a port without the
+ * corresponding feature (e.g. physical NIC or host netstack) do we
+ * finish the checksum and/or segment the frame in software.
+ */
+
+#include <vmm_error.h>
+#include <vmm_heap.h>
+#include <vmm_host_io.h>
+#include <vmm_modules.h>
+#include <net/vmm_protocol.h>
+#include <net/vmm_netoffload.h>
+#include <libs/stringlib.h>
+#include <vmm_macros.h>
+
+#define NETOFFLOAD_ETH_P_8021Q		0x8100
+#define NETOFFLOAD_IP6_HLEN		40
+#define NETOFFLOAD_IPPROTO_TCP		6
+#define NETOFFLOAD_UDP_CSUM_OFFSET	6
+#define NETOFFLOAD_TCP_FIN		0x01
+#define NETOFFLOAD_TCP_PSH		0x08
+#define NETOFFLOAD_TCP_CWR		0x80
+
+static inline void netoffload_put16(u8 *p, u16 val)
+{
+	p[0] = val >> 8;
+	p[1] = val & 0xff;
+}
+
+static inline u16 netoffload_get16(const u8 *p)
+{
+	return ((u16)p[0] << 8) | p[1];
+}
+
+static inline void netoffload_put32(u8 *p, u32 val)
+{
+	p[0] = val >> 24;
+	p[1] = (val >> 16) & 0xff;
+	p[2] = (val >> 8) & 0xff;
+	p[3] = val & 0xff;
+}
+
+static inline u32 netoffload_get32(const u8 *p)
+{
+	return ((u32)p[0] << 24) | ((u32)p[1] << 16) |
+	       ((u32)p[2] << 8) | p[3];
+}
+
+/* Accumulate big-endian words without folding. Since 2^16 == 1 in
+ * ones-complement arithmetic, summing 32-bit words gives the same
+ * result as summing their 16-bit halves while halving the loop count.
+ */
+static u64 netoffload_sum(const u8 *buf, u32 len, u64 sum)
+{
+	while (len >= 4) {
+		sum += netoffload_get32(buf);
+		buf += 4;
+		len -= 4;
+	}
+	if (len >= 2) {
+		sum += netoffload_get16(buf);
+		buf += 2;
+		len -= 2;
+	}
+	if (len) {
+		sum += (u32)buf[0] << 8;
+	}
+
+	return sum;
+}
+
+static u16 netoffload_fold(u64 sum)
+{
+	sum = (sum & 0xffffffffULL) + (sum >> 32);
+	sum = (sum & 0xffffffffULL) + (sum >> 32);
+	sum = (sum & 0xffff) + (sum >> 16);
+	sum = (sum & 0xffff) + (sum >> 16);
+	sum = (sum & 0xffff) + (sum >> 16);
+
+	return (u16)~sum;
+}
+
+void vmm_netoffload_csum(u8 *frame, u32 len, u16 csum_start, u16 csum_offset)
+{
+	u16 csum;
+
+	if (((u32)csum_start + csum_offset + 2) > len) {
+		return;
+	}
+
+	/* Checksum field holds pseudo-header sum so just sum it along */
+	csum = netoffload_fold(netoffload_sum(frame + csum_start,
+					      len - csum_start, 0));
+	if (!csum && (csum_offset == NETOFFLOAD_UDP_CSUM_OFFSET)) {
+		csum = 0xffff;
+	}
+
+	netoffload_put16(frame + csum_start + csum_offset, csum);
+}
+VMM_EXPORT_SYMBOL(vmm_netoffload_csum);
+
+static struct vmm_mbuf *netoffload_alloc(u32 len)
+{
+	struct vmm_mbuf *m;
+
+	MGETHDR(m, 0, 0);
+	if (!m) {
+		return NULL;
+	}
+	if (!MEXTMALLOC(m, len, 0)) {
+		m_freem(m);
+		return NULL;
+	}
+	m->m_len = m->m_pktlen = len;
+
+	return m;
+}
+
+static int netoffload_segment(struct vmm_mbuf *m, const u8 *frame, u32 len,
+			      int (*xmit)(void *, struct vmm_mbuf *),
+			      void *xmit_arg)
+{
+	int rc;
+	bool ipv4 = (m->m_pkthdr.gso_type == M_GSO_TCPV4) ? TRUE : FALSE;
+	u8 *buf, *ip, *tcp;
+	u16 ipid = 0;
+	u32 nh_off, l4_off, thl, hdr_len, mss, seq, off, seg_len, tcp_len;
+	u64 sum;
+
+	nh_off = ETHER_HLEN;
+	if (ether_type(frame) == NETOFFLOAD_ETH_P_8021Q) {
+		nh_off += 4;
+	}
+	l4_off = m->m_pkthdr.csum_start;
+	mss = m->m_pkthdr.gso_size;
+	if (!mss || ((l4_off + TCP_HLEN) > len) ||
+	    (l4_off < (nh_off + ((ipv4) ? IP4_HLEN : NETOFFLOAD_IP6_HLEN)))) {
+		return VMM_EINVALID;
+	}
+	thl = (frame[l4_off + 12] >> 4) * 4;
+	hdr_len = l4_off + thl;
+	if ((thl < TCP_HLEN) || (hdr_len > len)) {
+		return VMM_EINVALID;
+	}
+
+	seq = netoffload_get32(frame + l4_off + 4);
+	if (ipv4) {
+		ipid = netoffload_get16(frame + nh_off + 4);
+	}
+
+	for (off = hdr_len; off < len; off += seg_len) {
+		seg_len = min(mss, len - off);
+		tcp_len = thl + seg_len;
+
+		m = netoffload_alloc(hdr_len + seg_len);
+		if (!m) {
+			return VMM_ENOMEM;
+		}
+		buf = mtod(m, u8 *);
+		memcpy(buf, frame, hdr_len);
+		memcpy(buf + hdr_len, frame + off, seg_len);
+		ip = buf + nh_off;
+		tcp = buf + l4_off;
+
+		if (ipv4) {
+			netoffload_put16(ip + 2, l4_off - nh_off + tcp_len);
+			netoffload_put16(ip + 4, ipid++);
+			netoffload_put16(ip + 10, 0);
+			netoffload_put16(ip + 10, netoffload_fold(
+				netoffload_sum(ip, (ip[0] & 0xf) * 4, 0)));
+			sum = netoffload_sum(ip + 12, 8, 0);
+		} else {
+			netoffload_put16(ip + 4, l4_off - nh_off -
+					 NETOFFLOAD_IP6_HLEN + tcp_len);
+			sum = netoffload_sum(ip + 8, 32, 0);
+		}
+		sum += NETOFFLOAD_IPPROTO_TCP + tcp_len;
+
+		netoffload_put32(tcp + 4, seq + (off - hdr_len));
+		if ((off + seg_len) < len) {
+			tcp[13] &= ~(NETOFFLOAD_TCP_FIN | NETOFFLOAD_TCP_PSH);
+		}
+		if (off != hdr_len) {
+			tcp[13] &= ~NETOFFLOAD_TCP_CWR;
+		}
+		netoffload_put16(tcp + 16, 0);
+		netoffload_put16(tcp + 16,
+				 netoffload_fold(netoffload_sum(tcp, tcp_len, sum)));
+
+		rc = xmit(xmit_arg, m);
+		if (rc) {
+			return rc;
+		}
+	}
+
+	return VMM_OK;
+}
+
+int vmm_netoffload_resolve(struct vmm_mbuf *m,
+			   int (*xmit)(void *, struct vmm_mbuf *),
+			   void *xmit_arg)
+{
+	int rc;
+	u8 *frame;
+	u32 len;
+	struct vmm_mbuf *n;
+
+	if (!m || !xmit || !(m->m_flags & M_PKTHDR)) {
+		return VMM_EINVALID;
+	}
+	len = m->m_pktlen;
+
+	if ((m->m_pkthdr.gso_type != M_GSO_NONE) &&
+	    (m->m_flags & M_CSUM_PARTIAL) &&
+	    (len > ((u32)m->m_pkthdr.csum_start + TCP_HLEN))) {
+		if (m->m_next) {
+			frame = vmm_malloc(len);
+			if (!frame) {
+				return VMM_ENOMEM;
+			}
+			m_copydata(m, 0, len, frame);
+			rc = netoffload_segment(m, frame, len, xmit, xmit_arg);
+			vmm_free(frame);
+		} else {
+			rc = netoffload_segment(m, mtod(m, u8 *), len,
+						xmit, xmit_arg);
+		}
+		return rc;
+	}
+
+	/* Shared mbuf so complete checksum in a private copy */
+	n = netoffload_alloc(len);
+	if (!n) {
+		return VMM_ENOMEM;
+	}
+	m_copydata(m, 0, len, mtod(n, u8 *));
+	if (m->m_flags & M_CSUM_PARTIAL) {
+		vmm_netoffload_csum(mtod(n, u8 *), len,
+				    m->m_pkthdr.csum_start,
+				    m->m_pkthdr.csum_offset);
+	}
+
+	return xmit(xmit_arg, n);
+}
+VMM_EXPORT_SYMBOL(vmm_netoffload_resolve);
@@ -103,6 +103,11 @@ struct vmm_netport *vmm_netport_alloc(char *name, u32 queue_size)
 	}
 
 	INIT_SPIN_LOCK(&port->switch2port_xfer_lock);
+	port->txq_depth = VMM_NETPORT_MAX_TXQ_DEPTH(port);
+	INIT_LIST_HEAD(&port->txq);
+	INIT_LIST_HEAD(&port->throttle_list);
+	INIT_SPIN_LOCK(&port->throttle_lock);
+	INIT_LIST_HEAD(&port->throttle_head);
 
 	return port;
 }
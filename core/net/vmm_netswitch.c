@@ -33,10 +33,12 @@
 #include <vmm_modules.h>
 #include <vmm_threads.h>
 #include <vmm_completion.h>
+#include <vmm_trace.h>
 #include <net/vmm_mbuf.h>
 #include <net/vmm_protocol.h>
 #include <net/vmm_netswitch.h>
 #include <net/vmm_netport.h>
+#include <net/vmm_netoffload.h>
 #include <libs/list.h>
 #include <libs/mathlib.h>
 #include <libs/stringlib.h>
@@ -132,8 +134,16 @@ struct vmm_netswitch_bh_ctrl {
 	struct vmm_completion xfer_cmpl;
 	vmm_spinlock_t xfer_list_lock;
 	struct dlist xfer_list;
+	/* Source port of mbuf xfer being processed */
+	struct vmm_netport *xfer_src;
 };
 
+/* Throttle source when destination queue is half full and
+ * resume throttled sources when it is back to quarter full.
+ */
+#define NETSWITCH_TXQ_HIGH(port)	((port)->txq_depth / 2)
+#define NETSWITCH_TXQ_LOW(port)		((port)->txq_depth / 4)
+
 static DEFINE_PER_CPU(struct vmm_netswitch_bh_ctrl, nbctrl);
 
 static void __init netswitch_bh_init(struct vmm_netswitch_bh_ctrl *nbp)
@@ -200,6 +210,139 @@ static void netswitch_bh_port_flush(struct vmm_netswitch_bh_ctrl *nbp,
 	vmm_spin_unlock_irqrestore_lite(&nbp->xfer_list_lock, flags);
 }
 
+/* Park lazy xfer of a throttled port till it is unthrottled.
+ * Returns TRUE if xfer was consumed.
+ */
+static bool netswitch_port_park(struct vmm_netport *port,
+				struct vmm_netport_xfer *xfer)
+{
+	bool ret = FALSE;
+	irq_flags_t f;
+
+	vmm_spin_lock_irqsave_lite(&port->throttle_lock, f);
+	if (port->throttled) {
+		if (port->throttle_xfer) {
+			/* Already have a parked lazy xfer */
+			vmm_netport_free_xfer(port, xfer);
+		} else {
+			port->throttle_xfer = xfer;
+		}
+		ret = TRUE;
+	}
+	vmm_spin_unlock_irqrestore_lite(&port->throttle_lock, f);
+
+	return ret;
+}
+
+/* Throttle src port because queue of dst port is filling up.
+ * Note: Must be called with dst->switch2port_xfer_lock held.
+ */
+static void netswitch_port_throttle(struct vmm_netport *src,
+				    struct vmm_netport *dst)
+{
+	irq_flags_t f;
+
+	vmm_spin_lock_irqsave_lite(&src->throttle_lock, f);
+	if (!src->throttled) {
+		src->throttled = TRUE;
+		src->stats.throttled++;
+		/* Only dst port resumes src port */
+		src->throttle_dst = dst;
+		list_add_tail(&src->throttle_head, &dst->throttle_list);
+		/* Never stay throttled for long even if nobody resumes */
+		if (!vmm_timer_event_pending(&src->throttle_ev)) {
+			vmm_timer_event_start(&src->throttle_ev,
+					      VMM_NETPORT_THROTTLE_NSECS);
+		}
+	}
+	vmm_spin_unlock_irqrestore_lite(&src->throttle_lock, f);
+}
+
+/* Unthrottle all ports throttled by dst port and collect their
+ * parked lazy xfers in given list.
+ * Note: Must be called with dst->switch2port_xfer_lock held.
+ */
+static void netswitch_port_release(struct vmm_netport *dst,
+				   struct dlist *parked)
+{
+	irq_flags_t f;
+	struct vmm_netport *src;
+	struct vmm_netport_xfer *xfer;
+
+	while (!list_empty(&dst->throttle_list)) {
+		src = list_first_entry(&dst->throttle_list,
+				       struct vmm_netport, throttle_head);
+		list_del_init(&src->throttle_head);
+
+		vmm_spin_lock_irqsave_lite(&src->throttle_lock, f);
+		src->throttled = FALSE;
+		src->throttle_dst = NULL;
+		xfer = src->throttle_xfer;
+		src->throttle_xfer = NULL;
+		vmm_spin_unlock_irqrestore_lite(&src->throttle_lock, f);
+
+		if (xfer) {
+			list_add_tail(&xfer->head, parked);
+		}
+	}
+}
+
+/* Resume parked lazy xfers collected by netswitch_port_release() */
+static void netswitch_port_resume(struct dlist *parked)
+{
+	struct vmm_netport_xfer *xfer;
+
+	while (!list_empty(parked)) {
+		xfer = list_entry(list_pop(parked),
+				  struct vmm_netport_xfer, head);
+		netswitch_bh_enqueue(&this_cpu(nbctrl), xfer);
+	}
+}
+
+/* Unthrottle src port without help from port which throttled it.
+ * Returns parked lazy xfer of src port.
+ */
+static struct vmm_netport_xfer *netswitch_port_unthrottle(
+					struct vmm_netport *src)
+{
+	irq_flags_t f, f1;
+	struct vmm_netport *dst;
+	struct vmm_netport_xfer *xfer;
+
+	vmm_spin_lock_irqsave_lite(&src->throttle_lock, f);
+	dst = src->throttle_dst;
+	vmm_spin_unlock_irqrestore_lite(&src->throttle_lock, f);
+
+	/* Lock order is dst->switch2port_xfer_lock then src->throttle_lock */
+	if (dst) {
+		vmm_spin_lock_irqsave_lite(&dst->switch2port_xfer_lock, f1);
+	}
+	vmm_spin_lock_irqsave_lite(&src->throttle_lock, f);
+	if (dst && (src->throttle_dst == dst)) {
+		list_del_init(&src->throttle_head);
+		src->throttle_dst = NULL;
+	}
+	src->throttled = FALSE;
+	xfer = src->throttle_xfer;
+	src->throttle_xfer = NULL;
+	vmm_spin_unlock_irqrestore_lite(&src->throttle_lock, f);
+	if (dst) {
+		vmm_spin_unlock_irqrestore_lite(&dst->switch2port_xfer_lock,
+						f1);
+	}
+
+	return xfer;
+}
+
+static void netswitch_port_throttle_timeout(struct vmm_timer_event *ev)
+{
+	struct vmm_netport_xfer *xfer = netswitch_port_unthrottle(ev->priv);
+
+	if (xfer) {
+		netswitch_bh_enqueue(&this_cpu(nbctrl), xfer);
+	}
+}
+
 static int netswitch_bh_main(void *param)
 {
 	struct vmm_netport *xfer_port;
@@ -228,6 +371,12 @@ static int netswitch_bh_main(void *param)
 		xfer_lazy_arg = xfer->lazy_arg;
 		xfer_lazy_xfer = xfer->lazy_xfer;
 
+		/* Lazy xfer of throttled port is deferred */
+		if ((xfer_type == VMM_NETPORT_XFER_LAZY) && xfer_port &&
+		    netswitch_port_park(xfer_port, xfer)) {
+			continue;
+		}
+
 		/* Free netport xfer request */
 		vmm_netport_free_xfer(xfer->port, xfer);
 
@@ -256,8 +405,14 @@ static int netswitch_bh_main(void *param)
 			/* Dump packet */
 			DUMP_NETSWITCH_PKT(xfer_mbuf);
 
+			vmm_trace(VMM_TRACE_CAT_NET, VMM_TRACE_NET_PORT2SWITCH,
+				  xfer_mbuf->m_pktlen, (virtual_addr_t)xfer_port,
+				  (virtual_addr_t)xfer_nsw);
+
 			/* Call the rx function of net switch */
+			nbp->xfer_src = xfer_port;
 			xfer_nsw->port2switch_xfer(xfer_nsw, xfer_port, xfer_mbuf);
+			nbp->xfer_src = NULL;
 
 			/* Free mbuf in xfer request */
 			m_freem(xfer_mbuf);
@@ -353,6 +508,11 @@ int vmm_port2switch_xfer_lazy(struct vmm_netport *src,
 	xfer->lazy_budget = lazy_budget;
 	xfer->lazy_xfer = lazy_xfer;
 
+	/* Hold back lazy xfer while source port is throttled */
+	if (netswitch_port_park(src, xfer)) {
+		return VMM_OK;
+	}
+
 	/* Add xfer request to xfer ring */
 	rc = netswitch_bh_enqueue(nbp, xfer);
 	if (rc) {
@@ -365,11 +525,111 @@ int vmm_port2switch_xfer_lazy(struct vmm_netport *src,
 }
 VMM_EXPORT_SYMBOL(vmm_port2switch_xfer_lazy);
 
+/* Note: Must be called with dst->switch2port_xfer_lock held.
+ * Returns TRUE if queue drained below low watermark.
+ */
+static bool netswitch_txq_drain(struct vmm_netport *dst)
+{
+	u32 count = 0;
+	struct vmm_mbuf *mbuf;
+	struct vmm_netport_xfer *xfer;
+
+	while (dst->txq_len && (!dst->can_xfer || dst->can_xfer(dst))) {
+		xfer = list_first_entry(&dst->txq,
+					struct vmm_netport_xfer, head);
+		list_del(&xfer->head);
+		dst->txq_len--;
+		mbuf = xfer->mbuf;
+		vmm_netport_free_xfer(dst, xfer);
+
+		dst->stats.tx_packets++;
+		dst->switch2port_xfer(dst, mbuf);
+		count++;
+	}
+
+	return (count && (dst->txq_len <= NETSWITCH_TXQ_LOW(dst))) ?
+								TRUE : FALSE;
+}
+
+/* Note: Must be called with dst->switch2port_xfer_lock held */
+static void netswitch_txq_purge(struct vmm_netport *dst)
+{
+	struct vmm_netport_xfer *xfer;
+
+	while (!list_empty(&dst->txq)) {
+		xfer = list_first_entry(&dst->txq,
+					struct vmm_netport_xfer, head);
+		list_del(&xfer->head);
+		m_freem(xfer->mbuf);
+		vmm_netport_free_xfer(dst, xfer);
+		dst->stats.tx_dropped++;
+	}
+	dst->txq_len = 0;
+}
+
+/* Give mbuf to dst port or queue it if dst port is busy.
+ * Note: This consumes one reference of mbuf.
+ */
+static int netswitch_port_xfer(void *arg, struct vmm_mbuf *mbuf)
+{
+	int rc = VMM_OK;
+	irq_flags_t f;
+	bool resume, throttle = FALSE;
+	struct vmm_netport *src, *dst = arg;
+	struct vmm_netport_xfer *xfer = NULL;
+	struct dlist parked;
+
+	INIT_LIST_HEAD(&parked);
+
+	vmm_spin_lock_irqsave_lite(&dst->switch2port_xfer_lock, f);
+
+	/* Older queued frames go first */
+	resume = netswitch_txq_drain(dst);
+
+	if (!dst->txq_len && (!dst->can_xfer || dst->can_xfer(dst))) {
+		dst->stats.tx_packets++;
+		rc = dst->switch2port_xfer(dst, mbuf);
+	} else {
+		if (dst->txq_len < dst->txq_depth) {
+			xfer = vmm_netport_alloc_xfer(dst);
+		}
+		if (xfer) {
+			xfer->port = dst;
+			xfer->type = VMM_NETPORT_XFER_MBUF;
+			xfer->mbuf = mbuf;
+			list_add_tail(&xfer->head, &dst->txq);
+			dst->txq_len++;
+			dst->stats.tx_queued++;
+			throttle = (dst->txq_len >= NETSWITCH_TXQ_HIGH(dst)) ?
+								TRUE : FALSE;
+		} else {
+			m_freem(mbuf);
+			dst->stats.tx_dropped++;
+			throttle = TRUE;
+		}
+	}
+
+	if (resume) {
+		netswitch_port_release(dst, &parked);
+	}
+
+	/* Back-pressure the port which sent this frame */
+	src = this_cpu(nbctrl).xfer_src;
+	if (throttle && src && (src != dst)) {
+		netswitch_port_throttle(src, dst);
+	}
+
+	vmm_spin_unlock_irqrestore_lite(&dst->switch2port_xfer_lock, f);
+
+	netswitch_port_resume(&parked);
+
+	return rc;
+}
+
 int vmm_switch2port_xfer_mbuf(struct vmm_netswitch *nsw,
 			      struct vmm_netport *dst,
 			      struct vmm_mbuf *mbuf)
 {
-	int rc;
 	irq_flags_t f;
 
 	if (!nsw || !dst || !mbuf) {
@@ -380,19 +640,50 @@ int vmm_switch2port_xfer_mbuf(struct vmm_netswitch *nsw,
 	DPRINTF("%s: nsw=%s dst=%s\n", __func__, nsw->name, dst->name);
 
 	if (dst->can_receive && !dst->can_receive(dst)) {
+		vmm_spin_lock_irqsave_lite(&dst->switch2port_xfer_lock, f);
+		dst->stats.tx_dropped++;
+		vmm_spin_unlock_irqrestore_lite(&dst->switch2port_xfer_lock, f);
 		return VMM_OK;
 	}
 
+	vmm_trace(VMM_TRACE_CAT_NET, VMM_TRACE_NET_SWITCH2PORT,
+		  mbuf->m_pktlen, (virtual_addr_t)dst, (virtual_addr_t)nsw);
+
+	/* Checksum/segment in software if dst port can't take it as-is */
+	if (vmm_netoffload_needed(mbuf, dst->features)) {
+		return vmm_netoffload_resolve(mbuf,
+					      netswitch_port_xfer, dst);
+	}
+
 	MADDREFERENCE(mbuf);
 	MCLADDREFERENCE(mbuf);
 
+	return netswitch_port_xfer(dst, mbuf);
+}
+VMM_EXPORT_SYMBOL(vmm_switch2port_xfer_mbuf);
+
+int vmm_switch2port_xfer_resume(struct vmm_netport *dst)
+{
+	irq_flags_t f;
+	struct dlist parked;
+
+	if (!dst) {
+		return VMM_EFAIL;
+	}
+
+	INIT_LIST_HEAD(&parked);
+
 	vmm_spin_lock_irqsave_lite(&dst->switch2port_xfer_lock, f);
-	rc = dst->switch2port_xfer(dst, mbuf);
+	if (netswitch_txq_drain(dst)) {
+		netswitch_port_release(dst, &parked);
+	}
 	vmm_spin_unlock_irqrestore_lite(&dst->switch2port_xfer_lock, f);
 
-	return rc;
+	netswitch_port_resume(&parked);
+
+	return VMM_OK;
 }
-VMM_EXPORT_SYMBOL(vmm_switch2port_xfer_mbuf);
+VMM_EXPORT_SYMBOL(vmm_switch2port_xfer_resume);
 
 struct vmm_netswitch *vmm_netswitch_alloc(char *name)
 {
@@ -445,6 +736,16 @@ int vmm_netswitch_port_add(struct vmm_netswitch *nsw,
 	}
 
 	if (rc == VMM_OK) {
+		/* Setup flow control of the port */
+		if (port->txq_depth > VMM_NETPORT_MAX_TXQ_DEPTH(port)) {
+			port->txq_depth = VMM_NETPORT_MAX_TXQ_DEPTH(port);
+		}
+		port->throttled = FALSE;
+		port->throttle_dst = NULL;
+		port->throttle_xfer = NULL;
+		INIT_TIMER_EVENT(&port->throttle_ev,
+				 netswitch_port_throttle_timeout, port);
+
 		/* Add the port to the port_list */
 		vmm_write_lock_irqsave_lite(&nsw->port_list_lock, f);
 		list_add_tail(&port->head, &nsw->port_list);
@@ -477,6 +778,8 @@ static void netswitch_port_remove(struct vmm_netswitch *nsw,
 	u32 c;
 	irq_flags_t f;
 	struct vmm_netswitch_bh_ctrl *nbp;
+	struct vmm_netport_xfer *xfer;
+	struct dlist parked;
 
 	/* Notify the port about the link-status change */
 	port->flags &= ~VMM_NETPORT_LINK_UP;
@@ -485,6 +788,22 @@ static void netswitch_port_remove(struct vmm_netswitch *nsw,
 	/* Mark the port to belong to NULL netswitch */
 	port->nsw = NULL;
 
+	/* Drop frames queued for this port */
+	vmm_spin_lock_irqsave_lite(&port->switch2port_xfer_lock, f);
+	netswitch_txq_purge(port);
+	vmm_spin_unlock_irqrestore_lite(&port->switch2port_xfer_lock, f);
+
+	/* Drop parked lazy xfer of this port after waiting for throttle
+	 * timeout handler running on other host CPU (Note: handler takes
+	 * port locks so no port lock can be held here). Lazy xfer queued
+	 * by the handler is dropped by bh flush below.
+	 */
+	vmm_timer_event_stop_sync(&port->throttle_ev);
+	xfer = netswitch_port_unthrottle(port);
+	if (xfer) {
+		vmm_netport_free_xfer(port, xfer);
+	}
+
 	/* Flush all xfer request related to this port */
 	for_each_online_cpu(c) {
 		nbp = &per_cpu(nbctrl, c);
@@ -500,6 +819,13 @@ static void netswitch_port_remove(struct vmm_netswitch *nsw,
 	if (nsw->port_remove) {
 		nsw->port_remove(nsw, port);
 	}
+
+	/* Sources throttled by this port need not wait anymore */
+	INIT_LIST_HEAD(&parked);
+	vmm_spin_lock_irqsave_lite(&port->switch2port_xfer_lock, f);
+	netswitch_port_release(port, &parked);
+	vmm_spin_unlock_irqrestore_lite(&port->switch2port_xfer_lock, f);
+	netswitch_port_resume(&parked);
 }
 
 int vmm_netswitch_port_remove(struct vmm_netport *port)
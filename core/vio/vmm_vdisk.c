@@ -109,6 +109,12 @@ void vmm_vdisk_set_request_type(struct vmm_vdisk_request *vreq,
 	case VMM_VDISK_REQUEST_WRITE:
 		vreq->r.type = VMM_REQUEST_WRITE;
 		break;
+	case VMM_VDISK_REQUEST_DISCARD:
+		vreq->r.type = VMM_REQUEST_DISCARD;
+		break;
+	case VMM_VDISK_REQUEST_WRITE_ZEROES:
+		vreq->r.type = VMM_REQUEST_WRITE_ZEROES;
+		break;
 	default:
 		vreq->r.type = VMM_REQUEST_UNKNOWN;
 		break;
@@ -131,6 +137,12 @@ enum vmm_vdisk_request_type vmm_vdisk_get_request_type(
 	case VMM_REQUEST_WRITE:
 		type = VMM_VDISK_REQUEST_WRITE;
 		break;
+	case VMM_REQUEST_DISCARD:
+		type = VMM_VDISK_REQUEST_DISCARD;
+		break;
+	case VMM_REQUEST_WRITE_ZEROES:
+		type = VMM_VDISK_REQUEST_WRITE_ZEROES;
+		break;
 	default:
 		type = VMM_VDISK_REQUEST_UNKNOWN;
 		break;
@@ -176,24 +188,38 @@ u32 vmm_vdisk_get_request_len(struct vmm_vdisk_request *vreq)
 }
 VMM_EXPORT_SYMBOL(vmm_vdisk_get_request_len);
 
-int vmm_vdisk_submit_request(struct vmm_vdisk *vdisk,
-			     struct vmm_vdisk_request *vreq,
-			     enum vmm_vdisk_request_type type,
-			     u64 lba, void *data, u32 data_len)
+static int vdisk_submit_request(struct vmm_vdisk *vdisk,
+				struct vmm_vdisk_request *vreq,
+				enum vmm_vdisk_request_type type,
+				u64 lba, void *data,
+				struct scatterlist *sgl, u32 sg_nents,
+				u32 data_len)
 {
 	int rc;
 	irq_flags_t flags;
 
-	if (!vdisk || !vreq || !data) {
+	if (!vdisk || !vreq) {
 		return VMM_EINVALID;
 	}
 	if (data_len < vdisk->block_size) {
 		return VMM_EINVALID;
 	}
-	if ((type < VMM_VDISK_REQUEST_READ) ||
-	    (VMM_VDISK_REQUEST_WRITE < type)) {
+	switch (type) {
+	case VMM_VDISK_REQUEST_READ:
+	case VMM_VDISK_REQUEST_WRITE:
+		if (!data && !sgl) {
+			return VMM_EINVALID;
+		}
+		break;
+	case VMM_VDISK_REQUEST_DISCARD:
+	case VMM_VDISK_REQUEST_WRITE_ZEROES:
+		if (data || sgl) {
+			return VMM_EINVALID;
+		}
+		break;
+	default:
 		return VMM_EINVALID;
-	}
+	};
 
 	vmm_spin_lock_irqsave_lite(&vdisk->blk_lock, flags);
 	if (vdisk->blk) {
@@ -203,6 +229,8 @@ int vmm_vdisk_submit_request(struct vmm_vdisk *vdisk,
 		vreq->r.bcnt =
 			udiv32(data_len, vdisk->block_size) * vdisk->blk_factor;
 		vreq->r.data = data;
+		vreq->r.sgl = sgl;
+		vreq->r.sg_nents = sg_nents;
 		vreq->r.completed = vdisk_req_completed;
 		vreq->r.failed = vdisk_req_failed;
 		vreq->r.priv = NULL;
@@ -213,13 +241,52 @@ int vmm_vdisk_submit_request(struct vmm_vdisk *vdisk,
 	}
 	vmm_spin_unlock_irqrestore_lite(&vdisk->blk_lock, flags);
 
-	DPRINTF("%s: vdisk=%s lba=0x%llx bcnt=%d rc=%d\n",
-		__func__, vdisk->name, (u64)vreq->r.lba, vreq->r.bcnt, rc);
+	DPRINTF("%s: vdisk=%s lba=0x%llx bcnt=%d sg_nents=%d rc=%d\n",
+		__func__, vdisk->name, (u64)vreq->r.lba, vreq->r.bcnt,
+		sg_nents, rc);
 
 	return rc;
 }
+
+int vmm_vdisk_submit_request(struct vmm_vdisk *vdisk,
+			     struct vmm_vdisk_request *vreq,
+			     enum vmm_vdisk_request_type type,
+			     u64 lba, void *data, u32 data_len)
+{
+	if (!data) {
+		return VMM_EINVALID;
+	}
+
+	return vdisk_submit_request(vdisk, vreq, type, lba,
+				    data, NULL, 0, data_len);
+}
 VMM_EXPORT_SYMBOL(vmm_vdisk_submit_request);
 
+int vmm_vdisk_submit_request_sg(struct vmm_vdisk *vdisk,
+				struct vmm_vdisk_request *vreq,
+				enum vmm_vdisk_request_type type,
+				u64 lba, struct scatterlist *sgl,
+				u32 sg_nents, u32 data_len)
+{
+	if (!sgl || !sg_nents) {
+		return VMM_EINVALID;
+	}
+
+	return vdisk_submit_request(vdisk, vreq, type, lba,
+				    NULL, sgl, sg_nents, data_len);
+}
+VMM_EXPORT_SYMBOL(vmm_vdisk_submit_request_sg);
+
+int vmm_vdisk_submit_request_nodata(struct vmm_vdisk *vdisk,
+				    struct vmm_vdisk_request *vreq,
+				    enum vmm_vdisk_request_type type,
+				    u64 lba, u32 data_len)
+{
+	return vdisk_submit_request(vdisk, vreq, type, lba,
+				    NULL, NULL, 0, data_len);
+}
+VMM_EXPORT_SYMBOL(vmm_vdisk_submit_request_nodata);
+
 int vmm_vdisk_abort_request(struct vmm_vdisk *vdisk,
 			    struct vmm_vdisk_request *vreq)
 {
@@ -272,6 +339,40 @@ int vmm_vdisk_flush_cache(struct vmm_vdisk *vdisk)
 }
 VMM_EXPORT_SYMBOL(vmm_vdisk_flush_cache);
 
+void vmm_vdisk_plug(struct vmm_vdisk *vdisk)
+{
+	irq_flags_t flags;
+
+	if (!vdisk) {
+		return;
+	}
+
+	vmm_spin_lock_irqsave_lite(&vdisk->blk_lock, flags);
+	if (vdisk->blk && !vdisk->plug_blk) {
+		vdisk->plug_blk = vdisk->blk;
+		vmm_blockdev_plug(vdisk->plug_blk);
+	}
+	vmm_spin_unlock_irqrestore_lite(&vdisk->blk_lock, flags);
+}
+VMM_EXPORT_SYMBOL(vmm_vdisk_plug);
+
+void vmm_vdisk_unplug(struct vmm_vdisk *vdisk)
+{
+	irq_flags_t flags;
+
+	if (!vdisk) {
+		return;
+	}
+
+	vmm_spin_lock_irqsave_lite(&vdisk->blk_lock, flags);
+	if (vdisk->plug_blk) {
+		vmm_blockdev_unplug(vdisk->plug_blk);
+		vdisk->plug_blk = NULL;
+	}
+	vmm_spin_unlock_irqrestore_lite(&vdisk->blk_lock, flags);
+}
+VMM_EXPORT_SYMBOL(vmm_vdisk_unplug);
+
 u64 vmm_vdisk_capacity(struct vmm_vdisk *vdisk)
 {
 	u64 ret = 0;
@@ -294,6 +395,39 @@ u64 vmm_vdisk_capacity(struct vmm_vdisk *vdisk)
 }
 VMM_EXPORT_SYMBOL(vmm_vdisk_capacity);
 
+static u32 vdisk_max_blocks(struct vmm_vdisk *vdisk, bool discard)
+{
+	u32 ret = 0;
+	irq_flags_t flags;
+
+	if (!vdisk) {
+		return 0;
+	}
+
+	vmm_spin_lock_irqsave_lite(&vdisk->blk_lock, flags);
+	if (vdisk->blk) {
+		ret = (discard) ?
+			vmm_blockdev_max_discard_blocks(vdisk->blk) :
+			vmm_blockdev_max_write_zeroes_blocks(vdisk->blk);
+		ret = udiv32(ret, vdisk->blk_factor);
+	}
+	vmm_spin_unlock_irqrestore_lite(&vdisk->blk_lock, flags);
+
+	return ret;
+}
+
+u32 vmm_vdisk_max_discard_blocks(struct vmm_vdisk *vdisk)
+{
+	return vdisk_max_blocks(vdisk, TRUE);
+}
+VMM_EXPORT_SYMBOL(vmm_vdisk_max_discard_blocks);
+
+u32 vmm_vdisk_max_write_zeroes_blocks(struct vmm_vdisk *vdisk)
+{
+	return vdisk_max_blocks(vdisk, FALSE);
+}
+VMM_EXPORT_SYMBOL(vmm_vdisk_max_write_zeroes_blocks);
+
 int vmm_vdisk_current_block_device(struct vmm_vdisk *vdisk,
 				   char *name, u32 name_len)
 {
@@ -376,6 +510,10 @@ void vmm_vdisk_detach_block_device(struct vmm_vdisk *vdisk)
 
 	detached = FALSE;
 	vmm_spin_lock_irqsave_lite(&vdisk->blk_lock, flags);
+	if (vdisk->plug_blk) {
+		vmm_blockdev_unplug(vdisk->plug_blk);
+		vdisk->plug_blk = NULL;
+	}
 	if (vdisk->blk) {
 		vmm_blockdev_flush_cache(vdisk->blk);
 		detached = TRUE;
@@ -443,6 +581,7 @@ struct vmm_vdisk *vmm_vdisk_create(const char *name, u32 block_size,
 	INIT_SPIN_LOCK(&vdisk->blk_lock);
 	vdisk->blk = NULL;
 	vdisk->blk_factor = 1;
+	vdisk->plug_blk = NULL;
 	vdisk->priv = priv;
 
 	list_add_tail(&vdisk->head, &vdctrl.vdisk_list);
@@ -614,6 +753,9 @@ static int vdisk_blk_notification(struct vmm_notifier_block *nb,
 	/* Find virtual disk using block device */
 	list_for_each_entry(vdisk, &vdctrl.vdisk_list, head) {
 		vmm_spin_lock_irqsave_lite(&vdisk->blk_lock, flags);
+		if (vdisk->plug_blk == e->bdev) {
+			vdisk->plug_blk = NULL;
+		}
 		if (vdisk->blk == e->bdev) {
 			vdisk->blk = NULL;
 			vdisk->blk_factor = 1;
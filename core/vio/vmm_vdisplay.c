@@ -26,9 +26,11 @@
 #include <vmm_heap.h>
 #include <vmm_mutex.h>
 #include <vmm_modules.h>
+#include <vmm_host_aspace.h>
 #include <vmm_guest_aspace.h>
 #include <vio/vmm_vdisplay.h>
 #include <libs/mathlib.h>
+#include <libs/bitops.h>
 #include <libs/stringlib.h>
 
 #define MODULE_DESC			"Virtual Display Framework"
@@ -185,6 +187,126 @@ void vmm_pixelformat_init_different_endian(struct vmm_pixelformat *pf, int bpp)
 }
 VMM_EXPORT_SYMBOL(vmm_pixelformat_init_different_endian);
 
+static void __surface_dirty_free(struct vmm_surface *s)
+{
+	struct vmm_surface_dirty *d = &s->dirty;
+
+	if (d->shadow_va) {
+		vmm_host_free_pages(d->shadow_va, d->shadow_page_count);
+		d->shadow_va = 0x0;
+		d->shadow_page_count = 0;
+	}
+	if (d->row_buf) {
+		vmm_free(d->row_buf);
+		d->row_buf = NULL;
+	}
+	if (d->tracking) {
+		vmm_guest_dirty_range_stop(&d->track);
+		d->tracking = FALSE;
+	}
+	if (d->track_bmap) {
+		vmm_free(d->track_bmap);
+		d->track_bmap = NULL;
+	}
+	d->valid = FALSE;
+}
+
+/* Start dirty tracking of guest framebuffer pages. This is optional
+ * because guest RAM writes are not trapped on every architecture so
+ * rows are read and compared with shadow if this fails.
+ */
+static void __surface_dirty_track(struct vmm_surface *s)
+{
+	struct vmm_surface_dirty *d = &s->dirty;
+
+	if (vmm_guest_dirty_range_start(d->guest, &d->track, d->gphys,
+					(physical_size_t)d->rows *
+					d->src_width)) {
+		return;
+	}
+
+	d->track_bmap = vmm_zalloc(BITS_TO_LONGS(
+				vmm_guest_dirty_range_pages(&d->track)) *
+				sizeof(unsigned long));
+	if (!d->track_bmap) {
+		vmm_guest_dirty_range_stop(&d->track);
+		return;
+	}
+
+	d->tracking = TRUE;
+}
+
+/* Check whether any guest page of given framebuffer row was written */
+static bool __surface_row_written(struct vmm_surface_dirty *d, int row)
+{
+	u32 first, last;
+	physical_addr_t off;
+
+	off = (d->gphys & (VMM_PAGE_SIZE - 1)) +
+	      (physical_addr_t)row * d->src_width;
+	first = off >> VMM_PAGE_SHIFT;
+	last = (off + d->src_width - 1) >> VMM_PAGE_SHIFT;
+
+	return (find_next_bit(d->track_bmap, last + 1, first) <= last) ?
+		TRUE : FALSE;
+}
+
+/* Setup framebuffer shadow for given update parameters and
+ * force full update whenever update parameters change.
+ */
+static int __surface_dirty_prepare(struct vmm_surface *s,
+				   struct vmm_guest *guest,
+				   physical_addr_t gphys,
+				   int cols, int rows, int src_width,
+				   void (*fn)(struct vmm_surface *s,
+					      void *priv, u8 *dst,
+					      const u8 *src,
+					      int width, int dststep),
+				   void *fn_priv)
+{
+	struct vmm_surface_dirty *d = &s->dirty;
+
+	if (d->shadow_va && d->row_buf && (d->guest == guest) &&
+	    (d->gphys == gphys) && (d->cols == cols) &&
+	    (d->rows == rows) && (d->src_width == src_width) &&
+	    (d->fn == fn) && (d->fn_priv == fn_priv)) {
+		return VMM_OK;
+	}
+
+	__surface_dirty_free(s);
+
+	/* Shadow can be few MBs so take it from page allocator */
+	d->shadow_page_count = VMM_SIZE_TO_PAGE((u32)rows * src_width);
+	d->shadow_va = vmm_host_alloc_pages(d->shadow_page_count,
+					    VMM_MEMORY_FLAGS_NORMAL);
+	d->row_buf = vmm_malloc(src_width);
+	if (!d->shadow_va || !d->row_buf) {
+		if (!d->shadow_va) {
+			d->shadow_page_count = 0;
+		}
+		__surface_dirty_free(s);
+		return VMM_ENOMEM;
+	}
+	d->guest = guest;
+	d->gphys = gphys;
+	d->cols = cols;
+	d->rows = rows;
+	d->src_width = src_width;
+	d->fn = fn;
+	d->fn_priv = fn_priv;
+	__surface_dirty_track(s);
+
+	return VMM_OK;
+}
+
+void vmm_surface_invalidate(struct vmm_surface *s)
+{
+	if (s) {
+		s->dirty.valid = FALSE;
+	}
+}
+VMM_EXPORT_SYMBOL(vmm_surface_invalidate);
+
 void vmm_surface_update(struct vmm_surface *s,
 			struct vmm_guest *guest,
 			physical_addr_t src_gphys,
@@ -199,11 +321,10 @@ void vmm_surface_update(struct vmm_surface *s,
 			int *first_row,
 			int *last_row)
 {
-#define CHUNK_SIZE		256
-	u32 len;
-	int i, j;
-	int chunk_len, chunk_cols, chunk_dst_row_pitch;
-	u8 *dst, chunk[CHUNK_SIZE];
+	int i, first, last;
+	bool skip_clean = FALSE;
+	u8 *dst, *row_dst, *shadow;
+	struct vmm_surface_dirty *d;
 
 	/* Sanity check */
 	if (!s || !guest || !first_row || !last_row) {
@@ -225,6 +346,14 @@ void vmm_surface_update(struct vmm_surface *s,
 		return;
 	}
 
+	/* Setup framebuffer shadow */
+	d = &s->dirty;
+	if (__surface_dirty_prepare(s, guest, src_gphys, cols, rows,
+				    src_width, fn, fn_priv)) {
+		*first_row = -1;
+		return;
+	}
+
 	/* Determine dst pointer */
 	dst = vmm_surface_data(s);
 	if (dst_col_pitch < 0) {
@@ -233,37 +362,61 @@ void vmm_surface_update(struct vmm_surface *s,
 	if (dst_row_pitch < 0) {
 		dst -= dst_row_pitch * (rows - 1);
 	}
-	dst += (*first_row) * dst_row_pitch;
 
-	/* Determine src guest physical address */
-	src_gphys += (*first_row) * src_width;
+	/* Fetch framebuffer pages written since last full update. This
+	 * also write-protects them again before we read guest memory so
+	 * later writes are caught by next update. Partial updates leave
+	 * dirty bits for next full update.
+	 */
+	if (d->tracking && (*first_row == 0)) {
+		skip_clean = (!vmm_guest_dirty_range_fetch(&d->track,
+					d->track_bmap, NULL) && d->valid);
+	}
 
-	/* Update surface data in chunks */
+	/* Compare scanlines with shadow and convert only the changed
+	 * ones. Conversion is done from shadow which is cacheable.
+	 * Scanlines in pages not written by Guest are not even read.
+	 */
+	s->stats.updates++;
+	first = -1;
+	last = -1;
 	for (i = *first_row; i < rows; i++) {
-		j = 0;
-		while (j < src_width) {
-			chunk_len = min(src_width - j, CHUNK_SIZE);
-			chunk_cols = sdiv32((chunk_len * cols), src_width);
-			chunk_len = sdiv32((chunk_cols * src_width), cols);
-			chunk_dst_row_pitch =
-				sdiv32((chunk_len * dst_row_pitch), src_width);
-			
-			len = vmm_guest_memory_read(guest, src_gphys,
-						    chunk, chunk_len, FALSE);
-			if (len != chunk_len) {
-				goto next_chunk;
-			}
+		if (skip_clean && !__surface_row_written(d, i)) {
+			s->stats.rows_clean++;
+			s->stats.bytes_skipped += abs(dst_row_pitch);
+			continue;
+		}
+		if (vmm_guest_memory_read(guest,
+				src_gphys + (physical_addr_t)i * src_width,
+				d->row_buf, src_width, FALSE) != src_width) {
+			continue;
+		}
+		s->stats.rows_checked++;
+		s->stats.bytes_read += src_width;
 
-			fn(s, fn_priv, dst, chunk, chunk_cols, dst_col_pitch);
+		shadow = (u8 *)d->shadow_va + i * src_width;
+		if (d->valid && !memcmp(shadow, d->row_buf, src_width)) {
+			s->stats.bytes_skipped += abs(dst_row_pitch);
+			continue;
+		}
+		memcpy(shadow, d->row_buf, src_width);
 
-next_chunk:
-			j += chunk_len;
-			src_gphys += chunk_len;
-			dst += chunk_dst_row_pitch;
+		row_dst = dst + i * dst_row_pitch;
+		fn(s, fn_priv, row_dst, shadow, cols, dst_col_pitch);
+		s->stats.rows_dirty++;
+		s->stats.bytes_converted += abs(dst_row_pitch);
+
+		if (first < 0) {
+			first = i;
 		}
+		last = i;
 	}
 
-	*last_row = i;
+	/* Shadow is valid only if all rows were seen */
+	d->valid = (*first_row == 0) ? TRUE : d->valid;
+
+	*first_row = first;
+	*last_row = last;
 }
 VMM_EXPORT_SYMBOL(vmm_surface_update);
 
@@ -299,6 +452,8 @@ int vmm_surface_init(struct vmm_surface *s,
 #endif
 	memcpy(&s->pf, pf, sizeof(struct vmm_pixelformat));
 	s->ops = ops;
+	memset(&s->dirty, 0, sizeof(s->dirty));
+	memset(&s->stats, 0, sizeof(s->stats));
 	s->priv = NULL;
 
 	return VMM_OK;
@@ -335,6 +490,8 @@ void vmm_surface_free(struct vmm_surface *s)
 	if (!s) {
 		return;
 	}
+	__surface_dirty_free(s);
+
 	if (!(s->flags & VMM_SURFACE_ALLOCED_FLAG)) {
 		return;
 	}
@@ -445,6 +602,8 @@ VMM_EXPORT_SYMBOL(vmm_vdisplay_surface_refresh);
 
 static void __surface_gfx_clear(struct vmm_surface *sf)
 {
+	vmm_surface_invalidate(sf);
+
 	if (sf->ops && sf->ops->gfx_clear) {
 		sf->ops->gfx_clear(sf);
 	}
@@ -512,6 +671,8 @@ static void __surface_gfx_resize(struct vmm_surface *s, int w, int h)
 	w = max(w, 0);
 	h = max(h, 0);
 
+	vmm_surface_invalidate(s);
+
 	if (s->ops && s->ops->gfx_resize) {
 		s->ops->gfx_resize(s, w, h);
 	}
@@ -766,10 +927,39 @@ int vmm_vdisplay_del_surface(struct vmm_vdisplay *vdis,
 
 	vmm_spin_unlock_irqrestore(&vdis->surface_list_lock, flags);
 
+	__surface_dirty_free(sf);
+
 	return VMM_OK;
 }
 VMM_EXPORT_SYMBOL(vmm_vdisplay_del_surface);
 
+int vmm_vdisplay_surface_iterate(struct vmm_vdisplay *vdis, void *data,
+		int (*fn)(struct vmm_vdisplay *vdis,
+			  struct vmm_surface *s, void *data))
+{
+	int rc = VMM_OK;
+	irq_flags_t flags;
+	struct vmm_surface *sf;
+
+	if (!vdis || !fn) {
+		return VMM_EINVALID;
+	}
+
+	vmm_spin_lock_irqsave(&vdis->surface_list_lock, flags);
+
+	list_for_each_entry(sf, &vdis->surface_list, head) {
+		rc = fn(vdis, sf, data);
+		if (rc) {
+			break;
+		}
+	}
+
+	vmm_spin_unlock_irqrestore(&vdis->surface_list_lock, flags);
+
+	return rc;
+}
+VMM_EXPORT_SYMBOL(vmm_vdisplay_surface_iterate);
+
 struct vmm_vdisplay *vmm_vdisplay_create(const char *name,
 					 const struct vmm_vdisplay_ops *ops,
 					 void *priv)
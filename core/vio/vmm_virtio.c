@@ -29,7 +29,10 @@
 #include <vmm_host_io.h>
 #include <vmm_guest_aspace.h>
 #include <vmm_modules.h>
+#include <vmm_trace.h>
+#include <vmm_guest_snapshot.h>
 #include <vio/vmm_virtio.h>
+#include <arch_barrier.h>
 #include <libs/mathlib.h>
 #include <libs/stringlib.h>
 
@@ -154,6 +157,9 @@ u16 vmm_virtio_queue_pop(struct vmm_virtio_queue *vq)
 		return 0;
 	}
 
+	vmm_trace(VMM_TRACE_CAT_VIRTIO, VMM_TRACE_VIRTIO_POP,
+		  val, (virtual_addr_t)vq, 0);
+
 	return val;
 }
 VMM_EXPORT_SYMBOL(vmm_virtio_queue_pop);
@@ -258,6 +264,9 @@ void vmm_virtio_queue_set_used_elem(struct vmm_virtio_queue *vq,
 		return;
 	}
 
+	vmm_trace(VMM_TRACE_CAT_VIRTIO, VMM_TRACE_VIRTIO_PUSH,
+		  head, (virtual_addr_t)vq, len);
+
 	used_idx_pa = vq->vring.used_pa +
 		      offsetof(struct vmm_vring_used, idx);
 	ret = vmm_guest_memory_read(vq->guest, used_idx_pa,
@@ -289,6 +298,79 @@ void vmm_virtio_queue_set_used_elem(struct vmm_virtio_queue *vq,
 }
 VMM_EXPORT_SYMBOL(vmm_virtio_queue_set_used_elem);
 
+void vmm_virtio_queue_add_used(struct vmm_virtio_queue *vq,
+			       u32 head, u32 len)
+{
+	u32 ret;
+	struct vmm_vring_used_elem used_elem;
+	physical_addr_t used_idx_pa, used_elem_pa;
+
+	if (!vq || !vq->guest) {
+		return;
+	}
+
+	vmm_trace(VMM_TRACE_CAT_VIRTIO, VMM_TRACE_VIRTIO_PUSH,
+		  head, (virtual_addr_t)vq, len);
+
+	/* Start of a new batch so read current used index */
+	if (!vq->used_pending) {
+		used_idx_pa = vq->vring.used_pa +
+			      offsetof(struct vmm_vring_used, idx);
+		ret = vmm_guest_memory_read(vq->guest, used_idx_pa,
+					    &vq->used_idx,
+					    sizeof(vq->used_idx), TRUE);
+		if (ret != sizeof(vq->used_idx)) {
+			vmm_printf("%s: read failed at used_idx_pa="
+				   "0x%"PRIPADDR"\n", __func__, used_idx_pa);
+			return;
+		}
+	}
+
+	used_elem.id = head;
+	used_elem.len = len;
+	ret = umod32((u16)(vq->used_idx + vq->used_pending), vq->vring.num);
+	used_elem_pa = vq->vring.used_pa +
+		       offsetof(struct vmm_vring_used, ring[ret]);
+	ret = vmm_guest_memory_write(vq->guest, used_elem_pa,
+				     &used_elem, sizeof(used_elem), TRUE);
+	if (ret != sizeof(used_elem)) {
+		vmm_printf("%s: write failed at used_elem_pa=0x%"PRIPADDR"\n",
+			   __func__, used_elem_pa);
+		return;
+	}
+
+	vq->used_pending++;
+}
+VMM_EXPORT_SYMBOL(vmm_virtio_queue_add_used);
+
+void vmm_virtio_queue_flush_used(struct vmm_virtio_queue *vq)
+{
+	u32 ret;
+	u16 used_idx;
+	physical_addr_t used_idx_pa;
+
+	if (!vq || !vq->guest || !vq->used_pending) {
+		return;
+	}
+
+	used_idx = vq->used_idx + vq->used_pending;
+	vq->used_idx = used_idx;
+	vq->used_pending = 0;
+
+	/* Used elements must be visible before used index */
+	arch_smp_wmb();
+
+	used_idx_pa = vq->vring.used_pa +
+		      offsetof(struct vmm_vring_used, idx);
+	ret = vmm_guest_memory_write(vq->guest, used_idx_pa,
+				     &used_idx, sizeof(used_idx), TRUE);
+	if (ret != sizeof(used_idx)) {
+		vmm_printf("%s: write failed at used_idx_pa=0x%"PRIPADDR"\n",
+			   __func__, used_idx_pa);
+	}
+}
+VMM_EXPORT_SYMBOL(vmm_virtio_queue_flush_used);
+
 bool vmm_virtio_queue_setup_done(struct vmm_virtio_queue *vq)
 {
 	return (vq) ? ((vq->guest) ? TRUE : FALSE) : FALSE;
@@ -303,6 +385,8 @@ int vmm_virtio_queue_cleanup(struct vmm_virtio_queue *vq)
 
 	vq->last_avail_idx = 0;
 	vq->last_used_signalled = 0;
+	vq->used_idx = 0;
+	vq->used_pending = 0;
 
 	vq->guest = NULL;
 
@@ -373,6 +457,98 @@ int vmm_virtio_queue_setup(struct vmm_virtio_queue *vq,
 }
 VMM_EXPORT_SYMBOL(vmm_virtio_queue_setup);
 
+int vmm_virtio_queue_save(struct vmm_virtio_queue *vq,
+			  struct vmm_snapshot_stream *ss)
+{
+	int rc;
+	u32 idx[4];
+
+	if (!vq) {
+		return VMM_EFAIL;
+	}
+
+	if (!vmm_virtio_queue_setup_done(vq)) {
+		return vmm_snapshot_write_u32(ss, 0);
+	}
+
+	idx[0] = vq->last_avail_idx;
+	idx[1] = vq->last_used_signalled;
+	idx[2] = vq->used_idx;
+	idx[3] = vq->used_pending;
+
+	rc = vmm_snapshot_write_u32(ss, 1);
+	if (!rc) {
+		rc = vmm_snapshot_write_u32(ss, vq->desc_count);
+	}
+	if (!rc) {
+		rc = vmm_snapshot_write_u32(ss, vq->align);
+	}
+	if (!rc) {
+		rc = vmm_snapshot_write_u64(ss, vq->guest_pfn);
+	}
+	if (!rc) {
+		rc = vmm_snapshot_write_u64(ss, vq->guest_page_size);
+	}
+	if (!rc) {
+		rc = vmm_snapshot_write(ss, idx, sizeof(idx));
+	}
+
+	return rc;
+}
+VMM_EXPORT_SYMBOL(vmm_virtio_queue_save);
+
+int vmm_virtio_queue_restore(struct vmm_virtio_queue *vq,
+			     struct vmm_guest *guest,
+			     struct vmm_snapshot_stream *ss)
+{
+	int rc;
+	u32 setup_done, desc_count, align, idx[4];
+	u64 guest_pfn, guest_page_size;
+
+	if (!vq || !guest) {
+		return VMM_EFAIL;
+	}
+
+	rc = vmm_snapshot_read_u32(ss, &setup_done);
+	if (rc) {
+		return rc;
+	}
+	if (!setup_done) {
+		return vmm_virtio_queue_cleanup(vq);
+	}
+
+	rc = vmm_snapshot_read_u32(ss, &desc_count);
+	if (!rc) {
+		rc = vmm_snapshot_read_u32(ss, &align);
+	}
+	if (!rc) {
+		rc = vmm_snapshot_read_u64(ss, &guest_pfn);
+	}
+	if (!rc) {
+		rc = vmm_snapshot_read_u64(ss, &guest_page_size);
+	}
+	if (!rc) {
+		rc = vmm_snapshot_read(ss, idx, sizeof(idx));
+	}
+	if (rc) {
+		return rc;
+	}
+
+	rc = vmm_virtio_queue_setup(vq, guest, guest_pfn, guest_page_size,
+				    desc_count, align);
+	if (rc) {
+		return rc;
+	}
+
+	vq->last_avail_idx = idx[0];
+	vq->last_used_signalled = idx[1];
+	vq->used_idx = idx[2];
+	vq->used_pending = idx[3];
+
+	return VMM_OK;
+}
+VMM_EXPORT_SYMBOL(vmm_virtio_queue_restore);
+
 /*
  * Each buffer in the virtqueues is actually a chain of descriptors.  This
  * function returns the next descriptor in the chain, max descriptor count
@@ -688,6 +864,36 @@ int vmm_virtio_reset(struct vmm_virtio_device *dev)
 }
 VMM_EXPORT_SYMBOL(vmm_virtio_reset);
 
+int vmm_virtio_save(struct vmm_virtio_device *dev,
+		    struct vmm_snapshot_stream *ss)
+{
+	if (!dev || !dev->emu) {
+		return VMM_OK;
+	}
+
+	if (!dev->emu->save) {
+		return VMM_ENOTSUPP;
+	}
+
+	return dev->emu->save(dev, ss);
+}
+VMM_EXPORT_SYMBOL(vmm_virtio_save);
+
+int vmm_virtio_restore(struct vmm_virtio_device *dev,
+		       struct vmm_snapshot_stream *ss)
+{
+	if (!dev || !dev->emu) {
+		return VMM_OK;
+	}
+
+	if (!dev->emu->restore) {
+		return VMM_ENOTSUPP;
+	}
+
+	return dev->emu->restore(dev, ss);
+}
+VMM_EXPORT_SYMBOL(vmm_virtio_restore);
+
 int vmm_virtio_register_device(struct vmm_virtio_device *dev)
 {
 	int rc = VMM_OK;
@@ -25,6 +25,7 @@
 #include <vmm_heap.h>
 #include <vmm_modules.h>
 #include <vmm_workqueue.h>
+#include <vmm_guest_aspace.h>
 #include <vio/vmm_vmsg.h>
 #include <libs/idr.h>
 #include <libs/stringlib.h>
@@ -36,6 +37,9 @@
 #define	MODULE_INIT			vmm_vmsg_init
 #define	MODULE_EXIT			vmm_vmsg_exit
 
+/* Size of bounce buffer used for guest to guest message copy */
+#define VMSG_COPY_CHUNK			256
+
 struct vmm_vmsg_control {
 	struct vmm_mutex lock;
 	struct dlist domain_list;
@@ -65,7 +69,7 @@ void vmm_vmsg_ref(struct vmm_vmsg *msg)
 		arch_atomic_add(&msg->ref_count, 1);
 	}
 }
-VMM_EXPORT_SYMBOL(vmm_vmsg_unregister_client);
+VMM_EXPORT_SYMBOL(vmm_vmsg_ref);
 
 void vmm_vmsg_dref(struct vmm_vmsg *msg)
 {
@@ -83,38 +87,212 @@ void vmm_vmsg_dref(struct vmm_vmsg *msg)
 }
 VMM_EXPORT_SYMBOL(vmm_vmsg_dref);
 
+size_t vmm_vmsg_read(struct vmm_vmsg *msg, size_t off,
+		     void *buf, size_t len)
+{
+	if (!msg || !buf || (msg->len <= off)) {
+		return 0;
+	}
+
+	if ((msg->len - off) < len) {
+		len = msg->len - off;
+	}
+
+	if (msg->guest) {
+		return vmm_guest_memory_read(msg->guest, msg->gphys + off,
+					     buf, len, TRUE);
+	}
+
+	memcpy(buf, msg->data + off, len);
+
+	return len;
+}
+VMM_EXPORT_SYMBOL(vmm_vmsg_read);
+
+size_t vmm_vmsg_copy_to_guest(struct vmm_vmsg *msg, size_t off,
+			      struct vmm_guest *guest,
+			      physical_addr_t gphys, size_t len)
+{
+	u8 buf[VMSG_COPY_CHUNK];
+	size_t pos, chunk;
+
+	if (!msg || !guest || (msg->len <= off)) {
+		return 0;
+	}
+
+	if ((msg->len - off) < len) {
+		len = msg->len - off;
+	}
+
+	if (!msg->guest) {
+		return vmm_guest_memory_write(guest, gphys,
+					      msg->data + off, len, TRUE);
+	}
+
+	/* Guest to guest copy goes through a small bounce buffer
+	 * because only one guest page can be host mapped at a time.
+	 */
+	for (pos = 0; pos < len; pos += chunk) {
+		chunk = ((len - pos) < sizeof(buf)) ?
+					(len - pos) : sizeof(buf);
+		chunk = vmm_guest_memory_read(msg->guest,
+					      msg->gphys + off + pos,
+					      buf, chunk, TRUE);
+		if (!chunk) {
+			break;
+		}
+		chunk = vmm_guest_memory_write(guest, gphys + pos,
+					       buf, chunk, TRUE);
+		if (!chunk) {
+			break;
+		}
+	}
+
+	return pos;
+}
+VMM_EXPORT_SYMBOL(vmm_vmsg_copy_to_guest);
+
 static void vmsg_release(struct vmm_vmsg *msg)
 {
-	vmm_free(msg->data);
 	vmm_free(msg);
 }
 
 struct vmm_vmsg *vmm_vmsg_alloc(u32 dst, u32 src, size_t len)
 {
-	void *data;
 	struct vmm_vmsg *msg;
 
 	if (!len) {
 		return NULL;
 	}
 
-	data = vmm_malloc(len);
-	if (!data) {
-		return NULL;
-	}
-
-	msg = vmm_zalloc(sizeof(*msg));
+	/* Message and its data buffer share one allocation */
+	msg = vmm_malloc(sizeof(*msg) + len);
 	if (!msg) {
-		vmm_free(data);
 		return NULL;
 	}
 
-	INIT_VMSG(msg, dst, src, data, len, NULL, vmsg_release);
+	INIT_VMSG(msg, dst, src, &msg[1], len, NULL, vmsg_release);
 
 	return msg;
 }
 VMM_EXPORT_SYMBOL(vmm_vmsg_alloc);
 
+struct vmsg_pool_entry {
+	struct dlist head;
+	struct vmm_vmsg_pool *pool;
+	struct vmm_vmsg msg;
+};
+
+static inline size_t vmsg_pool_entry_size(size_t buf_size)
+{
+	return align(sizeof(struct vmsg_pool_entry) + buf_size,
+		     sizeof(unsigned long));
+}
+
+static void vmsg_pool_dref(struct vmm_vmsg_pool *pool)
+{
+	if (arch_atomic_sub_return(&pool->ref_count, 1)) {
+		return;
+	}
+
+	vmm_free(pool->mem);
+	vmm_free(pool);
+}
+
+static void vmsg_pool_release(struct vmm_vmsg *msg)
+{
+	irq_flags_t flags;
+	struct vmsg_pool_entry *e = msg->priv;
+	struct vmm_vmsg_pool *pool = e->pool;
+
+	vmm_spin_lock_irqsave(&pool->lock, flags);
+	list_add(&e->head, &pool->free_list);
+	vmm_spin_unlock_irqrestore(&pool->lock, flags);
+
+	vmsg_pool_dref(pool);
+}
+
+struct vmm_vmsg_pool *vmm_vmsg_pool_create(u32 count, size_t buf_size)
+{
+	u32 i;
+	size_t esz;
+	struct vmsg_pool_entry *e;
+	struct vmm_vmsg_pool *pool;
+
+	if (!count || !buf_size) {
+		return NULL;
+	}
+
+	pool = vmm_zalloc(sizeof(*pool));
+	if (!pool) {
+		return NULL;
+	}
+
+	esz = vmsg_pool_entry_size(buf_size);
+	pool->mem = vmm_malloc(esz * count);
+	if (!pool->mem) {
+		vmm_free(pool);
+		return NULL;
+	}
+
+	arch_atomic_write(&pool->ref_count, 1);
+	INIT_SPIN_LOCK(&pool->lock);
+	INIT_LIST_HEAD(&pool->free_list);
+	pool->count = count;
+	pool->buf_size = buf_size;
+
+	for (i = 0; i < count; i++) {
+		e = (struct vmsg_pool_entry *)((u8 *)pool->mem + i * esz);
+		INIT_LIST_HEAD(&e->head);
+		e->pool = pool;
+		list_add_tail(&e->head, &pool->free_list);
+	}
+
+	return pool;
+}
+VMM_EXPORT_SYMBOL(vmm_vmsg_pool_create);
+
+void vmm_vmsg_pool_destroy(struct vmm_vmsg_pool *pool)
+{
+	if (pool) {
+		vmsg_pool_dref(pool);
+	}
+}
+VMM_EXPORT_SYMBOL(vmm_vmsg_pool_destroy);
+
+struct vmm_vmsg *vmm_vmsg_pool_alloc(struct vmm_vmsg_pool *pool,
+				     u32 dst, u32 src, size_t len)
+{
+	irq_flags_t flags;
+	struct vmsg_pool_entry *e = NULL;
+
+	if (!len) {
+		return NULL;
+	}
+
+	if (pool && (len <= pool->buf_size)) {
+		vmm_spin_lock_irqsave(&pool->lock, flags);
+		if (!list_empty(&pool->free_list)) {
+			e = list_first_entry(&pool->free_list,
+					     struct vmsg_pool_entry, head);
+			list_del(&e->head);
+		}
+		vmm_spin_unlock_irqrestore(&pool->lock, flags);
+	}
+
+	if (!e) {
+		return vmm_vmsg_alloc(dst, src, len);
+	}
+
+	/* Each in-flight message holds a reference to its pool */
+	arch_atomic_add(&pool->ref_count, 1);
+
+	INIT_VMSG(&e->msg, dst, src, &e[1], len, e, vmsg_pool_release);
+
+	return &e->msg;
+}
+VMM_EXPORT_SYMBOL(vmm_vmsg_pool_alloc);
+
 struct vmsg_work {
 	struct dlist head;
 	struct vmm_vmsg_domain *domain;
@@ -135,13 +313,27 @@ static int vmsg_domain_enqueue_work(struct vmm_vmsg_domain *domain,
 	irq_flags_t flags;
 	struct vmsg_work *work;
 
+	bool was_empty;
+
 	if (!domain) {
 		return VMM_EINVALID;
 	}
 
-	work = vmm_zalloc(sizeof(*work));
+	work = NULL;
+	vmm_spin_lock_irqsave(&domain->work_lock, flags);
+	if (!list_empty(&domain->work_free_list)) {
+		work = list_first_entry(&domain->work_free_list,
+					struct vmsg_work, head);
+		list_del(&work->head);
+		domain->work_free_count--;
+	}
+	vmm_spin_unlock_irqrestore(&domain->work_lock, flags);
+
 	if (!work) {
-		return VMM_ENOMEM;
+		work = vmm_malloc(sizeof(*work));
+		if (!work) {
+			return VMM_ENOMEM;
+		}
 	}
 
 	INIT_LIST_HEAD(&work->head);
@@ -158,16 +350,53 @@ static int vmsg_domain_enqueue_work(struct vmm_vmsg_domain *domain,
 	}
 
 	vmm_spin_lock_irqsave(&domain->work_lock, flags);
+	was_empty = list_empty(&domain->work_list);
 	list_add_tail(&work->head, &domain->work_list);
 	vmm_spin_unlock_irqrestore(&domain->work_lock, flags);
 
-	vmm_completion_complete(&domain->work_avail);
+	/* Worker drains whole work list for each wakeup so we
+	 * only need to wake it up when work list was empty.
+	 */
+	if (was_empty) {
+		vmm_completion_complete(&domain->work_avail);
+	}
 
 	return VMM_OK;
 }
 
+/* Note: Must be called with work_lock held */
+static void vmsg_domain_free_work(struct vmm_vmsg_domain *domain,
+				  struct vmsg_work *work)
+{
+	if (domain->work_free_count < VMM_VMSG_DOMAIN_WORK_CACHE) {
+		list_add(&work->head, &domain->work_free_list);
+		domain->work_free_count++;
+	} else {
+		vmm_free(work);
+	}
+}
+
+static void vmsg_domain_recv_done(struct vmm_vmsg_domain *domain)
+{
+	struct vmm_vmsg_node *node;
+
+	vmm_mutex_lock(&domain->node_lock);
+
+	list_for_each_entry(node, &domain->node_list, domain_head) {
+		if (!node->recv_pending)
+			continue;
+
+		node->recv_pending = FALSE;
+		if (node->ops->recv_done)
+			node->ops->recv_done(node);
+	}
+
+	vmm_mutex_unlock(&domain->node_lock);
+}
+
 static int vmsg_domain_worker_main(void *data)
 {
+	u32 count;
 	irq_flags_t flags;
 	struct vmm_vmsg_domain *vmd = data;
 	struct vmsg_work *work;
@@ -175,28 +404,46 @@ static int vmsg_domain_worker_main(void *data)
 	while (1) {
 		vmm_completion_wait(&vmd->work_avail);
 
-		work = NULL;
-		vmm_spin_lock_irqsave(&vmd->work_lock, flags);
-		if (!list_empty(&vmd->work_list)) {
-			work = list_first_entry(&vmd->work_list,
-						struct vmsg_work, head);
-			list_del(&work->head);
-		}
-		vmm_spin_unlock_irqrestore(&vmd->work_lock, flags);
-		if (!work) {
-			continue;
-		}
+		count = 0;
+		while (1) {
+			work = NULL;
+			vmm_spin_lock_irqsave(&vmd->work_lock, flags);
+			if (!list_empty(&vmd->work_list)) {
+				work = list_first_entry(&vmd->work_list,
+							struct vmsg_work, head);
+				list_del(&work->head);
+			}
+			vmm_spin_unlock_irqrestore(&vmd->work_lock, flags);
+			if (!work) {
+				break;
+			}
 
-		if (work->func) {
-			work->func(work);
+			if (work->func) {
+				work->func(work);
+			}
+
+			if (work->msg) {
+				vmm_vmsg_dref(work->msg);
+				work->msg = NULL;
+			}
+
+			vmm_spin_lock_irqsave(&vmd->work_lock, flags);
+			vmsg_domain_free_work(vmd, work);
+			vmm_spin_unlock_irqrestore(&vmd->work_lock, flags);
+
+			count++;
 		}
 
-		if (work->msg) {
-			vmm_vmsg_dref(work->msg);
-			work->msg = NULL;
+		if (!count) {
+			continue;
 		}
 
-		vmm_free(work);
+		vmm_spin_lock_irqsave(&vmd->work_lock, flags);
+		vmd->work_count += count;
+		vmd->wakeup_count++;
+		vmm_spin_unlock_irqrestore(&vmd->work_lock, flags);
+
+		vmsg_domain_recv_done(vmd);
 	}
 
 	return VMM_OK;
@@ -306,8 +553,12 @@ static void vmsg_node_send_func(struct vmsg_work *work)
 
 		if ((node->addr == msg->dst) ||
 		    (msg->dst == VMM_VMSG_NODE_ADDR_ANY)) {
-			if (node->ops->recv_msg)
+			if (node->ops->recv_msg) {
 				node->ops->recv_msg(node, msg);
+				node->recv_pending = TRUE;
+				node->rx_msgs++;
+				node->rx_bytes += msg->len;
+			}
 		}
 	}
 
@@ -316,7 +567,7 @@ static void vmsg_node_send_func(struct vmsg_work *work)
 
 static int vmsg_node_send(struct vmm_vmsg_node *node, struct vmm_vmsg *msg)
 {
-	if (!node || !msg || !msg->data || !msg->len ||
+	if (!node || !msg || (!msg->data && !msg->guest) || !msg->len ||
 	    (msg->dst == node->addr) ||
 	    (msg->dst == msg->src) ||
 	    (msg->dst < VMM_VMSG_NODE_ADDR_MIN)) {
@@ -370,7 +621,7 @@ static int vmsg_node_stop_work(struct vmm_vmsg_node *node,
 		    (work->data1 == fn) &&
 		    (work->msg == NULL)) {
 			list_del(&work->head);
-			vmm_free(work);
+			vmsg_domain_free_work(domain, work);
 		}
 	}
 
@@ -417,6 +668,10 @@ struct vmm_vmsg_domain *vmm_vmsg_domain_create(const char *name, void *priv)
 	INIT_COMPLETION(&new_vmd->work_avail);
 	INIT_SPIN_LOCK(&new_vmd->work_lock);
 	INIT_LIST_HEAD(&new_vmd->work_list);
+	INIT_LIST_HEAD(&new_vmd->work_free_list);
+	new_vmd->work_free_count = 0;
+	new_vmd->work_count = 0;
+	new_vmd->wakeup_count = 0;
 	INIT_MUTEX(&new_vmd->node_lock);
 	INIT_LIST_HEAD(&new_vmd->node_list);
 
@@ -455,6 +710,7 @@ VMM_EXPORT_SYMBOL(vmm_vmsg_domain_create);
 int vmm_vmsg_domain_destroy(struct vmm_vmsg_domain *domain)
 {
 	bool found;
+	struct vmsg_work *work;
 	struct vmm_vmsg_event event;
 	struct vmm_vmsg_domain *vmd;
 
@@ -491,6 +747,12 @@ int vmm_vmsg_domain_destroy(struct vmm_vmsg_domain *domain)
 
 	list_del(&domain->head);
 	vmm_threads_destroy(domain->worker);
+	while (!list_empty(&domain->work_free_list)) {
+		work = list_first_entry(&domain->work_free_list,
+					struct vmsg_work, head);
+		list_del(&work->head);
+		vmm_free(work);
+	}
 	vmm_free(domain);
 
 	vmm_mutex_unlock(&vmctrl.lock);
@@ -625,6 +887,26 @@ const char *vmm_vmsg_domain_get_name(struct vmm_vmsg_domain *domain)
 }
 VMM_EXPORT_SYMBOL(vmm_vmsg_domain_get_name);
 
+void vmm_vmsg_domain_get_stats(struct vmm_vmsg_domain *domain,
+			       u64 *work_count, u64 *wakeup_count)
+{
+	irq_flags_t flags;
+
+	if (!domain) {
+		return;
+	}
+
+	vmm_spin_lock_irqsave(&domain->work_lock, flags);
+	if (work_count) {
+		*work_count = domain->work_count;
+	}
+	if (wakeup_count) {
+		*wakeup_count = domain->wakeup_count;
+	}
+	vmm_spin_unlock_irqrestore(&domain->work_lock, flags);
+}
+VMM_EXPORT_SYMBOL(vmm_vmsg_domain_get_stats);
+
 struct vmm_vmsg_node *vmm_vmsg_node_create(const char *name, u32 addr,
 				struct vmm_vmsg_node_ops *ops,
 				struct vmm_vmsg_domain *domain,
@@ -674,8 +956,17 @@ struct vmm_vmsg_node *vmm_vmsg_node_create(const char *name, u32 addr,
 		return NULL;
 	}
 
+	new_vmn->pool = vmm_vmsg_pool_create(VMM_VMSG_NODE_POOL_COUNT,
+					     VMM_VMSG_NODE_POOL_BUF_SIZE);
+	if (!new_vmn->pool) {
+		vmm_free(new_vmn);
+		vmm_mutex_unlock(&vmctrl.lock);
+		return NULL;
+	}
+
 	a = ida_simple_get(&vmctrl.node_ida, id_min, id_max, 0);
 	if (a < 0) {
+		vmm_vmsg_pool_destroy(new_vmn->pool);
 		vmm_free(new_vmn);
 		vmm_mutex_unlock(&vmctrl.lock);
 		return NULL;
@@ -687,6 +978,7 @@ struct vmm_vmsg_node *vmm_vmsg_node_create(const char *name, u32 addr,
 	strncpy(new_vmn->name, name, sizeof(new_vmn->name));
 	new_vmn->priv = priv;
 	arch_atomic_write(&new_vmn->is_ready, 0);
+	new_vmn->recv_pending = FALSE;
 	new_vmn->domain = domain;
 	new_vmn->ops = ops;
 
@@ -738,6 +1030,7 @@ int vmm_vmsg_node_destroy(struct vmm_vmsg_node *node)
 
 	ida_simple_remove(&vmctrl.node_ida, node->addr);
 
+	vmm_vmsg_pool_destroy(node->pool);
 	vmm_free(node);
 
 	vmm_mutex_unlock(&vmctrl.lock);
@@ -910,6 +1203,25 @@ struct vmm_vmsg_domain *vmm_vmsg_node_get_domain(struct vmm_vmsg_node *node)
 }
 VMM_EXPORT_SYMBOL(vmm_vmsg_node_get_domain);
 
+void vmm_vmsg_node_get_stats(struct vmm_vmsg_node *node,
+			     u64 *rx_msgs, u64 *rx_bytes)
+{
+	if (!node) {
+		return;
+	}
+
+	/* Stats are updated by domain worker with node_lock held */
+	vmm_mutex_lock(&node->domain->node_lock);
+	if (rx_msgs) {
+		*rx_msgs = node->rx_msgs;
+	}
+	if (rx_bytes) {
+		*rx_bytes = node->rx_bytes;
+	}
+	vmm_mutex_unlock(&node->domain->node_lock);
+}
+VMM_EXPORT_SYMBOL(vmm_vmsg_node_get_stats);
+
 static int __init vmm_vmsg_init(void)
 {
 	memset(&vmctrl, 0, sizeof(vmctrl));
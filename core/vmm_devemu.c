@@ -135,6 +135,8 @@ static int devemu_doread(struct vmm_emudev *edev,
 		return VMM_EFAIL;
 	}
 
+	arch_atomic64_add(&edev->read_count, 1);
+
 	switch (dst_len) {
 	case 1:
 		if (edev->emu->read8) {
@@ -292,6 +294,8 @@ static int devemu_dowrite(struct vmm_emudev *edev,
 		return VMM_EFAIL;
 	}
 
+	arch_atomic64_add(&edev->write_count, 1);
+
 	switch (src_len) {
 	case 1:		
 		if (edev->emu->write8) {
@@ -891,6 +895,20 @@ int vmm_devemu_simple_write32(struct vmm_emudev *edev,
 	return edev->emu->write_simple(edev, offset, 0x00000000, src, sizeof(u32));
 }
 
+int vmm_devemu_stateless_save(struct vmm_emudev *edev,
+			      struct vmm_snapshot_stream *ss)
+{
+	/* Nothing to save. */
+	return VMM_OK;
+}
+
+int vmm_devemu_stateless_restore(struct vmm_emudev *edev,
+				 struct vmm_snapshot_stream *ss)
+{
+	/* Nothing to restore. */
+	return VMM_OK;
+}
+
 int vmm_devemu_unregister_emulator(struct vmm_emulator *emu)
 {
 	bool found;
@@ -1125,6 +1143,77 @@ int vmm_devemu_reset_region(struct vmm_guest *guest,
 	return devemu_reset_edev(guest, edev);
 }
 
+static int devemu_snapshot_edev(struct vmm_guest *guest,
+				struct vmm_emudev *edev,
+				struct vmm_snapshot_stream *ss,
+				bool save)
+{
+	irq_flags_t f;
+	int rc = VMM_OK;
+	struct vmm_emudev *e, *en;
+
+	if (save && edev->emu->save) {
+		rc = edev->emu->save(edev, ss);
+	} else if (!save && edev->emu->restore) {
+		rc = edev->emu->restore(edev, ss);
+	} else {
+		rc = VMM_ENOTSUPP;
+	}
+	if (rc) {
+		vmm_printf("%s: %s/%s (%s) %s error %d\n",
+			   __func__, guest->name, edev->node->name,
+			   edev->emu->name, (save) ? "save" : "restore", rc);
+		return rc;
+	}
+
+	vmm_read_lock_irqsave_lite(&edev->child_list_lock, f);
+
+	list_for_each_entry_safe(e, en, &edev->child_list, head) {
+		vmm_read_unlock_irqrestore_lite(&edev->child_list_lock, f);
+		rc = devemu_snapshot_edev(guest, e, ss, save);
+		if (rc) {
+			return rc;
+		}
+		vmm_read_lock_irqsave_lite(&edev->child_list_lock, f);
+	}
+
+	vmm_read_unlock_irqrestore_lite(&edev->child_list_lock, f);
+
+	return VMM_OK;
+}
+
+int vmm_devemu_save_region(struct vmm_guest *guest,
+			   struct vmm_region *reg,
+			   struct vmm_snapshot_stream *ss)
+{
+	if (!guest || !reg || !reg->devemu_priv || !ss) {
+		return VMM_EFAIL;
+	}
+
+	if (!(reg->flags & VMM_REGION_ISDEVICE) ||
+	    (reg->flags & VMM_REGION_ALIAS)) {
+		return VMM_EINVALID;
+	}
+
+	return devemu_snapshot_edev(guest, reg->devemu_priv, ss, TRUE);
+}
+
+int vmm_devemu_restore_region(struct vmm_guest *guest,
+			      struct vmm_region *reg,
+			      struct vmm_snapshot_stream *ss)
+{
+	if (!guest || !reg || !reg->devemu_priv || !ss) {
+		return VMM_EFAIL;
+	}
+
+	if (!(reg->flags & VMM_REGION_ISDEVICE) ||
+	    (reg->flags & VMM_REGION_ALIAS)) {
+		return VMM_EINVALID;
+	}
+
+	return devemu_snapshot_edev(guest, reg->devemu_priv, ss, FALSE);
+}
+
 static int devemu_remove_edev(struct vmm_guest *guest,
 			      struct vmm_emudev *edev)
 {
@@ -1273,6 +1362,8 @@ static struct vmm_emudev *devemu_probe_edev(struct vmm_guest *guest,
 		INIT_RW_LOCK(&edev->child_list_lock);
 		INIT_LIST_HEAD(&edev->child_list);
 		edev->priv = NULL;
+		ARCH_ATOMIC64_INIT(&edev->read_count, 0);
+		ARCH_ATOMIC64_INIT(&edev->write_count, 0);
 		set_debug_info(edev);
 
 		debug_probe(edev);
@@ -34,9 +34,20 @@
 #include <vmm_guest_aspace.h>
 #include <vmm_stdio.h>
 #include <vmm_notifier.h>
+#include <vmm_timer.h>
 #include <arch_guest.h>
 #include <libs/stringlib.h>
 #include <libs/mathlib.h>
+#include <libs/bitmap.h>
+
+/* Naturally aligned host RAM chunk orders tried for huge page regions */
+#define REGION_HUGE_ORDER_1G		30
+#define REGION_HUGE_ORDER_2M		21
+
+static const u32 region_huge_orders[] = {
+	REGION_HUGE_ORDER_1G,
+	REGION_HUGE_ORDER_2M,
+};
 
 static BLOCKING_NOTIFIER_CHAIN(guest_aspace_notifier_chain);
 
@@ -256,6 +267,20 @@ void vmm_guest_find_mapping(struct vmm_guest *guest,
 	hphys = map->hphys_addr + (gphys_addr - map_gphys_addr);
 	size = map->hphys_addr + mapping_phys_size(reg, i) - hphys;
 
+	/*
+	 * Mapping is part of a bigger naturally aligned host RAM
+	 * chunk so report availability till the end of chunk.
+	 */
+	if (reg->map_order < map->contig_order) {
+		map_gphys_addr = gphys_addr &
+			~(((physical_addr_t)1 << map->contig_order) - 1);
+		hphys = map->hphys_addr &
+			~(((physical_addr_t)1 << map->contig_order) - 1);
+		hphys += gphys_addr - map_gphys_addr;
+		size = ((physical_size_t)1 << map->contig_order) -
+			(gphys_addr - map_gphys_addr);
+	}
+
 done:
 	if (hphys_addr) {
 		*hphys_addr = hphys;
@@ -290,6 +315,503 @@ void vmm_guest_iterate_mapping(struct vmm_guest *guest,
 	}
 }
 
+static physical_size_t block_usage_span(physical_addr_t gphys_addr,
+					physical_addr_t hphys_addr,
+					physical_size_t phys_size,
+					u32 block_order)
+{
+	physical_addr_t start, end;
+	physical_size_t block_size = (physical_size_t)1 << block_order;
+
+	if ((gphys_addr ^ hphys_addr) & (block_size - 1)) {
+		return 0;
+	}
+
+	start = roundup2_order_size(gphys_addr, block_order);
+	end = (gphys_addr + phys_size) & ~((physical_addr_t)block_size - 1);
+
+	return (start < end) ? (end - start) : 0;
+}
+
+static void block_usage_iter(struct vmm_guest *guest,
+			     struct vmm_region *reg,
+			     void *priv)
+{
+	u32 i, j;
+	physical_size_t span, sz_1g, sz_2m;
+	physical_addr_t gphys, hphys;
+	struct vmm_guest_ram_blocks *blks = priv;
+
+	if (reg->flags & (VMM_REGION_ALIAS | VMM_REGION_VIRTUAL) ||
+	    !(reg->flags & (VMM_REGION_ISRAM | VMM_REGION_ISROM))) {
+		return;
+	}
+
+	/* Process runs of host physically contiguous mappings */
+	for (i = 0; i < reg->maps_count; i = j) {
+		gphys = reg->gphys_addr + mapping_gphys_offset(reg, i);
+		hphys = reg->maps[i].hphys_addr;
+		span = mapping_phys_size(reg, i);
+		for (j = i + 1; j < reg->maps_count; j++) {
+			if (reg->maps[j].hphys_addr != (hphys + span))
+				break;
+			span += mapping_phys_size(reg, j);
+		}
+
+		sz_1g = block_usage_span(gphys, hphys, span,
+					 REGION_HUGE_ORDER_1G);
+		sz_2m = block_usage_span(gphys, hphys, span,
+					 REGION_HUGE_ORDER_2M) - sz_1g;
+		blks->size_1g += sz_1g;
+		blks->size_2m += sz_2m;
+		blks->size_page += span - sz_1g - sz_2m;
+	}
+}
+
+void vmm_guest_ram_block_usage(struct vmm_guest *guest,
+			       struct vmm_guest_ram_blocks *blks)
+{
+	if (!blks) {
+		return;
+	}
+
+	blks->size_1g = 0;
+	blks->size_2m = 0;
+	blks->size_page = 0;
+
+	vmm_guest_iterate_region(guest, VMM_REGION_MEMORY,
+				 block_usage_iter, blks);
+}
+
+static bool is_region_dirty_loggable(struct vmm_region *reg)
+{
+	if ((reg->flags & VMM_REGION_MANIFEST_MASK) != VMM_REGION_REAL) {
+		return FALSE;
+	}
+	if (!(reg->flags & VMM_REGION_MEMORY) ||
+	    !(reg->flags & VMM_REGION_ISRAM) ||
+	    (reg->flags & VMM_REGION_READONLY)) {
+		return FALSE;
+	}
+
+	return (reg->phys_size >= VMM_PAGE_SIZE) ? TRUE : FALSE;
+}
+
+static void dirty_log_start_iter(struct vmm_guest *guest,
+				 struct vmm_region *reg,
+				 void *priv)
+{
+	int *rc = priv;
+	irq_flags_t flags;
+	unsigned long *bmap;
+	struct vmm_guest_aspace *aspace = &guest->aspace;
+
+	if (*rc || !is_region_dirty_loggable(reg)) {
+		return;
+	}
+
+	bmap = vmm_zalloc(BITS_TO_LONGS(vmm_guest_dirty_log_pages(reg)) *
+			  sizeof(unsigned long));
+	if (!bmap) {
+		*rc = VMM_ENOMEM;
+		return;
+	}
+
+	vmm_spin_lock_irqsave_lite(&aspace->dirty_lock, flags);
+	if (!reg->dirty_bmap) {
+		reg->dirty_bmap = bmap;
+		bmap = NULL;
+	}
+	vmm_spin_unlock_irqrestore_lite(&aspace->dirty_lock, flags);
+
+	if (bmap) {
+		vmm_free(bmap);
+	}
+
+	/* Write faults are recorded from now so write-protect region */
+	*rc = arch_guest_wrprotect_range(guest, VMM_REGION_GPHYS_START(reg),
+					 VMM_REGION_PHYS_SIZE(reg));
+}
+
+static void dirty_log_stop_iter(struct vmm_guest *guest,
+				struct vmm_region *reg,
+				void *priv)
+{
+	irq_flags_t flags;
+	unsigned long *bmap;
+	struct vmm_guest_aspace *aspace = &guest->aspace;
+
+	vmm_spin_lock_irqsave_lite(&aspace->dirty_lock, flags);
+	bmap = reg->dirty_bmap;
+	reg->dirty_bmap = NULL;
+	vmm_spin_unlock_irqrestore_lite(&aspace->dirty_lock, flags);
+
+	if (bmap) {
+		vmm_free(bmap);
+	}
+}
+
+int vmm_guest_dirty_log_start(struct vmm_guest *guest)
+{
+	int rc = VMM_OK;
+	irq_flags_t flags;
+	struct vmm_guest_aspace *aspace;
+
+	if (!guest) {
+		return VMM_EFAIL;
+	}
+	aspace = &guest->aspace;
+
+	vmm_spin_lock_irqsave_lite(&aspace->dirty_lock, flags);
+	if (aspace->dirty_log) {
+		vmm_spin_unlock_irqrestore_lite(&aspace->dirty_lock, flags);
+		return VMM_EALREADY;
+	}
+	aspace->dirty_log = TRUE;
+	aspace->dirty_log_tstamp = vmm_timer_timestamp();
+	aspace->dirty_faults = 0;
+	aspace->dirty_fault_nsecs = 0;
+	vmm_spin_unlock_irqrestore_lite(&aspace->dirty_lock, flags);
+
+	vmm_guest_iterate_region(guest, VMM_REGION_MEMORY,
+				 dirty_log_start_iter, &rc);
+	if (rc) {
+		vmm_guest_dirty_log_stop(guest);
+	}
+
+	return rc;
+}
+
+int vmm_guest_dirty_log_stop(struct vmm_guest *guest)
+{
+	irq_flags_t flags;
+	struct vmm_guest_aspace *aspace;
+
+	if (!guest) {
+		return VMM_EFAIL;
+	}
+	aspace = &guest->aspace;
+
+	vmm_spin_lock_irqsave_lite(&aspace->dirty_lock, flags);
+	if (!aspace->dirty_log) {
+		vmm_spin_unlock_irqrestore_lite(&aspace->dirty_lock, flags);
+		return VMM_EINVALID;
+	}
+	aspace->dirty_log = FALSE;
+	vmm_spin_unlock_irqrestore_lite(&aspace->dirty_lock, flags);
+
+	/*
+	 * Stage2 mappings are left write-protected. The arch code
+	 * restores write access lazily upon next write fault.
+	 */
+	vmm_guest_iterate_region(guest, VMM_REGION_MEMORY,
+				 dirty_log_stop_iter, NULL);
+
+	return VMM_OK;
+}
+
+int vmm_guest_dirty_log_fetch(struct vmm_guest *guest,
+			      struct vmm_region *reg,
+			      unsigned long *bmap, bool clear,
+			      u32 *dirty_pages)
+{
+	int rc = VMM_OK;
+	u32 pages, count;
+	irq_flags_t flags;
+	struct vmm_guest_aspace *aspace;
+
+	if (!guest || !reg || (reg->aspace != &guest->aspace)) {
+		return VMM_EINVALID;
+	}
+	aspace = &guest->aspace;
+	pages = vmm_guest_dirty_log_pages(reg);
+
+	vmm_spin_lock_irqsave_lite(&aspace->dirty_lock, flags);
+	if (!reg->dirty_bmap) {
+		vmm_spin_unlock_irqrestore_lite(&aspace->dirty_lock, flags);
+		return VMM_ENOENT;
+	}
+	if (bmap) {
+		bitmap_copy(bmap, reg->dirty_bmap, pages);
+	}
+	count = bitmap_weight(reg->dirty_bmap, pages);
+	if (clear) {
+		bitmap_zero(reg->dirty_bmap, pages);
+	}
+	vmm_spin_unlock_irqrestore_lite(&aspace->dirty_lock, flags);
+
+	/*
+	 * Only dirty pages have write access in stage2 so write-protect
+	 * them again after clearing. Writes done between clearing and
+	 * write-protecting are to pages already reported as dirty. The
+	 * arch code marks a page again after giving it write access so
+	 * a page made writable concurrently is not lost from the log.
+	 */
+	if (clear && count) {
+		rc = arch_guest_wrprotect_range(guest,
+						VMM_REGION_GPHYS_START(reg),
+						VMM_REGION_PHYS_SIZE(reg));
+	}
+
+	if (dirty_pages) {
+		*dirty_pages = count;
+	}
+
+	return rc;
+}
+
+int vmm_guest_dirty_log_page(struct vmm_guest *guest,
+			     physical_addr_t gphys_addr,
+			     bool mark, bool *dirty)
+{
+	u32 page, rpage;
+	irq_flags_t flags;
+	bool tracked = FALSE, all_dirty = TRUE;
+	struct vmm_region *reg;
+	struct vmm_guest_dirty_range *dr;
+	struct vmm_guest_aspace *aspace;
+
+	if (!guest) {
+		return VMM_EFAIL;
+	}
+	aspace = &guest->aspace;
+
+	if (!aspace->dirty_log && list_empty(&aspace->dirty_ranges)) {
+		return VMM_ENOENT;
+	}
+
+	reg = vmm_guest_find_region(guest, gphys_addr,
+				    VMM_REGION_MEMORY, FALSE);
+	while (reg && (reg->flags & VMM_REGION_ALIAS)) {
+		gphys_addr = VMM_REGION_GPHYS_TO_APHYS(reg, gphys_addr);
+		reg = vmm_guest_find_region(guest, gphys_addr,
+					    VMM_REGION_MEMORY, FALSE);
+	}
+	if (!reg) {
+		return VMM_ENOENT;
+	}
+	page = (gphys_addr - reg->gphys_addr) >> VMM_PAGE_SHIFT;
+
+	vmm_spin_lock_irqsave_lite(&aspace->dirty_lock, flags);
+	if (reg->dirty_bmap && (page < vmm_guest_dirty_log_pages(reg))) {
+		tracked = TRUE;
+		if (mark) {
+			__set_bit(page, reg->dirty_bmap);
+		}
+		if (!test_bit(page, reg->dirty_bmap)) {
+			all_dirty = FALSE;
+		}
+	}
+	list_for_each_entry(dr, &aspace->dirty_ranges, head) {
+		if ((dr->reg != reg) || (page < dr->first_page) ||
+		    ((dr->first_page + dr->pages) <= page)) {
+			continue;
+		}
+		tracked = TRUE;
+		rpage = page - dr->first_page;
+		if (mark) {
+			__set_bit(rpage, dr->bmap);
+		}
+		if (!test_bit(rpage, dr->bmap)) {
+			all_dirty = FALSE;
+		}
+	}
+	vmm_spin_unlock_irqrestore_lite(&aspace->dirty_lock, flags);
+
+	if (!tracked) {
+		return VMM_ENOENT;
+	}
+	if (dirty) {
+		*dirty = all_dirty;
+	}
+
+	return VMM_OK;
+}
+
+void vmm_guest_dirty_log_account(struct vmm_guest *guest, u64 fault_nsecs)
+{
+	irq_flags_t flags;
+	struct vmm_guest_aspace *aspace;
+
+	if (!guest) {
+		return;
+	}
+	aspace = &guest->aspace;
+
+	vmm_spin_lock_irqsave_lite(&aspace->dirty_lock, flags);
+	if (aspace->dirty_log) {
+		aspace->dirty_faults++;
+		aspace->dirty_fault_nsecs += fault_nsecs;
+	}
+	vmm_spin_unlock_irqrestore_lite(&aspace->dirty_lock, flags);
+}
+
+int vmm_guest_dirty_log_stats(struct vmm_guest *guest,
+			      struct vmm_guest_dirty_log_stats *stats)
+{
+	irq_flags_t flags;
+	struct vmm_guest_aspace *aspace;
+
+	if (!guest || !stats) {
+		return VMM_EFAIL;
+	}
+	aspace = &guest->aspace;
+
+	vmm_spin_lock_irqsave_lite(&aspace->dirty_lock, flags);
+	stats->enabled = aspace->dirty_log;
+	stats->elapsed_nsecs = (aspace->dirty_log) ?
+		vmm_timer_timestamp() - aspace->dirty_log_tstamp : 0;
+	stats->faults = aspace->dirty_faults;
+	stats->fault_nsecs = aspace->dirty_fault_nsecs;
+	vmm_spin_unlock_irqrestore_lite(&aspace->dirty_lock, flags);
+
+	return VMM_OK;
+}
+
+int vmm_guest_dirty_range_start(struct vmm_guest *guest,
+				struct vmm_guest_dirty_range *dr,
+				physical_addr_t gphys_addr,
+				physical_size_t size)
+{
+	int rc;
+	u32 first, last;
+	irq_flags_t flags;
+	struct vmm_region *reg;
+	struct vmm_guest_aspace *aspace;
+
+	if (!guest || !dr || !size) {
+		return VMM_EINVALID;
+	}
+	aspace = &guest->aspace;
+
+	reg = vmm_guest_find_region(guest, gphys_addr,
+				    VMM_REGION_MEMORY, FALSE);
+	while (reg && (reg->flags & VMM_REGION_ALIAS)) {
+		gphys_addr = VMM_REGION_GPHYS_TO_APHYS(reg, gphys_addr);
+		reg = vmm_guest_find_region(guest, gphys_addr,
+					    VMM_REGION_MEMORY, FALSE);
+	}
+	if (!reg || !is_region_dirty_loggable(reg)) {
+		return VMM_ENOTSUPP;
+	}
+	if ((VMM_REGION_GPHYS_END(reg) - gphys_addr) < size) {
+		return VMM_EINVALID;
+	}
+
+	first = (gphys_addr - reg->gphys_addr) >> VMM_PAGE_SHIFT;
+	last = (gphys_addr + size - 1 - reg->gphys_addr) >> VMM_PAGE_SHIFT;
+
+	dr->guest = guest;
+	dr->first_page = first;
+	dr->pages = last - first + 1;
+	dr->bmap = vmm_zalloc(BITS_TO_LONGS(dr->pages) *
+			      sizeof(unsigned long));
+	if (!dr->bmap) {
+		dr->guest = NULL;
+		return VMM_ENOMEM;
+	}
+
+	vmm_spin_lock_irqsave_lite(&aspace->dirty_lock, flags);
+	dr->reg = reg;
+	list_add_tail(&dr->head, &aspace->dirty_ranges);
+	vmm_spin_unlock_irqrestore_lite(&aspace->dirty_lock, flags);
+
+	/* Write faults are recorded from now so write-protect range */
+	gphys_addr = reg->gphys_addr +
+		     ((physical_addr_t)first << VMM_PAGE_SHIFT);
+	rc = arch_guest_wrprotect_range(guest, gphys_addr,
+			(physical_size_t)dr->pages << VMM_PAGE_SHIFT);
+	if (rc) {
+		vmm_guest_dirty_range_stop(dr);
+	}
+
+	return rc;
+}
+
+void vmm_guest_dirty_range_stop(struct vmm_guest_dirty_range *dr)
+{
+	irq_flags_t flags;
+	struct vmm_guest_aspace *aspace;
+
+	if (!dr || !dr->guest) {
+		return;
+	}
+	aspace = &dr->guest->aspace;
+
+	/*
+	 * Range is already detached if its region was deleted.
+	 * Stage2 mappings are left write-protected. The arch code
+	 * restores write access lazily upon next write fault.
+	 */
+	vmm_spin_lock_irqsave_lite(&aspace->dirty_lock, flags);
+	if (dr->reg) {
+		list_del(&dr->head);
+		dr->reg = NULL;
+	}
+	vmm_spin_unlock_irqrestore_lite(&aspace->dirty_lock, flags);
+
+	vmm_free(dr->bmap);
+	dr->bmap = NULL;
+	dr->guest = NULL;
+}
+
+int vmm_guest_dirty_range_fetch(struct vmm_guest_dirty_range *dr,
+				unsigned long *bmap, u32 *dirty_pages)
+{
+	int rc = VMM_OK;
+	u32 count;
+	irq_flags_t flags;
+	physical_addr_t gphys_addr;
+	struct vmm_guest_aspace *aspace;
+
+	if (!dr || !dr->guest) {
+		return VMM_EINVALID;
+	}
+	aspace = &dr->guest->aspace;
+
+	vmm_spin_lock_irqsave_lite(&aspace->dirty_lock, flags);
+	if (!dr->reg) {
+		vmm_spin_unlock_irqrestore_lite(&aspace->dirty_lock, flags);
+		return VMM_ENOENT;
+	}
+	gphys_addr = dr->reg->gphys_addr +
+		     ((physical_addr_t)dr->first_page << VMM_PAGE_SHIFT);
+	if (bmap) {
+		bitmap_copy(bmap, dr->bmap, dr->pages);
+	}
+	count = bitmap_weight(dr->bmap, dr->pages);
+	bitmap_zero(dr->bmap, dr->pages);
+	vmm_spin_unlock_irqrestore_lite(&aspace->dirty_lock, flags);
+
+	/* Same as vmm_guest_dirty_log_fetch() but only for the range */
+	if (count) {
+		rc = arch_guest_wrprotect_range(dr->guest, gphys_addr,
+				(physical_size_t)dr->pages << VMM_PAGE_SHIFT);
+	}
+
+	if (dirty_pages) {
+		*dirty_pages = count;
+	}
+
+	return rc;
+}
+
+static void dirty_log_mark_range(struct vmm_guest *guest,
+				 physical_addr_t gphys_addr, u32 len)
+{
+	physical_addr_t end = gphys_addr + len;
+
+	if (!guest->aspace.dirty_log &&
+	    list_empty(&guest->aspace.dirty_ranges)) {
+		return;
+	}
+
+	gphys_addr &= ~((physical_addr_t)VMM_PAGE_SIZE - 1);
+	for (; gphys_addr < end; gphys_addr += VMM_PAGE_SIZE) {
+		vmm_guest_dirty_log_page(guest, gphys_addr, TRUE, NULL);
+	}
+}
+
 int vmm_guest_overwrite_real_device_mapping(struct vmm_guest *guest,
 					    struct vmm_region *reg,
 					    physical_addr_t gphys_addr,
@@ -387,6 +909,9 @@ u32 vmm_guest_memory_write(struct vmm_guest *guest,
 			break;
 		}
 
+		/* Hypervisor writes bypass stage2 so log them here */
+		dirty_log_mark_range(guest, gphys_addr, to_write);
+
 		gphys_addr += to_write;
 		bytes_written += to_write;
 		src += to_write;
@@ -676,6 +1201,66 @@ static void region_overlap_message(const char *func,
 		   reg_overlap->gphys_addr, overlap_reg_size);
 }
 
+static int region_alloc_huge_ram(struct vmm_guest *guest,
+				 struct vmm_region *reg)
+{
+	u32 i, j, o, count, order, fallback_order;
+	physical_addr_t gphys, hphys;
+	physical_size_t sz;
+
+	fallback_order = (VMM_PAGE_SHIFT <= reg->align_order) ?
+			 reg->align_order : VMM_PAGE_SHIFT;
+
+	for (i = 0; i < reg->maps_count; i += count) {
+		gphys = reg->gphys_addr + mapping_gphys_offset(reg, i);
+
+		/*
+		 * Try biggest naturally aligned chunk first. The guest
+		 * physical address must have same alignment otherwise
+		 * stage2 can never use a block mapping for it.
+		 */
+		for (o = 0; o < array_size(region_huge_orders); o++) {
+			order = region_huge_orders[o];
+			sz = (physical_size_t)1 << order;
+			if (order < reg->map_order) {
+				continue;
+			}
+			if (gphys & (sz - 1)) {
+				continue;
+			}
+			if ((VMM_REGION_GPHYS_END(reg) - gphys) < sz) {
+				continue;
+			}
+			if (vmm_host_ram_alloc(&hphys, sz, order)) {
+				break;
+			}
+		}
+
+		/* Fallback to one mapping with region align_order */
+		if (o == array_size(region_huge_orders)) {
+			order = 0;
+			sz = mapping_phys_size(reg, i);
+			if (!vmm_host_ram_alloc(&hphys, sz, fallback_order)) {
+				return VMM_ENOMEM;
+			}
+		}
+
+		count = 0;
+		for (j = i; (j < reg->maps_count) &&
+			    (mapping_gphys_offset(reg, j) <
+			     (mapping_gphys_offset(reg, i) + sz)); j++) {
+			reg->maps[j].hphys_addr = hphys +
+				(mapping_gphys_offset(reg, j) -
+				 mapping_gphys_offset(reg, i));
+			reg->maps[j].contig_order = order;
+			reg->maps[j].flags |= VMM_REGION_MAPPING_ISHOSTRAM;
+			count++;
+		}
+	}
+
+	return VMM_OK;
+}
+
 static int region_add(struct vmm_guest *guest,
 		      struct vmm_devtree_node *rnode,
 		      struct vmm_region **new_reg,
@@ -914,6 +1499,21 @@ static int region_add(struct vmm_guest *guest,
 		}
 	}
 
+	/*
+	 * Overwrite mapping order for huge page backed alloced RAM
+	 * regions so that each mapping can be backed by a 2MB chunk
+	 * and consecutive mappings can be grouped into 1GB chunks.
+	 */
+	if (!(reg->flags & (VMM_REGION_ALIAS | VMM_REGION_VIRTUAL)) &&
+	    (reg->flags & VMM_REGION_ISRAM) &&
+	    (reg->flags & VMM_REGION_ISALLOCED) &&
+	    vmm_devtree_getattr(reg->node,
+				VMM_DEVTREE_HUGE_PAGES_ATTR_NAME) &&
+	    (((physical_size_t)1 << REGION_HUGE_ORDER_2M) <= reg->phys_size)) {
+		reg->flags |= VMM_REGION_ISHUGEPAGE;
+		reg->map_order = REGION_HUGE_ORDER_2M;
+	}
+
 	/* Overwrite mapping order for colored RAM/ROM regions */
 	if (!(reg->flags & (VMM_REGION_ALIAS | VMM_REGION_VIRTUAL)) &&
 	    (reg->flags & (VMM_REGION_ISRAM | VMM_REGION_ISROM)) &&
@@ -937,10 +1537,12 @@ static int region_add(struct vmm_guest *guest,
 	reg->maps[0].hphys_addr = reg->gphys_addr +
 				  mapping_gphys_offset(reg, 0);
 	reg->maps[0].flags = 0;
+	reg->maps[0].contig_order = 0;
 	for (i = 1; i < reg->maps_count; i++) {
 		reg->maps[i].hphys_addr = reg->gphys_addr +
 					  mapping_gphys_offset(reg, i);
 		reg->maps[i].flags = 0;
+		reg->maps[i].contig_order = 0;
 	}
 
 	reg->devemu_priv = NULL;
@@ -999,10 +1601,25 @@ static int region_add(struct vmm_guest *guest,
 		}
 	}
 
+	/* Allocate host RAM for huge page backed alloced RAM regions */
+	if (!(reg->flags & (VMM_REGION_ALIAS | VMM_REGION_VIRTUAL)) &&
+	    (reg->flags & VMM_REGION_ISRAM) &&
+	    (reg->flags & VMM_REGION_ISHUGEPAGE)) {
+		rc = region_alloc_huge_ram(guest, reg);
+		if (rc) {
+			vmm_printf("%s: Failed to alloc "
+				   "host RAM for %s/%s\n",
+				   __func__, guest->name,
+				   reg->node->name);
+			goto region_ram_free_fail;
+		}
+	}
+
 	/* Allocate host RAM for alloced RAM/ROM regions */
 	if (!(reg->flags & (VMM_REGION_ALIAS | VMM_REGION_VIRTUAL)) &&
 	    (reg->flags & (VMM_REGION_ISRAM | VMM_REGION_ISROM)) &&
-	    (reg->flags & VMM_REGION_ISALLOCED)) {
+	    (reg->flags & VMM_REGION_ISALLOCED) &&
+	    !(reg->flags & VMM_REGION_ISHUGEPAGE)) {
 		for (i = 0; i < reg->maps_count; i++) {
 			if (!vmm_host_ram_alloc(&reg->maps[i].hphys_addr,
 						mapping_phys_size(reg, i),
@@ -1150,6 +1767,8 @@ static int region_del(struct vmm_guest *guest,
 	irq_flags_t flags;
 	vmm_rwlock_t *root_lock;
 	struct rb_root *root = NULL;
+	unsigned long *dirty_bmap;
+	struct vmm_guest_dirty_range *dr, *dr1;
 	struct vmm_devtree_node *rnode = reg->node;
 	struct vmm_guest_aspace *aspace = &guest->aspace;
 
@@ -1212,6 +1831,21 @@ static int region_del(struct vmm_guest *guest,
 		}
 	}
 
+	/* Free dirty bitmap and detach dirty tracked ranges */
+	vmm_spin_lock_irqsave_lite(&aspace->dirty_lock, flags);
+	dirty_bmap = reg->dirty_bmap;
+	reg->dirty_bmap = NULL;
+	list_for_each_entry_safe(dr, dr1, &aspace->dirty_ranges, head) {
+		if (dr->reg == reg) {
+			list_del(&dr->head);
+			dr->reg = NULL;
+		}
+	}
+	vmm_spin_unlock_irqrestore_lite(&aspace->dirty_lock, flags);
+	if (dirty_bmap) {
+		vmm_free(dirty_bmap);
+	}
+
 	/* Free region mappings */
 	vmm_free(reg->maps);
 
@@ -1530,6 +2164,8 @@ int vmm_guest_aspace_init(struct vmm_guest *guest)
 	INIT_RW_LOCK(&aspace->reg_memtree_lock);
 	aspace->reg_memtree = RB_ROOT;
 	INIT_LIST_HEAD(&aspace->reg_memprobe_list);
+	INIT_SPIN_LOCK(&aspace->dirty_lock);
+	INIT_LIST_HEAD(&aspace->dirty_ranges);
 	guest->aspace.devemu_priv = NULL;
 
 	/* Initialize device emulation context */
@@ -0,0 +1,840 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vmm_guest_snapshot.c
+ * @author agent (agent@local)
+ * @brief source code for guest snapshot save/restore
+ *
+ * The snapshot is a sequence of records following a header. Each
+ * record carries state of one VCPU, one emulated device region, or
+ * one chunk of a guest RAM region. RAM chunks carry a descriptor
+ * per-page so that zero pages are skipped and other pages are
+ * either stored raw or LZ4 compressed.
+ */
+
+#include <vmm_error.h>
+#include <vmm_heap.h>
+#include <vmm_stdio.h>
+#include <vmm_timer.h>
+#include <vmm_devemu.h>
+#include <vmm_manager.h>
+#include <vmm_guest_aspace.h>
+#include <vmm_guest_snapshot.h>
+#include <arch_vcpu.h>
+#include <libs/stringlib.h>
+#include <libs/lz4.h>
+
+#define SNAPSHOT_MAGIC			0x504E5358 /* "XSNP" */
+#define SNAPSHOT_VERSION		1
+
+#define SNAPSHOT_REC_VCPU		1
+#define SNAPSHOT_REC_EMU		2
+#define SNAPSHOT_REC_RAM		3
+#define SNAPSHOT_REC_END		4
+
+/* Upper limit on size of VCPU and emulator records */
+#define SNAPSHOT_MAX_STATE_LEN		(1024 * 1024)
+
+#define SNAPSHOT_CHUNK_PAGES		16
+#define SNAPSHOT_CHUNK_SIZE		(SNAPSHOT_CHUNK_PAGES * VMM_PAGE_SIZE)
+#define SNAPSHOT_CHUNK_ZERO		0x1
+
+#define SNAPSHOT_PAGE_ZERO		0x0
+#define SNAPSHOT_PAGE_RAW		0x1
+#define SNAPSHOT_PAGE_LZ4		0x2
+#define SNAPSHOT_PDESC_KIND_SHIFT	28
+#define SNAPSHOT_PDESC_LEN_MASK		0x0FFFFFFF
+#define SNAPSHOT_PDESC(kind, len)	(((kind) << SNAPSHOT_PDESC_KIND_SHIFT) | \
+					 ((len) & SNAPSHOT_PDESC_LEN_MASK))
+#define SNAPSHOT_PDESC_KIND(pdesc)	((pdesc) >> SNAPSHOT_PDESC_KIND_SHIFT)
+#define SNAPSHOT_PDESC_LEN(pdesc)	((pdesc) & SNAPSHOT_PDESC_LEN_MASK)
+
+struct snapshot_header {
+	u32 magic;
+	u32 version;
+	u32 flags;
+	u32 vcpu_count;
+	char guest_name[VMM_FIELD_NAME_SIZE];
+} __packed;
+
+struct snapshot_record {
+	u32 type;
+	u32 id;
+	u64 len;
+	u64 addr;
+	u32 flags;
+	u32 reserved;
+	char name[VMM_FIELD_NAME_SIZE];
+} __packed;
+
+struct snapshot_chunk {
+	u64 offset;
+	u32 pages;
+	u32 flags;
+} __packed;
+
+/* Growable memory stream used to find length of a record */
+struct snapshot_buf {
+	struct vmm_snapshot_stream ss;
+	u8 *data;
+	u32 len;
+	u32 size;
+	u32 pos;
+};
+
+struct snapshot_ctx {
+	struct vmm_guest *guest;
+	struct vmm_snapshot_stream *ss;
+	struct vmm_guest_snapshot_stats *stats;
+	u32 flags;
+	int rc;
+	struct snapshot_buf buf;
+	u32 pdesc[SNAPSHOT_CHUNK_PAGES];
+	u8 *chunk;
+	u8 *out;
+	void *wrkmem;
+};
+
+static int snapshot_buf_write(struct vmm_snapshot_stream *ss,
+			      const void *buf, u32 len)
+{
+	u8 *data;
+	u32 size;
+	struct snapshot_buf *b = ss->priv;
+
+	if ((b->len + len) > SNAPSHOT_MAX_STATE_LEN) {
+		return VMM_ENOSPC;
+	}
+
+	if ((b->len + len) > b->size) {
+		size = (b->size) ? b->size : 256;
+		while (size < (b->len + len)) {
+			size = size * 2;
+		}
+		data = vmm_malloc(size);
+		if (!data) {
+			return VMM_ENOMEM;
+		}
+		if (b->data) {
+			memcpy(data, b->data, b->len);
+			vmm_free(b->data);
+		}
+		b->data = data;
+		b->size = size;
+	}
+
+	memcpy(&b->data[b->len], buf, len);
+	b->len += len;
+
+	return VMM_OK;
+}
+
+static int snapshot_buf_read(struct vmm_snapshot_stream *ss,
+			     void *buf, u32 len)
+{
+	struct snapshot_buf *b = ss->priv;
+
+	if (len > (b->len - b->pos)) {
+		return VMM_EIO;
+	}
+
+	memcpy(buf, &b->data[b->pos], len);
+	b->pos += len;
+
+	return VMM_OK;
+}
+
+static void snapshot_buf_reset(struct snapshot_buf *b)
+{
+	b->ss.write = snapshot_buf_write;
+	b->ss.read = snapshot_buf_read;
+	b->ss.priv = b;
+	b->len = 0;
+	b->pos = 0;
+}
+
+static int snapshot_out(struct snapshot_ctx *ctx, const void *buf, u32 len)
+{
+	int rc = (len) ? vmm_snapshot_write(ctx->ss, buf, len) : VMM_OK;
+
+	if (!rc && ctx->stats) {
+		ctx->stats->stream_bytes += len;
+	}
+
+	return rc;
+}
+
+static int snapshot_in(struct snapshot_ctx *ctx, void *buf, u32 len)
+{
+	int rc = (len) ? vmm_snapshot_read(ctx->ss, buf, len) : VMM_OK;
+
+	if (!rc && ctx->stats) {
+		ctx->stats->stream_bytes += len;
+	}
+
+	return rc;
+}
+
+static int snapshot_write_record(struct snapshot_ctx *ctx,
+				 u32 type, u32 id, u64 len,
+				 struct vmm_region *reg)
+{
+	struct snapshot_record rec;
+
+	memset(&rec, 0, sizeof(rec));
+	rec.type = type;
+	rec.id = id;
+	rec.len = len;
+	if (reg) {
+		rec.addr = VMM_REGION_GPHYS_START(reg);
+		rec.flags = VMM_REGION_FLAGS(reg);
+		strncpy(rec.name, VMM_REGION_NAME(reg), sizeof(rec.name) - 1);
+	}
+
+	return snapshot_out(ctx, &rec, sizeof(rec));
+}
+
+static bool snapshot_page_is_zero(const u8 *page)
+{
+	u32 i;
+	const u64 *p = (const u64 *)page;
+
+	for (i = 0; i < (VMM_PAGE_SIZE / sizeof(u64)); i++) {
+		if (p[i]) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static bool snapshot_is_ram(struct vmm_region *reg)
+{
+	if ((reg->flags & VMM_REGION_MANIFEST_MASK) != VMM_REGION_REAL) {
+		return FALSE;
+	}
+
+	return (reg->flags & (VMM_REGION_ISRAM | VMM_REGION_ISROM)) ?
+							TRUE : FALSE;
+}
+
+static int snapshot_save_vcpus(struct snapshot_ctx *ctx)
+{
+	int rc;
+	struct vmm_vcpu *vcpu;
+
+	vmm_manager_for_each_guest_vcpu(vcpu, ctx->guest) {
+		snapshot_buf_reset(&ctx->buf);
+		rc = arch_vcpu_save(vcpu, &ctx->buf.ss);
+		if (rc) {
+			vmm_printf("%s: %s VCPU%d save error %d\n",
+				   __func__, ctx->guest->name,
+				   vcpu->subid, rc);
+			return rc;
+		}
+
+		rc = snapshot_write_record(ctx, SNAPSHOT_REC_VCPU,
+					   vcpu->subid, ctx->buf.len, NULL);
+		if (rc) {
+			return rc;
+		}
+		rc = snapshot_out(ctx, ctx->buf.data, ctx->buf.len);
+		if (rc) {
+			return rc;
+		}
+	}
+
+	return VMM_OK;
+}
+
+static void snapshot_save_emu(struct vmm_guest *guest,
+			      struct vmm_region *reg, void *priv)
+{
+	int rc;
+	struct snapshot_ctx *ctx = priv;
+
+	if (ctx->rc || !reg->devemu_priv ||
+	    (reg->flags & VMM_REGION_ALIAS)) {
+		return;
+	}
+
+	snapshot_buf_reset(&ctx->buf);
+	rc = vmm_devemu_save_region(guest, reg, &ctx->buf.ss);
+	if (!rc) {
+		rc = snapshot_write_record(ctx, SNAPSHOT_REC_EMU,
+					   0, ctx->buf.len, reg);
+	}
+	if (!rc) {
+		rc = snapshot_out(ctx, ctx->buf.data, ctx->buf.len);
+	}
+
+	ctx->rc = rc;
+}
+
+static int snapshot_save_chunk(struct snapshot_ctx *ctx,
+			       struct vmm_region *reg,
+			       physical_size_t offset, u32 pages)
+{
+	int rc;
+	u8 *page, *op;
+	u32 i, clen, out_len;
+	bool all_zero = TRUE;
+	struct snapshot_chunk chunk;
+
+	if (vmm_guest_memory_read(ctx->guest,
+				  VMM_REGION_GPHYS_START(reg) + offset,
+				  ctx->chunk, pages * VMM_PAGE_SIZE,
+				  TRUE) != (pages * VMM_PAGE_SIZE)) {
+		return VMM_EIO;
+	}
+
+	op = ctx->out;
+	for (i = 0; i < pages; i++) {
+		page = &ctx->chunk[i * VMM_PAGE_SIZE];
+
+		if (snapshot_page_is_zero(page)) {
+			ctx->pdesc[i] = SNAPSHOT_PDESC(SNAPSHOT_PAGE_ZERO, 0);
+			if (ctx->stats) {
+				ctx->stats->zero_bytes += VMM_PAGE_SIZE;
+			}
+			continue;
+		}
+		all_zero = FALSE;
+
+		/* Keep page raw if compression does not save anything */
+		clen = 0;
+		if (ctx->flags & VMM_GUEST_SNAPSHOT_COMPRESS) {
+			clen = lz4_compress(page, VMM_PAGE_SIZE,
+					    op, VMM_PAGE_SIZE - 1,
+					    ctx->wrkmem);
+		}
+		if (clen) {
+			ctx->pdesc[i] = SNAPSHOT_PDESC(SNAPSHOT_PAGE_LZ4, clen);
+			op += clen;
+		} else {
+			memcpy(op, page, VMM_PAGE_SIZE);
+			ctx->pdesc[i] = SNAPSHOT_PDESC(SNAPSHOT_PAGE_RAW,
+						       VMM_PAGE_SIZE);
+			op += VMM_PAGE_SIZE;
+		}
+	}
+	out_len = op - ctx->out;
+
+	memset(&chunk, 0, sizeof(chunk));
+	chunk.offset = offset;
+	chunk.pages = pages;
+	chunk.flags = (all_zero) ? SNAPSHOT_CHUNK_ZERO : 0;
+
+	rc = snapshot_write_record(ctx, SNAPSHOT_REC_RAM, 0,
+		sizeof(chunk) + ((all_zero) ? 0 :
+			(pages * sizeof(u32) + out_len)), reg);
+	if (rc) {
+		return rc;
+	}
+	rc = snapshot_out(ctx, &chunk, sizeof(chunk));
+	if (rc || all_zero) {
+		return rc;
+	}
+	rc = snapshot_out(ctx, ctx->pdesc, pages * sizeof(u32));
+	if (rc) {
+		return rc;
+	}
+
+	return snapshot_out(ctx, ctx->out, out_len);
+}
+
+static void snapshot_save_ram(struct vmm_guest *guest,
+			      struct vmm_region *reg, void *priv)
+{
+	u32 pages;
+	physical_size_t offset, size;
+	struct snapshot_ctx *ctx = priv;
+
+	if (ctx->rc || !snapshot_is_ram(reg)) {
+		return;
+	}
+
+	size = VMM_REGION_PHYS_SIZE(reg);
+	for (offset = 0; offset < size; offset += pages * VMM_PAGE_SIZE) {
+		pages = (size - offset) >> VMM_PAGE_SHIFT;
+		pages = (pages < SNAPSHOT_CHUNK_PAGES) ?
+					pages : SNAPSHOT_CHUNK_PAGES;
+		if (!pages) {
+			break;
+		}
+
+		ctx->rc = snapshot_save_chunk(ctx, reg, offset, pages);
+		if (ctx->rc) {
+			vmm_printf("%s: %s/%s offset 0x%"PRIPSIZE" error %d\n",
+				   __func__, guest->name,
+				   VMM_REGION_NAME(reg), offset, ctx->rc);
+			return;
+		}
+		if (ctx->stats) {
+			ctx->stats->ram_bytes += pages * VMM_PAGE_SIZE;
+		}
+	}
+}
+
+static int snapshot_check_guest(struct vmm_guest *guest)
+{
+	u32 state;
+	struct vmm_vcpu *vcpu;
+
+	/* VCPUs must not run while we capture or update their state */
+	vmm_manager_for_each_guest_vcpu(vcpu, guest) {
+		state = vmm_manager_vcpu_get_state(vcpu);
+		if ((state == VMM_VCPU_STATE_READY) ||
+		    (state == VMM_VCPU_STATE_RUNNING)) {
+			vmm_printf("%s: %s VCPU%d not paused\n",
+				   __func__, guest->name, vcpu->subid);
+			return VMM_EBUSY;
+		}
+	}
+
+	return VMM_OK;
+}
+
+static int snapshot_ctx_init(struct snapshot_ctx *ctx,
+			     struct vmm_guest *guest,
+			     struct vmm_snapshot_stream *ss, u32 flags,
+			     struct vmm_guest_snapshot_stats *stats)
+{
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->guest = guest;
+	ctx->ss = ss;
+	ctx->stats = stats;
+	ctx->flags = flags;
+	snapshot_buf_reset(&ctx->buf);
+
+	ctx->chunk = vmm_malloc(SNAPSHOT_CHUNK_SIZE);
+	ctx->out = vmm_malloc(SNAPSHOT_CHUNK_SIZE);
+	if (flags & VMM_GUEST_SNAPSHOT_COMPRESS) {
+		ctx->wrkmem = vmm_malloc(LZ4_MEM_COMPRESS);
+	}
+	if (!ctx->chunk || !ctx->out ||
+	    ((flags & VMM_GUEST_SNAPSHOT_COMPRESS) && !ctx->wrkmem)) {
+		return VMM_ENOMEM;
+	}
+
+	if (stats) {
+		memset(stats, 0, sizeof(*stats));
+	}
+
+	return VMM_OK;
+}
+
+static void snapshot_ctx_cleanup(struct snapshot_ctx *ctx)
+{
+	if (ctx->wrkmem) {
+		vmm_free(ctx->wrkmem);
+	}
+	if (ctx->out) {
+		vmm_free(ctx->out);
+	}
+	if (ctx->chunk) {
+		vmm_free(ctx->chunk);
+	}
+	if (ctx->buf.data) {
+		vmm_free(ctx->buf.data);
+	}
+	vmm_free(ctx);
+}
+
+int vmm_guest_snapshot_save(struct vmm_guest *guest,
+			    struct vmm_snapshot_stream *ss, u32 flags,
+			    struct vmm_guest_snapshot_stats *stats)
+{
+	int rc;
+	u64 tstamp;
+	struct snapshot_header hdr;
+	struct snapshot_ctx *ctx;
+
+	if (!guest || !ss) {
+		return VMM_EINVALID;
+	}
+
+	rc = snapshot_check_guest(guest);
+	if (rc) {
+		return rc;
+	}
+
+	ctx = vmm_malloc(sizeof(*ctx));
+	if (!ctx) {
+		return VMM_ENOMEM;
+	}
+	rc = snapshot_ctx_init(ctx, guest, ss, flags, stats);
+	if (rc) {
+		goto done;
+	}
+	tstamp = vmm_timer_timestamp();
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = SNAPSHOT_MAGIC;
+	hdr.version = SNAPSHOT_VERSION;
+	hdr.flags = flags;
+	hdr.vcpu_count = guest->vcpu_count;
+	strncpy(hdr.guest_name, guest->name, sizeof(hdr.guest_name) - 1);
+	rc = snapshot_out(ctx, &hdr, sizeof(hdr));
+	if (rc) {
+		goto done;
+	}
+
+	rc = snapshot_save_vcpus(ctx);
+	if (rc) {
+		goto done;
+	}
+
+	vmm_guest_iterate_region(guest, VMM_REGION_ISDEVICE,
+				 snapshot_save_emu, ctx);
+	if (!ctx->rc) {
+		vmm_guest_iterate_region(guest,
+				 VMM_REGION_IO | VMM_REGION_ISDEVICE,
+				 snapshot_save_emu, ctx);
+	}
+	if (!ctx->rc) {
+		vmm_guest_iterate_region(guest, VMM_REGION_MEMORY,
+					 snapshot_save_ram, ctx);
+	}
+	rc = ctx->rc;
+	if (rc) {
+		goto done;
+	}
+
+	rc = snapshot_write_record(ctx, SNAPSHOT_REC_END, 0, 0, NULL);
+
+	if (stats) {
+		stats->nsecs = vmm_timer_timestamp() - tstamp;
+	}
+
+done:
+	snapshot_ctx_cleanup(ctx);
+	return rc;
+}
+
+static struct vmm_region *snapshot_find_region(struct snapshot_ctx *ctx,
+					       struct snapshot_record *rec)
+{
+	struct vmm_region *reg;
+
+	reg = vmm_guest_find_region(ctx->guest, rec->addr,
+			rec->flags & (VMM_REGION_IO | VMM_REGION_MEMORY),
+			FALSE);
+	if (!reg || (VMM_REGION_GPHYS_START(reg) != rec->addr) ||
+	    strncmp(VMM_REGION_NAME(reg), rec->name, sizeof(rec->name))) {
+		vmm_printf("%s: %s region %s not found\n",
+			   __func__, ctx->guest->name, rec->name);
+		return NULL;
+	}
+
+	return reg;
+}
+
+static int snapshot_read_state(struct snapshot_ctx *ctx,
+			       struct snapshot_record *rec)
+{
+	int rc;
+	u8 *data;
+
+	if (rec->len > SNAPSHOT_MAX_STATE_LEN) {
+		return VMM_EINVALID;
+	}
+
+	snapshot_buf_reset(&ctx->buf);
+	if (rec->len > ctx->buf.size) {
+		data = vmm_malloc(rec->len);
+		if (!data) {
+			return VMM_ENOMEM;
+		}
+		if (ctx->buf.data) {
+			vmm_free(ctx->buf.data);
+		}
+		ctx->buf.data = data;
+		ctx->buf.size = rec->len;
+	}
+
+	rc = snapshot_in(ctx, ctx->buf.data, rec->len);
+	if (rc) {
+		return rc;
+	}
+	ctx->buf.len = rec->len;
+
+	return VMM_OK;
+}
+
+static int snapshot_restore_vcpu(struct snapshot_ctx *ctx,
+				 struct snapshot_record *rec)
+{
+	int rc;
+	struct vmm_vcpu *vcpu;
+
+	vcpu = vmm_manager_guest_vcpu(ctx->guest, rec->id);
+	if (!vcpu) {
+		return VMM_ENOTAVAIL;
+	}
+
+	rc = snapshot_read_state(ctx, rec);
+	if (rc) {
+		return rc;
+	}
+
+	rc = arch_vcpu_restore(vcpu, &ctx->buf.ss);
+	if (rc) {
+		vmm_printf("%s: %s VCPU%d restore error %d\n",
+			   __func__, ctx->guest->name, vcpu->subid, rc);
+		return rc;
+	}
+
+	return (ctx->buf.pos == ctx->buf.len) ? VMM_OK : VMM_EINVALID;
+}
+
+static int snapshot_restore_emu(struct snapshot_ctx *ctx,
+				struct snapshot_record *rec)
+{
+	int rc;
+	struct vmm_region *reg;
+
+	reg = snapshot_find_region(ctx, rec);
+	if (!reg) {
+		return VMM_ENOTAVAIL;
+	}
+
+	rc = snapshot_read_state(ctx, rec);
+	if (rc) {
+		return rc;
+	}
+
+	rc = vmm_devemu_restore_region(ctx->guest, reg, &ctx->buf.ss);
+	if (rc) {
+		return rc;
+	}
+
+	return (ctx->buf.pos == ctx->buf.len) ? VMM_OK : VMM_EINVALID;
+}
+
+static int snapshot_restore_ram(struct snapshot_ctx *ctx,
+				struct snapshot_record *rec)
+{
+	int rc;
+	u8 *ip, *page;
+	u32 i, plen, in_len, len;
+	struct vmm_region *reg;
+	struct snapshot_chunk chunk;
+
+	reg = snapshot_find_region(ctx, rec);
+	if (!reg || !snapshot_is_ram(reg)) {
+		return VMM_ENOTAVAIL;
+	}
+
+	if (rec->len < sizeof(chunk)) {
+		return VMM_EINVALID;
+	}
+	rc = snapshot_in(ctx, &chunk, sizeof(chunk));
+	if (rc) {
+		return rc;
+	}
+	if (!chunk.pages || (chunk.pages > SNAPSHOT_CHUNK_PAGES) ||
+	    (chunk.offset & VMM_PAGE_MASK) ||
+	    (chunk.offset >= VMM_REGION_PHYS_SIZE(reg)) ||
+	    ((chunk.offset + chunk.pages * VMM_PAGE_SIZE) >
+					VMM_REGION_PHYS_SIZE(reg))) {
+		return VMM_EINVALID;
+	}
+	len = chunk.pages * VMM_PAGE_SIZE;
+
+	if (chunk.flags & SNAPSHOT_CHUNK_ZERO) {
+		if (rec->len != sizeof(chunk)) {
+			return VMM_EINVALID;
+		}
+		memset(ctx->chunk, 0, len);
+		if (ctx->stats) {
+			ctx->stats->zero_bytes += len;
+		}
+		goto write_chunk;
+	}
+
+	if (rec->len < (sizeof(chunk) + chunk.pages * sizeof(u32))) {
+		return VMM_EINVALID;
+	}
+	in_len = rec->len - sizeof(chunk) - chunk.pages * sizeof(u32);
+	if (in_len > SNAPSHOT_CHUNK_SIZE) {
+		return VMM_EINVALID;
+	}
+	rc = snapshot_in(ctx, ctx->pdesc, chunk.pages * sizeof(u32));
+	if (rc) {
+		return rc;
+	}
+	rc = snapshot_in(ctx, ctx->out, in_len);
+	if (rc) {
+		return rc;
+	}
+
+	ip = ctx->out;
+	for (i = 0; i < chunk.pages; i++) {
+		page = &ctx->chunk[i * VMM_PAGE_SIZE];
+		plen = SNAPSHOT_PDESC_LEN(ctx->pdesc[i]);
+		if (plen > (u32)(ctx->out + in_len - ip)) {
+			return VMM_EINVALID;
+		}
+
+		switch (SNAPSHOT_PDESC_KIND(ctx->pdesc[i])) {
+		case SNAPSHOT_PAGE_ZERO:
+			memset(page, 0, VMM_PAGE_SIZE);
+			if (ctx->stats) {
+				ctx->stats->zero_bytes += VMM_PAGE_SIZE;
+			}
+			break;
+		case SNAPSHOT_PAGE_RAW:
+			if (plen != VMM_PAGE_SIZE) {
+				return VMM_EINVALID;
+			}
+			memcpy(page, ip, VMM_PAGE_SIZE);
+			break;
+		case SNAPSHOT_PAGE_LZ4:
+			if (lz4_decompress(ip, plen, page,
+					   VMM_PAGE_SIZE) != VMM_PAGE_SIZE) {
+				return VMM_EINVALID;
+			}
+			break;
+		default:
+			return VMM_EINVALID;
+		};
+		ip += plen;
+	}
+	if (ip != (ctx->out + in_len)) {
+		return VMM_EINVALID;
+	}
+
+write_chunk:
+	if (vmm_guest_memory_write(ctx->guest,
+				   VMM_REGION_GPHYS_START(reg) + chunk.offset,
+				   ctx->chunk, len, FALSE) != len) {
+		return VMM_EIO;
+	}
+	if (ctx->stats) {
+		ctx->stats->ram_bytes += len;
+	}
+
+	return VMM_OK;
+}
+
+static int snapshot_skip(struct snapshot_ctx *ctx, u64 len)
+{
+	int rc;
+	u32 l;
+
+	while (len) {
+		l = (len < SNAPSHOT_CHUNK_SIZE) ? len : SNAPSHOT_CHUNK_SIZE;
+		rc = snapshot_in(ctx, ctx->out, l);
+		if (rc) {
+			return rc;
+		}
+		len -= l;
+	}
+
+	return VMM_OK;
+}
+
+int vmm_guest_snapshot_restore(struct vmm_guest *guest,
+			       struct vmm_snapshot_stream *ss,
+			       struct vmm_guest_snapshot_stats *stats)
+{
+	int rc;
+	u64 tstamp;
+	struct snapshot_header hdr;
+	struct snapshot_record rec;
+	struct snapshot_ctx *ctx;
+
+	if (!guest || !ss) {
+		return VMM_EINVALID;
+	}
+
+	rc = snapshot_check_guest(guest);
+	if (rc) {
+		return rc;
+	}
+
+	ctx = vmm_malloc(sizeof(*ctx));
+	if (!ctx) {
+		return VMM_ENOMEM;
+	}
+	rc = snapshot_ctx_init(ctx, guest, ss, 0x0, stats);
+	if (rc) {
+		goto done;
+	}
+	tstamp = vmm_timer_timestamp();
+
+	rc = snapshot_in(ctx, &hdr, sizeof(hdr));
+	if (rc) {
+		goto done;
+	}
+	if ((hdr.magic != SNAPSHOT_MAGIC) ||
+	    (hdr.version != SNAPSHOT_VERSION)) {
+		vmm_printf("%s: invalid snapshot header\n", __func__);
+		rc = VMM_EINVALID;
+		goto done;
+	}
+	if (hdr.vcpu_count != guest->vcpu_count) {
+		vmm_printf("%s: %s has %d VCPUs but snapshot has %d VCPUs\n",
+			   __func__, guest->name,
+			   guest->vcpu_count, hdr.vcpu_count);
+		rc = VMM_EINVALID;
+		goto done;
+	}
+
+	while (1) {
+		rc = snapshot_in(ctx, &rec, sizeof(rec));
+		if (rc) {
+			goto done;
+		}
+		rec.name[sizeof(rec.name) - 1] = '\0';
+
+		switch (rec.type) {
+		case SNAPSHOT_REC_VCPU:
+			rc = snapshot_restore_vcpu(ctx, &rec);
+			break;
+		case SNAPSHOT_REC_EMU:
+			rc = snapshot_restore_emu(ctx, &rec);
+			break;
+		case SNAPSHOT_REC_RAM:
+			rc = snapshot_restore_ram(ctx, &rec);
+			break;
+		case SNAPSHOT_REC_END:
+			goto end;
+		default:
+			/* Skip unknown records */
+			rc = snapshot_skip(ctx, rec.len);
+			break;
+		};
+		if (rc) {
+			vmm_printf("%s: %s record type %d (%s) error %d\n",
+				   __func__, guest->name,
+				   rec.type, rec.name, rc);
+			goto done;
+		}
+	}
+
+end:
+	if (stats) {
+		stats->nsecs = vmm_timer_timestamp() - tstamp;
+	}
+
+done:
+	snapshot_ctx_cleanup(ctx);
+	return rc;
+}
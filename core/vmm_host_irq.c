@@ -28,6 +28,7 @@
 #include <vmm_host_irq.h>
 #include <vmm_host_irqext.h>
 #include <vmm_host_irqdomain.h>
+#include <vmm_trace.h>
 #include <arch_cpu_irq.h>
 #include <arch_host_irq.h>
 #include <libs/stringlib.h>
@@ -135,9 +136,11 @@ int vmm_host_generic_irq_exec(u32 hirq_no)
 	cpu = vmm_smp_processor_id();
 	irq->count[cpu]++;
 	irq->percpu_state[cpu] |= VMM_PERCPU_IRQ_STATE_IN_PROG;
+	vmm_trace(VMM_TRACE_CAT_IRQ, VMM_TRACE_HOST_IRQ_ENTER, hirq_no, 0, 0);
 	if (irq->handler) {
 		irq->handler(irq, cpu, irq->handler_data);
 	}
+	vmm_trace(VMM_TRACE_CAT_IRQ, VMM_TRACE_HOST_IRQ_EXIT, hirq_no, 0, 0);
 	irq->percpu_state[cpu] &= ~VMM_PERCPU_IRQ_STATE_IN_PROG;
 
 	return VMM_OK;
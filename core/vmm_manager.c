@@ -633,6 +633,7 @@ struct vmm_vcpu *vmm_manager_vcpu_orphan_create(const char *name,
 	vcpu->reset_count = 0;
 	vcpu->reset_tstamp = 0;
 	vcpu->preempt_count = 0;
+	vmm_vcpu_stats_reset(&vcpu->stats);
 	vcpu->resumed = FALSE;
 	vcpu->sched_priv = NULL;
 
@@ -1463,6 +1464,7 @@ struct vmm_guest *vmm_manager_guest_create(struct vmm_devtree_node *gnode)
 		vcpu->reset_count = 0;
 		vcpu->reset_tstamp = 0;
 		vcpu->preempt_count = 0;
+		vmm_vcpu_stats_reset(&vcpu->stats);
 		vcpu->resumed = FALSE;
 		vcpu->sched_priv = NULL;
 
@@ -1753,6 +1755,8 @@ int __init vmm_manager_init(void)
 		mngr.vcpu_array[vnum].state_halted_nsecs = 0;
 		mngr.vcpu_array[vnum].reset_count = 0;
 		mngr.vcpu_array[vnum].reset_tstamp = 0;
+		memset(&mngr.vcpu_array[vnum].stats, 0,
+		       sizeof(mngr.vcpu_array[vnum].stats));
 		INIT_RW_LOCK(&mngr.vcpu_array[vnum].sched_lock);
 		mngr.vcpu_avail_array[vnum] = TRUE;
 	}
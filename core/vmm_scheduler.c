@@ -28,6 +28,7 @@
 #include <vmm_stdio.h>
 #include <vmm_vcpu_irq.h>
 #include <vmm_timer.h>
+#include <vmm_trace.h>
 #include <vmm_schedalgo.h>
 #include <vmm_scheduler.h>
 #include <vmm_stdio.h>
@@ -276,6 +277,8 @@ static void vmm_scheduler_switch(struct vmm_scheduler_ctrl *schedp,
 	}
 
 	if (next) {
+		vmm_trace(VMM_TRACE_CAT_SCHED, VMM_TRACE_SCHED_SWITCH,
+			  (current) ? current->id : UINT_MAX, next->id, 0);
 		arch_vcpu_post_switch(next, regs);
 	}
 }
@@ -29,6 +29,8 @@
 #include <vmm_clocksource.h>
 #include <vmm_clockchip.h>
 #include <vmm_timer.h>
+#include <vmm_trace.h>
+#include <arch_barrier.h>
 #include <arch_cpu_irq.h>
 #include <libs/stringlib.h>
 
@@ -40,6 +42,7 @@ struct vmm_timer_local_ctrl {
 	bool inprocess;
 	u64 next_event;
 	struct vmm_timer_event *curr;
+	struct vmm_timer_event *running;
 	vmm_rwlock_t event_list_lock;
 	struct dlist event_list;
 };
@@ -143,12 +146,32 @@ static void timer_clockchip_event_handler(struct vmm_clockchip *cc)
 			vmm_read_unlock_irqrestore_lite(&tlcp->event_list_lock, flags);
 			/* Set current CPU event to NULL */
 			tlcp->curr = NULL;
-			/* Stop expired active event */
+			/* Stop expired active event unless somebody
+			 * else stopped it after we found it.
+			 */
 			vmm_spin_lock_irqsave_lite(&e->active_lock, flags1);
+			if (!e->active_state) {
+				vmm_spin_unlock_irqrestore_lite(&e->active_lock,
+								flags1);
+				vmm_read_lock_irqsave_lite(
+					&tlcp->event_list_lock, flags);
+				continue;
+			}
+			tlcp->running = e;
 			__timer_event_stop(e);
 			vmm_spin_unlock_irqrestore_lite(&e->active_lock, flags1);
 			/* Call event handler */
+			vmm_trace(VMM_TRACE_CAT_TIMER,
+				  VMM_TRACE_TIMER_EXPIRE_ENTER,
+				  0, (virtual_addr_t)e,
+				  (virtual_addr_t)e->handler);
 			e->handler(e);
+			vmm_trace(VMM_TRACE_CAT_TIMER,
+				  VMM_TRACE_TIMER_EXPIRE_EXIT,
+				  0, (virtual_addr_t)e, 0);
+			/* Event handler may have freed the event */
+			arch_smp_mb();
+			tlcp->running = NULL;
 			/* Lock back event list */
 			vmm_read_lock_irqsave_lite(&tlcp->event_list_lock, flags);
 		} else {
@@ -214,6 +237,9 @@ int vmm_timer_event_start(struct vmm_timer_event *ev, u64 duration_nsecs)
 	tlcp = &per_cpu(tlc, hcpu);
 	tstamp = vmm_timer_timestamp();
 
+	vmm_trace(VMM_TRACE_CAT_TIMER, VMM_TRACE_TIMER_START,
+		  0, (virtual_addr_t)ev, duration_nsecs);
+
 	vmm_spin_lock_irqsave_lite(&ev->active_lock, flags);
 
 	__timer_event_stop(ev);
@@ -273,6 +299,37 @@ int vmm_timer_event_stop(struct vmm_timer_event *ev)
 	return VMM_OK;
 }
 
+int vmm_timer_event_stop_sync(struct vmm_timer_event *ev)
+{
+	u32 c;
+	irq_flags_t flags;
+	struct vmm_timer_local_ctrl *tlcp;
+
+	if (!ev) {
+		return VMM_EFAIL;
+	}
+
+	vmm_spin_lock_irqsave_lite(&ev->active_lock, flags);
+
+	__timer_event_stop(ev);
+
+	vmm_spin_unlock_irqrestore_lite(&ev->active_lock, flags);
+
+	/* Wait for handler already running on other host CPUs */
+	for_each_online_cpu(c) {
+		if (c == vmm_smp_processor_id()) {
+			continue;
+		}
+		tlcp = &per_cpu(tlc, c);
+		while (*((volatile struct vmm_timer_event **)&tlcp->running)
+									== ev) {
+			arch_smp_mb();
+		}
+	}
+
+	return VMM_OK;
+}
+
 bool vmm_timer_started(void)
 {
 	return this_cpu(tlc).started;
@@ -317,8 +374,9 @@ int __cpuinit vmm_timer_init(void)
 	tlcp->started = FALSE;
 	tlcp->inprocess = FALSE;
 
-	/* Initialize Per CPU current event pointer */
+	/* Initialize Per CPU current and running event pointer */
 	tlcp->curr = NULL;
+	tlcp->running = NULL;
 
 	/* Initialize Per CPU event list */
 	INIT_RW_LOCK(&tlcp->event_list_lock);
@@ -0,0 +1,286 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vmm_trace.c
+ * @author agent (agent@local)
+ * @brief source file for hypervisor tracepoints
+ */
+
+#include <vmm_error.h>
+#include <vmm_smp.h>
+#include <vmm_timer.h>
+#include <vmm_mutex.h>
+#include <vmm_cpumask.h>
+#include <vmm_host_aspace.h>
+#include <vmm_trace.h>
+#include <vmm_modules.h>
+#include <arch_cpu_irq.h>
+#include <arch_barrier.h>
+#include <libs/stringlib.h>
+
+#define TRACE_RING_SIZE		(1U << CONFIG_TRACE_RING_SHIFT)
+#define TRACE_RING_MASK		(TRACE_RING_SIZE - 1)
+#define TRACE_RING_PAGES	\
+		VMM_SIZE_TO_PAGE(TRACE_RING_SIZE * sizeof(struct vmm_trace_entry))
+
+struct vmm_trace_ring {
+	struct vmm_trace_entry *entries;
+	/* Free-running count of entries written so far */
+	u64 head;
+};
+
+struct vmm_trace_ctrl {
+	struct vmm_mutex lock;
+	struct vmm_trace_ring ring[CONFIG_CPU_COUNT];
+};
+
+static struct vmm_trace_ctrl tctrl = {
+	.lock = __MUTEX_INITIALIZER(tctrl.lock),
+};
+
+u32 vmm_trace_mask;
+VMM_EXPORT_SYMBOL(vmm_trace_mask);
+
+static const char *cat_names[VMM_TRACE_CAT_MAX] = {
+	[VMM_TRACE_CAT_SCHED] = "sched",
+	[VMM_TRACE_CAT_TIMER] = "timer",
+	[VMM_TRACE_CAT_IRQ] = "irq",
+	[VMM_TRACE_CAT_VIRTIO] = "virtio",
+	[VMM_TRACE_CAT_NET] = "net",
+};
+
+static const struct {
+	const char *name;
+	u32 cat;
+} events[VMM_TRACE_EVENT_MAX] = {
+	[VMM_TRACE_SCHED_SWITCH] =
+		{ "sched_switch", VMM_TRACE_CAT_SCHED },
+	[VMM_TRACE_TIMER_START] =
+		{ "timer_start", VMM_TRACE_CAT_TIMER },
+	[VMM_TRACE_TIMER_EXPIRE_ENTER] =
+		{ "timer_expire_enter", VMM_TRACE_CAT_TIMER },
+	[VMM_TRACE_TIMER_EXPIRE_EXIT] =
+		{ "timer_expire_exit", VMM_TRACE_CAT_TIMER },
+	[VMM_TRACE_HOST_IRQ_ENTER] =
+		{ "host_irq_enter", VMM_TRACE_CAT_IRQ },
+	[VMM_TRACE_HOST_IRQ_EXIT] =
+		{ "host_irq_exit", VMM_TRACE_CAT_IRQ },
+	[VMM_TRACE_VCPU_IRQ_ASSERT] =
+		{ "vcpu_irq_assert", VMM_TRACE_CAT_IRQ },
+	[VMM_TRACE_VIRTIO_POP] =
+		{ "virtio_pop", VMM_TRACE_CAT_VIRTIO },
+	[VMM_TRACE_VIRTIO_PUSH] =
+		{ "virtio_push", VMM_TRACE_CAT_VIRTIO },
+	[VMM_TRACE_NET_PORT2SWITCH] =
+		{ "net_port2switch", VMM_TRACE_CAT_NET },
+	[VMM_TRACE_NET_SWITCH2PORT] =
+		{ "net_switch2port", VMM_TRACE_CAT_NET },
+};
+
+void __vmm_trace(u32 event, u32 arg0, u64 arg1, u64 arg2)
+{
+	u32 cpu;
+	irq_flags_t flags;
+	struct vmm_trace_ring *r;
+	struct vmm_trace_entry *e;
+
+	arch_cpu_irq_save(flags);
+
+	cpu = vmm_smp_processor_id();
+	r = &tctrl.ring[cpu];
+	if (unlikely(!r->entries)) {
+		arch_cpu_irq_restore(flags);
+		return;
+	}
+
+	e = &r->entries[r->head & TRACE_RING_MASK];
+	e->tstamp = vmm_timer_timestamp();
+	e->event = event;
+	e->cpu = cpu;
+	e->arg0 = arg0;
+	e->arg1 = arg1;
+	e->arg2 = arg2;
+
+	/* Publish entry only after it is completely written */
+	arch_smp_wmb();
+	r->head++;
+
+	arch_cpu_irq_restore(flags);
+}
+VMM_EXPORT_SYMBOL(__vmm_trace);
+
+const char *vmm_trace_category_name(u32 cat)
+{
+	return (cat < VMM_TRACE_CAT_MAX) ? cat_names[cat] : NULL;
+}
+VMM_EXPORT_SYMBOL(vmm_trace_category_name);
+
+int vmm_trace_category_find(const char *name)
+{
+	u32 cat;
+
+	if (!name) {
+		return VMM_EINVALID;
+	}
+
+	for (cat = 0; cat < VMM_TRACE_CAT_MAX; cat++) {
+		if (!strcmp(cat_names[cat], name)) {
+			return cat;
+		}
+	}
+
+	return VMM_ENOTAVAIL;
+}
+VMM_EXPORT_SYMBOL(vmm_trace_category_find);
+
+const char *vmm_trace_event_name(u32 event)
+{
+	return (event < VMM_TRACE_EVENT_MAX) ? events[event].name : NULL;
+}
+VMM_EXPORT_SYMBOL(vmm_trace_event_name);
+
+u32 vmm_trace_event_category(u32 event)
+{
+	return (event < VMM_TRACE_EVENT_MAX) ?
+				events[event].cat : VMM_TRACE_CAT_MAX;
+}
+VMM_EXPORT_SYMBOL(vmm_trace_event_category);
+
+u32 vmm_trace_enabled(void)
+{
+	return vmm_trace_mask;
+}
+VMM_EXPORT_SYMBOL(vmm_trace_enabled);
+
+int vmm_trace_enable(u32 cat_mask)
+{
+	u32 cpu;
+	virtual_addr_t va;
+	struct vmm_trace_ring *r;
+
+	cat_mask &= (1U << VMM_TRACE_CAT_MAX) - 1;
+	if (!cat_mask) {
+		return VMM_EINVALID;
+	}
+
+	vmm_mutex_lock(&tctrl.lock);
+
+	for_each_possible_cpu(cpu) {
+		r = &tctrl.ring[cpu];
+		if (r->entries) {
+			continue;
+		}
+
+		va = vmm_host_alloc_pages(TRACE_RING_PAGES,
+					  VMM_MEMORY_FLAGS_NORMAL);
+		if (!va) {
+			vmm_mutex_unlock(&tctrl.lock);
+			return VMM_ENOMEM;
+		}
+
+		r->head = 0;
+		arch_smp_wmb();
+		r->entries = (struct vmm_trace_entry *)va;
+	}
+
+	vmm_trace_mask |= cat_mask;
+
+	vmm_mutex_unlock(&tctrl.lock);
+
+	return VMM_OK;
+}
+VMM_EXPORT_SYMBOL(vmm_trace_enable);
+
+void vmm_trace_disable(u32 cat_mask)
+{
+	vmm_mutex_lock(&tctrl.lock);
+	vmm_trace_mask &= ~cat_mask;
+	vmm_mutex_unlock(&tctrl.lock);
+}
+VMM_EXPORT_SYMBOL(vmm_trace_disable);
+
+static void trace_clear_local(void *a0, void *a1, void *a2)
+{
+	irq_flags_t flags;
+
+	arch_cpu_irq_save(flags);
+	tctrl.ring[vmm_smp_processor_id()].head = 0;
+	arch_cpu_irq_restore(flags);
+}
+
+void vmm_trace_clear(void)
+{
+	vmm_mutex_lock(&tctrl.lock);
+	/* Ring head is only updated by its own host CPU */
+	vmm_smp_ipi_sync_call(cpu_online_mask, 1000,
+			      trace_clear_local, NULL, NULL, NULL);
+	vmm_mutex_unlock(&tctrl.lock);
+}
+VMM_EXPORT_SYMBOL(vmm_trace_clear);
+
+u32 vmm_trace_ring_size(void)
+{
+	return TRACE_RING_SIZE;
+}
+VMM_EXPORT_SYMBOL(vmm_trace_ring_size);
+
+u32 vmm_trace_read(u32 cpu, struct vmm_trace_entry *entries, u32 count)
+{
+	u64 i, start, end, valid;
+	struct vmm_trace_ring *r;
+
+	if ((CONFIG_CPU_COUNT <= cpu) || !entries || !count) {
+		return 0;
+	}
+
+	r = &tctrl.ring[cpu];
+	if (!r->entries) {
+		return 0;
+	}
+
+	end = *((volatile u64 *)&r->head);
+	arch_smp_rmb();
+	start = (end > TRACE_RING_SIZE) ? (end - TRACE_RING_SIZE) : 0;
+	if ((end - start) > count) {
+		start = end - count;
+	}
+
+	for (i = start; i < end; i++) {
+		memcpy(&entries[i - start],
+		       &r->entries[i & TRACE_RING_MASK],
+		       sizeof(*entries));
+	}
+
+	/* Drop entries which the writer may have overwritten while
+	 * we were copying (including the one it may be writing now).
+	 */
+	arch_smp_rmb();
+	i = *((volatile u64 *)&r->head) + 1;
+	valid = (i > TRACE_RING_SIZE) ? (i - TRACE_RING_SIZE) : 0;
+	if (valid > start) {
+		if (valid >= end) {
+			return 0;
+		}
+		memmove(entries, &entries[valid - start],
+			(end - valid) * sizeof(*entries));
+		start = valid;
+	}
+
+	return end - start;
+}
+VMM_EXPORT_SYMBOL(vmm_trace_read);
@@ -29,6 +29,7 @@
 #include <vmm_scheduler.h>
 #include <vmm_devtree.h>
 #include <vmm_vcpu_irq.h>
+#include <vmm_trace.h>
 #include <libs/stringlib.h>
 
 #define DEASSERTED	0
@@ -193,6 +194,8 @@ void vmm_vcpu_irq_assert(struct vmm_vcpu *vcpu, u32 irq_no, u64 reason)
 	/* Assert the irq */
 	if (arch_atomic_cmpxchg(&vcpu->irqs.irq[irq_no].assert, 
 				DEASSERTED, ASSERTED) == DEASSERTED) {
+		vmm_trace(VMM_TRACE_CAT_IRQ, VMM_TRACE_VCPU_IRQ_ASSERT,
+			  vcpu->id, irq_no, reason);
 		if (arch_vcpu_irq_assert(vcpu, irq_no, reason) == VMM_OK) {
 			vcpu->irqs.irq[irq_no].reason = reason;
 			arch_atomic_inc(&vcpu->irqs.execute_pending);
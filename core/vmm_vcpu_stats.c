@@ -0,0 +1,179 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vmm_vcpu_stats.c
+ * @author agent (agent@local)
+ * @brief source file for VCPU exit and event statistics
+ */
+
+#include <vmm_stdio.h>
+#include <vmm_timer.h>
+#include <vmm_vcpu_stats.h>
+#include <libs/stringlib.h>
+#include <libs/mathlib.h>
+#include <libs/bitops.h>
+
+static const char *exit_names[VMM_VCPU_EXIT_MAX] = {
+	[VMM_VCPU_EXIT_OTHER] = "other",
+	[VMM_VCPU_EXIT_STAGE2_FAULT] = "stage2_fault",
+	[VMM_VCPU_EXIT_MMIO] = "mmio",
+	[VMM_VCPU_EXIT_SYSREG] = "sysreg",
+	[VMM_VCPU_EXIT_WFI_WFE] = "wfi_wfe",
+	[VMM_VCPU_EXIT_HYPERCALL] = "hypercall",
+	[VMM_VCPU_EXIT_FPU] = "fpu",
+	[VMM_VCPU_EXIT_IRQ] = "irq",
+};
+
+static const char *event_names[VMM_VCPU_EVENT_MAX] = {
+	[VMM_VCPU_EVENT_VGIC_MAINT] = "vgic_maint",
+	[VMM_VCPU_EVENT_IPI] = "ipi",
+};
+
+const char *vmm_vcpu_stats_exit_name(u32 type)
+{
+	return (type < VMM_VCPU_EXIT_MAX) ? exit_names[type] : "unknown";
+}
+
+const char *vmm_vcpu_stats_event_name(u32 event)
+{
+	return (event < VMM_VCPU_EVENT_MAX) ? event_names[event] : "unknown";
+}
+
+void vmm_vcpu_stats_exit_begin(struct vmm_vcpu_stats *stats, u32 type)
+{
+	stats->exit_type = (type < VMM_VCPU_EXIT_MAX) ?
+					type : VMM_VCPU_EXIT_OTHER;
+	stats->exit_tstamp = vmm_timer_timestamp();
+}
+
+void vmm_vcpu_stats_exit_end(struct vmm_vcpu_stats *stats)
+{
+	int b;
+	u64 nsecs, tstamp = vmm_timer_timestamp();
+	u32 type = stats->exit_type;
+
+	if (!stats->exit_tstamp || (type >= VMM_VCPU_EXIT_MAX)) {
+		return;
+	}
+
+	nsecs = (tstamp > stats->exit_tstamp) ?
+				(tstamp - stats->exit_tstamp) : 0;
+	stats->exit_tstamp = 0;
+
+	if (nsecs >> VMM_VCPU_STATS_HIST_SHIFT) {
+		b = fls64(nsecs) - VMM_VCPU_STATS_HIST_SHIFT;
+		if (b >= VMM_VCPU_STATS_HIST_BUCKETS) {
+			b = VMM_VCPU_STATS_HIST_BUCKETS - 1;
+		}
+	} else {
+		b = 0;
+	}
+
+	stats->exit_count[type]++;
+	stats->exit_nsecs[type] += nsecs;
+	stats->exit_hist[type][b]++;
+}
+
+void vmm_vcpu_stats_reset(struct vmm_vcpu_stats *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+	stats->reset_tstamp = vmm_timer_timestamp();
+}
+
+void vmm_vcpu_stats_accumulate(struct vmm_vcpu_stats *dst,
+			       const struct vmm_vcpu_stats *src)
+{
+	u32 t, b;
+
+	for (t = 0; t < VMM_VCPU_EXIT_MAX; t++) {
+		dst->exit_count[t] += src->exit_count[t];
+		dst->exit_nsecs[t] += src->exit_nsecs[t];
+		for (b = 0; b < VMM_VCPU_STATS_HIST_BUCKETS; b++) {
+			dst->exit_hist[t][b] += src->exit_hist[t][b];
+		}
+	}
+	for (t = 0; t < VMM_VCPU_EVENT_MAX; t++) {
+		dst->event_count[t] += src->event_count[t];
+	}
+	if (!dst->reset_tstamp ||
+	    (src->reset_tstamp && (src->reset_tstamp < dst->reset_tstamp))) {
+		dst->reset_tstamp = src->reset_tstamp;
+	}
+}
+
+void vmm_vcpu_stats_dump(struct vmm_chardev *cdev,
+			 const struct vmm_vcpu_stats *stats)
+{
+	u32 t, b;
+	u64 tstamp = vmm_timer_timestamp();
+
+	if (stats->reset_tstamp && (tstamp > stats->reset_tstamp)) {
+		vmm_cprintf(cdev, "Time since reset: %"PRIu64" msecs\n",
+			    udiv64(tstamp - stats->reset_tstamp, 1000000));
+	}
+
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "--------------------------------\n");
+	vmm_cprintf(cdev, " %-16s %16s %16s %16s\n",
+		    "Exit", "Count", "Total (nsecs)", "Avg (nsecs)");
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "--------------------------------\n");
+	for (t = 0; t < VMM_VCPU_EXIT_MAX; t++) {
+		vmm_cprintf(cdev, " %-16s %16"PRIu64" %16"PRIu64" %16"PRIu64"\n",
+			    exit_names[t], stats->exit_count[t],
+			    stats->exit_nsecs[t],
+			    (stats->exit_count[t]) ?
+			    udiv64(stats->exit_nsecs[t],
+				   stats->exit_count[t]) : 0);
+	}
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "--------------------------------\n");
+	for (t = 0; t < VMM_VCPU_EVENT_MAX; t++) {
+		vmm_cprintf(cdev, " %-16s %16"PRIu64"\n",
+			    event_names[t], stats->event_count[t]);
+	}
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "--------------------------------\n");
+
+	for (t = 0; t < VMM_VCPU_EXIT_MAX; t++) {
+		if (!stats->exit_count[t]) {
+			continue;
+		}
+		vmm_cprintf(cdev, "Exit handling time of %s:\n",
+			    exit_names[t]);
+		for (b = 0; b < VMM_VCPU_STATS_HIST_BUCKETS; b++) {
+			if (!stats->exit_hist[t][b]) {
+				continue;
+			}
+			if (b == 0) {
+				vmm_cprintf(cdev, "  %10s - %-10u : ", "0",
+				    (1U << VMM_VCPU_STATS_HIST_SHIFT) - 1);
+			} else if (b == (VMM_VCPU_STATS_HIST_BUCKETS - 1)) {
+				vmm_cprintf(cdev, "  %10u - %-10s : ",
+				    1U << (b - 1 + VMM_VCPU_STATS_HIST_SHIFT),
+				    "inf");
+			} else {
+				vmm_cprintf(cdev, "  %10u - %-10u : ",
+				    1U << (b - 1 + VMM_VCPU_STATS_HIST_SHIFT),
+				    (1U << (b + VMM_VCPU_STATS_HIST_SHIFT)) - 1);
+			}
+			vmm_cprintf(cdev, "%"PRIu64"\n",
+				    stats->exit_hist[t][b]);
+		}
+	}
+}
@@ -0,0 +1,784 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file cowblk.c
+ * @author agent (agent@local)
+ * @brief Copy-on-write overlay block device driver.
+ *
+ * All read/write requests of a COWBLK instance are processed by the
+ * worker thread of its block request queue using blocking IO on base
+ * and write layer block devices.
+ */
+
+#include <vmm_error.h>
+#include <vmm_heap.h>
+#include <vmm_limits.h>
+#include <vmm_mutex.h>
+#include <vmm_host_io.h>
+#include <vmm_modules.h>
+#include <block/vmm_blockrq.h>
+#include <libs/mathlib.h>
+#include <libs/stringlib.h>
+#include <libs/scatterlist.h>
+#include <drv/cowblk.h>
+
+#define MODULE_DESC			"Copy-on-write Overlay Block Driver"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		(COWBLK_IPRIORITY)
+#define	MODULE_INIT			cowblk_driver_init
+#define	MODULE_EXIT			cowblk_driver_exit
+
+/* Max pending requests of a COWBLK instance */
+#define COWBLK_MAX_PENDING		16
+
+/* Max scatter-gather entries handled in one request */
+#define COWBLK_MAX_SG_NENTS		256
+
+/* Max bytes handled by one WRITE_ZEROES request */
+#define COWBLK_MAX_ZERO_SIZE		0x80000000
+
+static LIST_HEAD(cowblk_list);
+static DEFINE_MUTEX(cowblk_list_lock);
+
+/* Contiguous range of base or write layer pending IO */
+struct cowblk_run {
+	struct vmm_blockdev *bdev;
+	enum vmm_request_type type;
+	u64 off;
+	u8 *buf;
+	u32 len;
+};
+
+static int cowblk_run_flush(struct cowblk_run *run)
+{
+	u32 len = run->len;
+
+	if (!len) {
+		return VMM_OK;
+	}
+	run->len = 0;
+
+	if (vmm_blockdev_rw(run->bdev, run->type,
+			    run->buf, run->off, len) != len) {
+		return VMM_EIO;
+	}
+
+	return VMM_OK;
+}
+
+/* Add range to current run or flush current run and start new one */
+static int cowblk_run_add(struct cowblk_run *run, struct vmm_blockdev *bdev,
+			  u64 off, u8 *buf, u32 len)
+{
+	int rc;
+
+	if (run->len && (run->bdev == bdev) &&
+	    ((run->off + run->len) == off) &&
+	    ((run->buf + run->len) == buf)) {
+		run->len += len;
+		return VMM_OK;
+	}
+
+	rc = cowblk_run_flush(run);
+	if (rc) {
+		return rc;
+	}
+
+	run->bdev = bdev;
+	run->off = off;
+	run->buf = buf;
+	run->len = len;
+
+	return VMM_OK;
+}
+
+/* Number of valid bytes in given base cluster */
+static u32 cowblk_cluster_len(struct cowblk *cb, u32 c)
+{
+	u64 base_size = cb->bdev->num_blocks * cb->bdev->block_size;
+	u64 start = (u64)c << cb->cluster_bits;
+	u32 csize = 1 << cb->cluster_bits;
+
+	return ((base_size - start) < csize) ? (base_size - start) : csize;
+}
+
+/* Write block of cluster map containing entry of given cluster */
+static int cowblk_map_write(struct cowblk *cb, u32 c)
+{
+	u32 bsize = cb->layer->block_size;
+	u64 off = ((u64)c * sizeof(u32)) & ~((u64)bsize - 1);
+
+	if (vmm_blockdev_write(cb->layer, (u8 *)cb->map + off,
+			       cb->map_offset + off, bsize) != bsize) {
+		return VMM_EIO;
+	}
+
+	return VMM_OK;
+}
+
+/* Copy given cluster to a new write layer slot and apply write */
+static int cowblk_cluster_alloc(struct cowblk *cb, u32 c, u32 coff,
+				u8 *buf, u32 len)
+{
+	int rc;
+	u8 *data = buf;
+	u32 slot, clen = cowblk_cluster_len(cb, c);
+
+	if (cb->max_slots <= cb->used_slots) {
+		return VMM_ENOSPC;
+	}
+	slot = cb->used_slots;
+
+	if (coff || (len < clen)) {
+		if (vmm_blockdev_read(cb->base, cb->cluster,
+				      (u64)c << cb->cluster_bits,
+				      clen) != clen) {
+			return VMM_EIO;
+		}
+		memcpy(cb->cluster + coff, buf, len);
+		data = cb->cluster;
+	}
+
+	/* Write data slot first and then point map entry to it */
+	if (vmm_blockdev_write(cb->layer, data,
+			cb->data_offset + ((u64)slot << cb->cluster_bits),
+			clen) != clen) {
+		return VMM_EIO;
+	}
+
+	cb->map[c] = vmm_cpu_to_le32(slot + 1);
+	rc = cowblk_map_write(cb, c);
+	if (rc) {
+		cb->map[c] = 0;
+		return rc;
+	}
+	cb->used_slots++;
+
+	return VMM_OK;
+}
+
+static int cowblk_rw_buf(struct cowblk *cb, struct cowblk_run *run,
+			 u64 off, u8 *buf, u32 len)
+{
+	int rc;
+	u64 loff;
+	u32 c, coff, chunk, slot;
+	u32 csize = 1 << cb->cluster_bits;
+
+	while (len) {
+		c = off >> cb->cluster_bits;
+		coff = off & (csize - 1);
+		chunk = csize - coff;
+		chunk = (len < chunk) ? len : chunk;
+		slot = vmm_le32_to_cpu(cb->map[c]);
+
+		if (slot) {
+			loff = cb->data_offset;
+			loff += ((u64)(slot - 1) << cb->cluster_bits) + coff;
+			rc = cowblk_run_add(run, cb->layer, loff, buf, chunk);
+		} else if (run->type == VMM_REQUEST_READ) {
+			rc = cowblk_run_add(run, cb->base, off, buf, chunk);
+		} else {
+			rc = cowblk_run_flush(run);
+			if (!rc) {
+				rc = cowblk_cluster_alloc(cb, c, coff,
+							  buf, chunk);
+			}
+		}
+		if (rc) {
+			return rc;
+		}
+
+		off += chunk;
+		buf += chunk;
+		len -= chunk;
+	}
+
+	return VMM_OK;
+}
+
+static int cowblk_rw(struct cowblk *cb, struct vmm_request *r,
+		     enum vmm_request_type type)
+{
+	int rc = VMM_OK;
+	u32 i;
+	struct scatterlist *sg;
+	struct cowblk_run run;
+	u64 off = r->lba * cb->bdev->block_size;
+
+	run.bdev = NULL;
+	run.type = type;
+	run.off = 0;
+	run.buf = NULL;
+	run.len = 0;
+
+	vmm_mutex_lock(&cb->io_lock);
+
+	if (!cb->base || !cb->layer) {
+		rc = VMM_EIO;
+		goto done;
+	}
+
+	if (!r->sgl) {
+		rc = cowblk_rw_buf(cb, &run, off, r->data,
+				   r->bcnt * cb->bdev->block_size);
+	} else {
+		for_each_sg(r->sgl, sg, r->sg_nents, i) {
+			rc = cowblk_rw_buf(cb, &run, off,
+					   sg_virt(sg), sg->length);
+			if (rc) {
+				break;
+			}
+			off += sg->length;
+		}
+	}
+	if (!rc) {
+		rc = cowblk_run_flush(&run);
+	}
+
+done:
+	vmm_mutex_unlock(&cb->io_lock);
+
+	return rc;
+}
+
+/* Zero given range by writing zeros to write layer
+ * Note: Clusters still in base are copied-up because we don't know
+ * whether they are zero in base.
+ */
+static int cowblk_zero(struct cowblk *cb, struct vmm_request *r)
+{
+	int rc = VMM_OK;
+	u8 *zero;
+	u32 c, coff, chunk, slot;
+	u32 csize = 1 << cb->cluster_bits;
+	u64 loff, off = r->lba * cb->bdev->block_size;
+	u64 len = (u64)r->bcnt * cb->bdev->block_size;
+
+	zero = vmm_zalloc(csize);
+	if (!zero) {
+		return VMM_ENOMEM;
+	}
+
+	vmm_mutex_lock(&cb->io_lock);
+
+	if (!cb->base || !cb->layer) {
+		rc = VMM_EIO;
+		goto done;
+	}
+
+	while (len) {
+		c = off >> cb->cluster_bits;
+		coff = off & (csize - 1);
+		chunk = csize - coff;
+		chunk = (len < chunk) ? len : chunk;
+		slot = vmm_le32_to_cpu(cb->map[c]);
+
+		if (slot) {
+			loff = cb->data_offset;
+			loff += ((u64)(slot - 1) << cb->cluster_bits) + coff;
+			if (vmm_blockdev_write(cb->layer, zero,
+					       loff, chunk) != chunk) {
+				rc = VMM_EIO;
+			}
+		} else {
+			rc = cowblk_cluster_alloc(cb, c, coff, zero, chunk);
+		}
+		if (rc) {
+			break;
+		}
+
+		off += chunk;
+		len -= chunk;
+	}
+
+done:
+	vmm_mutex_unlock(&cb->io_lock);
+	vmm_free(zero);
+
+	return rc;
+}
+
+static int cowblk_read_request(struct vmm_blockrq *brq,
+			       struct vmm_request *r, void *priv)
+{
+	return cowblk_rw(priv, r, VMM_REQUEST_READ);
+}
+
+static int cowblk_write_request(struct vmm_blockrq *brq,
+				struct vmm_request *r, void *priv)
+{
+	return cowblk_rw(priv, r, VMM_REQUEST_WRITE);
+}
+
+static int cowblk_write_zeroes_request(struct vmm_blockrq *brq,
+				       struct vmm_request *r, void *priv)
+{
+	return cowblk_zero(priv, r);
+}
+
+static void cowblk_flush_request(struct vmm_blockrq *brq, void *priv)
+{
+	struct cowblk *cb = priv;
+
+	vmm_mutex_lock(&cb->io_lock);
+	if (cb->layer) {
+		vmm_blockdev_flush_cache(cb->layer);
+	}
+	vmm_mutex_unlock(&cb->io_lock);
+}
+
+/* Number of clusters required for cluster map */
+static u32 cowblk_map_clusters(u32 num_clusters, u32 cluster_bits)
+{
+	u64 sz = (u64)num_clusters * sizeof(u32);
+
+	return (sz + (1 << cluster_bits) - 1) >> cluster_bits;
+}
+
+static int cowblk_check_devices(struct vmm_blockdev *base,
+				struct vmm_blockdev *layer,
+				u32 cluster_bits)
+{
+	if (!base || !layer || (base == layer)) {
+		return VMM_ENODEV;
+	}
+	if (!(layer->flags & VMM_BLOCKDEV_RW)) {
+		return VMM_EINVALID;
+	}
+	if (base->block_size != layer->block_size) {
+		return VMM_EINVALID;
+	}
+	if ((cluster_bits < COWBLK_MIN_CLUSTER_BITS) ||
+	    (COWBLK_MAX_CLUSTER_BITS < cluster_bits) ||
+	    ((1 << cluster_bits) < base->block_size) ||
+	    ((1 << cluster_bits) & (base->block_size - 1))) {
+		return VMM_EINVALID;
+	}
+
+	return VMM_OK;
+}
+
+int cowblk_format(const char *base_name, const char *layer_name,
+		  u32 cluster_bits)
+{
+	int rc = VMM_OK;
+	u8 *buf;
+	u32 i, csize, map_clusters;
+	u64 num_clusters, base_size, layer_size;
+	struct cowblk_header hdr;
+	struct vmm_blockdev *base, *layer;
+
+	if (!base_name || !layer_name) {
+		return VMM_EINVALID;
+	}
+	if (!cluster_bits) {
+		cluster_bits = COWBLK_DEF_CLUSTER_BITS;
+	}
+
+	base = vmm_blockdev_find(base_name);
+	layer = vmm_blockdev_find(layer_name);
+	rc = cowblk_check_devices(base, layer, cluster_bits);
+	if (rc) {
+		return rc;
+	}
+
+	csize = 1 << cluster_bits;
+	base_size = base->num_blocks * base->block_size;
+	layer_size = layer->num_blocks * layer->block_size;
+	num_clusters = (base_size + csize - 1) >> cluster_bits;
+	if (!num_clusters || (U32_MAX <= num_clusters)) {
+		return VMM_EINVALID;
+	}
+	map_clusters = cowblk_map_clusters(num_clusters, cluster_bits);
+
+	/* Write layer must have room for at least one data slot */
+	if (layer_size < (((u64)map_clusters + 2) << cluster_bits)) {
+		return VMM_ENOSPC;
+	}
+
+	buf = vmm_zalloc(csize);
+	if (!buf) {
+		return VMM_ENOMEM;
+	}
+
+	/* Zero cluster map first and write header at the end */
+	for (i = 0; i < map_clusters; i++) {
+		if (vmm_blockdev_write(layer, buf,
+				       (u64)(i + 1) << cluster_bits,
+				       csize) != csize) {
+			rc = VMM_EIO;
+			goto done;
+		}
+	}
+
+	hdr.magic = vmm_cpu_to_le32(COWBLK_MAGIC);
+	hdr.version = vmm_cpu_to_le32(COWBLK_VERSION);
+	hdr.cluster_bits = vmm_cpu_to_le32(cluster_bits);
+	hdr.num_clusters = vmm_cpu_to_le32((u32)num_clusters);
+	hdr.base_blocks = vmm_cpu_to_le64(base->num_blocks);
+	hdr.block_size = vmm_cpu_to_le32(base->block_size);
+	hdr.reserved = 0;
+	memcpy(buf, &hdr, sizeof(hdr));
+	if (vmm_blockdev_write(layer, buf, 0, csize) != csize) {
+		rc = VMM_EIO;
+		goto done;
+	}
+
+	rc = vmm_blockdev_flush_cache(layer);
+
+done:
+	vmm_free(buf);
+	return rc;
+}
+VMM_EXPORT_SYMBOL(cowblk_format);
+
+static int cowblk_load(struct cowblk *cb)
+{
+	u32 i, slot, csize, map_clusters;
+	u64 map_size, layer_size, slots;
+	struct cowblk_header hdr;
+	struct vmm_blockdev *base = cb->base, *layer = cb->layer;
+
+	if (vmm_blockdev_read(layer, (u8 *)&hdr, 0,
+			      sizeof(hdr)) != sizeof(hdr)) {
+		return VMM_EIO;
+	}
+	if ((vmm_le32_to_cpu(hdr.magic) != COWBLK_MAGIC) ||
+	    (vmm_le32_to_cpu(hdr.version) != COWBLK_VERSION) ||
+	    (vmm_le64_to_cpu(hdr.base_blocks) != base->num_blocks) ||
+	    (vmm_le32_to_cpu(hdr.block_size) != base->block_size)) {
+		return VMM_EINVALID;
+	}
+
+	cb->cluster_bits = vmm_le32_to_cpu(hdr.cluster_bits);
+	if (cowblk_check_devices(base, layer, cb->cluster_bits)) {
+		return VMM_EINVALID;
+	}
+	csize = 1 << cb->cluster_bits;
+
+	cb->num_clusters = vmm_le32_to_cpu(hdr.num_clusters);
+	if (cb->num_clusters !=
+	    udiv64(base->num_blocks * base->block_size + csize - 1, csize)) {
+		return VMM_EINVALID;
+	}
+
+	map_clusters = cowblk_map_clusters(cb->num_clusters, cb->cluster_bits);
+	map_size = (u64)map_clusters << cb->cluster_bits;
+	cb->map_offset = csize;
+	cb->data_offset = cb->map_offset + map_size;
+
+	layer_size = layer->num_blocks * layer->block_size;
+	if (layer_size <= cb->data_offset) {
+		return VMM_ENOSPC;
+	}
+	slots = (layer_size - cb->data_offset) >> cb->cluster_bits;
+	cb->max_slots = (U32_MAX <= slots) ? (U32_MAX - 1) : slots;
+	if (!cb->max_slots) {
+		return VMM_ENOSPC;
+	}
+
+	cb->map = vmm_malloc(map_size);
+	cb->cluster = vmm_malloc(csize);
+	if (!cb->map || !cb->cluster) {
+		return VMM_ENOMEM;
+	}
+	if (vmm_blockdev_read(layer, (u8 *)cb->map,
+			      cb->map_offset, map_size) != map_size) {
+		return VMM_EIO;
+	}
+
+	/* Slots are allocated sequentially so highest slot is usage */
+	cb->used_slots = 0;
+	for (i = 0; i < cb->num_clusters; i++) {
+		slot = vmm_le32_to_cpu(cb->map[i]);
+		if (cb->max_slots < slot) {
+			return VMM_EINVALID;
+		}
+		if (cb->used_slots < slot) {
+			cb->used_slots = slot;
+		}
+	}
+
+	return VMM_OK;
+}
+
+static void cowblk_free(struct cowblk *cb)
+{
+	if (cb->cluster) {
+		vmm_free(cb->cluster);
+	}
+	if (cb->map) {
+		vmm_free(cb->map);
+	}
+	vmm_free(cb);
+}
+
+struct cowblk *cowblk_create(const char *name,
+			      const char *base_name,
+			      const char *layer_name)
+{
+	struct cowblk *cb;
+	struct vmm_blockrq *brq;
+
+	if (!name || !base_name || !layer_name) {
+		return NULL;
+	}
+
+	cb = vmm_zalloc(sizeof(struct cowblk));
+	if (!cb) {
+		goto free_nothing;
+	}
+	INIT_LIST_HEAD(&cb->head);
+	INIT_MUTEX(&cb->io_lock);
+	strncpy(cb->base_name, base_name, sizeof(cb->base_name));
+	cb->base_name[sizeof(cb->base_name) - 1] = '\0';
+	strncpy(cb->layer_name, layer_name, sizeof(cb->layer_name));
+	cb->layer_name[sizeof(cb->layer_name) - 1] = '\0';
+
+	cb->base = vmm_blockdev_find(cb->base_name);
+	cb->layer = vmm_blockdev_find(cb->layer_name);
+	if (!cb->base || !cb->layer) {
+		goto free_cowblk;
+	}
+
+	if (cowblk_load(cb)) {
+		goto free_cowblk;
+	}
+
+	cb->bdev = vmm_blockdev_alloc();
+	if (!cb->bdev) {
+		goto free_cowblk;
+	}
+
+	/* Setup block device instance */
+	strncpy(cb->bdev->name, name, VMM_FIELD_NAME_SIZE);
+	strncpy(cb->bdev->desc, "Copy-on-write overlay block device",
+		VMM_FIELD_DESC_SIZE);
+	cb->bdev->flags = VMM_BLOCKDEV_RW;
+	cb->bdev->start_lba = 0;
+	cb->bdev->num_blocks = cb->base->num_blocks;
+	cb->bdev->block_size = cb->base->block_size;
+
+	/* Setup request queue for block device instance */
+	brq = vmm_blockrq_create(name, COWBLK_MAX_PENDING, FALSE,
+				 cowblk_read_request,
+				 cowblk_write_request,
+				 NULL,
+				 cowblk_flush_request,
+				 cb);
+	if (!brq) {
+		goto free_bdev;
+	}
+	vmm_blockrq_set_sg_limits(brq, COWBLK_MAX_SG_NENTS, FALSE);
+	vmm_blockrq_set_write_zeroes(brq, cowblk_write_zeroes_request,
+			udiv32(COWBLK_MAX_ZERO_SIZE, cb->bdev->block_size));
+	cb->bdev->rq = vmm_blockrq_to_rq(brq);
+
+	/* Add to list of COWBLK instances before block device
+	 * registration so that we don't miss unregister events
+	 * of base and write layer block devices.
+	 */
+	vmm_mutex_lock(&cowblk_list_lock);
+	list_add_tail(&cb->head, &cowblk_list);
+	vmm_mutex_unlock(&cowblk_list_lock);
+
+	/* Register block device instance */
+	if (vmm_blockdev_register(cb->bdev)) {
+		goto del_cowblk;
+	}
+
+	return cb;
+
+del_cowblk:
+	vmm_mutex_lock(&cowblk_list_lock);
+	list_del(&cb->head);
+	vmm_mutex_unlock(&cowblk_list_lock);
+	vmm_blockrq_destroy(vmm_rq_to_blockrq(cb->bdev->rq));
+free_bdev:
+	vmm_blockdev_free(cb->bdev);
+free_cowblk:
+	cowblk_free(cb);
+free_nothing:
+	return NULL;
+}
+VMM_EXPORT_SYMBOL(cowblk_create);
+
+void cowblk_destroy(struct cowblk *cb)
+{
+	/* Sanity check */
+	if (!cb) {
+		return;
+	}
+
+	/* Unregister block device */
+	vmm_blockdev_unregister(cb->bdev);
+
+	/* Free block device request queue */
+	vmm_blockrq_destroy(vmm_rq_to_blockrq(cb->bdev->rq));
+
+	/* Free block device */
+	vmm_blockdev_free(cb->bdev);
+
+	/* Remove from list of COWBLK instances */
+	vmm_mutex_lock(&cowblk_list_lock);
+	list_del(&cb->head);
+	vmm_mutex_unlock(&cowblk_list_lock);
+
+	/* Flush write layer */
+	vmm_mutex_lock(&cb->io_lock);
+	if (cb->layer) {
+		vmm_blockdev_flush_cache(cb->layer);
+	}
+	vmm_mutex_unlock(&cb->io_lock);
+
+	/* Free COWBLK instance */
+	cowblk_free(cb);
+}
+VMM_EXPORT_SYMBOL(cowblk_destroy);
+
+struct cowblk *cowblk_find(const char *name)
+{
+	bool found;
+	struct cowblk *cb;
+
+	if (!name) {
+		return NULL;
+	}
+
+	found = FALSE;
+
+	vmm_mutex_lock(&cowblk_list_lock);
+
+	list_for_each_entry(cb, &cowblk_list, head) {
+		if (strcmp(cb->bdev->name, name) == 0) {
+			found = TRUE;
+			break;
+		}
+	}
+
+	vmm_mutex_unlock(&cowblk_list_lock);
+
+	return (found) ? cb : NULL;
+}
+VMM_EXPORT_SYMBOL(cowblk_find);
+
+struct cowblk *cowblk_get(int index)
+{
+	bool found;
+	struct cowblk *cb;
+
+	if (index < 0) {
+		return NULL;
+	}
+
+	found = FALSE;
+
+	vmm_mutex_lock(&cowblk_list_lock);
+
+	list_for_each_entry(cb, &cowblk_list, head) {
+		if (!index) {
+			found = TRUE;
+			break;
+		}
+		index--;
+	}
+
+	vmm_mutex_unlock(&cowblk_list_lock);
+
+	return (found) ? cb : NULL;
+}
+VMM_EXPORT_SYMBOL(cowblk_get);
+
+u32 cowblk_count(void)
+{
+	u32 retval = 0;
+	struct cowblk *cb;
+
+	vmm_mutex_lock(&cowblk_list_lock);
+
+	list_for_each_entry(cb, &cowblk_list, head) {
+		retval++;
+	}
+
+	vmm_mutex_unlock(&cowblk_list_lock);
+
+	return retval;
+}
+VMM_EXPORT_SYMBOL(cowblk_count);
+
+static int cowblk_blockdev_event(struct vmm_notifier_block *nb,
+				 unsigned long evt, void *data)
+{
+	struct cowblk *cb;
+	struct vmm_blockdev_event *e = data;
+
+	if (evt != VMM_BLOCKDEV_EVENT_UNREGISTER) {
+		/* We are only interested in unregister events so,
+		 * don't care about this event.
+		 */
+		return NOTIFY_DONE;
+	}
+
+	vmm_mutex_lock(&cowblk_list_lock);
+
+	/* Forget base or write layer block device going away */
+	list_for_each_entry(cb, &cowblk_list, head) {
+		vmm_mutex_lock(&cb->io_lock);
+		if (cb->base == e->bdev) {
+			cb->base = NULL;
+		}
+		if (cb->layer == e->bdev) {
+			cb->layer = NULL;
+		}
+		vmm_mutex_unlock(&cb->io_lock);
+	}
+
+	vmm_mutex_unlock(&cowblk_list_lock);
+
+	return NOTIFY_OK;
+}
+
+static struct vmm_notifier_block cowblk_blockdev_client = {
+	.notifier_call = &cowblk_blockdev_event,
+	.priority = 0,
+};
+
+static int __init cowblk_driver_init(void)
+{
+	return vmm_blockdev_register_client(&cowblk_blockdev_client);
+}
+
+static void __exit cowblk_driver_exit(void)
+{
+	struct cowblk *cb;
+
+	while ((cb = cowblk_get(0))) {
+		cowblk_destroy(cb);
+	}
+
+	vmm_blockdev_unregister_client(&cowblk_blockdev_client);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+			MODULE_AUTHOR,
+			MODULE_LICENSE,
+			MODULE_IPRIORITY,
+			MODULE_INIT,
+			MODULE_EXIT);
@@ -0,0 +1,856 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file fileblk.c
+ * @author agent (agent@local)
+ * @brief VFS file backed block device driver.
+ *
+ * All read/write requests of a FILEBLK instance are processed by
+ * the worker thread of its block request queue, so the VFS file
+ * offset and sparse image metadata are never updated concurrently.
+ */
+
+#include <vmm_error.h>
+#include <vmm_heap.h>
+#include <vmm_limits.h>
+#include <vmm_spinlocks.h>
+#include <vmm_host_io.h>
+#include <vmm_modules.h>
+#include <block/vmm_blockrq.h>
+#include <libs/mathlib.h>
+#include <libs/stringlib.h>
+#include <libs/scatterlist.h>
+#include <drv/fileblk.h>
+
+#define MODULE_DESC			"File Backed Block Driver"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		(FILEBLK_IPRIORITY)
+#define	MODULE_INIT			fileblk_driver_init
+#define	MODULE_EXIT			fileblk_driver_exit
+
+/* Max pending requests of a FILEBLK instance */
+#define FILEBLK_MAX_PENDING		16
+
+/* Max scatter-gather entries handled in one request */
+#define FILEBLK_MAX_SG_NENTS		256
+
+/* Number of L2 tables cached per sparse image */
+#define FILEBLK_L2_CACHE_SIZE		8
+
+/* Max blocks handled by one DISCARD or WRITE_ZEROES request */
+#define FILEBLK_MAX_ZERO_BLOCKS		(0x80000000 / FILEBLK_BLOCK_SIZE)
+
+/* Size of zero buffer used for zeroing raw image */
+#define FILEBLK_ZERO_BUF_SIZE		(64 * 1024)
+
+static LIST_HEAD(fileblk_list);
+static DEFINE_SPINLOCK(fileblk_list_lock);
+
+struct fileblk_l2_cache {
+	bool valid;
+	u32 l1_index;
+	u64 tick;
+	u64 *table;
+};
+
+struct fileblk_sparse {
+	u32 cluster_bits;
+	u32 l2_bits;
+	u32 l1_entries;
+	u64 l1_offset;
+	u64 *l1;
+	u8 *cluster;
+	u64 l2_tick;
+	struct fileblk_l2_cache l2_cache[FILEBLK_L2_CACHE_SIZE];
+	/* Clusters released by DISCARD or WRITE_ZEROES which are
+	 * reused by fileblk_append() before growing backing file.
+	 * Note: This list is not persistent so released clusters
+	 * are leaked in backing file upon destroy.
+	 */
+	u64 *free;
+	u32 free_count;
+	u32 free_max;
+};
+
+static int fileblk_pread(int fd, u64 off, void *buf, size_t len)
+{
+	if (vfs_lseek(fd, off, SEEK_SET) != (loff_t)off) {
+		return VMM_EIO;
+	}
+
+	return (vfs_read(fd, buf, len) == len) ? VMM_OK : VMM_EIO;
+}
+
+static int fileblk_pwrite(int fd, u64 off, void *buf, size_t len)
+{
+	if (vfs_lseek(fd, off, SEEK_SET) != (loff_t)off) {
+		return VMM_EIO;
+	}
+
+	return (vfs_write(fd, buf, len) == len) ? VMM_OK : VMM_EIO;
+}
+
+/* Append one cluster at end of backing file */
+static int fileblk_append(struct fileblk *fb, void *buf, u64 *off)
+{
+	int rc;
+	u32 csize = 1 << fb->sparse->cluster_bits;
+
+	if (fb->sparse->free_count) {
+		*off = fb->sparse->free[fb->sparse->free_count - 1];
+		rc = fileblk_pwrite(fb->fd, *off, buf, csize);
+		if (!rc) {
+			fb->sparse->free_count--;
+		}
+		return rc;
+	}
+
+	*off = fb->file_size;
+	rc = fileblk_pwrite(fb->fd, *off, buf, csize);
+	if (rc) {
+		/* Partial write possible so re-sync file size */
+		fb->file_size = vfs_lseek(fb->fd, 0, SEEK_END);
+		return rc;
+	}
+	fb->file_size += csize;
+
+	return VMM_OK;
+}
+
+/* Remember released cluster for reuse by fileblk_append() */
+static void fileblk_release(struct fileblk *fb, u64 off)
+{
+	u64 *free;
+	u32 free_max;
+	struct fileblk_sparse *s = fb->sparse;
+
+	if (s->free_count == s->free_max) {
+		free_max = (s->free_max) ? (2 * s->free_max) : 64;
+		free = vmm_malloc(free_max * sizeof(*free));
+		if (!free) {
+			/* Cluster is leaked in backing file */
+			return;
+		}
+		if (s->free) {
+			memcpy(free, s->free, s->free_count * sizeof(*free));
+			vmm_free(s->free);
+		}
+		s->free = free;
+		s->free_max = free_max;
+	}
+
+	s->free[s->free_count++] = off;
+}
+
+static u64 *fileblk_l2_get(struct fileblk *fb, u32 l1_index,
+			   bool alloc, int *err)
+{
+	u32 i;
+	u64 off;
+	struct fileblk_sparse *s = fb->sparse;
+	struct fileblk_l2_cache *c, *victim = NULL;
+	u32 csize = 1 << s->cluster_bits;
+
+	*err = VMM_OK;
+
+	for (i = 0; i < FILEBLK_L2_CACHE_SIZE; i++) {
+		c = &s->l2_cache[i];
+		if (c->valid && (c->l1_index == l1_index)) {
+			c->tick = ++s->l2_tick;
+			return c->table;
+		}
+		if (!c->valid) {
+			if (!victim || victim->valid) {
+				victim = c;
+			}
+		} else if (!victim ||
+			   (victim->valid && (c->tick < victim->tick))) {
+			victim = c;
+		}
+	}
+
+	off = vmm_le64_to_cpu(s->l1[l1_index]);
+	if (!off && !alloc) {
+		return NULL;
+	}
+
+	if (!victim->table) {
+		victim->table = vmm_malloc(csize);
+		if (!victim->table) {
+			*err = VMM_ENOMEM;
+			return NULL;
+		}
+	}
+	victim->valid = FALSE;
+
+	if (off) {
+		*err = fileblk_pread(fb->fd, off, victim->table, csize);
+		if (*err) {
+			return NULL;
+		}
+	} else {
+		/* Append zeroed L2 table and then point L1 entry to it */
+		memset(victim->table, 0, csize);
+		*err = fileblk_append(fb, victim->table, &off);
+		if (*err) {
+			return NULL;
+		}
+		s->l1[l1_index] = vmm_cpu_to_le64(off);
+		*err = fileblk_pwrite(fb->fd,
+				s->l1_offset + l1_index * sizeof(u64),
+				&s->l1[l1_index], sizeof(u64));
+		if (*err) {
+			s->l1[l1_index] = 0;
+			return NULL;
+		}
+	}
+
+	victim->valid = TRUE;
+	victim->l1_index = l1_index;
+	victim->tick = ++s->l2_tick;
+
+	return victim->table;
+}
+
+/* Read/write sparse image range which does not cross a cluster */
+static int fileblk_sparse_rw(struct fileblk *fb, u64 voff,
+			     u8 *buf, u32 len, bool write)
+{
+	int rc;
+	u64 *l2, off, l2_off;
+	u8 *data = buf;
+	struct fileblk_sparse *s = fb->sparse;
+	u32 csize = 1 << s->cluster_bits;
+	u32 l1_index = voff >> (s->cluster_bits + s->l2_bits);
+	u32 l2_index = (voff >> s->cluster_bits) & ((1 << s->l2_bits) - 1);
+	u32 coff = voff & (csize - 1);
+
+	l2 = fileblk_l2_get(fb, l1_index, write, &rc);
+	if (!l2) {
+		if (rc) {
+			return rc;
+		}
+		memset(buf, 0, len);
+		return VMM_OK;
+	}
+
+	off = vmm_le64_to_cpu(l2[l2_index]);
+	if (off) {
+		return (write) ? fileblk_pwrite(fb->fd, off + coff, buf, len) :
+				 fileblk_pread(fb->fd, off + coff, buf, len);
+	}
+
+	if (!write) {
+		memset(buf, 0, len);
+		return VMM_OK;
+	}
+
+	/* Append new data cluster and then point L2 entry to it */
+	if (coff || (len < csize)) {
+		memset(s->cluster, 0, csize);
+		memcpy(s->cluster + coff, buf, len);
+		data = s->cluster;
+	}
+	rc = fileblk_append(fb, data, &off);
+	if (rc) {
+		return rc;
+	}
+
+	l2[l2_index] = vmm_cpu_to_le64(off);
+	l2_off = vmm_le64_to_cpu(s->l1[l1_index]);
+	rc = fileblk_pwrite(fb->fd, l2_off + l2_index * sizeof(u64),
+			    &l2[l2_index], sizeof(u64));
+	if (rc) {
+		l2[l2_index] = 0;
+	}
+
+	return rc;
+}
+
+/* Zero sparse image range which does not cross a cluster
+ * Note: Fully covered clusters are deallocated so that they read
+ * as zeros and partially covered clusters are overwritten.
+ */
+static int fileblk_sparse_zero(struct fileblk *fb, u64 voff, u32 len)
+{
+	int rc;
+	u64 *l2, off, l2_off;
+	struct fileblk_sparse *s = fb->sparse;
+	u32 csize = 1 << s->cluster_bits;
+	u32 l1_index = voff >> (s->cluster_bits + s->l2_bits);
+	u32 l2_index = (voff >> s->cluster_bits) & ((1 << s->l2_bits) - 1);
+	u32 coff = voff & (csize - 1);
+
+	l2 = fileblk_l2_get(fb, l1_index, FALSE, &rc);
+	if (!l2) {
+		return rc;
+	}
+
+	off = vmm_le64_to_cpu(l2[l2_index]);
+	if (!off) {
+		return VMM_OK;
+	}
+
+	if (coff || (len < csize)) {
+		memset(s->cluster, 0, len);
+		return fileblk_pwrite(fb->fd, off + coff, s->cluster, len);
+	}
+
+	l2[l2_index] = 0;
+	l2_off = vmm_le64_to_cpu(s->l1[l1_index]);
+	rc = fileblk_pwrite(fb->fd, l2_off + l2_index * sizeof(u64),
+			    &l2[l2_index], sizeof(u64));
+	if (rc) {
+		l2[l2_index] = vmm_cpu_to_le64(off);
+		return rc;
+	}
+	fileblk_release(fb, off);
+
+	return VMM_OK;
+}
+
+static int fileblk_zero(struct fileblk *fb, struct vmm_request *r)
+{
+	int rc = VMM_OK;
+	u8 *zero;
+	u32 csize, chunk;
+	u64 voff = r->lba * FILEBLK_BLOCK_SIZE;
+	u64 len = (u64)r->bcnt * FILEBLK_BLOCK_SIZE;
+
+	if (fb->sparse) {
+		csize = 1 << fb->sparse->cluster_bits;
+		while (len) {
+			chunk = csize - (voff & (csize - 1));
+			chunk = (len < chunk) ? len : chunk;
+			rc = fileblk_sparse_zero(fb, voff, chunk);
+			if (rc) {
+				return rc;
+			}
+			voff += chunk;
+			len -= chunk;
+		}
+		return VMM_OK;
+	}
+
+	/* Raw image can't be deallocated so write zeros */
+	chunk = (len < FILEBLK_ZERO_BUF_SIZE) ? len : FILEBLK_ZERO_BUF_SIZE;
+	zero = vmm_zalloc(chunk);
+	if (!zero) {
+		return VMM_ENOMEM;
+	}
+	while (len) {
+		chunk = (len < FILEBLK_ZERO_BUF_SIZE) ?
+			len : FILEBLK_ZERO_BUF_SIZE;
+		rc = fileblk_pwrite(fb->fd, voff, zero, chunk);
+		if (rc) {
+			break;
+		}
+		voff += chunk;
+		len -= chunk;
+	}
+	vmm_free(zero);
+
+	return rc;
+}
+
+static int fileblk_rw_buf(struct fileblk *fb, u64 voff,
+			  u8 *buf, u32 len, bool write)
+{
+	int rc;
+	u32 csize, chunk;
+
+	if (!fb->sparse) {
+		return (write) ? fileblk_pwrite(fb->fd, voff, buf, len) :
+				 fileblk_pread(fb->fd, voff, buf, len);
+	}
+
+	csize = 1 << fb->sparse->cluster_bits;
+	while (len) {
+		chunk = csize - (voff & (csize - 1));
+		chunk = (len < chunk) ? len : chunk;
+		rc = fileblk_sparse_rw(fb, voff, buf, chunk, write);
+		if (rc) {
+			return rc;
+		}
+		voff += chunk;
+		buf += chunk;
+		len -= chunk;
+	}
+
+	return VMM_OK;
+}
+
+static int fileblk_rw(struct fileblk *fb, struct vmm_request *r, bool write)
+{
+	int rc;
+	u32 i;
+	struct scatterlist *sg;
+	u64 voff = r->lba * FILEBLK_BLOCK_SIZE;
+
+	if (!r->sgl) {
+		return fileblk_rw_buf(fb, voff, r->data,
+				      r->bcnt * FILEBLK_BLOCK_SIZE, write);
+	}
+
+	for_each_sg(r->sgl, sg, r->sg_nents, i) {
+		rc = fileblk_rw_buf(fb, voff, sg_virt(sg), sg->length, write);
+		if (rc) {
+			return rc;
+		}
+		voff += sg->length;
+	}
+
+	return VMM_OK;
+}
+
+static int fileblk_read_request(struct vmm_blockrq *brq,
+				struct vmm_request *r, void *priv)
+{
+	return fileblk_rw(priv, r, FALSE);
+}
+
+static int fileblk_write_request(struct vmm_blockrq *brq,
+				 struct vmm_request *r, void *priv)
+{
+	return fileblk_rw(priv, r, TRUE);
+}
+
+static int fileblk_zero_request(struct vmm_blockrq *brq,
+				struct vmm_request *r, void *priv)
+{
+	return fileblk_zero(priv, r);
+}
+
+static void fileblk_flush_request(struct vmm_blockrq *brq, void *priv)
+{
+	struct fileblk *fb = priv;
+
+	if (!fb->read_only) {
+		vfs_fsync(fb->fd);
+	}
+}
+
+static void fileblk_sparse_free(struct fileblk_sparse *s)
+{
+	u32 i;
+
+	if (!s) {
+		return;
+	}
+
+	for (i = 0; i < FILEBLK_L2_CACHE_SIZE; i++) {
+		if (s->l2_cache[i].table) {
+			vmm_free(s->l2_cache[i].table);
+		}
+	}
+	if (s->cluster) {
+		vmm_free(s->cluster);
+	}
+	if (s->free) {
+		vmm_free(s->free);
+	}
+	if (s->l1) {
+		vmm_free(s->l1);
+	}
+	vmm_free(s);
+}
+
+/* Number of L1 entries required by sparse image of given size */
+static u64 fileblk_sparse_l1_entries(u64 size, u32 cluster_bits)
+{
+	u32 shift = cluster_bits + (cluster_bits - 3);
+
+	return (size + ((u64)1 << shift) - 1) >> shift;
+}
+
+/* Returns VMM_ENOENT if backing file is not a sparse image */
+static int fileblk_sparse_open(struct fileblk *fb)
+{
+	int rc;
+	u32 csize;
+	struct fileblk_sparse *s;
+	struct fileblk_sparse_header hdr;
+
+	if (fb->file_size < sizeof(hdr)) {
+		return VMM_ENOENT;
+	}
+
+	rc = fileblk_pread(fb->fd, 0, &hdr, sizeof(hdr));
+	if (rc) {
+		return rc;
+	}
+	if (vmm_le32_to_cpu(hdr.magic) != FILEBLK_SPARSE_MAGIC) {
+		return VMM_ENOENT;
+	}
+
+	hdr.version = vmm_le32_to_cpu(hdr.version);
+	hdr.size = vmm_le64_to_cpu(hdr.size);
+	hdr.cluster_bits = vmm_le32_to_cpu(hdr.cluster_bits);
+	hdr.l1_entries = vmm_le32_to_cpu(hdr.l1_entries);
+	hdr.l1_offset = vmm_le64_to_cpu(hdr.l1_offset);
+
+	if ((hdr.version != FILEBLK_SPARSE_VERSION) ||
+	    (hdr.cluster_bits < FILEBLK_SPARSE_MIN_CLUSTER_BITS) ||
+	    (FILEBLK_SPARSE_MAX_CLUSTER_BITS < hdr.cluster_bits) ||
+	    !hdr.size ||
+	    (hdr.l1_entries !=
+	     fileblk_sparse_l1_entries(hdr.size, hdr.cluster_bits)) ||
+	    (fb->file_size <
+	     (hdr.l1_offset + (u64)hdr.l1_entries * sizeof(u64)))) {
+		return VMM_EINVALID;
+	}
+	csize = 1 << hdr.cluster_bits;
+
+	s = vmm_zalloc(sizeof(*s));
+	if (!s) {
+		return VMM_ENOMEM;
+	}
+	s->cluster_bits = hdr.cluster_bits;
+	s->l2_bits = hdr.cluster_bits - 3;
+	s->l1_entries = hdr.l1_entries;
+	s->l1_offset = hdr.l1_offset;
+
+	s->l1 = vmm_malloc(s->l1_entries * sizeof(u64));
+	s->cluster = vmm_malloc(csize);
+	if (!s->l1 || !s->cluster) {
+		fileblk_sparse_free(s);
+		return VMM_ENOMEM;
+	}
+
+	rc = fileblk_pread(fb->fd, s->l1_offset, s->l1,
+			   s->l1_entries * sizeof(u64));
+	if (rc) {
+		fileblk_sparse_free(s);
+		return rc;
+	}
+
+	fb->size = hdr.size;
+	fb->sparse = s;
+
+	return VMM_OK;
+}
+
+int fileblk_format_sparse(const char *path, u64 size, u32 cluster_bits)
+{
+	int fd, rc = VMM_OK;
+	u8 *buf;
+	u64 l1_entries, l1_clusters, i;
+	u32 csize;
+	struct fileblk_sparse_header hdr;
+
+	if (!path) {
+		return VMM_EINVALID;
+	}
+	if (!cluster_bits) {
+		cluster_bits = FILEBLK_SPARSE_DEF_CLUSTER_BITS;
+	}
+	if ((cluster_bits < FILEBLK_SPARSE_MIN_CLUSTER_BITS) ||
+	    (FILEBLK_SPARSE_MAX_CLUSTER_BITS < cluster_bits)) {
+		return VMM_EINVALID;
+	}
+	if (!size || (size & (FILEBLK_BLOCK_SIZE - 1))) {
+		return VMM_EINVALID;
+	}
+
+	csize = 1 << cluster_bits;
+	l1_entries = fileblk_sparse_l1_entries(size, cluster_bits);
+	if (U32_MAX < l1_entries) {
+		return VMM_EINVALID;
+	}
+	l1_clusters = (l1_entries * sizeof(u64) + csize - 1) >> cluster_bits;
+
+	buf = vmm_zalloc(csize);
+	if (!buf) {
+		return VMM_ENOMEM;
+	}
+
+	hdr.magic = vmm_cpu_to_le32(FILEBLK_SPARSE_MAGIC);
+	hdr.version = vmm_cpu_to_le32(FILEBLK_SPARSE_VERSION);
+	hdr.size = vmm_cpu_to_le64(size);
+	hdr.cluster_bits = vmm_cpu_to_le32(cluster_bits);
+	hdr.l1_entries = vmm_cpu_to_le32((u32)l1_entries);
+	hdr.l1_offset = vmm_cpu_to_le64(csize);
+	memcpy(buf, &hdr, sizeof(hdr));
+
+	fd = vfs_open(path, O_WRONLY | O_CREAT | O_TRUNC,
+		      S_IRUSR | S_IWUSR);
+	if (fd < 0) {
+		vmm_free(buf);
+		return fd;
+	}
+
+	/* Header cluster followed by zeroed L1 table clusters */
+	if (vfs_write(fd, buf, csize) != csize) {
+		rc = VMM_EIO;
+		goto done;
+	}
+	memset(buf, 0, csize);
+	for (i = 0; i < l1_clusters; i++) {
+		if (vfs_write(fd, buf, csize) != csize) {
+			rc = VMM_EIO;
+			goto done;
+		}
+	}
+
+	rc = vfs_fsync(fd);
+
+done:
+	vfs_close(fd);
+	vmm_free(buf);
+	return rc;
+}
+VMM_EXPORT_SYMBOL(fileblk_format_sparse);
+
+struct fileblk *fileblk_create(const char *name,
+				const char *path,
+				bool read_only)
+{
+	int rc;
+	struct stat st;
+	struct fileblk *fb;
+	irq_flags_t flags;
+	struct vmm_blockrq *brq;
+
+	if (!name || !path) {
+		return NULL;
+	}
+
+	fb = vmm_zalloc(sizeof(struct fileblk));
+	if (!fb) {
+		goto free_nothing;
+	}
+	INIT_LIST_HEAD(&fb->head);
+	strncpy(fb->path, path, sizeof(fb->path));
+	fb->path[sizeof(fb->path) - 1] = '\0';
+	fb->read_only = read_only;
+
+	fb->fd = vfs_open(fb->path, (read_only) ? O_RDONLY : O_RDWR, 0);
+	if (fb->fd < 0) {
+		goto free_fileblk;
+	}
+
+	if (vfs_fstat(fb->fd, &st)) {
+		goto close_fd;
+	}
+	fb->file_size = st.st_size;
+
+	/* Use sparse image if backing file has one otherwise raw image */
+	rc = fileblk_sparse_open(fb);
+	if (rc == VMM_ENOENT) {
+		fb->size = fb->file_size & ~((u64)FILEBLK_BLOCK_SIZE - 1);
+	} else if (rc) {
+		goto close_fd;
+	}
+	if (fb->size < FILEBLK_BLOCK_SIZE) {
+		goto free_sparse;
+	}
+
+	fb->bdev = vmm_blockdev_alloc();
+	if (!fb->bdev) {
+		goto free_sparse;
+	}
+
+	/* Setup block device instance */
+	strncpy(fb->bdev->name, name, VMM_FIELD_NAME_SIZE);
+	strncpy(fb->bdev->desc, (fb->sparse) ?
+		"Sparse file backed block device" :
+		"File backed block device", VMM_FIELD_DESC_SIZE);
+	fb->bdev->flags = (read_only) ? VMM_BLOCKDEV_RDONLY : VMM_BLOCKDEV_RW;
+	fb->bdev->start_lba = 0;
+	fb->bdev->num_blocks = udiv64(fb->size, FILEBLK_BLOCK_SIZE);
+	fb->bdev->block_size = FILEBLK_BLOCK_SIZE;
+
+	/* Setup request queue for block device instance */
+	brq = vmm_blockrq_create(name, FILEBLK_MAX_PENDING, FALSE,
+				 fileblk_read_request,
+				 fileblk_write_request,
+				 NULL,
+				 fileblk_flush_request,
+				 fb);
+	if (!brq) {
+		goto free_bdev;
+	}
+	vmm_blockrq_set_sg_limits(brq, FILEBLK_MAX_SG_NENTS, FALSE);
+	if (!read_only) {
+		/* DISCARD only makes sense when we can deallocate */
+		if (fb->sparse) {
+			vmm_blockrq_set_discard(brq, fileblk_zero_request,
+						FILEBLK_MAX_ZERO_BLOCKS);
+		}
+		vmm_blockrq_set_write_zeroes(brq, fileblk_zero_request,
+					     FILEBLK_MAX_ZERO_BLOCKS);
+	}
+	fb->bdev->rq = vmm_blockrq_to_rq(brq);
+
+	/* Register block device instance */
+	if (vmm_blockdev_register(fb->bdev)) {
+		goto free_bdev_rq;
+	}
+
+	/* Add to list of FILEBLK instances */
+	vmm_spin_lock_irqsave(&fileblk_list_lock, flags);
+	list_add_tail(&fb->head, &fileblk_list);
+	vmm_spin_unlock_irqrestore(&fileblk_list_lock, flags);
+
+	return fb;
+
+free_bdev_rq:
+	vmm_blockrq_destroy(vmm_rq_to_blockrq(fb->bdev->rq));
+free_bdev:
+	vmm_blockdev_free(fb->bdev);
+free_sparse:
+	fileblk_sparse_free(fb->sparse);
+close_fd:
+	vfs_close(fb->fd);
+free_fileblk:
+	vmm_free(fb);
+free_nothing:
+	return NULL;
+}
+VMM_EXPORT_SYMBOL(fileblk_create);
+
+void fileblk_destroy(struct fileblk *fb)
+{
+	irq_flags_t flags;
+
+	/* Sanity check */
+	if (!fb) {
+		return;
+	}
+
+	/* Remove from list of FILEBLK instances */
+	vmm_spin_lock_irqsave(&fileblk_list_lock, flags);
+	list_del(&fb->head);
+	vmm_spin_unlock_irqrestore(&fileblk_list_lock, flags);
+
+	/* Unregister block device */
+	vmm_blockdev_unregister(fb->bdev);
+
+	/* Free block device request queue */
+	vmm_blockrq_destroy(vmm_rq_to_blockrq(fb->bdev->rq));
+
+	/* Free block device */
+	vmm_blockdev_free(fb->bdev);
+
+	/* Sync and close backing file */
+	if (!fb->read_only) {
+		vfs_fsync(fb->fd);
+	}
+	vfs_close(fb->fd);
+
+	/* Free FILEBLK instance */
+	fileblk_sparse_free(fb->sparse);
+	vmm_free(fb);
+}
+VMM_EXPORT_SYMBOL(fileblk_destroy);
+
+struct fileblk *fileblk_find(const char *name)
+{
+	bool found;
+	struct fileblk *fb;
+	irq_flags_t flags;
+
+	if (!name) {
+		return NULL;
+	}
+
+	found = FALSE;
+
+	vmm_spin_lock_irqsave(&fileblk_list_lock, flags);
+
+	list_for_each_entry(fb, &fileblk_list, head) {
+		if (strcmp(fb->bdev->name, name) == 0) {
+			found = TRUE;
+			break;
+		}
+	}
+
+	vmm_spin_unlock_irqrestore(&fileblk_list_lock, flags);
+
+	return (found) ? fb : NULL;
+}
+VMM_EXPORT_SYMBOL(fileblk_find);
+
+struct fileblk *fileblk_get(int index)
+{
+	bool found;
+	struct fileblk *fb;
+	irq_flags_t flags;
+
+	if (index < 0) {
+		return NULL;
+	}
+
+	found = FALSE;
+
+	vmm_spin_lock_irqsave(&fileblk_list_lock, flags);
+
+	list_for_each_entry(fb, &fileblk_list, head) {
+		if (!index) {
+			found = TRUE;
+			break;
+		}
+		index--;
+	}
+
+	vmm_spin_unlock_irqrestore(&fileblk_list_lock, flags);
+
+	return (found) ? fb : NULL;
+}
+VMM_EXPORT_SYMBOL(fileblk_get);
+
+u32 fileblk_count(void)
+{
+	u32 retval = 0;
+	struct fileblk *fb;
+	irq_flags_t flags;
+
+	vmm_spin_lock_irqsave(&fileblk_list_lock, flags);
+
+	list_for_each_entry(fb, &fileblk_list, head) {
+		retval++;
+	}
+
+	vmm_spin_unlock_irqrestore(&fileblk_list_lock, flags);
+
+	return retval;
+}
+VMM_EXPORT_SYMBOL(fileblk_count);
+
+static int __init fileblk_driver_init(void)
+{
+	/* Nothing to do here. */
+	return VMM_OK;
+}
+
+static void __exit fileblk_driver_exit(void)
+{
+	struct fileblk *fb;
+
+	while ((fb = fileblk_get(0))) {
+		fileblk_destroy(fb);
+	}
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+			MODULE_AUTHOR,
+			MODULE_LICENSE,
+			MODULE_IPRIORITY,
+			MODULE_INIT,
+			MODULE_EXIT);
@@ -24,4 +24,6 @@
 drivers-objs-$(CONFIG_BLOCK_RBD)+= block/rbd.o
 drivers-objs-$(CONFIG_BLOCK_INITRD)+= block/initrd.o
 drivers-objs-$(CONFIG_BLOCK_VIRTIO_HOST)+= block/virtio_host_blk.o
+drivers-objs-$(CONFIG_BLOCK_FILE)+= block/fileblk.o
+drivers-objs-$(CONFIG_BLOCK_COW)+= block/cowblk.o
 
@@ -31,6 +31,7 @@
 #include <block/vmm_blockrq.h>
 #include <libs/mathlib.h>
 #include <libs/stringlib.h>
+#include <libs/scatterlist.h>
 #include <drv/rbd.h>
 
 #define MODULE_DESC			"RAM Backed Block Driver"
@@ -43,17 +44,51 @@
 static LIST_HEAD(rbd_list);
 static DEFINE_SPINLOCK(rbd_list_lock);
 
-static int rbd_read_request(struct vmm_blockrq *brq,
-			    struct vmm_request *r, void *priv)
+/* Max scatter-gather entries handled in one request */
+#define RBD_MAX_SG_NENTS		256
+
+/* Max blocks zeroed by one DISCARD or WRITE_ZEROES request */
+#define RBD_MAX_ZERO_BLOCKS		(0x80000000 / RBD_BLOCK_SIZE)
+
+static void rbd_rw(struct rbd *d, struct vmm_request *r, bool write)
 {
-	struct rbd *d = priv;
+	u32 i;
 	physical_addr_t pa;
 	physical_size_t sz;
+	struct scatterlist *sg;
 
 	pa = d->addr + r->lba * RBD_BLOCK_SIZE;
 	sz = r->bcnt * RBD_BLOCK_SIZE;
 
-	vmm_host_memory_read(pa, r->data, sz, TRUE);
+	if (!r->sgl) {
+		if (write) {
+			vmm_host_memory_write(pa, r->data, sz, TRUE);
+		} else {
+			vmm_host_memory_read(pa, r->data, sz, TRUE);
+		}
+		return;
+	}
+
+	for_each_sg(r->sgl, sg, r->sg_nents, i) {
+		if (!sz) {
+			break;
+		}
+		if (write) {
+			vmm_host_memory_write(pa, sg_virt(sg),
+					      sg->length, TRUE);
+		} else {
+			vmm_host_memory_read(pa, sg_virt(sg),
+					     sg->length, TRUE);
+		}
+		pa += sg->length;
+		sz -= sg->length;
+	}
+}
+
+static int rbd_read_request(struct vmm_blockrq *brq,
+			    struct vmm_request *r, void *priv)
+{
+	rbd_rw(priv, r, FALSE);
 
 	return VMM_OK;
 }
@@ -61,14 +96,21 @@ static int rbd_read_request(struct vmm_blockrq *brq,
 static int rbd_write_request(struct vmm_blockrq *brq,
 			     struct vmm_request *r, void *priv)
 {
-	struct rbd *d = priv;
-	physical_addr_t pa;
-	physical_size_t sz;
+	rbd_rw(priv, r, TRUE);
 
-	pa = d->addr + r->lba * RBD_BLOCK_SIZE;
-	sz = r->bcnt * RBD_BLOCK_SIZE;
+	return VMM_OK;
+}
+
+/* RAM of RBD is reserved as one region so we can't release pages
+ * hence DISCARD and WRITE_ZEROES both simply clear the blocks.
+ */
+static int rbd_zero_request(struct vmm_blockrq *brq,
+			    struct vmm_request *r, void *priv)
+{
+	struct rbd *d = priv;
 
-	vmm_host_memory_write(pa, r->data, sz, TRUE);
+	vmm_host_memory_set(d->addr + r->lba * RBD_BLOCK_SIZE, 0,
+			    r->bcnt * RBD_BLOCK_SIZE, TRUE);
 
 	return VMM_OK;
 }
@@ -118,6 +160,10 @@ static struct rbd *__rbd_create(struct vmm_device *dev,
 	if (!brq) {
 		goto free_bdev;
 	}
+	vmm_blockrq_set_sg_limits(brq, RBD_MAX_SG_NENTS, FALSE);
+	vmm_blockrq_set_discard(brq, rbd_zero_request, RBD_MAX_ZERO_BLOCKS);
+	vmm_blockrq_set_write_zeroes(brq, rbd_zero_request,
+				     RBD_MAX_ZERO_BLOCKS);
 	d->bdev->rq = vmm_blockrq_to_rq(brq);
 
 	/* Register block device instance */
@@ -24,7 +24,9 @@
 #include <vmm_error.h>
 #include <vmm_heap.h>
 #include <vmm_spinlocks.h>
+#include <vmm_cpumask.h>
 #include <vmm_completion.h>
+#include <vmm_workqueue.h>
 #include <vmm_modules.h>
 #include <block/vmm_blockrq.h>
 #include <block/vmm_blockdev.h>
@@ -34,6 +36,7 @@
 #include <libs/idr.h>
 #include <libs/mathlib.h>
 #include <libs/stringlib.h>
+#include <libs/scatterlist.h>
 
 #undef DEBUG
 
@@ -51,14 +54,48 @@
 #define	MODULE_INIT			virtio_host_blk_init
 #define	MODULE_EXIT			virtio_host_blk_exit
 
+/* Max data segments we put in one request */
+#define VIRTIO_HOST_BLK_MAX_SEGS	8
+
+/* Max data segments we put in one request using indirect descriptors */
+#define VIRTIO_HOST_BLK_MAX_INDIRECT_SEGS	64
+
+/* Max bytes covered by one DISCARD or WRITE_ZEROES request */
+#define VIRTIO_HOST_BLK_MAX_ZERO_SIZE	0x80000000
+
+struct virtio_host_blk_vq;
+
 struct virtio_host_blk_req {
+	struct dlist head;
 	struct vmm_request *r;
 	struct vmm_completion *cmpl;
 	struct virtio_host_blk *vblk;
+	struct virtio_host_blk_vq *bvq;
 	struct vmm_virtio_blk_outhdr hdr;
+	struct vmm_virtio_blk_discard_write_zeroes dwz;
 	u8 status;
-	struct virtio_host_iovec iovec[3];
-	struct virtio_host_iovec *ivs[3];
+	struct virtio_host_iovec status_iovec;
+	/* Header iovec followed by upto seg_max data iovecs */
+	struct virtio_host_iovec *iovec;
+	struct virtio_host_iovec **ivs;
+	unsigned int out_ivs;
+	unsigned int in_ivs;
+	/* Bytes written by host (set when request is reaped) */
+	unsigned int len;
+};
+
+/* Per-queue state where lock serializes adding requests (from
+ * request queue thread) with reaping completed requests (from
+ * VirtIO host queue interrupt). Requests which don't fit in
+ * vring wait in pending list till earlier requests complete.
+ */
+struct virtio_host_blk_vq {
+	vmm_spinlock_t lock;
+	struct virtio_host_queue *vq;
+	struct dlist pending;
+	u32 max_reqs;
+	struct virtio_host_blk_req *reqs;
+	struct fifo *reqs_fifo;
 };
 
 struct virtio_host_blk {
@@ -69,13 +106,25 @@ struct virtio_host_blk {
 	u64 num_blocks;
 	u32 block_size;
 	u32 seg_size;
+	u32 seg_max;
 
 	u16 num_vqs;
 	struct virtio_host_queue **vqs;
+	struct virtio_host_blk_vq *bvqs;
+	u32 next_vq;
 
 	u32 max_reqs;
-	struct virtio_host_blk_req *reqs;
-	struct fifo *reqs_fifo;
+	struct virtio_host_iovec *reqs_iovecs;
+	struct virtio_host_iovec **reqs_ivs;
+
+	/* Requests reaped in interrupt context are completed by done_work
+	 * because completion callbacks copy data (bounce buffers and guest
+	 * memory) which we don't want to do in interrupt context.
+	 */
+	vmm_spinlock_t done_lock;
+	struct dlist done_list;
+	struct vmm_work done_work;
+	struct vmm_workqueue *done_wq;
 
 	u8 raw_serial[VMM_VIRTIO_BLK_ID_BYTES];
 	char serial[VMM_VIRTIO_BLK_ID_BYTES*2 + 1];
@@ -86,189 +135,376 @@ struct virtio_host_blk {
 
 static DEFINE_IDA(vd_index_ida);
 
+/* Get free request from next queue (round-robin) having one */
+static struct virtio_host_blk_req *virtio_host_blk_get_req(
+					struct virtio_host_blk *vblk)
+{
+	u32 i, q;
+	struct virtio_host_blk_req *req;
+
+	for (i = 0; i < vblk->num_vqs; i++) {
+		q = umod32(vblk->next_vq + i, vblk->num_vqs);
+		if (fifo_dequeue(vblk->bvqs[q].reqs_fifo, &req)) {
+			vblk->next_vq = q + 1;
+			req->r = NULL;
+			req->cmpl = NULL;
+			return req;
+		}
+	}
+
+	vmm_lerror(vblk->vdev->dev.name, "Failed to dequeue free request\n");
+
+	return NULL;
+}
+
+static void virtio_host_blk_put_req(struct virtio_host_blk_req *req)
+{
+	req->r = NULL;
+	req->cmpl = NULL;
+	fifo_enqueue(req->bvq->reqs_fifo, &req, TRUE);
+}
+
+/* Add pending requests to VirtIO host queue in order till it is full
+ * Note: Must be called with bvq->lock held.
+ */
+static bool virtio_host_blk_add_pending(struct virtio_host_blk_vq *bvq)
+{
+	bool added = FALSE;
+	struct virtio_host_blk_req *req;
+
+	while (!list_empty(&bvq->pending)) {
+		req = list_first_entry(&bvq->pending,
+				       struct virtio_host_blk_req, head);
+		if (virtio_host_queue_add_iovecs(bvq->vq, req->ivs,
+						 req->out_ivs, req->in_ivs,
+						 req)) {
+			break;
+		}
+		list_del(&req->head);
+		added = TRUE;
+	}
+
+	return added;
+}
+
+/* Add request to its VirtIO host queue and kick host */
+static int virtio_host_blk_queue_req(struct virtio_host_blk_req *req,
+				     unsigned int out_ivs,
+				     unsigned int in_ivs)
+{
+	int rc = VMM_OK;
+	bool notify = FALSE;
+	irq_flags_t flags;
+	struct virtio_host_blk_vq *bvq = req->bvq;
+
+	req->out_ivs = out_ivs;
+	req->in_ivs = in_ivs;
+
+	/* Request waits behind pending requests or for free descriptors
+	 * when vring is short of them.
+	 */
+	vmm_spin_lock_irqsave(&bvq->lock, flags);
+	if (list_empty(&bvq->pending)) {
+		rc = virtio_host_queue_add_iovecs(bvq->vq, req->ivs,
+						  out_ivs, in_ivs, req);
+		notify = (rc) ? FALSE :
+			 virtio_host_queue_kick_prepare(bvq->vq);
+	}
+	if (!list_empty(&bvq->pending) || (rc == VMM_ENOSPC)) {
+		list_add_tail(&req->head, &bvq->pending);
+		rc = VMM_OK;
+	}
+	vmm_spin_unlock_irqrestore(&bvq->lock, flags);
+
+	if (rc) {
+		vmm_lerror(req->vblk->vdev->dev.name,
+			   "Failed to add iovecs to VirtIO host queue\n");
+		virtio_host_blk_put_req(req);
+		return rc;
+	}
+
+	if (notify) {
+		virtio_host_queue_notify(bvq->vq);
+	}
+
+	return VMM_OK;
+}
+
+/* Fill data iovecs followed by status iovec and return data iovec count */
+static unsigned int virtio_host_blk_map_data(struct virtio_host_blk *vblk,
+					     struct virtio_host_blk_req *req,
+					     struct vmm_request *r)
+{
+	unsigned int i, n = 0;
+	struct scatterlist *sg;
+
+	if (r->sgl) {
+		for_each_sg(r->sgl, sg, r->sg_nents, i) {
+			req->iovec[1 + n].buf = sg_virt(sg);
+			req->iovec[1 + n].buf_len = sg->length;
+			req->ivs[1 + n] = &req->iovec[1 + n];
+			n++;
+		}
+	} else {
+		req->iovec[1].buf = r->data;
+		req->iovec[1].buf_len = r->bcnt * vblk->block_size;
+		req->ivs[1] = &req->iovec[1];
+		n = 1;
+	}
+	req->ivs[1 + n] = &req->status_iovec;
+
+	return n;
+}
+
 static int virtio_host_blk_read(struct vmm_blockrq *brq,
 				struct vmm_request *r, void *priv)
 {
-	int rc;
+	unsigned int n;
 	struct virtio_host_blk *vblk = priv;
 	struct virtio_host_blk_req *req;
 
-	if (!fifo_dequeue(vblk->reqs_fifo, &req)) {
-		vmm_lerror(vblk->vdev->dev.name,
-			   "Failed to dequeue free request\n");
+	req = virtio_host_blk_get_req(vblk);
+	if (!req) {
 		return VMM_EIO;
 	}
 
 	req->r = r;
-	req->cmpl = NULL;
 	req->hdr.type = cpu_to_virtio32(vblk->vdev, VMM_VIRTIO_BLK_T_IN);
 	req->hdr.ioprio = 0;
 	req->hdr.sector = cpu_to_virtio64(vblk->vdev, r->lba);
-	req->iovec[1].buf = r->data;
-	req->iovec[1].buf_len = r->bcnt * vblk->block_size;
+	n = virtio_host_blk_map_data(vblk, req, r);
 
 	DPRINTF(vblk, "%s: req=0x%p lba=%"PRIu64" bcnt=%d data=0x%p\n",
-		__func__, req, req->r->lba, req->r->bcnt, req->r->data);
-
-	rc = virtio_host_queue_add_iovecs(vblk->vqs[0], req->ivs, 1, 2, req);
-	if (rc) {
-		vmm_lerror(vblk->vdev->dev.name,
-			   "Failed to add iovecs to VirtIO host queue\n");
-		req->r = NULL;
-		req->cmpl = NULL;
-		fifo_enqueue(vblk->reqs_fifo, &req, TRUE);
-		return rc;
-	}
-
-	virtio_host_queue_kick(vblk->vqs[0]);
+		__func__, req, r->lba, r->bcnt, r->data);
 
-	return VMM_OK;
+	return virtio_host_blk_queue_req(req, 1, n + 1);
 }
 
 static int virtio_host_blk_write(struct vmm_blockrq *brq,
 				 struct vmm_request *r, void *priv)
 {
-	int rc;
+	unsigned int n;
 	struct virtio_host_blk *vblk = priv;
 	struct virtio_host_blk_req *req;
 
-	if (!fifo_dequeue(vblk->reqs_fifo, &req)) {
-		vmm_lerror(vblk->vdev->dev.name,
-			   "Failed to dequeue free request\n");
+	req = virtio_host_blk_get_req(vblk);
+	if (!req) {
 		return VMM_EIO;
 	}
 
 	req->r = r;
-	req->cmpl = NULL;
 	req->hdr.type = cpu_to_virtio32(vblk->vdev, VMM_VIRTIO_BLK_T_OUT);
 	req->hdr.ioprio = 0;
 	req->hdr.sector = cpu_to_virtio64(vblk->vdev, r->lba);
-	req->iovec[1].buf = r->data;
-	req->iovec[1].buf_len = r->bcnt * vblk->block_size;
+	n = virtio_host_blk_map_data(vblk, req, r);
 
 	DPRINTF(vblk, "%s: req=0x%p lba=%"PRIu64" bcnt=%d data=0x%p\n",
-		__func__, req, req->r->lba, req->r->bcnt, req->r->data);
+		__func__, req, r->lba, r->bcnt, r->data);
 
-	rc = virtio_host_queue_add_iovecs(vblk->vqs[0], req->ivs, 2, 1, req);
-	if (rc) {
-		vmm_lerror(vblk->vdev->dev.name,
-			   "Failed to add iovecs to VirtIO host queue\n");
-		req->r = NULL;
-		req->cmpl = NULL;
-		fifo_enqueue(vblk->reqs_fifo, &req, TRUE);
-		return rc;
+	return virtio_host_blk_queue_req(req, n + 1, 1);
+}
+
+static int virtio_host_blk_zero(struct virtio_host_blk *vblk,
+				struct vmm_request *r, u32 type)
+{
+	struct virtio_host_blk_req *req;
+	u32 factor = udiv32(vblk->block_size, 512);
+
+	req = virtio_host_blk_get_req(vblk);
+	if (!req) {
+		return VMM_EIO;
 	}
 
-	virtio_host_queue_kick(vblk->vqs[0]);
+	req->r = r;
+	req->hdr.type = cpu_to_virtio32(vblk->vdev, type);
+	req->hdr.ioprio = 0;
+	req->hdr.sector = 0;
+	req->dwz.sector = cpu_to_virtio64(vblk->vdev, r->lba * factor);
+	req->dwz.num_sectors = cpu_to_virtio32(vblk->vdev, r->bcnt * factor);
+	req->dwz.flags = 0;
+	req->iovec[1].buf = &req->dwz;
+	req->iovec[1].buf_len = sizeof(req->dwz);
+	req->ivs[1] = &req->iovec[1];
+	req->ivs[2] = &req->status_iovec;
+
+	DPRINTF(vblk, "%s: req=0x%p type=%d lba=%"PRIu64" bcnt=%d\n",
+		__func__, req, type, r->lba, r->bcnt);
+
+	return virtio_host_blk_queue_req(req, 2, 1);
+}
 
-	return VMM_OK;
+static int virtio_host_blk_discard(struct vmm_blockrq *brq,
+				   struct vmm_request *r, void *priv)
+{
+	return virtio_host_blk_zero(priv, r, VMM_VIRTIO_BLK_T_DISCARD);
+}
+
+static int virtio_host_blk_write_zeroes(struct vmm_blockrq *brq,
+					struct vmm_request *r, void *priv)
+{
+	return virtio_host_blk_zero(priv, r, VMM_VIRTIO_BLK_T_WRITE_ZEROES);
+}
+
+/* Max blocks in one DISCARD or WRITE_ZEROES request based on
+ * config field (in 512-byte sectors) where zero means no limit
+ */
+static u32 virtio_host_blk_zero_limit(struct virtio_host_blk *vblk,
+				      u32 max_sectors)
+{
+	u32 max = udiv32(VIRTIO_HOST_BLK_MAX_ZERO_SIZE, vblk->block_size);
+
+	max_sectors = udiv32(max_sectors, udiv32(vblk->block_size, 512));
+	if (max_sectors && (max_sectors < max)) {
+		max = max_sectors;
+	}
+
+	return max;
 }
 
 static void virtio_host_blk_flush(struct vmm_blockrq *brq, void *priv)
 {
-	int rc;
+	struct vmm_completion cmpl;
 	struct virtio_host_blk *vblk = priv;
 	struct virtio_host_blk_req *req;
 
-	if (!fifo_dequeue(vblk->reqs_fifo, &req)) {
-		vmm_lerror(vblk->vdev->dev.name,
-			   "Failed to dequeue free request\n");
+	req = virtio_host_blk_get_req(vblk);
+	if (!req) {
 		return;
 	}
 
-	req->r = NULL;
-	req->cmpl = NULL;
+	INIT_COMPLETION(&cmpl);
+
+	req->cmpl = &cmpl;
 	req->hdr.type = cpu_to_virtio32(vblk->vdev, VMM_VIRTIO_BLK_T_FLUSH);
 	req->hdr.ioprio = 0;
 	req->hdr.sector = 0;
-	req->iovec[1].buf = req->iovec[2].buf;
-	req->iovec[1].buf_len = req->iovec[2].buf_len;
+	req->ivs[1] = &req->status_iovec;
 
 	DPRINTF(vblk, "%s: req=0x%p\n", __func__, req);
 
-	rc = virtio_host_queue_add_iovecs(vblk->vqs[0], req->ivs, 1, 1, req);
-	if (rc) {
-		vmm_lerror(vblk->vdev->dev.name,
-			   "Failed to add iovecs to VirtIO host queue\n");
-		req->r = NULL;
-		req->cmpl = NULL;
-		fifo_enqueue(vblk->reqs_fifo, &req, TRUE);
-		return;
+	/* Wait so that flush is ordered before subsequent requests */
+	if (!virtio_host_blk_queue_req(req, 1, 1)) {
+		vmm_completion_wait(&cmpl);
 	}
-
-	virtio_host_queue_kick(vblk->vqs[0]);
-
-	return;
 }
 
-#define VIRTIO_HOST_BLK_DONE_BUDGET	8
-
-static void virtio_host_blk_done_work(struct vmm_blockrq *brq, void *priv)
+static void virtio_host_blk_req_done(struct virtio_host_blk *vblk,
+				     struct virtio_host_blk_req *req)
 {
 	int err;
-	unsigned int i, len, exp;
-	struct virtio_host_blk *vblk = priv;
-	struct virtio_host_blk_req *req;
-
-	i = 0;
-	do {
-		req = virtio_host_queue_get_buf(vblk->vqs[0], &len);
-		if (!req) {
-			break;
-		}
-
-		if (req->r) {
-			DPRINTF(vblk, "%s: req=0x%p lba=%"PRIu64" "
-				"bcnt=%d data=0x%p\n", __func__,
-				req, req->r->lba, req->r->bcnt, req->r->data);
+	unsigned int exp;
+	u8 status = req->status;
+	unsigned int len = req->len;
+	struct vmm_request *r = req->r;
+	struct vmm_completion *cmpl = req->cmpl;
+
+	/* Recycle request before completing it so that completion
+	 * callbacks can submit new requests.
+	 * Note: Request can be reused right away so only use
+	 * values latched above from here on.
+	 */
+	virtio_host_blk_put_req(req);
 
-			exp = sizeof(req->hdr);
-			exp += req->r->bcnt * vblk->block_size;
-			exp += sizeof(req->status);
+	if (r) {
+		exp = sizeof(struct vmm_virtio_blk_outhdr);
+		exp += vmm_request_data_size(r);
+		exp += sizeof(status);
 
-			DPRINTF(vblk, "%s: req=0x%p exp=%d len=%d\n",
-				__func__, req, exp, len);
+		DPRINTF(vblk, "%s: req=0x%p lba=%"PRIu64" bcnt=%d "
+			"exp=%d len=%d\n", __func__, req,
+			r->lba, r->bcnt, exp, len);
 
+		if (vmm_request_has_data(r)) {
 			err = (len == exp) ? VMM_OK : VMM_EIO;
-			vmm_blockrq_async_done(vblk->brq, req->r, err);
-		} else if (req->cmpl) {
-			DPRINTF(vblk, "%s: req=0x%p cmpl=0x%p len=%d\n",
-				__func__, req, req->cmpl, len);
-
-			vmm_completion_complete(req->cmpl);
 		} else {
-			DPRINTF(vblk, "%s: req=0x%p len=%d\n",
-				__func__, req, len);
+			err = (status == VMM_VIRTIO_BLK_S_OK) ?
+				VMM_OK : VMM_EIO;
 		}
+		vmm_blockrq_async_done(vblk->brq, r, err);
+	} else if (cmpl) {
+		DPRINTF(vblk, "%s: req=0x%p cmpl=0x%p len=%d\n",
+			__func__, req, cmpl, len);
 
-		req->r = NULL;
-		req->cmpl = NULL;
-		fifo_enqueue(vblk->reqs_fifo, &req, TRUE);
-	} while (i < VIRTIO_HOST_BLK_DONE_BUDGET);
+		vmm_completion_complete(cmpl);
+	} else {
+		DPRINTF(vblk, "%s: req=0x%p len=%d\n",
+			__func__, req, len);
+	}
+}
 
-	if (virtio_host_queue_have_buf(vblk->vqs[0]))
-		vmm_blockrq_queue_work(vblk->brq,
-				       virtio_host_blk_done_work, vblk);
+static void virtio_host_blk_done_work(struct vmm_work *work)
+{
+	irq_flags_t flags;
+	struct virtio_host_blk_req *req;
+	struct virtio_host_blk *vblk =
+			container_of(work, struct virtio_host_blk, done_work);
+
+	vmm_spin_lock_irqsave(&vblk->done_lock, flags);
+	while (!list_empty(&vblk->done_list)) {
+		req = list_entry(list_pop(&vblk->done_list),
+				 struct virtio_host_blk_req, head);
+		vmm_spin_unlock_irqrestore(&vblk->done_lock, flags);
+		virtio_host_blk_req_done(vblk, req);
+		vmm_spin_lock_irqsave(&vblk->done_lock, flags);
+	}
+	vmm_spin_unlock_irqrestore(&vblk->done_lock, flags);
 }
 
+/* Called from virtio_host_queue_interrupt() so used buffers are
+ * reaped in interrupt context and completed later by done_work.
+ */
 static void virtio_host_blk_done(struct virtio_host_queue *vq)
 {
+	bool notify;
+	unsigned int len;
+	irq_flags_t flags;
+	struct dlist done;
 	struct virtio_host_blk *vblk = vq->vdev->priv;
+	struct virtio_host_blk_vq *bvq;
+	struct virtio_host_blk_req *req;
+
+	if (!vblk || (vblk->num_vqs <= vq->index)) {
+		return;
+	}
+	bvq = &vblk->bvqs[vq->index];
+
+	INIT_LIST_HEAD(&done);
+
+	vmm_spin_lock_irqsave(&bvq->lock, flags);
+	while ((req = virtio_host_queue_get_buf(vq, &len)) != NULL) {
+		req->len = len;
+		list_add_tail(&req->head, &done);
+	}
+	/* Reaped requests freed descriptors for pending ones */
+	notify = virtio_host_blk_add_pending(bvq) &&
+		 virtio_host_queue_kick_prepare(vq);
+	vmm_spin_unlock_irqrestore(&bvq->lock, flags);
+
+	if (notify) {
+		virtio_host_queue_notify(vq);
+	}
+
+	if (list_empty(&done)) {
+		return;
+	}
 
-	vmm_blockrq_queue_work(vblk->brq, virtio_host_blk_done_work, vblk);
+	vmm_spin_lock_irqsave(&vblk->done_lock, flags);
+	list_splice_tail(&done, &vblk->done_list);
+	vmm_spin_unlock_irqrestore(&vblk->done_lock, flags);
+
+	vmm_workqueue_schedule_work(vblk->done_wq, &vblk->done_work);
 }
 
 static void virtio_host_blk_read_serial(struct virtio_host_blk *vblk)
 {
 	u8 sc;
-	int i, rc;
+	int i;
 	struct vmm_completion cmpl;
 	struct virtio_host_blk_req *req;
 	const char hexchar[] = "0123456789abcdef";
 
-	if (!fifo_dequeue(vblk->reqs_fifo, &req)) {
-		vmm_lerror(vblk->vdev->dev.name,
-			   "Failed to dequeue free request\n");
+	req = virtio_host_blk_get_req(vblk);
+	if (!req) {
 		return;
 	}
 
@@ -277,25 +513,19 @@ static void virtio_host_blk_read_serial(struct virtio_host_blk *vblk)
 	DPRINTF(vblk, "%s: req=0x%p cmpl=0x%p\n",
 		__func__, req, &cmpl);
 
-	req->r = NULL;
 	req->cmpl = &cmpl;
 	req->hdr.type = cpu_to_virtio32(vblk->vdev, VMM_VIRTIO_BLK_T_GET_ID);
 	req->hdr.ioprio = 0;
 	req->hdr.sector = 0;
 	req->iovec[1].buf = vblk->raw_serial;
 	req->iovec[1].buf_len = VMM_VIRTIO_BLK_ID_BYTES;
+	req->ivs[1] = &req->iovec[1];
+	req->ivs[2] = &req->status_iovec;
 
-	rc = virtio_host_queue_add_iovecs(vblk->vqs[0], req->ivs, 1, 2, req);
-	if (rc) {
-		vmm_lerror(vblk->vdev->dev.name,
-			   "Failed to add iovecs to VirtIO host queue\n");
-		req->r = NULL;
-		req->cmpl = NULL;
-		fifo_enqueue(vblk->reqs_fifo, &req, TRUE);
+	if (virtio_host_blk_queue_req(req, 1, 2)) {
+		return;
 	}
 
-	virtio_host_queue_kick(vblk->vqs[0]);
-
 	vmm_completion_wait(&cmpl);
 
 	for (i = 0; i < VMM_VIRTIO_BLK_ID_BYTES; i++) {
@@ -307,49 +537,102 @@ static void virtio_host_blk_read_serial(struct virtio_host_blk *vblk)
 
 static int virtio_host_blk_init_pool(struct virtio_host_blk *vblk)
 {
-	int i;
+	u32 i, q, r;
+	u32 niv = vblk->seg_max + 1;
+	struct virtio_host_blk_vq *bvq;
 	struct virtio_host_blk_req *req;
 
-	/* Setup max requests count
-	 * Note: We don't use indirect descriptors so
-	 * max requests count is half available descriptors
+	/* Setup max requests count of each queue
+	 * Note: With indirect descriptors a request takes one
+	 * descriptor. Otherwise it takes (data segments + 2)
+	 * descriptors so we keep half of vring as before and
+	 * requests which don't fit wait in pending list.
 	 */
-	vblk->max_reqs = vblk->vqs[0]->num_free / 2;
+	vblk->max_reqs = 0;
+	for (q = 0; q < vblk->num_vqs; q++) {
+		bvq = &vblk->bvqs[q];
+		bvq->max_reqs = bvq->vq->num_free;
+		if (!bvq->vq->indirect) {
+			bvq->max_reqs = udiv32(bvq->max_reqs, 2);
+		}
+		if (!bvq->max_reqs)
+			return VMM_EINVALID;
+		vblk->max_reqs += bvq->max_reqs;
+	}
 
-	vblk->reqs = vmm_zalloc(vblk->max_reqs * sizeof(*vblk->reqs));
-	if (!vblk->reqs)
-		return VMM_ENOMEM;
+	/* We need atleast one request for flush besides read/write */
+	if (vblk->max_reqs < 2)
+		return VMM_EINVALID;
 
-	vblk->reqs_fifo = fifo_alloc(sizeof(void *), vblk->max_reqs);
-	if (!vblk->reqs_fifo) {
-		vmm_free(vblk->reqs);
+	vblk->reqs_iovecs = vmm_zalloc(vblk->max_reqs * niv *
+					sizeof(*vblk->reqs_iovecs));
+	if (!vblk->reqs_iovecs)
 		return VMM_ENOMEM;
-	}
 
-	for (i = 0; i < vblk->max_reqs; i++) {
-		req = &vblk->reqs[i];
-		req->r = NULL;
-		req->cmpl = NULL;
-		req->vblk = vblk;
-		req->iovec[0].buf = &req->hdr;
-		req->iovec[0].buf_len = sizeof(req->hdr);
-		req->iovec[1].buf = NULL;
-		req->iovec[1].buf_len = 0;
-		req->iovec[2].buf = &req->status;
-		req->iovec[2].buf_len = sizeof(req->status);
-		req->ivs[0] = &req->iovec[0];
-		req->ivs[1] = &req->iovec[1];
-		req->ivs[2] = &req->iovec[2];
-		fifo_enqueue(vblk->reqs_fifo, &req, TRUE);
+	vblk->reqs_ivs = vmm_zalloc(vblk->max_reqs * (niv + 1) *
+				    sizeof(*vblk->reqs_ivs));
+	if (!vblk->reqs_ivs)
+		goto fail_free_iovecs;
+
+	i = 0;
+	for (q = 0; q < vblk->num_vqs; q++) {
+		bvq = &vblk->bvqs[q];
+
+		bvq->reqs = vmm_zalloc(bvq->max_reqs * sizeof(*bvq->reqs));
+		if (!bvq->reqs)
+			goto fail_free_bvqs;
+
+		bvq->reqs_fifo = fifo_alloc(sizeof(void *), bvq->max_reqs);
+		if (!bvq->reqs_fifo)
+			goto fail_free_bvqs;
+
+		for (r = 0; r < bvq->max_reqs; r++, i++) {
+			req = &bvq->reqs[r];
+			req->r = NULL;
+			req->cmpl = NULL;
+			req->vblk = vblk;
+			req->bvq = bvq;
+			req->iovec = &vblk->reqs_iovecs[i * niv];
+			req->ivs = &vblk->reqs_ivs[i * (niv + 1)];
+			req->iovec[0].buf = &req->hdr;
+			req->iovec[0].buf_len = sizeof(req->hdr);
+			req->status_iovec.buf = &req->status;
+			req->status_iovec.buf_len = sizeof(req->status);
+			req->ivs[0] = &req->iovec[0];
+			fifo_enqueue(bvq->reqs_fifo, &req, TRUE);
+		}
 	}
 
 	return VMM_OK;
+
+fail_free_bvqs:
+	for (q = 0; q < vblk->num_vqs; q++) {
+		bvq = &vblk->bvqs[q];
+		if (bvq->reqs_fifo) {
+			fifo_free(bvq->reqs_fifo);
+			bvq->reqs_fifo = NULL;
+		}
+		if (bvq->reqs) {
+			vmm_free(bvq->reqs);
+			bvq->reqs = NULL;
+		}
+	}
+	vmm_free(vblk->reqs_ivs);
+fail_free_iovecs:
+	vmm_free(vblk->reqs_iovecs);
+	return VMM_ENOMEM;
 }
 
 static void virtio_host_blk_cleanup_pool(struct virtio_host_blk *vblk)
 {
-	fifo_free(vblk->reqs_fifo);
-	vmm_free(vblk->reqs);
+	u32 q;
+
+	for (q = 0; q < vblk->num_vqs; q++) {
+		fifo_free(vblk->bvqs[q].reqs_fifo);
+		vmm_free(vblk->bvqs[q].reqs);
+	}
+	vmm_free(vblk->reqs_ivs);
+	vmm_free(vblk->reqs_iovecs);
 }
 
 static int virtio_host_blk_init_vqs(struct virtio_host_blk *vblk)
@@ -361,19 +644,29 @@ static int virtio_host_blk_init_vqs(struct virtio_host_blk *vblk)
 	rc = virtio_cread_feature(vblk->vdev, VMM_VIRTIO_BLK_F_MQ,
 				  struct vmm_virtio_blk_config, num_queues,
 				  &vblk->num_vqs);
-	if (rc)
+	if (rc || !vblk->num_vqs)
 		vblk->num_vqs = 1;
 
+	/* More queues than host CPUs won't help us */
+	if (vblk->num_vqs > vmm_num_online_cpus())
+		vblk->num_vqs = vmm_num_online_cpus();
+
 	vblk->vqs = vmm_zalloc(vblk->num_vqs * sizeof(*vblk->vqs));
 	if (!vblk->vqs) {
 		rc = VMM_ENOMEM;
 		goto fail;
 	}
 
+	vblk->bvqs = vmm_zalloc(vblk->num_vqs * sizeof(*vblk->bvqs));
+	if (!vblk->bvqs) {
+		rc = VMM_ENOMEM;
+		goto fail_free_vqs;
+	}
+
 	callbacks = vmm_zalloc(vblk->num_vqs * sizeof(*callbacks));
 	if (!callbacks) {
 		rc = VMM_ENOMEM;
-		goto fail_free_vqs;
+		goto fail_free_bvqs;
 	}
 
 	names = vmm_zalloc(vblk->num_vqs * sizeof(*names));
@@ -400,6 +693,9 @@ static int virtio_host_blk_init_vqs(struct virtio_host_blk *vblk)
 	}
 
 	for (i = 0; i < vblk->num_vqs; i++) {
+		INIT_SPIN_LOCK(&vblk->bvqs[i].lock);
+		INIT_LIST_HEAD(&vblk->bvqs[i].pending);
+		vblk->bvqs[i].vq = vblk->vqs[i];
 		if (!names[i]) {
 			continue;
 		}
@@ -422,6 +718,8 @@ fail_free_names:
 	vmm_free(names);
 fail_free_callbacks:
 	vmm_free(callbacks);
+fail_free_bvqs:
+	vmm_free(vblk->bvqs);
 fail_free_vqs:
 	vmm_free(vblk->vqs);
 fail:
@@ -431,6 +729,7 @@ fail:
 static void virtio_host_blk_cleanup_vqs(struct virtio_host_blk *vblk)
 {
 	virtio_host_del_vqs(vblk->vdev);
+	vmm_free(vblk->bvqs);
 	vmm_free(vblk->vqs);
 }
 
@@ -462,6 +761,7 @@ static int virtio_host_blk_name_format(char *prefix, int index,
 static int virtio_host_blk_probe(struct virtio_host_device *vdev)
 {
 	int rc = VMM_OK;
+	u32 max_sectors;
 	struct virtio_host_blk *vblk;
 
 	/* Allocate virtio host block device */
@@ -507,6 +807,12 @@ static int virtio_host_blk_probe(struct virtio_host_device *vdev)
 	if (rc) {
 		vblk->seg_size = U32_MAX;
 	}
+	rc = virtio_cread_feature(vdev, VMM_VIRTIO_BLK_F_SEG_MAX,
+				  struct vmm_virtio_blk_config, seg_max,
+				  &vblk->seg_max);
+	if (rc || !vblk->seg_max) {
+		vblk->seg_max = 1;
+	}
 
 	/* Host can optionally specify the block size of the device */
 	rc = virtio_cread_feature(vdev, VMM_VIRTIO_BLK_F_BLK_SIZE,
@@ -520,12 +826,41 @@ static int virtio_host_blk_probe(struct virtio_host_device *vdev)
 					  vblk->block_size);
 	}
 
+	/* Setup completion work */
+	INIT_SPIN_LOCK(&vblk->done_lock);
+	INIT_LIST_HEAD(&vblk->done_list);
+	INIT_WORK(&vblk->done_work, virtio_host_blk_done_work);
+	vblk->done_wq = vmm_workqueue_create(vdev->dev.name,
+					     VMM_THREAD_DEF_PRIORITY);
+	if (!vblk->done_wq) {
+		vmm_lerror(vdev->dev.name,
+			   "failed to create completion workqueue\n");
+		rc = VMM_ENOMEM;
+		goto fail_free_index;
+	}
+
 	/* Setup VirtIO host queues */
 	rc = virtio_host_blk_init_vqs(vblk);
 	if (rc) {
 		vmm_lerror(vdev->dev.name,
 			   "failed to setup virtio_host queues\n");
-		goto fail_free_index;
+		goto fail_destroy_wq;
+	}
+
+	/* Limit segments per request based on descriptors it will take
+	 * Note: With indirect descriptors a request only takes one
+	 * descriptor in vring but indirect table has (seg_max + 2)
+	 * descriptors which must not exceed vring size.
+	 */
+	if (vblk->vqs[0]->indirect) {
+		if (vblk->seg_max > VIRTIO_HOST_BLK_MAX_INDIRECT_SEGS) {
+			vblk->seg_max = VIRTIO_HOST_BLK_MAX_INDIRECT_SEGS;
+		}
+		if ((vblk->seg_max + 2) > vblk->vqs[0]->vring.num) {
+			vblk->seg_max = vblk->vqs[0]->vring.num - 2;
+		}
+	} else if (vblk->seg_max > VIRTIO_HOST_BLK_MAX_SEGS) {
+		vblk->seg_max = VIRTIO_HOST_BLK_MAX_SEGS;
 	}
 
 	/* Setup requests pool */
@@ -563,9 +898,12 @@ static int virtio_host_blk_probe(struct virtio_host_device *vdev)
 	vblk->bdev->num_blocks = vblk->num_blocks;
 	vblk->bdev->block_size = vblk->block_size;
 
-	/* Setup request queue for block device instance */
+	/* Setup request queue for block device instance
+	 * Note: One request is kept aside for flush so that flush
+	 * never fails due to read/write requests in-flight.
+	 */
 	vblk->brq = vmm_blockrq_create(vblk->bdev->name,
-				       vblk->max_reqs, TRUE,
+				       vblk->max_reqs - 1, TRUE,
 				       virtio_host_blk_read,
 				       virtio_host_blk_write,
 				       NULL,
@@ -577,6 +915,26 @@ static int virtio_host_blk_probe(struct virtio_host_device *vdev)
 		goto fail_free_bdev;
 	}
 	vblk->bdev->rq = vmm_blockrq_to_rq(vblk->brq);
+	if (vblk->seg_max > 1) {
+		vmm_blockrq_set_sg_limits(vblk->brq, vblk->seg_max, FALSE);
+	}
+
+	/* Pass-through DISCARD and WRITE_ZEROES if host supports them */
+	if (!vblk->read_only &&
+	    !virtio_cread_feature(vdev, VMM_VIRTIO_BLK_F_DISCARD,
+				  struct vmm_virtio_blk_config,
+				  max_discard_sectors, &max_sectors)) {
+		vmm_blockrq_set_discard(vblk->brq, virtio_host_blk_discard,
+				virtio_host_blk_zero_limit(vblk, max_sectors));
+	}
+	if (!vblk->read_only &&
+	    !virtio_cread_feature(vdev, VMM_VIRTIO_BLK_F_WRITE_ZEROES,
+				  struct vmm_virtio_blk_config,
+				  max_write_zeroes_sectors, &max_sectors)) {
+		vmm_blockrq_set_write_zeroes(vblk->brq,
+				virtio_host_blk_write_zeroes,
+				virtio_host_blk_zero_limit(vblk, max_sectors));
+	}
 
 	/* Register block device instance */
 	rc = vmm_blockdev_register(vblk->bdev);
@@ -594,8 +952,8 @@ static int virtio_host_blk_probe(struct virtio_host_device *vdev)
 
 	/* Read serial number */
 	virtio_host_blk_read_serial(vblk);
-	DPRINTF(vblk, "max_reqs=%d serial=%s\n",
-		vblk->max_reqs, vblk->serial);
+	DPRINTF(vblk, "num_vqs=%d max_reqs=%d seg_max=%d serial=%s\n",
+		vblk->num_vqs, vblk->max_reqs, vblk->seg_max, vblk->serial);
 
 	/* Announce presence of VirtIO host block device */
 	vmm_linfo(vdev->dev.name,
@@ -612,6 +970,8 @@ fail_free_pool:
 	virtio_host_blk_cleanup_pool(vblk);
 fail_free_vqs:
 	virtio_host_blk_cleanup_vqs(vblk);
+fail_destroy_wq:
+	vmm_workqueue_destroy(vblk->done_wq);
 fail_free_index:
 	ida_simple_remove(&vd_index_ida, vblk->index);
 fail_free_vblk:
@@ -624,6 +984,7 @@ static void virtio_host_blk_remove(struct virtio_host_device *vdev)
 	struct virtio_host_blk *vblk = vdev->priv;
 
 	virtio_host_device_reset(vblk->vdev);
+	vmm_workqueue_destroy(vblk->done_wq);
 	vmm_blockdev_unregister(vblk->bdev);
 	vmm_blockrq_destroy(vblk->brq);
 	vmm_blockdev_free(vblk->bdev);
@@ -646,6 +1007,9 @@ static unsigned int features_legacy[] = {
 	VMM_VIRTIO_BLK_F_RO,
 	VMM_VIRTIO_BLK_F_BLK_SIZE,
 	VMM_VIRTIO_BLK_F_FLUSH,
+	VMM_VIRTIO_BLK_F_DISCARD,
+	VMM_VIRTIO_BLK_F_WRITE_ZEROES,
+	VMM_VIRTIO_BLK_F_MQ,
 }
 ;
 static unsigned int features[] = {
@@ -655,6 +1019,9 @@ static unsigned int features[] = {
 	VMM_VIRTIO_BLK_F_RO,
 	VMM_VIRTIO_BLK_F_BLK_SIZE,
 	VMM_VIRTIO_BLK_F_FLUSH,
+	VMM_VIRTIO_BLK_F_DISCARD,
+	VMM_VIRTIO_BLK_F_WRITE_ZEROES,
+	VMM_VIRTIO_BLK_F_MQ,
 };
 
 static struct virtio_host_driver virtio_host_blk_driver = {
@@ -111,6 +111,7 @@ static int __init_ide_drive(struct ide_drive *drive)
 			   ide_make_request,
 			   ide_abort_request,
 			   NULL, drive);
+	bdev->rq->sg_capable = TRUE;
 
 	rc = vmm_blockdev_register(drive->bdev);
 	if (rc) {
@@ -147,6 +148,7 @@ static int __ide_blockdev_request(struct ide_drive *drive,
 {
 	int rc;
 	u32 cnt;
+	void *buf;
 
 	if (!r) {
 		return VMM_EFAIL;
@@ -157,9 +159,17 @@ static int __ide_blockdev_request(struct ide_drive *drive,
 		return VMM_EFAIL;
 	}
 
+	/* Scatter-gather requests go through bounce buffer */
+	buf = vmm_request_map_data(r);
+	if (!buf) {
+		vmm_blockdev_fail_request(r);
+		return VMM_ENOMEM;
+	}
+
 	switch (r->type) {
 	case VMM_REQUEST_READ:
-		cnt = __ide_bread(drive, r->lba, r->bcnt, r->data);
+		cnt = __ide_bread(drive, r->lba, r->bcnt, buf);
+		vmm_request_unmap_data(r, buf, cnt == r->bcnt);
 		if (cnt == r->bcnt) {
 			vmm_blockdev_complete_request(r);
 			rc = VMM_OK;
@@ -169,7 +179,8 @@ static int __ide_blockdev_request(struct ide_drive *drive,
 		}
 		break;
 	case VMM_REQUEST_WRITE:
-		cnt = __ide_bwrite(drive, r->lba, r->bcnt, r->data);
+		cnt = __ide_bwrite(drive, r->lba, r->bcnt, buf);
+		vmm_request_unmap_data(r, buf, FALSE);
 		if (cnt == r->bcnt) {
 			vmm_blockdev_complete_request(r);
 			rc = VMM_OK;
@@ -179,6 +190,7 @@ static int __ide_blockdev_request(struct ide_drive *drive,
 		}
 		break;
 	default:
+		vmm_request_unmap_data(r, buf, FALSE);
 		vmm_blockdev_fail_request(r);
 		rc = VMM_EFAIL;
 		break;
@@ -0,0 +1,117 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file cowblk.h
+ * @author agent (agent@local)
+ * @brief Interface for copy-on-write overlay block device driver.
+ *
+ * A copy-on-write overlay block device (COWBLK) stacks a per-guest
+ * write layer block device on top of a shared base block device.
+ * The base block device is never written. Clusters of base block
+ * device are copied to write layer when written for the first time
+ * and afterwards all IO on such clusters goes to write layer.
+ *
+ * Layout of write layer in units of clusters:
+ * 1. Header cluster
+ * 2. Cluster map with one little-endian u32 entry per base cluster.
+ *    Zero means cluster is in base otherwise entry is (slot + 1).
+ * 3. Data slots allocated sequentially as clusters are written.
+ *
+ * The write layer can be any block device (such as RBD or FILEBLK)
+ * and it can be smaller than base block device.
+ */
+
+#ifndef __COWBLK_H_
+#define __COWBLK_H_
+
+#include <vmm_types.h>
+#include <vmm_mutex.h>
+#include <libs/list.h>
+#include <block/vmm_blockdev.h>
+
+#define COWBLK_IPRIORITY		(VMM_BLOCKDEV_CLASS_IPRIORITY+1)
+
+#define COWBLK_MAGIC			0x574F4358 /* "XCOW" */
+#define COWBLK_VERSION			1
+#define COWBLK_MIN_CLUSTER_BITS		12
+#define COWBLK_MAX_CLUSTER_BITS		20
+#define COWBLK_DEF_CLUSTER_BITS		16
+
+/* Write layer header (on-disk format) */
+struct cowblk_header {
+	u32 magic;
+	u32 version;
+	u32 cluster_bits;	/* Cluster size is (1 << cluster_bits) */
+	u32 num_clusters;	/* Number of base clusters */
+	u64 base_blocks;	/* Number of base blocks */
+	u32 block_size;		/* Block size of base and write layer */
+	u32 reserved;
+} __packed;
+
+/* Copy-on-write overlay block device (COWBLK) context */
+struct cowblk {
+	struct dlist head;
+	struct vmm_blockdev *bdev;
+
+	/* Protects base, layer, map and used_slots */
+	struct vmm_mutex io_lock;
+	struct vmm_blockdev *base;
+	struct vmm_blockdev *layer;
+	char base_name[VMM_FIELD_NAME_SIZE];
+	char layer_name[VMM_FIELD_NAME_SIZE];
+
+	u32 cluster_bits;
+	u32 num_clusters;
+	u64 map_offset;
+	u64 data_offset;
+	u32 max_slots;
+	u32 used_slots;
+	u32 *map;
+	u8 *cluster;
+};
+
+/** Initialize write layer for overlay of given base block device
+ *  Note: cluster_bits zero means default cluster size
+ */
+int cowblk_format(const char *base_name, const char *layer_name,
+		  u32 cluster_bits);
+
+/** Create COWBLK instance using initialized write layer */
+struct cowblk *cowblk_create(const char *name,
+			      const char *base_name,
+			      const char *layer_name);
+
+/** Destroy COWBLK instance */
+void cowblk_destroy(struct cowblk *cb);
+
+/** Cluster size of COWBLK instance in bytes */
+static inline u32 cowblk_cluster_size(struct cowblk *cb)
+{
+	return (cb) ? (1 << cb->cluster_bits) : 0;
+}
+
+/** Find a COWBLK instance with given name */
+struct cowblk *cowblk_find(const char *name);
+
+/** Get COWBLK instance with given index */
+struct cowblk *cowblk_get(int index);
+
+/** Count number of COWBLK instances */
+u32 cowblk_count(void);
+
+#endif /* __COWBLK_H_ */
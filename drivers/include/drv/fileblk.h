@@ -0,0 +1,105 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file fileblk.h
+ * @author agent (agent@local)
+ * @brief Interface for VFS file backed block device driver.
+ *
+ * A file backed block device (FILEBLK) exposes a file from any
+ * VFS mounted filesystem as block device. The file can be:
+ *
+ * 1. Raw image: Block N of device is at offset (N * 512) in file.
+ *
+ * 2. Sparse image: File starts with a header cluster followed by
+ * L1 table. Each L1 entry points to a L2 table cluster and each
+ * L2 entry points to a data cluster. Unallocated (zero) entries
+ * read as zeros and clusters are only appended to the file when
+ * they are written for the first time. All on-disk fields are
+ * little-endian and all offsets are relative to start of file.
+ */
+
+#ifndef __FILEBLK_H_
+#define __FILEBLK_H_
+
+#include <vmm_types.h>
+#include <libs/list.h>
+#include <libs/vfs.h>
+#include <block/vmm_blockdev.h>
+
+#define FILEBLK_IPRIORITY		(VFS_IPRIORITY+1)
+#define FILEBLK_BLOCK_SIZE		512
+
+#define FILEBLK_SPARSE_MAGIC		0x50534258 /* "XBSP" */
+#define FILEBLK_SPARSE_VERSION		1
+#define FILEBLK_SPARSE_MIN_CLUSTER_BITS	12
+#define FILEBLK_SPARSE_MAX_CLUSTER_BITS	20
+#define FILEBLK_SPARSE_DEF_CLUSTER_BITS	16
+
+/* Sparse image header (on-disk format) */
+struct fileblk_sparse_header {
+	u32 magic;
+	u32 version;
+	u64 size;		/* Virtual disk size in bytes */
+	u32 cluster_bits;	/* Cluster size is (1 << cluster_bits) */
+	u32 l1_entries;		/* Number of L1 table entries */
+	u64 l1_offset;		/* Offset of L1 table */
+} __packed;
+
+struct fileblk_sparse;
+
+/* File backed block device (FILEBLK) context */
+struct fileblk {
+	struct dlist head;
+	struct vmm_blockdev *bdev;
+	char path[VFS_MAX_PATH];
+	int fd;
+	bool read_only;
+	u64 size;		/* Virtual disk size in bytes */
+	u64 file_size;		/* Backing file size in bytes */
+	struct fileblk_sparse *sparse; /* NULL for raw image */
+};
+
+/** Create sparse image file of given size
+ *  Note: cluster_bits zero means default cluster size
+ */
+int fileblk_format_sparse(const char *path, u64 size, u32 cluster_bits);
+
+/** Create FILEBLK instance for given file */
+struct fileblk *fileblk_create(const char *name,
+				const char *path,
+				bool read_only);
+
+/** Destroy FILEBLK instance */
+void fileblk_destroy(struct fileblk *fb);
+
+/** Check whether FILEBLK instance is backed by sparse image */
+static inline bool fileblk_is_sparse(struct fileblk *fb)
+{
+	return (fb && fb->sparse) ? TRUE : FALSE;
+}
+
+/** Find a FILEBLK instance with given name */
+struct fileblk *fileblk_find(const char *name);
+
+/** Get FILEBLK instance with given index */
+struct fileblk *fileblk_get(int index);
+
+/** Count number of FILEBLK instances */
+u32 fileblk_count(void);
+
+#endif /* __FILEBLK_H_ */
@@ -69,7 +69,8 @@ while (0)
 
 /** VirtIO host descriptor state */
 struct virtio_host_desc_state {
-	void *data;
+	void *data;			/* Data for callback. */
+	struct vmm_vring_desc *indir_desc; /* Indirect descriptor, if any. */
 };
 
 /** VirtIO host queue */
@@ -39,6 +39,7 @@
 #include <vmm_modules.h>
 #include <libs/stringlib.h>
 #include <libs/mathlib.h>
+#include <libs/scatterlist.h>
 #include <drv/mmc/mmc_core.h>
 
 #include "core.h"
@@ -369,20 +370,73 @@ static void mmc_host_poll_event_handler(struct vmm_timer_event *ev)
 	vmm_blockrq_queue_work(host->brq, mmc_host_poll, host);
 }
 
+/* Max scatter-gather entries handled in one request */
+#define MMC_MAX_SG_NENTS	64
+
+static int mmc_blockrq_rw_buf(struct mmc_host *host, u64 lba,
+			      u32 bcnt, void *buf, bool write)
+{
+	u32 cnt;
+
+	cnt = (write) ?
+	      __mmc_sd_bwrite(host, host->card, lba, bcnt, buf) :
+	      __mmc_sd_bread(host, host->card, lba, bcnt, buf);
+
+	return (cnt == bcnt) ? VMM_OK : VMM_EIO;
+}
+
+static int mmc_blockrq_rw(struct mmc_host *host,
+			  struct vmm_request *r, bool write)
+{
+	int rc;
+	u32 i, len = 0;
+	u64 lba = r->lba;
+	u8 *buf = NULL;
+	struct scatterlist *sg;
+
+	if (!r->sgl) {
+		return mmc_blockrq_rw_buf(host, lba, r->bcnt, r->data, write);
+	}
+
+	/* Issue one command for each run of virtually contiguous
+	 * entries (e.g. merged requests of adjacent buffers).
+	 * Note: Length of each entry is multiple of block size.
+	 */
+	for_each_sg(r->sgl, sg, r->sg_nents, i) {
+		if (len && (buf + len == (u8 *)sg_virt(sg))) {
+			len += sg->length;
+			continue;
+		}
+		if (len) {
+			rc = mmc_blockrq_rw_buf(host, lba,
+					udiv32(len, r->bdev->block_size),
+					buf, write);
+			if (rc) {
+				return rc;
+			}
+			lba += udiv32(len, r->bdev->block_size);
+		}
+		buf = sg_virt(sg);
+		len = sg->length;
+	}
+
+	if (!len) {
+		return VMM_OK;
+	}
+
+	return mmc_blockrq_rw_buf(host, lba,
+				  udiv32(len, r->bdev->block_size),
+				  buf, write);
+}
+
 static int mmc_blockrq_read(struct vmm_blockrq *brq,
 			    struct vmm_request *r, void *priv)
 {
-	u32 cnt;
-	int rc = VMM_OK;
+	int rc;
 	struct mmc_host *host = priv;
 
 	vmm_mutex_lock(&host->lock);
-	cnt = __mmc_sd_bread(host, host->card, r->lba, r->bcnt, r->data);
-	if (cnt == r->bcnt) {
-		rc = VMM_OK;
-	} else {
-		rc = VMM_EIO;
-	}
+	rc = mmc_blockrq_rw(host, r, FALSE);
 	vmm_mutex_unlock(&host->lock);
 
 	return rc;
@@ -391,17 +445,11 @@ static int mmc_blockrq_read(struct vmm_blockrq *brq,
 static int mmc_blockrq_write(struct vmm_blockrq *brq,
 			     struct vmm_request *r, void *priv)
 {
-	u32 cnt;
-	int rc = VMM_OK;
+	int rc;
 	struct mmc_host *host = priv;
 
 	vmm_mutex_lock(&host->lock);
-	cnt = __mmc_sd_bwrite(host, host->card, r->lba, r->bcnt, r->data);
-	if (cnt == r->bcnt) {
-		rc = VMM_OK;
-	} else {
-		rc = VMM_EIO;
-	}
+	rc = mmc_blockrq_rw(host, r, TRUE);
 	vmm_mutex_unlock(&host->lock);
 
 	return rc;
@@ -479,6 +527,7 @@ int mmc_add_host(struct mmc_host *host)
 		vmm_mutex_unlock(&mmc_host_list_mutex);
 		return VMM_EFAIL;
 	}
+	vmm_blockrq_set_sg_limits(host->brq, MMC_MAX_SG_NENTS, TRUE);
 
 	host->host_num = mmc_host_count;
 	mmc_host_count++;
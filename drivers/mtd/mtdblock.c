@@ -25,6 +25,7 @@
 #include <vmm_stdio.h>
 #include <block/vmm_blockdev.h>
 #include <block/vmm_blockrq.h>
+#include <libs/scatterlist.h>
 #include <linux/mtd/mtd.h>
 #include <linux/mtd/partitions.h>
 #include "mtdcore.h"
@@ -34,13 +35,39 @@ static void mtd_blockdev_erase_callback(struct erase_info *info)
 	/* Nothing to do here. */
 }
 
+/* Max scatter-gather entries handled in one request */
+#define MTDBLOCK_MAX_SG_NENTS	64
+
+static int mtd_blockdev_write_buf(struct vmm_request *r,
+				  physical_addr_t off,
+				  physical_size_t len,
+				  const u_char *buf,
+				  struct mtd_info *mtd)
+{
+	unsigned int retlen = 0;
+
+	if (mtd_write(mtd, off, len, &retlen, buf)) {
+		dev_err(&r->bdev->dev, "Writing at 0x%08X failed\n", off);
+		return VMM_EIO;
+	}
+
+	if (retlen < len) {
+		dev_warn(&r->bdev->dev, "Only 0x%X/0x%X bytes have been "
+			 "written at 0x%08X\n", retlen, len, off);
+		return VMM_EIO;
+	}
+	return VMM_OK;
+}
+
 static int mtd_blockdev_erase_write(struct vmm_request *r,
 				    physical_addr_t off,
 				    physical_size_t len,
 				    struct mtd_info *mtd)
 {
+	int rc;
+	unsigned int i;
+	struct scatterlist *sg;
 	struct erase_info info;
-	unsigned int retlen = 0;
 
 	info.mtd = mtd;
 	info.addr = off;
@@ -52,31 +79,48 @@ static int mtd_blockdev_erase_write(struct vmm_request *r,
 		return VMM_EIO;
 	}
 
-	if (mtd_write(mtd, off, len, &retlen, r->data)) {
-		dev_err(&r->bdev->dev, "Writing at 0x%08X failed\n", off);
-		return VMM_EIO;
+	if (!r->sgl) {
+		return mtd_blockdev_write_buf(r, off, len, r->data, mtd);
 	}
 
-	if (retlen < len) {
-		dev_warn(&r->bdev->dev, "Only 0x%X/0x%X bytes have been "
-			 "written at 0x%08X\n", retlen, len, off);
-		return VMM_EIO;
+	for_each_sg(r->sgl, sg, r->sg_nents, i) {
+		rc = mtd_blockdev_write_buf(r, off, sg->length,
+					    sg_virt(sg), mtd);
+		if (rc) {
+			return rc;
+		}
+		off += sg->length;
 	}
+
 	return VMM_OK;
 }
 
 int mtd_blockdev_read(struct vmm_blockrq *brq,
 	      struct vmm_request *r, void *priv)
 {
+	unsigned int i;
+	struct scatterlist *sg;
 	struct mtd_info *mtd = priv;
 	unsigned int retlen = 0;
 
 	physical_addr_t off = r->lba << mtd->erasesize_shift;
 	physical_size_t len = r->bcnt << mtd->erasesize_shift;
 
-	mtd_read(mtd, off, len, &retlen, r->data);
-	if (retlen < len) {
-		return VMM_EIO;
+	if (!r->sgl) {
+		mtd_read(mtd, off, len, &retlen, r->data);
+		if (retlen < len) {
+			return VMM_EIO;
+		}
+		return VMM_OK;
+	}
+
+	for_each_sg(r->sgl, sg, r->sg_nents, i) {
+		retlen = 0;
+		mtd_read(mtd, off, sg->length, &retlen, sg_virt(sg));
+		if (retlen < sg->length) {
+			return VMM_EIO;
+		}
+		off += sg->length;
 	}
 
 	return VMM_OK;
@@ -135,6 +179,7 @@ void mtdblock_add(struct mtd_info *mtd)
 		vmm_blockdev_free(bdev);
 		return;
 	}
+	vmm_blockrq_set_sg_limits(brq, MTDBLOCK_MAX_SG_NENTS, FALSE);
 	bdev->rq = vmm_blockrq_to_rq(brq);
 
 	/* Register block device instance */
@@ -154,6 +154,18 @@ static physical_addr_t virtio_map_one(const struct virtio_host_queue *vq,
 			   direction);
 }
 
+static physical_addr_t virtio_map_indirect(const struct virtio_host_queue *vq,
+					   struct vmm_vring_desc *desc,
+					   unsigned int num)
+{
+	struct virtio_host_iovec iv;
+
+	iv.buf = desc;
+	iv.buf_len = num * sizeof(struct vmm_vring_desc);
+
+	return virtio_map_one(vq, &iv, DMA_TO_DEVICE);
+}
+
 static void virtio_unmap_one(const struct virtio_host_queue *vq,
 			     struct vmm_vring_desc *desc)
 {
@@ -193,6 +205,22 @@ void virtio_host_queue_dump_vring(struct virtio_host_queue *vq)
 }
 VMM_EXPORT_SYMBOL(virtio_host_queue_dump_vring);
 
+static struct vmm_vring_desc *alloc_indirect(struct virtio_host_queue *vq,
+					     unsigned int total_ivs)
+{
+	unsigned int i;
+	struct vmm_vring_desc *desc;
+
+	desc = vmm_malloc(total_ivs * sizeof(struct vmm_vring_desc));
+	if (!desc)
+		return NULL;
+
+	for (i = 0; i < total_ivs; i++)
+		desc[i].next = cpu_to_virtio16(vq->vdev, i + 1);
+
+	return desc;
+}
+
 static int virtio_host_queue_add(struct virtio_host_queue *vq,
 				 struct virtio_host_iovec *ivs[],
 				 unsigned int total_ivs,
@@ -204,6 +232,7 @@ static int virtio_host_queue_add(struct virtio_host_queue *vq,
 	struct vmm_vring_desc *desc;
 	unsigned int i, n, avail, descs_used, prev = 0;
 	int head;
+	bool indirect;
 	physical_addr_t addr;
 
 	BUG_ON(data == NULL);
@@ -217,13 +246,26 @@ static int virtio_host_queue_add(struct virtio_host_queue *vq,
 
 	head = vq->free_head;
 
-	/* TODO: If the host supports indirect descriptor tables,
-	 * and we have multiple buffers, then go indirect.
-	 * TODO: tune the threshold of using indirect descriptor tables
+	/* If the host supports indirect descriptor tables, and we have
+	 * multiple buffers, then go indirect so that one request takes
+	 * only one descriptor of the ring.
 	 */
-	desc = vq->vring.desc;
-	i = head;
-	descs_used = total_ivs;
+	if (vq->indirect && (total_ivs > 1) && vq->num_free)
+		desc = alloc_indirect(vq, total_ivs);
+	else
+		desc = NULL;
+
+	if (desc) {
+		/* Use a single buffer which doesn't continue */
+		indirect = TRUE;
+		i = 0;
+		descs_used = 1;
+	} else {
+		indirect = FALSE;
+		desc = vq->vring.desc;
+		i = head;
+		descs_used = total_ivs;
+	}
 
 	if (vq->num_free < descs_used) {
 		DPRINTF("Can't add buf len %i - avail = %i\n",
@@ -233,6 +275,8 @@ static int virtio_host_queue_add(struct virtio_host_queue *vq,
 		 * host should service the ring ASAP. */
 		if (out_ivs)
 			vq->notify(vq);
+		if (indirect)
+			vmm_free(desc);
 		return VMM_ENOSPC;
 	}
 
@@ -264,14 +308,29 @@ static int virtio_host_queue_add(struct virtio_host_queue *vq,
 	/* Last one doesn't continue. */
 	desc[prev].flags &= cpu_to_virtio16(vq->vdev, ~VMM_VRING_DESC_F_NEXT);
 
+	if (indirect) {
+		/* Now that the indirect table is filled in, map it. */
+		addr = virtio_map_indirect(vq, desc, total_ivs);
+		vq->vring.desc[head].flags = cpu_to_virtio16(vq->vdev,
+						VMM_VRING_DESC_F_INDIRECT);
+		vq->vring.desc[head].addr = cpu_to_virtio64(vq->vdev, addr);
+		vq->vring.desc[head].len = cpu_to_virtio32(vq->vdev,
+				total_ivs * sizeof(struct vmm_vring_desc));
+	}
+
 	/* We're using some buffers from the free list. */
 	vq->num_free -= descs_used;
 
 	/* Update free pointer */
-	vq->free_head = i;
+	if (indirect)
+		vq->free_head = virtio16_to_cpu(vq->vdev,
+						vq->vring.desc[head].next);
+	else
+		vq->free_head = i;
 
 	/* Store token and indirect buffer state. */
 	vq->desc_state[head].data = data;
+	vq->desc_state[head].indir_desc = (indirect) ? desc : NULL;
 
 	/* Put entry in available array (but don't update avail->idx until they
 	 * do sync). */
@@ -399,7 +458,18 @@ static void detach_buf(struct virtio_host_queue *vq, unsigned int head)
 	/* Plus final descriptor */
 	vq->num_free++;
 
-	/* TODO: Free the indirect table, if any, now that it's unmapped. */
+	/* Free the indirect table, if any, now that it's unmapped. */
+	if (vq->desc_state[head].indir_desc) {
+		struct vmm_vring_desc *indir_desc =
+					vq->desc_state[head].indir_desc;
+		u32 len = virtio32_to_cpu(vq->vdev, vq->vring.desc[head].len);
+
+		for (i = 0; i < (len / sizeof(struct vmm_vring_desc)); i++)
+			virtio_unmap_one(vq, &indir_desc[i]);
+
+		vmm_free(indir_desc);
+		vq->desc_state[head].indir_desc = NULL;
+	}
 }
 
 static inline bool more_used(const struct virtio_host_queue *vq)
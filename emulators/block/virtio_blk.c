@@ -27,11 +27,13 @@
 #include <vmm_spinlocks.h>
 #include <vmm_modules.h>
 #include <vmm_devemu.h>
+#include <vmm_guest_snapshot.h>
 #include <vio/vmm_vdisk.h>
 #include <vio/vmm_virtio.h>
 #include <vio/vmm_virtio_blk.h>
 #include <libs/mathlib.h>
 #include <libs/stringlib.h>
+#include <libs/scatterlist.h>
 
 #undef DEBUG
 
@@ -53,6 +55,10 @@
 #define VIRTIO_BLK_NUM_QUEUES		1
 #define VIRTIO_BLK_SECTOR_SIZE		512
 #define VIRTIO_BLK_DISK_SEG_MAX		(VIRTIO_BLK_QUEUE_SIZE - 2)
+#define VIRTIO_BLK_MAX_DISCARD_SECTORS	(U32_MAX / VIRTIO_BLK_SECTOR_SIZE)
+
+#define VIRTIO_BLK_SNAPSHOT_MAGIC	0x4B4C4256 /* "VBLK" */
+#define VIRTIO_BLK_SNAPSHOT_VERSION	1
 
 struct virtio_blk_dev_req {
 	struct vmm_virtio_queue		*vq;
@@ -62,6 +68,9 @@ struct virtio_blk_dev_req {
 	u32				len;
 	struct vmm_virtio_iovec		status_iov;
 	void				*data;
+	struct scatterlist		*sgl;
+	u32				sg_nents;
+	bool				aborted;
 	struct vmm_vdisk_request	r;
 };
 
@@ -73,6 +82,11 @@ struct virtio_blk_dev {
 	struct virtio_blk_dev_req	reqs[VIRTIO_BLK_QUEUE_SIZE];
 	u32 				features;
 
+	/* Requests which could not be aborted by reset */
+	vmm_spinlock_t			abort_lock;
+	u32				abort_count;
+	bool				io_deferred;
+
 	struct vmm_virtio_blk_config 	config;
 	struct vmm_vdisk		*vdisk;
 };
@@ -82,6 +96,8 @@ static u32 virtio_blk_get_host_features(struct vmm_virtio_device *dev)
 	return	1UL << VMM_VIRTIO_BLK_F_SEG_MAX
 		| 1UL << VMM_VIRTIO_BLK_F_BLK_SIZE
 		| 1UL << VMM_VIRTIO_BLK_F_FLUSH
+		| 1UL << VMM_VIRTIO_BLK_F_DISCARD
+		| 1UL << VMM_VIRTIO_BLK_F_WRITE_ZEROES
 		| 1UL << VMM_VIRTIO_RING_F_EVENT_IDX;
 #if 0
 		| 1UL << VMM_VIRTIO_RING_F_INDIRECT_DESC;
@@ -156,20 +172,135 @@ static int virtio_blk_set_size_vq(struct vmm_virtio_device *dev,
 	return size;
 }
 
+static void virtio_blk_req_free_data(struct virtio_blk_dev_req *req)
+{
+	u32 i;
+
+	if (req->sgl) {
+		for (i = 0; i < req->sg_nents; i++) {
+			vmm_free(sg_virt(&req->sgl[i]));
+		}
+		vmm_free(req->sgl);
+		req->sgl = NULL;
+		req->sg_nents = 0;
+	}
+
+	if (req->data) {
+		vmm_free(req->data);
+		req->data = NULL;
+	}
+}
+
+/* Allocate one buffer per guest iovec so that large requests
+ * don't need a large contiguous heap allocation. We fallback
+ * to single buffer for single iovec or when this fails.
+ */
+static int virtio_blk_req_alloc_data(struct virtio_blk_dev_req *req,
+				     struct vmm_virtio_iovec *iov,
+				     u32 iov_cnt)
+{
+	u32 i;
+	void *buf;
+
+	if (1 < iov_cnt) {
+		req->sgl = vmm_zalloc(iov_cnt * sizeof(*req->sgl));
+		if (req->sgl) {
+			sg_init_table(req->sgl, iov_cnt);
+			for (i = 0; i < iov_cnt; i++) {
+				buf = (iov[i].len) ?
+					vmm_malloc(iov[i].len) : NULL;
+				if (!buf) {
+					break;
+				}
+				sg_set_buf(&req->sgl[i], buf, iov[i].len);
+				req->sg_nents++;
+			}
+			if (req->sg_nents == iov_cnt) {
+				return VMM_OK;
+			}
+			virtio_blk_req_free_data(req);
+		}
+	}
+
+	req->data = vmm_malloc(req->len);
+
+	return (req->data) ? VMM_OK : VMM_ENOMEM;
+}
+
+static void __virtio_blk_do_io(struct vmm_virtio_device *dev,
+			       struct virtio_blk_dev *vbdev);
+
+/* Release request which was in-flight when device was reset and
+ * resume queue processing once all such requests are done.
+ */
+static void virtio_blk_req_abort_done(struct virtio_blk_dev *vbdev,
+				      struct virtio_blk_dev_req *req)
+{
+	irq_flags_t flags;
+	bool resume = FALSE;
+
+	if (req->read_iov) {
+		vmm_free(req->read_iov);
+		req->read_iov = NULL;
+		req->read_iov_cnt = 0;
+	}
+	virtio_blk_req_free_data(req);
+
+	vmm_spin_lock_irqsave(&vbdev->abort_lock, flags);
+	req->aborted = FALSE;
+	vbdev->abort_count--;
+	if (!vbdev->abort_count && vbdev->io_deferred) {
+		vbdev->io_deferred = FALSE;
+		resume = TRUE;
+	}
+	vmm_spin_unlock_irqrestore(&vbdev->abort_lock, flags);
+
+	if (resume) {
+		__virtio_blk_do_io(vbdev->vdev, vbdev);
+	}
+}
+
 static void virtio_blk_req_done(struct virtio_blk_dev *vbdev,
 				struct virtio_blk_dev_req *req, u8 status)
 {
+	u32 i;
+	bool aborted;
+	irq_flags_t flags;
+	enum vmm_vdisk_request_type type;
 	struct vmm_virtio_device *dev = vbdev->vdev;
 	int queueid = req->vq - vbdev->vqs;
 
-	if (req->read_iov && req->len && req->data &&
+	vmm_spin_lock_irqsave(&vbdev->abort_lock, flags);
+	type = vmm_vdisk_get_request_type(&req->r);
+	vmm_vdisk_set_request_type(&req->r, VMM_VDISK_REQUEST_UNKNOWN);
+	aborted = req->aborted;
+	vmm_spin_unlock_irqrestore(&vbdev->abort_lock, flags);
+
+	/* Virtqueue of aborted request is gone so drop the result */
+	if (aborted) {
+		if (type != VMM_VDISK_REQUEST_UNKNOWN) {
+			virtio_blk_req_abort_done(vbdev, req);
+		}
+		return;
+	}
+
+	if (req->read_iov && req->len && (req->data || req->sgl) &&
 	    (status == VMM_VIRTIO_BLK_S_OK) &&
-	    (vmm_vdisk_get_request_type(&req->r) == VMM_VDISK_REQUEST_READ)) {
-		vmm_virtio_buf_to_iovec_write(dev,
-					  req->read_iov,
-					  req->read_iov_cnt,
-					  req->data,
-					  req->len);
+	    (type == VMM_VDISK_REQUEST_READ)) {
+		if (req->sgl) {
+			for (i = 0; i < req->sg_nents; i++) {
+				vmm_virtio_buf_to_iovec_write(dev,
+						&req->read_iov[i], 1,
+						sg_virt(&req->sgl[i]),
+						req->sgl[i].length);
+			}
+		} else {
+			vmm_virtio_buf_to_iovec_write(dev,
+						  req->read_iov,
+						  req->read_iov_cnt,
+						  req->data,
+						  req->len);
+		}
 	}
 
 	if (req->read_iov) {
@@ -178,11 +309,7 @@ static void virtio_blk_req_done(struct virtio_blk_dev *vbdev,
 		req->read_iov_cnt = 0;
 	}
 
-	vmm_vdisk_set_request_type(&req->r, VMM_VDISK_REQUEST_UNKNOWN);
-	if (req->data) {
-		vmm_free(req->data);
-		req->data = NULL;
-	}
+	virtio_blk_req_free_data(req);
 
 	vmm_virtio_buf_to_iovec_write(dev, &req->status_iov, 1, &status, 1);
 
@@ -193,6 +320,33 @@ static void virtio_blk_req_done(struct virtio_blk_dev *vbdev,
 	}
 }
 
+static void virtio_blk_update_discard_config(struct virtio_blk_dev *vbdev)
+{
+	u32 max;
+
+	/* Note: Zero max sectors means no limit to guest so we keep
+	 * discard segment limits even when attached block device does
+	 * not support DISCARD or WRITE_ZEROES. Such requests are handled
+	 * in virtio_blk_do_discard().
+	 */
+	vbdev->config.discard_sector_alignment = 1;
+	vbdev->config.max_discard_seg = 1;
+	vbdev->config.max_write_zeroes_seg = 1;
+	vbdev->config.write_zeroes_may_unmap = 0;
+
+	max = vmm_vdisk_max_discard_blocks(vbdev->vdisk);
+	if (VIRTIO_BLK_MAX_DISCARD_SECTORS < max) {
+		max = VIRTIO_BLK_MAX_DISCARD_SECTORS;
+	}
+	vbdev->config.max_discard_sectors = max;
+
+	max = vmm_vdisk_max_write_zeroes_blocks(vbdev->vdisk);
+	if (VIRTIO_BLK_MAX_DISCARD_SECTORS < max) {
+		max = VIRTIO_BLK_MAX_DISCARD_SECTORS;
+	}
+	vbdev->config.max_write_zeroes_sectors = max;
+}
+
 static void virtio_blk_attached(struct vmm_vdisk *vdisk)
 {
 	struct virtio_blk_dev *vbdev = vmm_vdisk_priv(vdisk);
@@ -203,6 +357,7 @@ static void virtio_blk_attached(struct vmm_vdisk *vdisk)
 	vbdev->config.capacity = vmm_vdisk_capacity(vbdev->vdisk);
 	vbdev->config.seg_max = VIRTIO_BLK_DISK_SEG_MAX,
 	vbdev->config.blk_size = vmm_vdisk_block_size(vbdev->vdisk);
+	virtio_blk_update_discard_config(vbdev);
 }
 
 static void virtio_blk_detached(struct vmm_vdisk *vdisk)
@@ -215,6 +370,7 @@ static void virtio_blk_detached(struct vmm_vdisk *vdisk)
 	vbdev->config.capacity = 0;
 	vbdev->config.seg_max = VIRTIO_BLK_DISK_SEG_MAX,
 	vbdev->config.blk_size = VIRTIO_BLK_SECTOR_SIZE;
+	virtio_blk_update_discard_config(vbdev);
 }
 
 static void virtio_blk_req_completed(struct vmm_vdisk *vdisk,
@@ -239,8 +395,67 @@ static void virtio_blk_req_failed(struct vmm_vdisk *vdisk,
 			    VMM_VIRTIO_BLK_S_IOERR);
 }
 
-static void virtio_blk_do_io(struct vmm_virtio_device *dev,
-			     struct virtio_blk_dev *vbdev)
+static void virtio_blk_do_discard(struct vmm_virtio_device *dev,
+				  struct virtio_blk_dev *vbdev,
+				  struct virtio_blk_dev_req *req,
+				  u32 iov_cnt, u32 type)
+{
+	u32 len, max, num_sectors;
+	enum vmm_vdisk_request_type vtype;
+	struct vmm_virtio_blk_discard_write_zeroes seg;
+
+	if (type == VMM_VIRTIO_BLK_T_DISCARD) {
+		vtype = VMM_VDISK_REQUEST_DISCARD;
+		max = vbdev->config.max_discard_sectors;
+	} else {
+		vtype = VMM_VDISK_REQUEST_WRITE_ZEROES;
+		max = vbdev->config.max_write_zeroes_sectors;
+	}
+
+	/* We advertise only one segment per request */
+	if ((iov_cnt < 3) || (req->len != sizeof(seg))) {
+		virtio_blk_req_done(vbdev, req, VMM_VIRTIO_BLK_S_UNSUPP);
+		return;
+	}
+	len = vmm_virtio_iovec_to_buf_read(dev, &vbdev->iov[1], iov_cnt - 2,
+					   &seg, sizeof(seg));
+	if (len < sizeof(seg)) {
+		virtio_blk_req_done(vbdev, req, VMM_VIRTIO_BLK_S_IOERR);
+		return;
+	}
+	num_sectors = seg.num_sectors;
+
+	DPRINTF("%s: type=%d dev=%s sector=%"PRIu64" num_sectors=%d\n",
+		__func__, type, dev->name,
+		(u64)seg.sector, num_sectors);
+
+	if (!max) {
+		/* DISCARD is only a hint so we can safely ignore it
+		 * whereas guest will fallback to writing zeroes itself
+		 * for unsupported WRITE_ZEROES.
+		 */
+		virtio_blk_req_done(vbdev, req,
+				    (vtype == VMM_VDISK_REQUEST_DISCARD) ?
+				    VMM_VIRTIO_BLK_S_OK :
+				    VMM_VIRTIO_BLK_S_UNSUPP);
+		return;
+	}
+	if (!num_sectors || (max < num_sectors)) {
+		virtio_blk_req_done(vbdev, req, VMM_VIRTIO_BLK_S_IOERR);
+		return;
+	}
+
+	vmm_vdisk_set_request_type(&req->r, vtype);
+	/* Note: We will get failed() or complete() callback
+	 * even when no block device attached to virtual disk
+	 */
+	vmm_vdisk_submit_request_nodata(vbdev->vdisk, &req->r, vtype,
+					seg.sector,
+					num_sectors * VIRTIO_BLK_SECTOR_SIZE);
+}
+
+static void __virtio_blk_do_io(struct vmm_virtio_device *dev,
+			       struct virtio_blk_dev *vbdev)
 {
 	u16 head;
 	u32 i, iov_cnt, len;
@@ -248,6 +463,9 @@ static void virtio_blk_do_io(struct vmm_virtio_device *dev,
 	struct vmm_virtio_queue *vq = &vbdev->vqs[VIRTIO_BLK_IO_QUEUE];
 	struct vmm_virtio_blk_outhdr hdr;
 
+	/* Let block device merge requests popped in this batch */
+	vmm_vdisk_plug(vbdev->vdisk);
+
 	while (vmm_virtio_queue_available(vq)) {
 		head = vmm_virtio_queue_pop(vq);
 		req = &vbdev->reqs[head];
@@ -258,6 +476,9 @@ static void virtio_blk_do_io(struct vmm_virtio_device *dev,
 		req->head = head;
 		req->read_iov = NULL;
 		req->read_iov_cnt = 0;
+		req->data = NULL;
+		req->sgl = NULL;
+		req->sg_nents = 0;
 		req->len = 0;
 		for (i = 1; i < (iov_cnt - 1); i++) {
 			req->len += vbdev->iov[i].len;
@@ -277,8 +498,8 @@ static void virtio_blk_do_io(struct vmm_virtio_device *dev,
 		case VMM_VIRTIO_BLK_T_IN:
 			vmm_vdisk_set_request_type(&req->r,
 						   VMM_VDISK_REQUEST_READ);
-			req->data = vmm_malloc(req->len);
-			if (!req->data) {
+			if (virtio_blk_req_alloc_data(req, &vbdev->iov[1],
+						      iov_cnt - 2)) {
 				virtio_blk_req_done(vbdev, req,
 						    VMM_VIRTIO_BLK_S_IOERR);
 				continue;
@@ -302,18 +523,33 @@ static void virtio_blk_do_io(struct vmm_virtio_device *dev,
 			/* Note: We will get failed() or complete() callback
 			 * even when no block device attached to virtual disk
 			 */
-			vmm_vdisk_submit_request(vbdev->vdisk, &req->r,
-						 VMM_VDISK_REQUEST_READ,
-						 hdr.sector, req->data, req->len);
+			if (req->sgl) {
+				vmm_vdisk_submit_request_sg(vbdev->vdisk,
+						&req->r, VMM_VDISK_REQUEST_READ,
+						hdr.sector, req->sgl,
+						req->sg_nents, req->len);
+			} else {
+				vmm_vdisk_submit_request(vbdev->vdisk,
+						&req->r, VMM_VDISK_REQUEST_READ,
+						hdr.sector, req->data,
+						req->len);
+			}
 			break;
 		case VMM_VIRTIO_BLK_T_OUT:
 			vmm_vdisk_set_request_type(&req->r,
 						   VMM_VDISK_REQUEST_WRITE);
-			req->data = vmm_malloc(req->len);
-			if (!req->data) {
+			if (virtio_blk_req_alloc_data(req, &vbdev->iov[1],
+						      iov_cnt - 2)) {
 				virtio_blk_req_done(vbdev, req,
 						    VMM_VIRTIO_BLK_S_IOERR);
 				continue;
+			} else if (req->sgl) {
+				for (i = 0; i < req->sg_nents; i++) {
+					vmm_virtio_iovec_to_buf_read(dev,
+						&vbdev->iov[i + 1], 1,
+						sg_virt(&req->sgl[i]),
+						req->sgl[i].length);
+				}
 			} else {
 				vmm_virtio_iovec_to_buf_read(dev,
 							 &vbdev->iov[1],
@@ -328,9 +564,17 @@ static void virtio_blk_do_io(struct vmm_virtio_device *dev,
 			/* Note: We will get failed() or complete() callback
 			 * even when no block device attached to virtual disk
 			 */
-			vmm_vdisk_submit_request(vbdev->vdisk, &req->r,
-						 VMM_VDISK_REQUEST_WRITE,
-						 hdr.sector, req->data, req->len);
+			if (req->sgl) {
+				vmm_vdisk_submit_request_sg(vbdev->vdisk,
+						&req->r, VMM_VDISK_REQUEST_WRITE,
+						hdr.sector, req->sgl,
+						req->sg_nents, req->len);
+			} else {
+				vmm_vdisk_submit_request(vbdev->vdisk,
+						&req->r, VMM_VDISK_REQUEST_WRITE,
+						hdr.sector, req->data,
+						req->len);
+			}
 			break;
 		case VMM_VIRTIO_BLK_T_FLUSH:
 			vmm_vdisk_set_request_type(&req->r,
@@ -376,10 +620,38 @@ static void virtio_blk_do_io(struct vmm_virtio_device *dev,
 						    VMM_VIRTIO_BLK_S_OK);
 			}
 			break;
+		case VMM_VIRTIO_BLK_T_DISCARD:
+		case VMM_VIRTIO_BLK_T_WRITE_ZEROES:
+			virtio_blk_do_discard(dev, vbdev, req,
+					      iov_cnt, hdr.type);
+			break;
 		default:
+			virtio_blk_req_done(vbdev, req,
+					    VMM_VIRTIO_BLK_S_UNSUPP);
 			break;
 		};
 	}
+
+	vmm_vdisk_unplug(vbdev->vdisk);
+}
+
+static void virtio_blk_do_io(struct vmm_virtio_device *dev,
+			     struct virtio_blk_dev *vbdev)
+{
+	irq_flags_t flags;
+
+	/* Requests not aborted by reset still own their slots so new
+	 * requests are picked up only after all of them are done.
+	 */
+	vmm_spin_lock_irqsave(&vbdev->abort_lock, flags);
+	if (vbdev->abort_count) {
+		vbdev->io_deferred = TRUE;
+		vmm_spin_unlock_irqrestore(&vbdev->abort_lock, flags);
+		return;
+	}
+	vmm_spin_unlock_irqrestore(&vbdev->abort_lock, flags);
+
+	__virtio_blk_do_io(dev, vbdev);
 }
 
 static int virtio_blk_notify_vq(struct vmm_virtio_device *dev, u32 vq)
@@ -444,6 +716,8 @@ static int virtio_blk_write_config(struct vmm_virtio_device *dev,
 static int virtio_blk_reset(struct vmm_virtio_device *dev)
 {
 	int i, rc;
+	irq_flags_t flags;
+	bool inflight, busy;
 	struct virtio_blk_dev_req *req;
 	struct virtio_blk_dev *vbdev = dev->emu_data;
 
@@ -451,10 +725,46 @@ static int virtio_blk_reset(struct vmm_virtio_device *dev)
 
 	for (i = 0; i < VIRTIO_BLK_QUEUE_SIZE; i++) {
 		req = &vbdev->reqs[i];
-		if (vmm_vdisk_get_request_type(&req->r) !=
-					VMM_VDISK_REQUEST_UNKNOWN) {
-			vmm_vdisk_abort_request(vbdev->vdisk, &req->r);
+
+		/* Mark in-flight request as aborted before trying to
+		 * abort it so that its completion (now or later, when
+		 * abort fails with VMM_EBUSY) only releases the request.
+		 */
+		vmm_spin_lock_irqsave(&vbdev->abort_lock, flags);
+		inflight = (vmm_vdisk_get_request_type(&req->r) !=
+					VMM_VDISK_REQUEST_UNKNOWN);
+		if (inflight && !req->aborted) {
+			req->aborted = TRUE;
+			vbdev->abort_count++;
 		}
+		busy = req->aborted;
+		vmm_spin_unlock_irqrestore(&vbdev->abort_lock, flags);
+
+		if (inflight) {
+			rc = vmm_vdisk_abort_request(vbdev->vdisk, &req->r);
+			if (!rc || (rc == VMM_EBUSY)) {
+				continue;
+			}
+
+			/* Block device does not own this request
+			 * anymore so release it right away.
+			 */
+			vmm_spin_lock_irqsave(&vbdev->abort_lock, flags);
+			inflight = req->aborted &&
+				   (vmm_vdisk_get_request_type(&req->r) !=
+						VMM_VDISK_REQUEST_UNKNOWN);
+			vmm_vdisk_set_request_type(&req->r,
+					VMM_VDISK_REQUEST_UNKNOWN);
+			vmm_spin_unlock_irqrestore(&vbdev->abort_lock, flags);
+			if (inflight) {
+				virtio_blk_req_abort_done(vbdev, req);
+			}
+			continue;
+		}
+		if (busy) {
+			continue;
+		}
+
 		memset(req, 0, sizeof(*req));
 		vmm_vdisk_set_request_type(&req->r,
 					   VMM_VDISK_REQUEST_UNKNOWN);
@@ -468,6 +778,52 @@ static int virtio_blk_reset(struct vmm_virtio_device *dev)
 	return VMM_OK;
 }
 
+static int virtio_blk_save(struct vmm_virtio_device *dev,
+			   struct vmm_snapshot_stream *ss)
+{
+	int i, rc;
+	struct virtio_blk_dev *vbdev = dev->emu_data;
+
+	/* Requests submitted to block device can't be saved so
+	 * caller has to retry after they are completed.
+	 */
+	for (i = 0; i < VIRTIO_BLK_QUEUE_SIZE; i++) {
+		if (vmm_vdisk_get_request_type(&vbdev->reqs[i].r) !=
+					VMM_VDISK_REQUEST_UNKNOWN) {
+			return VMM_EBUSY;
+		}
+	}
+
+	rc = vmm_snapshot_write_tag(ss, VIRTIO_BLK_SNAPSHOT_MAGIC,
+				    VIRTIO_BLK_SNAPSHOT_VERSION);
+	if (!rc) {
+		rc = vmm_snapshot_write_u32(ss, vbdev->features);
+	}
+	for (i = 0; !rc && (i < VIRTIO_BLK_NUM_QUEUES); i++) {
+		rc = vmm_virtio_queue_save(&vbdev->vqs[i], ss);
+	}
+
+	return rc;
+}
+
+static int virtio_blk_restore(struct vmm_virtio_device *dev,
+			      struct vmm_snapshot_stream *ss)
+{
+	int i, rc;
+	struct virtio_blk_dev *vbdev = dev->emu_data;
+
+	rc = vmm_snapshot_read_tag(ss, VIRTIO_BLK_SNAPSHOT_MAGIC,
+				   VIRTIO_BLK_SNAPSHOT_VERSION);
+	if (!rc) {
+		rc = vmm_snapshot_read_u32(ss, &vbdev->features);
+	}
+	for (i = 0; !rc && (i < VIRTIO_BLK_NUM_QUEUES); i++) {
+		rc = vmm_virtio_queue_restore(&vbdev->vqs[i], dev->guest, ss);
+	}
+
+	return rc;
+}
+
 static int virtio_blk_connect(struct vmm_virtio_device *dev,
 			      struct vmm_virtio_emulator *emu)
 {
@@ -482,6 +838,7 @@ static int virtio_blk_connect(struct vmm_virtio_device *dev,
 		return VMM_ENOMEM;
 	}
 	vbdev->vdev = dev;
+	INIT_SPIN_LOCK(&vbdev->abort_lock);
 
 	vbdev->config.capacity = 0;
 	vbdev->config.seg_max = VIRTIO_BLK_DISK_SEG_MAX,
@@ -497,6 +854,7 @@ static int virtio_blk_connect(struct vmm_virtio_device *dev,
 		vmm_free(vbdev);
 		return VMM_EFAIL;
 	}
+	virtio_blk_update_discard_config(vbdev);
 
 	/* Attach block device */
 	if (vmm_devtree_read_string(dev->edev->node,
@@ -544,6 +902,8 @@ struct vmm_virtio_emulator virtio_blk = {
 	.reset = virtio_blk_reset,
 	.connect = virtio_blk_connect,
 	.disconnect = virtio_blk_disconnect,
+	.save = virtio_blk_save,
+	.restore = virtio_blk_restore,
 };
 
 static int __init virtio_blk_init(void)
@@ -26,6 +26,7 @@
 #include <vmm_heap.h>
 #include <vmm_modules.h>
 #include <vmm_devemu.h>
+#include <vmm_guest_snapshot.h>
 #include <vio/vmm_vserial.h>
 #include <vio/vmm_virtio.h>
 #include <vio/vmm_virtio_console.h>
@@ -47,6 +48,9 @@
 
 #define VIRTIO_CONSOLE_VSERIAL_FIFO_SZ	1024
 
+#define VIRTIO_CONSOLE_SNAPSHOT_MAGIC	0x4E4F4356 /* "VCON" */
+#define VIRTIO_CONSOLE_SNAPSHOT_VERSION	1
+
 struct virtio_console_dev {
 	struct vmm_virtio_device *vdev;
 
@@ -318,6 +322,56 @@ static int virtio_console_reset(struct vmm_virtio_device *dev)
 	return VMM_OK;
 }
 
+static int virtio_console_save(struct vmm_virtio_device *dev,
+			       struct vmm_snapshot_stream *ss)
+{
+	int i, rc;
+	struct virtio_console_dev *cdev = dev->emu_data;
+
+	/* Note: Unread emergency characters are not saved */
+	rc = vmm_snapshot_write_tag(ss, VIRTIO_CONSOLE_SNAPSHOT_MAGIC,
+				    VIRTIO_CONSOLE_SNAPSHOT_VERSION);
+	if (!rc) {
+		rc = vmm_snapshot_write(ss, &cdev->config.cols,
+					sizeof(cdev->config.cols));
+	}
+	if (!rc) {
+		rc = vmm_snapshot_write(ss, &cdev->config.rows,
+					sizeof(cdev->config.rows));
+	}
+	for (i = 0; !rc && (i < VIRTIO_CONSOLE_NUM_QUEUES); i++) {
+		rc = vmm_virtio_queue_save(&cdev->vqs[i], ss);
+	}
+
+	return rc;
+}
+
+static int virtio_console_restore(struct vmm_virtio_device *dev,
+				  struct vmm_snapshot_stream *ss)
+{
+	int i, rc;
+	struct virtio_console_dev *cdev = dev->emu_data;
+
+	rc = vmm_snapshot_read_tag(ss, VIRTIO_CONSOLE_SNAPSHOT_MAGIC,
+				   VIRTIO_CONSOLE_SNAPSHOT_VERSION);
+	if (!rc) {
+		rc = vmm_snapshot_read(ss, &cdev->config.cols,
+				       sizeof(cdev->config.cols));
+	}
+	if (!rc) {
+		rc = vmm_snapshot_read(ss, &cdev->config.rows,
+				       sizeof(cdev->config.rows));
+	}
+	for (i = 0; !rc && (i < VIRTIO_CONSOLE_NUM_QUEUES); i++) {
+		rc = vmm_virtio_queue_restore(&cdev->vqs[i], dev->guest, ss);
+	}
+	if (!rc && !fifo_clear(cdev->emerg_rd)) {
+		rc = VMM_EFAIL;
+	}
+
+	return rc;
+}
+
 static int virtio_console_connect(struct vmm_virtio_device *dev, 
 				  struct vmm_virtio_emulator *emu)
 {
@@ -389,6 +443,8 @@ struct vmm_virtio_emulator virtio_console = {
 	.reset = virtio_console_reset,
 	.connect = virtio_console_connect,
 	.disconnect = virtio_console_disconnect,
+	.save = virtio_console_save,
+	.restore = virtio_console_restore,
 };
 
 static int __init virtio_console_init(void)
@@ -38,3 +38,238 @@
 #include "drawfn_template.h"
 #define SURFACE_BITS 32
 #include "drawfn_template.h"
+
+/*
+ * Optimized kernels for the common guest formats (32bpp and 16bpp 565
+ * with little-endian bytes and pixels) converted to 32bpp surfaces.
+ *
+ * The hypervisor is built without FP/SIMD register usage (guest owns
+ * these registers while we emulate) so the kernels are plain integer
+ * code which avoids per-pixel channel extraction and per-pixel
+ * surface write callback checks. They fallback to template generated
+ * functions for surfaces having custom write32() operation, for
+ * destination step other than 4 bytes and for unaligned buffers.
+ */
+
+#ifdef CONFIG_CPU_LE
+
+static bool drawfn_fast_tables_ready;
+static u32 drawfn_565_bgr_lo[256], drawfn_565_bgr_hi[256];
+static u32 drawfn_565_rgb_lo[256], drawfn_565_rgb_hi[256];
+
+static u32 drawfn_565_to_pixel32(u32 data, bool rgb)
+{
+	u32 r, g, b;
+
+	b = (data & 0x1f) << 3;
+	g = ((data >> 5) & 0x3f) << 2;
+	r = ((data >> 11) & 0x1f) << 3;
+
+	return (rgb) ? rgb_to_pixel32(b, g, r) : rgb_to_pixel32(r, g, b);
+}
+
+static void drawfn_fast_tables_init(void)
+{
+	u32 i;
+
+	/* Each channel of a 565 pixel maps to distinct bits of the
+	 * 32bpp pixel hence we can OR lookups of both the bytes.
+	 */
+	for (i = 0; i < 256; i++) {
+		drawfn_565_bgr_lo[i] = drawfn_565_to_pixel32(i, FALSE);
+		drawfn_565_bgr_hi[i] = drawfn_565_to_pixel32(i << 8, FALSE);
+		drawfn_565_rgb_lo[i] = drawfn_565_to_pixel32(i, TRUE);
+		drawfn_565_rgb_hi[i] = drawfn_565_to_pixel32(i << 8, TRUE);
+	}
+
+	drawfn_fast_tables_ready = TRUE;
+}
+
+/* Kernels write packed 32bpp pixels and read source using u32 loads
+ * hence destination must be packed and both buffers must be aligned.
+ */
+static inline bool drawfn_fast_possible(struct vmm_surface *s,
+					u8 *d, const u8 *src, int deststep)
+{
+	if (s && s->ops && s->ops->write32) {
+		return FALSE;
+	}
+
+	if ((deststep != 4) ||
+	    ((unsigned long)d & 0x3) ||
+	    ((unsigned long)src & 0x3)) {
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void drawfn_fast_line32_lblp_bgr32(struct vmm_surface *s,
+					  void *opaque, u8 *d,
+					  const u8 *src,
+					  int width, int deststep)
+{
+	u32 *dst = (u32 *)d;
+	const u32 *sp = (const u32 *)src;
+
+	if (!drawfn_fast_possible(s, d, src, deststep)) {
+		drawfn_line32_lblp_bgr32(s, opaque, d, src, width, deststep);
+		return;
+	}
+
+	while (width >= 4) {
+		dst[0] = sp[0] & 0x00ffffff;
+		dst[1] = sp[1] & 0x00ffffff;
+		dst[2] = sp[2] & 0x00ffffff;
+		dst[3] = sp[3] & 0x00ffffff;
+		dst += 4;
+		sp += 4;
+		width -= 4;
+	}
+	while (width > 0) {
+		*dst++ = *sp++ & 0x00ffffff;
+		width--;
+	}
+}
+
+#define DRAWFN_SWAP_RB(x)	((((x) & 0xff) << 16) | ((x) & 0xff00) | \
+				 (((x) >> 16) & 0xff))
+
+static void drawfn_fast_line32_lblp_rgb32(struct vmm_surface *s,
+					  void *opaque, u8 *d,
+					  const u8 *src,
+					  int width, int deststep)
+{
+	u32 *dst = (u32 *)d;
+	const u32 *sp = (const u32 *)src;
+
+	if (!drawfn_fast_possible(s, d, src, deststep)) {
+		drawfn_line32_lblp_rgb32(s, opaque, d, src, width, deststep);
+		return;
+	}
+
+	while (width >= 4) {
+		dst[0] = DRAWFN_SWAP_RB(sp[0]);
+		dst[1] = DRAWFN_SWAP_RB(sp[1]);
+		dst[2] = DRAWFN_SWAP_RB(sp[2]);
+		dst[3] = DRAWFN_SWAP_RB(sp[3]);
+		dst += 4;
+		sp += 4;
+		width -= 4;
+	}
+	while (width > 0) {
+		*dst++ = DRAWFN_SWAP_RB(*sp);
+		sp++;
+		width--;
+	}
+}
+
+#undef DRAWFN_SWAP_RB
+
+static inline void drawfn_fast_line16(u32 *dst, const u8 *src, int width,
+				      const u32 *lo, const u32 *hi)
+{
+	u32 data;
+	const u32 *sp = (const u32 *)src;
+
+	while (width >= 2) {
+		data = *sp++;
+		dst[0] = lo[data & 0xff] | hi[(data >> 8) & 0xff];
+		dst[1] = lo[(data >> 16) & 0xff] | hi[data >> 24];
+		dst += 2;
+		width -= 2;
+	}
+	if (width > 0) {
+		src = (const u8 *)sp;
+		dst[0] = lo[src[0]] | hi[src[1]];
+	}
+}
+
+static void drawfn_fast_line16_lblp_bgr32(struct vmm_surface *s,
+					  void *opaque, u8 *d,
+					  const u8 *src,
+					  int width, int deststep)
+{
+	if (!drawfn_fast_possible(s, d, src, deststep) ||
+	    !drawfn_fast_tables_ready) {
+		drawfn_line16_lblp_bgr32(s, opaque, d, src, width, deststep);
+		return;
+	}
+
+	drawfn_fast_line16((u32 *)d, src, width,
+			   drawfn_565_bgr_lo, drawfn_565_bgr_hi);
+}
+
+static void drawfn_fast_line16_lblp_rgb32(struct vmm_surface *s,
+					  void *opaque, u8 *d,
+					  const u8 *src,
+					  int width, int deststep)
+{
+	if (!drawfn_fast_possible(s, d, src, deststep) ||
+	    !drawfn_fast_tables_ready) {
+		drawfn_line16_lblp_rgb32(s, opaque, d, src, width, deststep);
+		return;
+	}
+
+	drawfn_fast_line16((u32 *)d, src, width,
+			   drawfn_565_rgb_lo, drawfn_565_rgb_hi);
+}
+
+#endif
+
+drawfn drawfn_surface_lookup(int surface_bits,
+			     enum drawfn_format format,
+			     enum drawfn_order order,
+			     enum drawfn_bppmode bppmode)
+{
+	drawfn *fntable;
+
+	if ((format >= DRAWFN_FORMAT_MAX) ||
+	    (order >= DRAWFN_ORDER_MAX) ||
+	    (bppmode >= DRAWFN_BPPMODE_MAX)) {
+		return NULL;
+	}
+
+#ifdef CONFIG_CPU_LE
+	if ((surface_bits == 32) && (order == DRAWFN_ORDER_LBLP)) {
+		if (!drawfn_fast_tables_ready) {
+			drawfn_fast_tables_init();
+		}
+
+		switch (bppmode) {
+		case DRAWFN_BPP_32:
+			return (format == DRAWFN_FORMAT_RGB) ?
+				drawfn_fast_line32_lblp_rgb32 :
+				drawfn_fast_line32_lblp_bgr32;
+		case DRAWFN_BPP_16_565:
+			return (format == DRAWFN_FORMAT_RGB) ?
+				drawfn_fast_line16_lblp_rgb32 :
+				drawfn_fast_line16_lblp_bgr32;
+		default:
+			break;
+		};
+	}
+#endif
+
+	switch (surface_bits) {
+	case 8:
+		fntable = drawfn_surface_fntable_8;
+		break;
+	case 15:
+		fntable = drawfn_surface_fntable_15;
+		break;
+	case 16:
+		fntable = drawfn_surface_fntable_16;
+		break;
+	case 24:
+		fntable = drawfn_surface_fntable_24;
+		break;
+	case 32:
+		fntable = drawfn_surface_fntable_32;
+		break;
+	default:
+		return NULL;
+	};
+
+	return fntable[DRAWFN_FNTABLE_INDEX(format, order, bppmode)];
+}
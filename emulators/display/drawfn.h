@@ -79,4 +79,13 @@ drawfn drawfn_surface_fntable_24[DRAWFN_FNTABLE_SIZE];
 
 drawfn drawfn_surface_fntable_32[DRAWFN_FNTABLE_SIZE];
 
+/** Find best conversion function for given surface bits and
+ *  guest framebuffer format, order, and bppmode
+ *  Note: This returns NULL if no conversion function is available
+ */
+drawfn drawfn_surface_lookup(int surface_bits,
+			     enum drawfn_format format,
+			     enum drawfn_order order,
+			     enum drawfn_bppmode bppmode);
+
 #endif
@@ -0,0 +1,181 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file drawfn_bench.c
+ * @author agent (agent@local)
+ * @brief Benchmark of framebuffer format conversion routines
+ */
+
+#include <vmm_error.h>
+#include <vmm_heap.h>
+#include <vmm_stdio.h>
+#include <vmm_timer.h>
+#include <vmm_modules.h>
+#include <vio/vmm_vdisplay.h>
+#include <libs/mathlib.h>
+#include <libs/stringlib.h>
+#include <libs/wboxtest.h>
+
+#include "drawfn.h"
+
+#define MODULE_DESC			"drawfn benchmark"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		(WBOXTEST_IPRIORITY+1)
+#define	MODULE_INIT			wb_drawfn_init
+#define	MODULE_EXIT			wb_drawfn_exit
+
+#define BENCH_COLS			1920
+#define BENCH_ROWS			1080
+#define BENCH_FRAMES			10
+/* Number of source lines cycled through for each frame */
+#define BENCH_LINES			64
+
+struct wb_drawfn_case {
+	const char *name;
+	enum drawfn_format format;
+	enum drawfn_bppmode bppmode;
+	u32 src_bpp;
+};
+
+static const struct wb_drawfn_case wb_drawfn_cases[] = {
+	{ "32bpp BGR", DRAWFN_FORMAT_BGR, DRAWFN_BPP_32, 4 },
+	{ "32bpp RGB", DRAWFN_FORMAT_RGB, DRAWFN_BPP_32, 4 },
+	{ "16bpp 565 BGR", DRAWFN_FORMAT_BGR, DRAWFN_BPP_16_565, 2 },
+	{ "16bpp 565 RGB", DRAWFN_FORMAT_RGB, DRAWFN_BPP_16_565, 2 },
+};
+
+static u64 wb_drawfn_time(drawfn fn, u8 *dst, const u8 *src, u32 src_pitch)
+{
+	u32 f, r;
+	u64 tstamp = vmm_timer_timestamp();
+
+	for (f = 0; f < BENCH_FRAMES; f++) {
+		for (r = 0; r < BENCH_ROWS; r++) {
+			fn(NULL, NULL, dst,
+			   src + (r % BENCH_LINES) * src_pitch,
+			   BENCH_COLS, 4);
+		}
+	}
+
+	return vmm_timer_timestamp() - tstamp;
+}
+
+static u64 wb_drawfn_fps(u64 nsecs)
+{
+	return (nsecs) ? udiv64((u64)BENCH_FRAMES * 1000000000ULL, nsecs) : 0;
+}
+
+static int wb_drawfn_run(struct wboxtest *test, struct vmm_chardev *cdev,
+			 u32 test_hcpu)
+{
+	int rc = VMM_OK;
+	u32 i, c, src_pitch, dst_pitch, seed = 0x12345678;
+	u64 slow_ns, fast_ns;
+	u8 *src, *dst_slow, *dst_fast;
+	drawfn slow, fast;
+	const struct wb_drawfn_case *tc;
+
+	src_pitch = BENCH_COLS * 4;
+	dst_pitch = BENCH_COLS * 4;
+	src = vmm_malloc(src_pitch * BENCH_LINES);
+	dst_slow = vmm_malloc(dst_pitch);
+	dst_fast = vmm_malloc(dst_pitch);
+	if (!src || !dst_slow || !dst_fast) {
+		rc = VMM_ENOMEM;
+		goto done;
+	}
+
+	for (i = 0; i < (src_pitch * BENCH_LINES); i++) {
+		seed = seed * 1103515245 + 12345;
+		src[i] = (u8)(seed >> 16);
+	}
+
+	for (c = 0; c < array_size(wb_drawfn_cases); c++) {
+		tc = &wb_drawfn_cases[c];
+		slow = drawfn_surface_fntable_32[DRAWFN_FNTABLE_INDEX(
+				tc->format, DRAWFN_ORDER_LBLP, tc->bppmode)];
+		fast = drawfn_surface_lookup(32, tc->format,
+					     DRAWFN_ORDER_LBLP, tc->bppmode);
+		if (!slow || !fast) {
+			vmm_cprintf(cdev, "%s: no conversion function\n",
+				    tc->name);
+			rc = VMM_EFAIL;
+			continue;
+		}
+
+		/* Odd widths exercise the tail handling */
+		for (i = BENCH_COLS - 3; i <= BENCH_COLS; i++) {
+			memset(dst_slow, 0, dst_pitch);
+			memset(dst_fast, 0, dst_pitch);
+			slow(NULL, NULL, dst_slow, src, i, 4);
+			fast(NULL, NULL, dst_fast, src, i, 4);
+			if (memcmp(dst_slow, dst_fast, i * 4)) {
+				vmm_cprintf(cdev, "%s: output mismatch for "
+					    "width %u\n", tc->name, i);
+				rc = VMM_EFAIL;
+				break;
+			}
+		}
+
+		slow_ns = wb_drawfn_time(slow, dst_slow, src,
+					 BENCH_COLS * tc->src_bpp);
+		fast_ns = wb_drawfn_time(fast, dst_fast, src,
+					 BENCH_COLS * tc->src_bpp);
+
+		vmm_cprintf(cdev, "%-14s %dx%d generic %"PRIu64" fps, "
+			    "optimized %"PRIu64" fps\n",
+			    tc->name, BENCH_COLS, BENCH_ROWS,
+			    wb_drawfn_fps(slow_ns), wb_drawfn_fps(fast_ns));
+	}
+
+done:
+	if (dst_fast) {
+		vmm_free(dst_fast);
+	}
+	if (dst_slow) {
+		vmm_free(dst_slow);
+	}
+	if (src) {
+		vmm_free(src);
+	}
+
+	return rc;
+}
+
+static struct wboxtest wb_drawfn = {
+	.name = "drawfn",
+	.run = wb_drawfn_run,
+};
+
+static int __init wb_drawfn_init(void)
+{
+	return wboxtest_register("display", &wb_drawfn);
+}
+
+static void __exit wb_drawfn_exit(void)
+{
+	wboxtest_unregister(&wb_drawfn);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+		   MODULE_AUTHOR,
+		   MODULE_LICENSE,
+		   MODULE_IPRIORITY,
+		   MODULE_INIT,
+		   MODULE_EXIT);
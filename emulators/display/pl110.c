@@ -172,7 +172,7 @@ static void pl110_display_update(struct vmm_vdisplay *vdis,
 				 struct vmm_surface *sf)
 {
 	u32 *palette;
-	drawfn *fntable;
+	drawfn fn;
 	physical_addr_t gphys;
 	enum drawfn_format fmt;
 	enum drawfn_order order;
@@ -189,27 +189,22 @@ static void pl110_display_update(struct vmm_vdisplay *vdis,
 	case 0:
 		return;
 	case 8:
-		fntable = drawfn_surface_fntable_8;
 		dest_width = 1;
 		palette = s->palette8;
 		break;
 	case 15:
-		fntable = drawfn_surface_fntable_15;
 		dest_width = 2;
 		palette = s->palette15;
 		break;
 	case 16:
-		fntable = drawfn_surface_fntable_16;
 		dest_width = 2;
 		palette = s->palette16;
 		break;
 	case 24:
-		fntable = drawfn_surface_fntable_24;
 		dest_width = 3;
 		palette = s->palette32;
 		break;
 	case 32:
-		fntable = drawfn_surface_fntable_32;
 		dest_width = 4;
 		palette = s->palette32;
 		break;
@@ -294,10 +289,16 @@ static void pl110_display_update(struct vmm_vdisplay *vdis,
 
 	vmm_spin_unlock(&s->lock);
 
+	fn = drawfn_surface_lookup(vmm_surface_bits_per_pixel(sf),
+				   fmt, order, bppmode);
+	if (!fn) {
+		return;
+	}
+
 	first = 0;
 	vmm_surface_update(sf, s->guest, gphys, cols, rows,
 			   src_width, dest_width, 0,
-			   fntable[DRAWFN_FNTABLE_INDEX(fmt, order, bppmode)],
+			   fn,
 			   palette, &first, &last);
 	if (first >= 0) {
 		vmm_vdisplay_surface_gfx_update(vdis, 0, first, cols,
@@ -458,7 +459,7 @@ static int pl110_reg_write(struct pl110_state *s, u32 offset,
 			   u32 src_mask, u32 src)
 {
 	u32 val, n;
-	bool resize = FALSE, update = FALSE;
+	bool resize = FALSE, update = FALSE, invalidate = FALSE;
 	int resize_w, resize_h, rc = VMM_OK;
 
 	vmm_spin_lock(&s->lock);
@@ -468,6 +469,7 @@ static int pl110_reg_write(struct pl110_state *s, u32 offset,
 		n = (offset - 0x200) >> 2;
 		val = s->raw_palette[(offset - 0x200) >> 2];
 		val = (val & src_mask) | (src & ~src_mask);
+		invalidate = (s->raw_palette[n] != val);
 		s->raw_palette[(offset - 0x200) >> 2] = val;
 		__pl110_palette_update(s, 8, n);
 		__pl110_palette_update(s, 15, n);
@@ -498,7 +500,9 @@ static int pl110_reg_write(struct pl110_state *s, u32 offset,
 		s->timing[3] = (s->timing[3] & src_mask) | (src & ~src_mask);
 		break;
 	case 4: /* LCDUPBASE */
-		s->upbase = (s->upbase & src_mask) | (src & ~src_mask);
+		val = (s->upbase & src_mask) | (src & ~src_mask);
+		invalidate = (s->upbase != val);
+		s->upbase = val;
 		break;
 	case 5: /* LCDLPBASE */
 		s->lpbase = (s->lpbase & src_mask) | (src & ~src_mask);
@@ -516,7 +520,9 @@ static int pl110_reg_write(struct pl110_state *s, u32 offset,
 			goto imsc;
 		}
 	control:
-		s->cr = (s->cr & src_mask) | (src & ~src_mask);
+		val = (s->cr & src_mask) | (src & ~src_mask);
+		invalidate = (s->cr != val);
+		s->cr = val;
 		s->bpp = (s->cr >> 1) & 7;
 		resize = TRUE;
 		resize_w = s->cols;
@@ -542,10 +548,12 @@ done:
 		pl110_resize(s, resize_w, resize_h);
 	}
 
-	/* For simplicity clear the surface whenever
-	 * a control register is written to.
+	/* Redraw whole surface when format, base or palette changes.
+	 * Note: Geometry changes are covered by pl110_resize().
 	 */
-	pl110_display_invalidate(s->vdis);
+	if (invalidate) {
+		pl110_display_invalidate(s->vdis);
+	}
 
 	return rc;
 }
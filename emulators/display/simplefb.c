@@ -117,7 +117,7 @@ static int simplefb_display_pixeldata(struct vmm_vdisplay *vdis,
 static void simplefb_display_update(struct vmm_vdisplay *vdis,
 				    struct vmm_surface *sf)
 {
-	drawfn *fntable;
+	drawfn fn;
 	physical_addr_t gphys;
 	int width, height, first, last;
 	int dest_width, src_width;
@@ -128,15 +128,12 @@ static void simplefb_display_update(struct vmm_vdisplay *vdis,
 
 	switch (vmm_surface_bits_per_pixel(sf)) {
 	case 16:
-		fntable = drawfn_surface_fntable_16;
 		dest_width = 2;
 		break;
 	case 24:
-		fntable = drawfn_surface_fntable_24;
 		dest_width = 3;
 		break;
 	case 32:
-		fntable = drawfn_surface_fntable_32;
 		dest_width = 4;
 		break;
 	default:
@@ -157,10 +154,16 @@ static void simplefb_display_update(struct vmm_vdisplay *vdis,
 
 	vmm_spin_unlock(&s->lock);
 
+	fn = drawfn_surface_lookup(vmm_surface_bits_per_pixel(sf),
+				   fmt, order, bppmode);
+	if (!fn) {
+		return;
+	}
+
 	first = 0;
 	vmm_surface_update(sf, s->guest, gphys, width, height,
 			   src_width, dest_width, 0,
-			   fntable[DRAWFN_FNTABLE_INDEX(fmt, order, bppmode)],
+			   fn,
 			   NULL, &first, &last);
 	if (first >= 0) {
 		vmm_vdisplay_surface_gfx_update(vdis, 0, first, width,
@@ -475,16 +478,16 @@ static struct vmm_devtree_nodeid simplefb_emuid_table[] = {
 	{ /* end of list */ },
 };
 
-VMM_DECLARE_EMULATOR_SIMPLE(simplefb_emulator,
-			    "simplefb",
-			    simplefb_emuid_table,
-			    VMM_DEVEMU_LITTLE_ENDIAN,
-			    simplefb_emulator_probe,
-			    simplefb_emulator_remove,
-			    simplefb_emulator_reset,
-			    NULL,
-			    simplefb_emulator_read,
-			    simplefb_emulator_write);
+VMM_DECLARE_EMULATOR_STATELESS(simplefb_emulator,
+			       "simplefb",
+			       simplefb_emuid_table,
+			       VMM_DEVEMU_LITTLE_ENDIAN,
+			       simplefb_emulator_probe,
+			       simplefb_emulator_remove,
+			       simplefb_emulator_reset,
+			       NULL,
+			       simplefb_emulator_read,
+			       simplefb_emulator_write);
 
 static int __init simplefb_emulator_init(void)
 {
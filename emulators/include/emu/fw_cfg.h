@@ -67,6 +67,27 @@
 
 #define FW_CFG_MAX_FILE_PATH    56
 
+/* FW_CFG_ID feature bits */
+#define FW_CFG_VERSION          0x01
+#define FW_CFG_VERSION_DMA      0x02
+
+/* FW_CFG_DMA_CONTROL bits */
+#define FW_CFG_DMA_CTL_ERROR    0x01
+#define FW_CFG_DMA_CTL_READ     0x02
+#define FW_CFG_DMA_CTL_SKIP     0x04
+#define FW_CFG_DMA_CTL_SELECT   0x08
+#define FW_CFG_DMA_CTL_WRITE    0x10
+
+/* Value read back from DMA address register ("QEMU CFG") */
+#define FW_CFG_DMA_SIGNATURE    0x51454d5520434647ULL
+
+/* DMA access descriptor in guest memory (all fields big-endian) */
+typedef struct fw_cfg_dma_access {
+	u32 control;
+	u32 length;
+	u64 address;
+} __packed fw_cfg_dma_access_t;
+
 typedef struct fw_cfg_file {
 	u32  size;        /* file size */
 	u16  select;      /* write this to 0x510 to read it */
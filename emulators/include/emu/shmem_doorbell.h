@@ -0,0 +1,131 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file shmem_doorbell.h
+ * @author agent (agent@local)
+ * @brief Guest visible interface of shared memory doorbell emulator
+ *
+ * The shared memory doorbell device lets co-located guests exchange
+ * data through a vmm_shmem instance and notify each other using
+ * doorbell interrupts. Each guest maps the shared memory instance as
+ * a "shared_ram" region and has one doorbell device which refers to
+ * the same shared memory instance using "shared_mem" attribute.
+ *
+ * All doorbell devices referring to the same shared memory instance
+ * form a group of peers. Each peer has a unique ID (0 to 31) and 32
+ * interrupt vectors. Writing (peer ID << 16) | vector to DOORBELL
+ * register sets the vector in INT_STATUS register of target peer and
+ * the target peer gets its interrupt while (INT_STATUS & INT_MASK)
+ * is non-zero. Vector 31 is set by the device itself whenever a peer
+ * joins or leaves the group.
+ *
+ * The device does not interpret content of shared memory. Guests
+ * may use the single-producer single-consumer ring layout described
+ * below, which needs no locks and no device access in the data path
+ * except doorbell writes for waking up a sleeping peer.
+ */
+#ifndef __SHMEM_DOORBELL_H__
+#define __SHMEM_DOORBELL_H__
+
+#define SHMDB_MAGIC_VALUE		0x53484442 /* "SHDB" */
+#define SHMDB_VERSION_VALUE		0x00000001
+
+#define SHMDB_MAX_PEERS			32
+#define SHMDB_MAX_VECTORS		32
+#define SHMDB_VECTOR_PEER_CHANGE	31
+
+/* Register offsets (all registers are 32bit little-endian) */
+#define SHMDB_MAGIC			0x00	/* RO: SHMDB_MAGIC_VALUE */
+#define SHMDB_VERSION			0x04	/* RO: SHMDB_VERSION_VALUE */
+#define SHMDB_PEER_ID			0x08	/* RO: ID of this peer */
+#define SHMDB_PEER_MASK			0x0C	/* RO: Bitmap of peers */
+#define SHMDB_SHM_SIZE_LO		0x10	/* RO: Shared memory size */
+#define SHMDB_SHM_SIZE_HI		0x14	/* RO: Shared memory size */
+#define SHMDB_INT_STATUS		0x18	/* RW: Write 1 to clear */
+#define SHMDB_INT_MASK			0x1C	/* RW: Enabled vectors */
+#define SHMDB_DOORBELL			0x20	/* WO: (peer << 16) | vector */
+
+#define SHMDB_DOORBELL_PEER_SHIFT	16
+#define SHMDB_DOORBELL_VECTOR_MASK	0x1F
+
+/*
+ * Single-producer single-consumer ring layout in shared memory
+ *
+ * A ring is a header followed by 'num' slots of 'slot_size' bytes
+ * each. Both 'num' and 'slot_size' must be power of two and each
+ * slot starts with struct shmdb_ring_slot. The producer and consumer
+ * fields are placed in separate 64 byte cache lines so that each
+ * cache line is written by only one side.
+ *
+ * Indexes are free-running 32bit counters and slot of index 'i' is
+ * (i & (num - 1)). The ring is empty when prod_idx == cons_idx and
+ * full when (prod_idx - cons_idx) == num.
+ *
+ * Producer:
+ *  1. If (prod_idx - cons_idx) == num then ring is full
+ *  2. Write slot (prod_idx & (num - 1))
+ *  3. Write barrier (dmb ishst on ARM64)
+ *  4. Store prod_idx + 1 to prod_idx
+ *  5. Full barrier (dmb ish on ARM64)
+ *  6. If cons_wait is set then ring consumer doorbell
+ *
+ * Consumer:
+ *  1. Load prod_idx and if it equals cons_idx then ring is empty;
+ *     to sleep set cons_wait, full barrier, re-check prod_idx, and
+ *     wait for doorbell interrupt only if ring is still empty, then
+ *     clear cons_wait after waking up
+ *  2. Read barrier (dmb ishld on ARM64)
+ *  3. Read slot (cons_idx & (num - 1))
+ *  4. Full barrier (dmb ish on ARM64)
+ *  5. Store cons_idx + 1 to cons_idx
+ *  6. If prod_wait is set then ring producer doorbell
+ *
+ * The prod_wait flag is used in the same way by a producer waiting
+ * for free slots in a full ring. Each side only writes fields of its
+ * own cache line (producer: prod_idx and prod_wait, consumer: cons_idx
+ * and cons_wait).
+ */
+
+#define SHMDB_RING_MAGIC		0x53524E47 /* "SRNG" */
+#define SHMDB_RING_CACHELINE		64
+
+struct shmdb_ring {
+	/* Written once by ring creator */
+	u32 magic;
+	u32 num;
+	u32 slot_size;
+	u32 reserved;
+	u8 pad0[SHMDB_RING_CACHELINE - 16];
+	/* Written by producer */
+	u32 prod_idx;
+	u32 prod_wait;
+	u8 pad1[SHMDB_RING_CACHELINE - 8];
+	/* Written by consumer */
+	u32 cons_idx;
+	u32 cons_wait;
+	u8 pad2[SHMDB_RING_CACHELINE - 8];
+	/* Slots follow here */
+} __packed;
+
+struct shmdb_ring_slot {
+	u32 len;
+	u32 flags;
+	/* Payload follows here */
+} __packed;
+
+#endif /* __SHMEM_DOORBELL_H__ */
@@ -39,10 +39,12 @@
 #include <vmm_modules.h>
 #include <vmm_devemu.h>
 #include <vmm_host_io.h>
+#include <vmm_guest_aspace.h>
 #include <emu/fw_cfg.h>
 
 #define FW_CFG_SIZE		2
 #define FW_CFG_DATA_SIZE	1
+#define FW_CFG_DMA_OFFSET	4
 #define FW_CFG_NAME		"fw_cfg"
 #define FW_CFG_PATH		"/machine/" FW_CFG_NAME
 
@@ -62,11 +64,13 @@ typedef struct fw_cfg_entry {
 } fw_cfg_entry_t;
 
 struct fw_cfg_state {
+	struct vmm_guest *guest;
 	u32 ctl_iobase, data_iobase;
 	fw_cfg_entry_t entries[2][FW_CFG_MAX_ENTRY];
 	fw_cfg_files_t *files;
 	u16 cur_entry;
 	u32 cur_offset;
+	u64 dma_addr;
 };
 
 static void fw_cfg_reboot(fw_cfg_state_t *s)
@@ -130,6 +134,141 @@ static u64 fw_cfg_data_mem_read(void *opaque, physical_addr_t addr)
 	return fw_cfg_read(opaque);
 }
 
+static int fw_cfg_dma_zero(fw_cfg_state_t *s, physical_addr_t addr, u32 len)
+{
+	u32 count;
+	u8 zeros[64];
+
+	memset(zeros, 0, sizeof(zeros));
+	while (len) {
+		count = min(len, (u32)sizeof(zeros));
+		if (vmm_guest_memory_write(s->guest, addr,
+					   zeros, count, TRUE) != count) {
+			return VMM_EFAIL;
+		}
+		addr += count;
+		len -= count;
+	}
+
+	return VMM_OK;
+}
+
+/*
+ * Process the DMA access descriptor pointed by DMA address register.
+ * The whole transfer is done using bulk guest memory read/write so
+ * that firmware can fetch large items (such as kernel and initrd) in
+ * one trapped access instead of one trapped access per byte.
+ */
+static void fw_cfg_dma_transfer(fw_cfg_state_t *s)
+{
+	int arch, rc = VMM_OK;
+	u32 len, control;
+	physical_addr_t dma_addr = s->dma_addr;
+	fw_cfg_dma_access_t dma;
+	fw_cfg_entry_t *e;
+
+	s->dma_addr = 0;
+
+	if (vmm_guest_memory_read(s->guest, dma_addr,
+				  &dma, sizeof(dma), TRUE) != sizeof(dma)) {
+		vmm_printf("%s: failed to read descriptor at 0x%"PRIPADDR"\n",
+			   __func__, dma_addr);
+		return;
+	}
+	dma.control = vmm_be32_to_cpu(dma.control);
+	dma.length = vmm_be32_to_cpu(dma.length);
+	dma.address = vmm_be64_to_cpu(dma.address);
+
+	if (dma.control & FW_CFG_DMA_CTL_SELECT) {
+		fw_cfg_select(s, dma.control >> 16);
+	}
+
+	arch = !!(s->cur_entry & FW_CFG_ARCH_LOCAL);
+	e = &s->entries[arch][s->cur_entry & FW_CFG_ENTRY_MASK];
+
+	if (!(dma.control & (FW_CFG_DMA_CTL_READ |
+			     FW_CFG_DMA_CTL_WRITE |
+			     FW_CFG_DMA_CTL_SKIP))) {
+		dma.length = 0;
+	}
+
+	while ((rc == VMM_OK) && dma.length) {
+		if ((s->cur_entry == FW_CFG_INVALID) || !e->data ||
+		    (s->cur_offset >= e->len)) {
+			/* Reads past end of item return zeros */
+			len = dma.length;
+			if (dma.control & FW_CFG_DMA_CTL_READ) {
+				rc = fw_cfg_dma_zero(s, dma.address, len);
+			} else if (dma.control & FW_CFG_DMA_CTL_WRITE) {
+				rc = VMM_EINVALID;
+			}
+		} else {
+			len = min(dma.length, e->len - s->cur_offset);
+			if (dma.control & FW_CFG_DMA_CTL_READ) {
+				if (e->read_callback) {
+					e->read_callback(e->callback_opaque,
+							 s->cur_offset);
+				}
+				if (vmm_guest_memory_write(s->guest,
+						dma.address,
+						&e->data[s->cur_offset],
+						len, TRUE) != len) {
+					rc = VMM_EFAIL;
+				}
+			} else if (dma.control & FW_CFG_DMA_CTL_WRITE) {
+				if (!(s->cur_entry & FW_CFG_WRITE_CHANNEL) ||
+				    !e->callback) {
+					rc = VMM_EINVALID;
+				} else if (vmm_guest_memory_read(s->guest,
+						dma.address,
+						&e->data[s->cur_offset],
+						len, TRUE) != len) {
+					rc = VMM_EFAIL;
+				}
+			}
+			s->cur_offset += len;
+			if ((rc == VMM_OK) &&
+			    (dma.control & FW_CFG_DMA_CTL_WRITE) &&
+			    (s->cur_offset == e->len)) {
+				e->callback(e->callback_opaque, e->data);
+				s->cur_offset = 0;
+			}
+		}
+		dma.address += len;
+		dma.length -= len;
+	}
+
+	/* Completion is reported by clearing control field */
+	control = vmm_cpu_to_be32((rc == VMM_OK) ? 0 : FW_CFG_DMA_CTL_ERROR);
+	vmm_guest_memory_write(s->guest, dma_addr,
+			       &control, sizeof(control), TRUE);
+}
+
+static u32 fw_cfg_dma_mem_read(fw_cfg_state_t *s, physical_addr_t offset)
+{
+	/* DMA address register reads back as big-endian signature */
+	if (offset == FW_CFG_DMA_OFFSET) {
+		return vmm_cpu_to_be32((u32)(FW_CFG_DMA_SIGNATURE >> 32));
+	}
+
+	return vmm_cpu_to_be32((u32)FW_CFG_DMA_SIGNATURE);
+}
+
+static void fw_cfg_dma_mem_write(fw_cfg_state_t *s,
+				 physical_addr_t offset, u32 value)
+{
+	/* DMA address register is big-endian and writing
+	 * lower 32bits triggers the DMA transfer.
+	 */
+	value = vmm_be32_to_cpu(value);
+	if (offset == FW_CFG_DMA_OFFSET) {
+		s->dma_addr = (u64)value << 32;
+	} else {
+		s->dma_addr |= value;
+		fw_cfg_dma_transfer(s);
+	}
+}
+
 static void fw_cfg_data_mem_write(void *opaque, u64 value)
 {
 	fw_cfg_write(opaque, (u8)value);
@@ -270,7 +409,6 @@ static int fwcfg_emulator_read8(struct vmm_emudev *edev,
 				physical_addr_t offset,
 				u8 *dst)
 {
-	/* Always read zero */
 	*dst = fw_cfg_data_mem_read(edev->priv, offset);
 
 	return VMM_OK;
@@ -280,7 +418,6 @@ static int fwcfg_emulator_read16(struct vmm_emudev *edev,
 				 physical_addr_t offset,
 				 u16 *dst)
 {
-	/* Always read zero */
 	*dst = (u16)fw_cfg_data_mem_read(edev->priv, offset);
 
 	return VMM_OK;
@@ -290,8 +427,26 @@ static int fwcfg_emulator_read32(struct vmm_emudev *edev,
 				 physical_addr_t offset,
 				 u32 *dst)
 {
-	/* Always read zero */
-	*dst = (u32)fw_cfg_data_mem_read(edev->priv, offset);
+	if ((offset == FW_CFG_DMA_OFFSET) ||
+	    (offset == (FW_CFG_DMA_OFFSET + 4))) {
+		*dst = fw_cfg_dma_mem_read(edev->priv, offset);
+	} else {
+		*dst = (u32)fw_cfg_data_mem_read(edev->priv, offset);
+	}
+
+	return VMM_OK;
+}
+
+static int fwcfg_emulator_read64(struct vmm_emudev *edev,
+				 physical_addr_t offset,
+				 u64 *dst)
+{
+	if (offset != FW_CFG_DMA_OFFSET) {
+		return VMM_EFAIL;
+	}
+
+	*dst = vmm_cpu_to_be64(FW_CFG_DMA_SIGNATURE);
+
 	return VMM_OK;
 }
 
@@ -344,6 +499,10 @@ static int fwcfg_emulator_write32(struct vmm_emudev *edev,
 	case 1:
 		fw_cfg_data_mem_write(edev->priv, src);
 		break;
+	case FW_CFG_DMA_OFFSET:
+	case FW_CFG_DMA_OFFSET + 4:
+		fw_cfg_dma_mem_write(edev->priv, offset, src);
+		break;
 	default:
 		return VMM_EFAIL;
 	}
@@ -352,9 +511,28 @@ static int fwcfg_emulator_write32(struct vmm_emudev *edev,
 	return VMM_OK;
 }
 
+static int fwcfg_emulator_write64(struct vmm_emudev *edev,
+				  physical_addr_t offset,
+				  u64 src)
+{
+	fw_cfg_state_t *s = edev->priv;
+
+	if (offset != FW_CFG_DMA_OFFSET) {
+		return VMM_EFAIL;
+	}
+
+	s->dma_addr = vmm_be64_to_cpu(src);
+	fw_cfg_dma_transfer(s);
+
+	return VMM_OK;
+}
+
 static int fwcfg_emulator_reset(struct vmm_emudev *edev)
 {
-	fw_cfg_select(edev->priv, 0);
+	fw_cfg_state_t *s = edev->priv;
+
+	fw_cfg_select(s, 0);
+	s->dma_addr = 0;
 
 	return VMM_OK;
 }
@@ -370,7 +548,10 @@ static int fwcfg_emulator_probe(struct vmm_guest *guest,
 	if (!s)
 		return VMM_ENOMEM;
 
+	s->guest = guest;
+
 	fw_cfg_add_bytes(s, FW_CFG_SIGNATURE, (char *)"QEMU", 4);
+	fw_cfg_add_i32(s, FW_CFG_ID, FW_CFG_VERSION | FW_CFG_VERSION_DMA);
 	fw_cfg_add_i16(s, FW_CFG_NOGRAPHIC, 1);
 
 	/* SMP FIXME: Change when SMP support is added */
@@ -413,6 +594,8 @@ static struct vmm_emulator fwcfg_emulator = {
 	.write16 = fwcfg_emulator_write16,
 	.read32 = fwcfg_emulator_read32,
 	.write32 = fwcfg_emulator_write32,
+	.read64 = fwcfg_emulator_read64,
+	.write64 = fwcfg_emulator_write64,
 	.reset = fwcfg_emulator_reset,
 	.remove = fwcfg_emulator_remove,
 };
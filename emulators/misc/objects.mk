@@ -26,6 +26,7 @@ emulators-objs-$(CONFIG_EMU_MISC_A9MPCORE)+= misc/a9mpcore.o
 emulators-objs-$(CONFIG_EMU_MISC_ARM11MPCORE)+= misc/arm11mpcore.o
 emulators-objs-$(CONFIG_EMU_MISC_PSM)+= misc/xpsm.o
 emulators-objs-$(CONFIG_EMU_MISC_FW_CFG)+= misc/fw_cfg.o
+emulators-objs-$(CONFIG_EMU_MISC_SHMEM_DOORBELL)+= misc/shmem_doorbell.o
 emulators-objs-$(CONFIG_EMU_MISC_IMX6_ANATOP)+= misc/imx_anatop.o
 emulators-objs-$(CONFIG_EMU_MISC_IMX6_CCM)+= misc/imx_ccm.o
 emulators-objs-$(CONFIG_EMU_MISC_IMX6_APBH)+= misc/imx_apbh.o
@@ -0,0 +1,424 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file shmem_doorbell.c
+ * @author agent (agent@local)
+ * @brief Shared memory doorbell emulator for inter-guest communication
+ */
+
+#include <vmm_error.h>
+#include <vmm_heap.h>
+#include <vmm_stdio.h>
+#include <vmm_mutex.h>
+#include <vmm_shmem.h>
+#include <vmm_spinlocks.h>
+#include <vmm_modules.h>
+#include <vmm_devtree.h>
+#include <vmm_devemu.h>
+#include <libs/list.h>
+#include <libs/stringlib.h>
+#include <emu/shmem_doorbell.h>
+
+#define MODULE_DESC			"Shared Memory Doorbell Emulator"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		0
+#define	MODULE_INIT			shmdb_emulator_init
+#define	MODULE_EXIT			shmdb_emulator_exit
+
+#define SHMDB_PEER_ID_ATTR_NAME		"peer_id"
+
+struct shmdb_state;
+
+/* Group of peers sharing same shared memory instance */
+struct shmdb_group {
+	struct dlist head;
+	struct vmm_shmem *shm;
+	vmm_spinlock_t lock;
+	u32 peer_mask;
+	struct shmdb_state *peers[SHMDB_MAX_PEERS];
+};
+
+struct shmdb_state {
+	struct vmm_guest *guest;
+	struct shmdb_group *grp;
+	u32 id;
+	u32 irq;
+	vmm_spinlock_t lock;
+	u32 int_status;
+	u32 int_mask;
+};
+
+static DEFINE_MUTEX(shmdb_group_lock);
+static LIST_HEAD(shmdb_group_list);
+
+/* Note: Must be called with s->lock held */
+static void shmdb_update_irq(struct shmdb_state *s)
+{
+	vmm_devemu_emulate_irq(s->guest, s->irq,
+			       (s->int_status & s->int_mask) ? 1 : 0);
+}
+
+static void shmdb_raise(struct shmdb_state *s, u32 vector)
+{
+	irq_flags_t flags;
+
+	vmm_spin_lock_irqsave(&s->lock, flags);
+	s->int_status |= (1U << vector);
+	shmdb_update_irq(s);
+	vmm_spin_unlock_irqrestore(&s->lock, flags);
+}
+
+/* Note: Must be called with grp->lock held */
+static void shmdb_peer_change(struct shmdb_group *grp, u32 skip_id)
+{
+	u32 i;
+
+	for (i = 0; i < SHMDB_MAX_PEERS; i++) {
+		if (grp->peers[i] && (i != skip_id)) {
+			shmdb_raise(grp->peers[i], SHMDB_VECTOR_PEER_CHANGE);
+		}
+	}
+}
+
+static void shmdb_ring(struct shmdb_state *s, u32 val)
+{
+	irq_flags_t flags;
+	struct shmdb_group *grp = s->grp;
+	u32 peer = val >> SHMDB_DOORBELL_PEER_SHIFT;
+	u32 vector = val & SHMDB_DOORBELL_VECTOR_MASK;
+
+	if (peer >= SHMDB_MAX_PEERS) {
+		return;
+	}
+
+	/* Doorbells to absent peers are dropped */
+	vmm_spin_lock_irqsave(&grp->lock, flags);
+	if (grp->peers[peer]) {
+		shmdb_raise(grp->peers[peer], vector);
+	}
+	vmm_spin_unlock_irqrestore(&grp->lock, flags);
+}
+
+static int shmdb_reg_read(struct shmdb_state *s, u32 offset, u32 *dst)
+{
+	int rc = VMM_OK;
+	irq_flags_t flags;
+	physical_size_t size = vmm_shmem_get_size(s->grp->shm);
+
+	switch (offset) {
+	case SHMDB_MAGIC:
+		*dst = SHMDB_MAGIC_VALUE;
+		break;
+	case SHMDB_VERSION:
+		*dst = SHMDB_VERSION_VALUE;
+		break;
+	case SHMDB_PEER_ID:
+		*dst = s->id;
+		break;
+	case SHMDB_PEER_MASK:
+		vmm_spin_lock_irqsave(&s->grp->lock, flags);
+		*dst = s->grp->peer_mask;
+		vmm_spin_unlock_irqrestore(&s->grp->lock, flags);
+		break;
+	case SHMDB_SHM_SIZE_LO:
+		*dst = (u32)size;
+		break;
+	case SHMDB_SHM_SIZE_HI:
+		*dst = (u32)((u64)size >> 32);
+		break;
+	case SHMDB_INT_STATUS:
+		vmm_spin_lock_irqsave(&s->lock, flags);
+		*dst = s->int_status;
+		vmm_spin_unlock_irqrestore(&s->lock, flags);
+		break;
+	case SHMDB_INT_MASK:
+		vmm_spin_lock_irqsave(&s->lock, flags);
+		*dst = s->int_mask;
+		vmm_spin_unlock_irqrestore(&s->lock, flags);
+		break;
+	case SHMDB_DOORBELL:
+		*dst = 0;
+		break;
+	default:
+		rc = VMM_EINVALID;
+		break;
+	};
+
+	return rc;
+}
+
+static int shmdb_reg_write(struct shmdb_state *s, u32 offset, u32 val)
+{
+	int rc = VMM_OK;
+	irq_flags_t flags;
+
+	switch (offset) {
+	case SHMDB_INT_STATUS:
+		vmm_spin_lock_irqsave(&s->lock, flags);
+		s->int_status &= ~val;
+		shmdb_update_irq(s);
+		vmm_spin_unlock_irqrestore(&s->lock, flags);
+		break;
+	case SHMDB_INT_MASK:
+		vmm_spin_lock_irqsave(&s->lock, flags);
+		s->int_mask = val;
+		shmdb_update_irq(s);
+		vmm_spin_unlock_irqrestore(&s->lock, flags);
+		break;
+	case SHMDB_DOORBELL:
+		shmdb_ring(s, val);
+		break;
+	case SHMDB_MAGIC:
+	case SHMDB_VERSION:
+	case SHMDB_PEER_ID:
+	case SHMDB_PEER_MASK:
+	case SHMDB_SHM_SIZE_LO:
+	case SHMDB_SHM_SIZE_HI:
+		/* Read-only registers */
+		break;
+	default:
+		rc = VMM_EINVALID;
+		break;
+	};
+
+	return rc;
+}
+
+static int shmdb_emulator_read32(struct vmm_emudev *edev,
+				 physical_addr_t offset,
+				 u32 *dst)
+{
+	return shmdb_reg_read(edev->priv, offset & 0xFFC, dst);
+}
+
+static int shmdb_emulator_write32(struct vmm_emudev *edev,
+				  physical_addr_t offset,
+				  u32 src)
+{
+	return shmdb_reg_write(edev->priv, offset & 0xFFC, src);
+}
+
+static int shmdb_emulator_reset(struct vmm_emudev *edev)
+{
+	irq_flags_t flags;
+	struct shmdb_state *s = edev->priv;
+
+	vmm_spin_lock_irqsave(&s->lock, flags);
+	s->int_status = 0;
+	s->int_mask = 0;
+	shmdb_update_irq(s);
+	vmm_spin_unlock_irqrestore(&s->lock, flags);
+
+	return VMM_OK;
+}
+
+static struct shmdb_group *shmdb_group_get(const char *shm_name)
+{
+	bool found = FALSE;
+	struct vmm_shmem *shm;
+	struct shmdb_group *grp;
+
+	list_for_each_entry(grp, &shmdb_group_list, head) {
+		if (!strcmp(vmm_shmem_get_name(grp->shm), shm_name)) {
+			found = TRUE;
+			break;
+		}
+	}
+	if (found) {
+		return grp;
+	}
+
+	shm = vmm_shmem_find_byname(shm_name);
+	if (!shm) {
+		return NULL;
+	}
+
+	grp = vmm_zalloc(sizeof(*grp));
+	if (!grp) {
+		vmm_shmem_dref(shm);
+		return NULL;
+	}
+
+	INIT_LIST_HEAD(&grp->head);
+	grp->shm = shm;
+	INIT_SPIN_LOCK(&grp->lock);
+	list_add_tail(&grp->head, &shmdb_group_list);
+
+	return grp;
+}
+
+static void shmdb_group_put(struct shmdb_group *grp)
+{
+	if (grp->peer_mask) {
+		return;
+	}
+
+	list_del(&grp->head);
+	vmm_shmem_dref(grp->shm);
+	vmm_free(grp);
+}
+
+static int shmdb_emulator_probe(struct vmm_guest *guest,
+				struct vmm_emudev *edev,
+				const struct vmm_devtree_nodeid *eid)
+{
+	int rc = VMM_OK;
+	u32 id;
+	irq_flags_t flags;
+	const char *shm_name;
+	struct shmdb_group *grp;
+	struct shmdb_state *s;
+
+	s = vmm_zalloc(sizeof(struct shmdb_state));
+	if (!s) {
+		return VMM_ENOMEM;
+	}
+
+	s->guest = guest;
+	INIT_SPIN_LOCK(&s->lock);
+
+	rc = vmm_devtree_read_u32_atindex(edev->node,
+					  VMM_DEVTREE_INTERRUPTS_ATTR_NAME,
+					  &s->irq, 0);
+	if (rc) {
+		goto free_state;
+	}
+
+	rc = vmm_devtree_read_string(edev->node,
+				     VMM_DEVTREE_SHARED_MEM_ATTR_NAME,
+				     &shm_name);
+	if (rc) {
+		goto free_state;
+	}
+
+	if (vmm_devtree_read_u32(edev->node,
+				 SHMDB_PEER_ID_ATTR_NAME, &id)) {
+		id = SHMDB_MAX_PEERS;
+	}
+
+	vmm_mutex_lock(&shmdb_group_lock);
+
+	grp = shmdb_group_get(shm_name);
+	if (!grp) {
+		vmm_printf("%s: %s/%s: shared memory %s not found\n",
+			   __func__, guest->name, edev->node->name, shm_name);
+		rc = VMM_ENOTAVAIL;
+		goto unlock;
+	}
+
+	vmm_spin_lock_irqsave(&grp->lock, flags);
+	if (id >= SHMDB_MAX_PEERS) {
+		/* Use first free peer ID */
+		for (id = 0; id < SHMDB_MAX_PEERS; id++) {
+			if (!grp->peers[id]) {
+				break;
+			}
+		}
+	}
+	if ((id >= SHMDB_MAX_PEERS) || grp->peers[id]) {
+		vmm_spin_unlock_irqrestore(&grp->lock, flags);
+		vmm_printf("%s: %s/%s: peer ID not available\n",
+			   __func__, guest->name, edev->node->name);
+		shmdb_group_put(grp);
+		rc = VMM_EEXIST;
+		goto unlock;
+	}
+	s->id = id;
+	s->grp = grp;
+	grp->peers[id] = s;
+	grp->peer_mask |= (1U << id);
+	shmdb_peer_change(grp, id);
+	vmm_spin_unlock_irqrestore(&grp->lock, flags);
+
+	vmm_mutex_unlock(&shmdb_group_lock);
+
+	edev->priv = s;
+
+	return VMM_OK;
+
+unlock:
+	vmm_mutex_unlock(&shmdb_group_lock);
+free_state:
+	vmm_free(s);
+	return rc;
+}
+
+static int shmdb_emulator_remove(struct vmm_emudev *edev)
+{
+	irq_flags_t flags;
+	struct shmdb_state *s = edev->priv;
+	struct shmdb_group *grp;
+
+	if (!s) {
+		return VMM_OK;
+	}
+	grp = s->grp;
+
+	vmm_mutex_lock(&shmdb_group_lock);
+
+	vmm_spin_lock_irqsave(&grp->lock, flags);
+	grp->peers[s->id] = NULL;
+	grp->peer_mask &= ~(1U << s->id);
+	shmdb_peer_change(grp, s->id);
+	vmm_spin_unlock_irqrestore(&grp->lock, flags);
+
+	shmdb_group_put(grp);
+
+	vmm_mutex_unlock(&shmdb_group_lock);
+
+	vmm_free(s);
+	edev->priv = NULL;
+
+	return VMM_OK;
+}
+
+static struct vmm_devtree_nodeid shmdb_emuid_table[] = {
+	{ .type = "misc",
+	  .compatible = "shmem_doorbell",
+	},
+	{ /* end of list */ },
+};
+
+static struct vmm_emulator shmdb_emulator = {
+	.name = "shmem_doorbell",
+	.match_table = shmdb_emuid_table,
+	.endian = VMM_DEVEMU_LITTLE_ENDIAN,
+	.probe = shmdb_emulator_probe,
+	.read32 = shmdb_emulator_read32,
+	.write32 = shmdb_emulator_write32,
+	.reset = shmdb_emulator_reset,
+	.remove = shmdb_emulator_remove,
+};
+
+static int __init shmdb_emulator_init(void)
+{
+	return vmm_devemu_register_emulator(&shmdb_emulator);
+}
+
+static void __exit shmdb_emulator_exit(void)
+{
+	vmm_devemu_unregister_emulator(&shmdb_emulator);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+		   MODULE_AUTHOR,
+		   MODULE_LICENSE,
+		   MODULE_IPRIORITY,
+		   MODULE_INIT,
+		   MODULE_EXIT);
@@ -24,15 +24,20 @@
 #include <vmm_error.h>
 #include <vmm_heap.h>
 #include <vmm_modules.h>
+#include <vmm_timer.h>
 #include <vmm_devemu.h>
+#include <vmm_guest_snapshot.h>
+#include <arch_barrier.h>
 #include <vio/vmm_virtio.h>
 #include <vio/vmm_virtio_net.h>
+#include <libs/stringlib.h>
 
 #include <net/vmm_protocol.h>
 #include <net/vmm_mbuf.h>
 #include <net/vmm_net.h>
 #include <net/vmm_netswitch.h>
 #include <net/vmm_netport.h>
+#include <net/vmm_netoffload.h>
 #include <net/vmm_mbuf.h>
 
 #define MODULE_DESC			"VirtIO Net Emulator"
@@ -53,6 +58,24 @@
 
 #define VIRTIO_NET_TX_LAZY_BUDGET	(VIRTIO_NET_QUEUE_SIZE / 4)
 
+/* Default RX interrupt coalescing parameters which can be
+ * overridden using "rx_coalesce_packets" and "rx_coalesce_usecs"
+ * attributes of device tree node. Zero "rx_coalesce_usecs" means
+ * used ring is updated (and guest signaled) for every packet so
+ * coalescing is off unless device tree node asks for it.
+ */
+#define VIRTIO_NET_RX_COALESCE_PACKETS	(VIRTIO_NET_QUEUE_SIZE / 8)
+#define VIRTIO_NET_RX_COALESCE_USECS	0
+
+/* Frames for guest are queued by netswitch while guest RX ring is
+ * empty. Default depth of this queue can be overridden using
+ * "switch_queue_depth" attribute of device tree node.
+ */
+#define VIRTIO_NET_SWITCH_QUEUE_DEPTH	(VIRTIO_NET_QUEUE_SIZE / 2)
+
+#define VIRTIO_NET_SNAPSHOT_MAGIC	0x54454E56 /* "VNET" */
+#define VIRTIO_NET_SNAPSHOT_VERSION	1
+
 struct virtio_net_queue {
 	int num;
 	int valid;
@@ -75,19 +98,25 @@ struct virtio_net_dev {
 	int mode;
 	struct vmm_netport *port;
 	char name[VMM_VIRTIO_DEVICE_MAX_NAME_LEN];
+
+	/* RX interrupt coalescing (protected by port xfer lock) */
+	u32 rx_coalesce_packets;
+	u64 rx_coalesce_nsecs;
+	struct vmm_timer_event rx_coalesce_ev;
 };
 
 static u32 virtio_net_get_host_features(struct vmm_virtio_device *dev)
 {
 	return 1UL << VMM_VIRTIO_NET_F_MAC
-#if 0
 		| 1UL << VMM_VIRTIO_NET_F_CSUM
-		| 1UL << VMM_VIRTIO_NET_F_HOST_UFO
+		| 1UL << VMM_VIRTIO_NET_F_GUEST_CSUM
 		| 1UL << VMM_VIRTIO_NET_F_HOST_TSO4
 		| 1UL << VMM_VIRTIO_NET_F_HOST_TSO6
-		| 1UL << VMM_VIRTIO_NET_F_GUEST_UFO
 		| 1UL << VMM_VIRTIO_NET_F_GUEST_TSO4
 		| 1UL << VMM_VIRTIO_NET_F_GUEST_TSO6
+#if 0
+		| 1UL << VMM_VIRTIO_NET_F_HOST_UFO
+		| 1UL << VMM_VIRTIO_NET_F_GUEST_UFO
 #endif
 		| 1UL << VMM_VIRTIO_RING_F_EVENT_IDX
 #if 0
@@ -104,6 +133,18 @@ static void virtio_net_set_guest_features(struct vmm_virtio_device *dev,
 	struct virtio_net_dev *ndev = dev->emu_data;
 
 	ndev->features = features;
+
+	/* Offloads which guest can take from netswitch as-is */
+	ndev->port->features = 0;
+	if (features & (1UL << VMM_VIRTIO_NET_F_GUEST_CSUM)) {
+		ndev->port->features |= VMM_NETPORT_FEAT_CSUM;
+	}
+	if (features & (1UL << VMM_VIRTIO_NET_F_GUEST_TSO4)) {
+		ndev->port->features |= VMM_NETPORT_FEAT_TSO4;
+	}
+	if (features & (1UL << VMM_VIRTIO_NET_F_GUEST_TSO6)) {
+		ndev->port->features |= VMM_NETPORT_FEAT_TSO6;
+	}
 }
 
 static int virtio_net_init_vq(struct vmm_virtio_device *dev,
@@ -149,15 +190,57 @@ static int virtio_net_set_size_vq(struct vmm_virtio_device *dev,
 
 static void virtio_net_tx_poke(struct virtio_net_dev *ndev, u32 vq);
 
+/* Translate guest TX offload info into mbuf offload metadata */
+static int virtio_net_tx_offload(struct virtio_net_dev *ndev,
+				 struct vmm_virtio_net_hdr *hdr,
+				 struct vmm_mbuf *mb)
+{
+	if (hdr->flags & VIRTIO_NET_HDR_F_NEEDS_CSUM) {
+		if (!(ndev->features & (1UL << VMM_VIRTIO_NET_F_CSUM))) {
+			return VMM_EINVALID;
+		}
+		mb->m_flags |= M_CSUM_PARTIAL;
+		mb->m_pkthdr.csum_start = hdr->csum_start;
+		mb->m_pkthdr.csum_offset = hdr->csum_offset;
+	}
+
+	switch (hdr->gso_type & ~VIRTIO_NET_HDR_GSO_ECN) {
+	case VIRTIO_NET_HDR_GSO_NONE:
+		return VMM_OK;
+	case VIRTIO_NET_HDR_GSO_TCPV4:
+		if (!(ndev->features & (1UL << VMM_VIRTIO_NET_F_HOST_TSO4))) {
+			return VMM_EINVALID;
+		}
+		mb->m_pkthdr.gso_type = M_GSO_TCPV4;
+		break;
+	case VIRTIO_NET_HDR_GSO_TCPV6:
+		if (!(ndev->features & (1UL << VMM_VIRTIO_NET_F_HOST_TSO6))) {
+			return VMM_EINVALID;
+		}
+		mb->m_pkthdr.gso_type = M_GSO_TCPV6;
+		break;
+	default:
+		return VMM_EINVALID;
+	};
+
+	if (!(mb->m_flags & M_CSUM_PARTIAL) || !hdr->gso_size) {
+		return VMM_EINVALID;
+	}
+	mb->m_pkthdr.gso_size = hdr->gso_size;
+
+	return VMM_OK;
+}
+
 static void virtio_net_tx_lazy(struct vmm_netport *port, void *arg, int budget)
 {
 	u16 head = 0;
-	u32 iov_cnt = 0, pkt_len = 0, total_len = 0;
+	u32 iov_cnt = 0, pkt_len = 0, total_len = 0, max_len;
 	struct virtio_net_queue *q = arg;
 	struct virtio_net_dev *ndev = q->ndev;
 	struct vmm_virtio_queue *vq = &q->vq;
 	struct vmm_virtio_device *dev = ndev->vdev;
 	struct vmm_virtio_iovec *iov = q->iov;
+	struct vmm_virtio_net_hdr hdr;
 	struct vmm_mbuf *mb;
 
 	while ((budget > 0) && vmm_virtio_queue_available(vq)) {
@@ -165,22 +248,33 @@ static void virtio_net_tx_lazy(struct vmm_netport *port, void *arg, int budget)
 
 		/* iov[0] is offload info */
 		pkt_len = total_len - iov[0].len;
+		memset(&hdr, 0, sizeof(hdr));
+		vmm_virtio_iovec_to_buf_read(dev, &iov[0], 1, &hdr,
+					     min(iov[0].len, (u32)sizeof(hdr)));
+		max_len = (hdr.gso_type != VIRTIO_NET_HDR_GSO_NONE) ?
+				VMM_NETOFFLOAD_GSO_MAX_LEN : VIRTIO_NET_MTU;
 
-		if (pkt_len <= VIRTIO_NET_MTU) {
+		if (pkt_len <= max_len) {
 			MGETHDR(mb, 0, 0);
 			MEXTMALLOC(mb, pkt_len, 0);
 			vmm_virtio_iovec_to_buf_read(dev, 
 						 &iov[1], iov_cnt - 1,
 						 M_BUFADDR(mb), pkt_len);
 			mb->m_len = mb->m_pktlen = pkt_len;
-			vmm_port2switch_xfer_mbuf(ndev->port, mb);
+			if (virtio_net_tx_offload(ndev, &hdr, mb) == VMM_OK) {
+				vmm_port2switch_xfer_mbuf(ndev->port, mb);
+			} else {
+				m_freem(mb);
+			}
 		}
 
-		vmm_virtio_queue_set_used_elem(vq, head, total_len);
+		vmm_virtio_queue_add_used(vq, head, total_len);
 
 		budget--;
 	}
 
+	vmm_virtio_queue_flush_used(vq);
+
 	if (vmm_virtio_queue_should_signal(vq)) {
 		dev->tra->notify(dev, q->num);
 	}
@@ -237,6 +331,8 @@ static int virtio_net_notify_vq(struct vmm_virtio_device *dev, u32 vq)
 		virtio_net_tx_poke(ndev, vq);
 		break;
 	case VIRTIO_NET_RX_QUEUE:
+		/* Guest added RX buffers so flush frames queued for us */
+		vmm_switch2port_xfer_resume(ndev->port);
 		break;
 	case VIRTIO_NET_CTRL_QUEUE:
 		virtio_net_handle_comp(ndev, vq);
@@ -282,19 +378,79 @@ static int virtio_net_can_receive(struct vmm_netport *p)
 	return ndev->can_receive;
 }
 
+static int virtio_net_can_xfer(struct vmm_netport *p)
+{
+	struct virtio_net_dev *ndev = p->priv;
+	/* FIXME: Select correct RX queue here  */
+	struct vmm_virtio_queue *vq = &ndev->vqs[0].vq;
+
+	if (vmm_virtio_queue_available(vq)) {
+		return 1;
+	}
+
+	/* Ask guest to kick us when it adds RX buffers and check
+	 * again in case guest added them meanwhile.
+	 */
+	vmm_virtio_queue_set_avail_event(vq);
+	arch_smp_mb();
+
+	return vmm_virtio_queue_available(vq) ? 1 : 0;
+}
+
+/* Note: Must be called with port xfer lock held */
+static void virtio_net_rx_flush(struct virtio_net_dev *ndev,
+				struct virtio_net_queue *q)
+{
+	struct vmm_virtio_device *dev = ndev->vdev;
+
+	if (!vmm_virtio_queue_used_pending(&q->vq)) {
+		return;
+	}
+
+	vmm_virtio_queue_flush_used(&q->vq);
+
+	if (vmm_virtio_queue_should_signal(&q->vq)) {
+		dev->tra->notify(dev, q->num);
+	}
+}
+
+/* Note: Must be called with port xfer lock held */
+static void virtio_net_rx_flush_all(struct virtio_net_dev *ndev)
+{
+	int i;
+
+	for (i = 0; i < ndev->max_queues; i++) {
+		if (ndev->vqs[i].valid &&
+		    (ndev->vqs[i].type == VIRTIO_NET_RX_QUEUE)) {
+			virtio_net_rx_flush(ndev, &ndev->vqs[i]);
+		}
+	}
+}
+
+static void virtio_net_rx_coalesce_event(struct vmm_timer_event *ev)
+{
+	irq_flags_t flags;
+	struct virtio_net_dev *ndev = ev->priv;
+
+	/* Queues reset meanwhile are no longer valid */
+	vmm_spin_lock_irqsave_lite(&ndev->port->switch2port_xfer_lock, flags);
+	virtio_net_rx_flush_all(ndev);
+	vmm_spin_unlock_irqrestore_lite(&ndev->port->switch2port_xfer_lock,
+					flags);
+}
+
 static int virtio_net_switch2port_xfer(struct vmm_netport *p,
 				       struct vmm_mbuf *mb)
 {
 	u16 head = 0;
-	u32 iov_cnt = 0, total_len = 0, pkt_len = 0;
+	u32 iov_cnt = 0, total_len = 0, pkt_len = 0, hdr_len;
 	struct virtio_net_dev *ndev = p->priv;
 	/* FIXME: Select correct RX queue here  */
 	struct virtio_net_queue *q = &ndev->vqs[0];
 	struct vmm_virtio_queue *vq = &q->vq;
 	struct vmm_virtio_iovec *iov = q->iov;
 	struct vmm_virtio_device *dev = ndev->vdev;
-
-	pkt_len = min(VIRTIO_NET_MTU, mb->m_pktlen);
+	struct vmm_virtio_net_hdr_mrg_rxbuf hdr;
 
 	if (vmm_virtio_queue_available(vq)) {
 		head = vmm_virtio_queue_get_iovec(vq, iov,
@@ -302,14 +458,51 @@ static int virtio_net_switch2port_xfer(struct vmm_netport *p,
 	}
 
 	if (iov_cnt > 1) {
-		vmm_virtio_iovec_fill_zeros(dev, &iov[0], 1);
-		vmm_virtio_buf_to_iovec_write(dev, &iov[1], 1,
+		/* iov[0] is offload info. The netswitch only gives us
+		 * offloads which guest has accepted (port->features).
+		 */
+		memset(&hdr, 0, sizeof(hdr));
+		if (mb->m_flags & M_CSUM_PARTIAL) {
+			hdr.hdr.flags = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+			hdr.hdr.csum_start = mb->m_pkthdr.csum_start;
+			hdr.hdr.csum_offset = mb->m_pkthdr.csum_offset;
+		}
+		switch (mb->m_pkthdr.gso_type) {
+		case M_GSO_TCPV4:
+			hdr.hdr.gso_type = VIRTIO_NET_HDR_GSO_TCPV4;
+			break;
+		case M_GSO_TCPV6:
+			hdr.hdr.gso_type = VIRTIO_NET_HDR_GSO_TCPV6;
+			break;
+		default:
+			break;
+		};
+		if (hdr.hdr.gso_type != VIRTIO_NET_HDR_GSO_NONE) {
+			hdr.hdr.gso_size = mb->m_pkthdr.gso_size;
+			pkt_len = mb->m_pktlen;
+		} else {
+			pkt_len = min(VIRTIO_NET_MTU, mb->m_pktlen);
+		}
+		pkt_len = min(pkt_len, total_len - iov[0].len);
+		hdr_len = min(iov[0].len, (u32)sizeof(hdr));
+		vmm_virtio_buf_to_iovec_write(dev, &iov[0], 1, &hdr, hdr_len);
+		vmm_virtio_buf_to_iovec_write(dev, &iov[1], iov_cnt - 1,
 						M_BUFADDR(mb), pkt_len);
-		vmm_virtio_queue_set_used_elem(vq, head, iov[0].len + pkt_len);
-
-		if (vmm_virtio_queue_should_signal(vq)) {
-			/* FIXME: Select correct RX queue here  */
-			dev->tra->notify(dev, 0);
+		vmm_virtio_queue_add_used(vq, head, iov[0].len + pkt_len);
+
+		/* Publish used ring and signal guest once per batch. The
+		 * batch ends when enough packets are pending, when guest
+		 * has no more RX buffers, or when coalescing timer expires.
+		 */
+		if (!ndev->rx_coalesce_nsecs ||
+		    (vmm_virtio_queue_used_pending(vq) >=
+					ndev->rx_coalesce_packets) ||
+		    !vmm_virtio_queue_available(vq)) {
+			vmm_timer_event_stop(&ndev->rx_coalesce_ev);
+			virtio_net_rx_flush(ndev, q);
+		} else if (!vmm_timer_event_pending(&ndev->rx_coalesce_ev)) {
+			vmm_timer_event_start(&ndev->rx_coalesce_ev,
+					      ndev->rx_coalesce_nsecs);
 		}
 	}
 
@@ -348,20 +541,112 @@ static int virtio_net_write_config(struct vmm_virtio_device *dev,
 
 static int virtio_net_reset(struct vmm_virtio_device *dev)
 {
-	int rc, i;
+	int rc = VMM_OK, i;
+	irq_flags_t flags;
 	struct virtio_net_dev *ndev = dev->emu_data;
 
+	/* Coalescing timer and switch only touch valid queues under
+	 * port xfer lock so invalidate queues with it held.
+	 */
+	vmm_spin_lock_irqsave_lite(&ndev->port->switch2port_xfer_lock, flags);
+	vmm_timer_event_stop(&ndev->rx_coalesce_ev);
+	ndev->port->features = 0;
+
 	for (i = 0; i < ndev->max_queues; i++) {
 		if (ndev->vqs[i].valid) {
 			rc = vmm_virtio_queue_cleanup(&ndev->vqs[i].vq);
 			if (rc) {
-				return rc;
+				break;
 			}
 		}
 		ndev->vqs[i].valid = 0;
 	}
 	ndev->can_receive = 0;
+	vmm_spin_unlock_irqrestore_lite(&ndev->port->switch2port_xfer_lock,
+					flags);
+
+	return rc;
+}
+
+static int virtio_net_save(struct vmm_virtio_device *dev,
+			   struct vmm_snapshot_stream *ss)
+{
+	int rc, i;
+	irq_flags_t flags;
+	struct virtio_net_dev *ndev = dev->emu_data;
 
+	/* Publish RX packets held back for coalescing */
+	vmm_spin_lock_irqsave_lite(&ndev->port->switch2port_xfer_lock, flags);
+	vmm_timer_event_stop(&ndev->rx_coalesce_ev);
+	virtio_net_rx_flush_all(ndev);
+	vmm_spin_unlock_irqrestore_lite(&ndev->port->switch2port_xfer_lock,
+					flags);
+
+	rc = vmm_snapshot_write_tag(ss, VIRTIO_NET_SNAPSHOT_MAGIC,
+				    VIRTIO_NET_SNAPSHOT_VERSION);
+	if (!rc) {
+		rc = vmm_snapshot_write_u32(ss, ndev->max_queues);
+	}
+	if (!rc) {
+		rc = vmm_snapshot_write_u32(ss, ndev->features);
+	}
+	if (!rc) {
+		rc = vmm_snapshot_write(ss, ndev->config.mac,
+					sizeof(ndev->config.mac));
+	}
+	for (i = 0; !rc && (i < ndev->max_queues); i++) {
+		rc = vmm_snapshot_write_u32(ss, ndev->vqs[i].valid);
+		if (!rc) {
+			rc = vmm_virtio_queue_save(&ndev->vqs[i].vq, ss);
+		}
+	}
+
+	return rc;
+}
+
+static int virtio_net_restore(struct vmm_virtio_device *dev,
+			      struct vmm_snapshot_stream *ss)
+{
+	int rc, i;
+	u32 val;
+	struct virtio_net_dev *ndev = dev->emu_data;
+
+	rc = vmm_snapshot_read_tag(ss, VIRTIO_NET_SNAPSHOT_MAGIC,
+				   VIRTIO_NET_SNAPSHOT_VERSION);
+	if (!rc) {
+		rc = vmm_snapshot_read_u32(ss, &val);
+	}
+	if (rc) {
+		return rc;
+	}
+	if (val != ndev->max_queues) {
+		return VMM_EINVALID;
+	}
+
+	rc = vmm_snapshot_read_u32(ss, &val);
+	if (!rc) {
+		rc = vmm_snapshot_read(ss, ndev->config.mac,
+				       sizeof(ndev->config.mac));
+	}
+	if (rc) {
+		return rc;
+	}
+	virtio_net_set_guest_features(dev, val);
+
+	vmm_timer_event_stop(&ndev->rx_coalesce_ev);
+	for (i = 0; i < ndev->max_queues; i++) {
+		rc = vmm_snapshot_read_u32(ss, &val);
+		if (!rc) {
+			rc = vmm_virtio_queue_restore(&ndev->vqs[i].vq,
+						      dev->guest, ss);
+		}
+		if (rc) {
+			return rc;
+		}
+		ndev->vqs[i].valid = (val) ? 1 : 0;
+	}
+
+	/* Note: can_receive is updated by status_changed() */
 	return VMM_OK;
 }
 
@@ -369,6 +654,7 @@ static int virtio_net_connect(struct vmm_virtio_device *dev,
 			      struct vmm_virtio_emulator *emu)
 {
 	int i, rc;
+	u32 usecs;
 	const char *attr;
 	struct virtio_net_dev *ndev;
 	struct vmm_netswitch *nsw;
@@ -390,9 +676,32 @@ static int virtio_net_connect(struct vmm_virtio_device *dev,
 	ndev->port->mtu = VIRTIO_NET_MTU;
 	ndev->port->link_changed = virtio_net_link_changed;
 	ndev->port->can_receive = virtio_net_can_receive;
+	ndev->port->can_xfer = virtio_net_can_xfer;
 	ndev->port->switch2port_xfer = virtio_net_switch2port_xfer;
 	ndev->port->priv = ndev;
 
+	if (vmm_devtree_read_u32(dev->edev->node, "rx_coalesce_packets",
+				 &ndev->rx_coalesce_packets) != VMM_OK) {
+		ndev->rx_coalesce_packets = VIRTIO_NET_RX_COALESCE_PACKETS;
+	}
+	if (!ndev->rx_coalesce_packets) {
+		ndev->rx_coalesce_packets = 1;
+	}
+	if (vmm_devtree_read_u32(dev->edev->node, "rx_coalesce_usecs",
+				 &usecs) != VMM_OK) {
+		usecs = VIRTIO_NET_RX_COALESCE_USECS;
+	}
+	ndev->rx_coalesce_nsecs = (u64)usecs * 1000ULL;
+	if (vmm_devtree_read_u32(dev->edev->node, "switch_queue_depth",
+				 &ndev->port->txq_depth) != VMM_OK) {
+		ndev->port->txq_depth = VIRTIO_NET_SWITCH_QUEUE_DEPTH;
+	}
+	if (ndev->port->txq_depth > VMM_NETPORT_MAX_TXQ_DEPTH(ndev->port)) {
+		ndev->port->txq_depth = VMM_NETPORT_MAX_TXQ_DEPTH(ndev->port);
+	}
+	INIT_TIMER_EVENT(&ndev->rx_coalesce_ev,
+			 virtio_net_rx_coalesce_event, ndev);
+
 	ndev->config.max_virtqueue_pairs = dev->guest->vcpu_count;
 	/* Total queus: max_virtqueue_pairs * 2 + 1 this is nothing but
 	 *  (RX VQ + TX VQ) * 2 + CONFIG VQ.
@@ -452,9 +761,18 @@ static int virtio_net_connect(struct vmm_virtio_device *dev,
 
 static void virtio_net_disconnect(struct vmm_virtio_device *dev)
 {
+	irq_flags_t flags;
 	struct virtio_net_dev *ndev = dev->emu_data;
 
+	/* Make sure nobody starts coalescing timer again before
+	 * cancelling it for good.
+	 */
 	vmm_netport_unregister(ndev->port);
+	vmm_spin_lock_irqsave_lite(&ndev->port->switch2port_xfer_lock, flags);
+	ndev->rx_coalesce_nsecs = 0;
+	vmm_spin_unlock_irqrestore_lite(&ndev->port->switch2port_xfer_lock,
+					flags);
+	vmm_timer_event_stop_sync(&ndev->rx_coalesce_ev);
 	vmm_free(ndev->vqs);
 	vmm_netport_free(ndev->port);
 	vmm_free(ndev);
@@ -485,6 +803,8 @@ struct vmm_virtio_emulator virtio_net = {
 	.reset = virtio_net_reset,
 	.connect = virtio_net_connect,
 	.disconnect = virtio_net_disconnect,
+	.save = virtio_net_save,
+	.restore = virtio_net_restore,
 };
 
 static int __init virtio_net_init(void)
@@ -26,6 +26,7 @@
 #include <vmm_heap.h>
 #include <vmm_modules.h>
 #include <vmm_devemu.h>
+#include <vmm_guest_snapshot.h>
 #include <vio/vmm_vmsg.h>
 #include <vio/vmm_virtio.h>
 #include <vio/vmm_virtio_rpmsg.h>
@@ -46,6 +47,35 @@
 #define VIRTIO_RPMSG_RX_QUEUE		0
 #define VIRTIO_RPMSG_TX_QUEUE		1
 
+#define VIRTIO_RPMSG_SNAPSHOT_MAGIC	0x474D5256 /* "VRMG" */
+#define VIRTIO_RPMSG_SNAPSHOT_VERSION	1
+
+struct virtio_rpmsg_txq;
+
+/* TX buffer of guest handed over to vmsg framework without copying */
+struct virtio_rpmsg_tx_buf {
+	struct vmm_vmsg msg;
+	struct virtio_rpmsg_txq *txq;
+	bool busy;
+	u32 gen;
+	u16 head;
+	u32 len;
+};
+
+/* Guest TX buffers in-flight as vmsg messages
+ * Note: This is allocated separately and reference counted because
+ * messages can outlive device reset and device disconnect. Messages
+ * of an older generation (i.e. before device reset) are not returned
+ * to guest.
+ */
+struct virtio_rpmsg_txq {
+	atomic_t ref_count;
+	vmm_spinlock_t lock;
+	struct virtio_rpmsg_dev *rdev;
+	u32 gen;
+	struct virtio_rpmsg_tx_buf bufs[VIRTIO_RPMSG_QUEUE_SIZE];
+};
+
 struct virtio_rpmsg_dev {
 	struct vmm_virtio_device *vdev;
 
@@ -53,6 +83,7 @@ struct virtio_rpmsg_dev {
 	struct vmm_virtio_iovec rx_iov[VIRTIO_RPMSG_QUEUE_SIZE];
 	struct vmm_virtio_iovec tx_iov[VIRTIO_RPMSG_QUEUE_SIZE];
 	u32 features;
+	struct virtio_rpmsg_txq *txq;
 
 	char name[VMM_VIRTIO_DEVICE_MAX_NAME_LEN];
 	bool node_ns_name_avail;
@@ -136,11 +167,135 @@ static int virtio_rpmsg_set_size_vq(struct vmm_virtio_device *dev,
 	return size;
 }
 
+static void virtio_rpmsg_txq_put(struct virtio_rpmsg_txq *txq)
+{
+	if (arch_atomic_sub_return(&txq->ref_count, 1)) {
+		return;
+	}
+
+	vmm_free(txq);
+}
+
+static void virtio_rpmsg_txq_reset(struct virtio_rpmsg_txq *txq)
+{
+	irq_flags_t flags;
+
+	vmm_spin_lock_irqsave(&txq->lock, flags);
+	txq->gen++;
+	vmm_spin_unlock_irqrestore(&txq->lock, flags);
+}
+
+static void virtio_rpmsg_tx_release(struct vmm_vmsg *msg)
+{
+	irq_flags_t flags;
+	struct virtio_rpmsg_tx_buf *tb = msg->priv;
+	struct virtio_rpmsg_txq *txq = tb->txq;
+	struct virtio_rpmsg_dev *rdev;
+	struct vmm_virtio_queue *vq;
+
+	vmm_spin_lock_irqsave(&txq->lock, flags);
+
+	rdev = txq->rdev;
+	if (rdev && (tb->gen == txq->gen)) {
+		vq = &rdev->vqs[VIRTIO_RPMSG_TX_QUEUE];
+		vmm_virtio_queue_set_used_elem(vq, tb->head, tb->len);
+		if (vmm_virtio_queue_should_signal(vq)) {
+			rdev->vdev->tra->notify(rdev->vdev,
+						VIRTIO_RPMSG_TX_QUEUE);
+		}
+	}
+	tb->busy = FALSE;
+
+	vmm_spin_unlock_irqrestore(&txq->lock, flags);
+
+	virtio_rpmsg_txq_put(txq);
+}
+
+/* Send guest TX buffer as guest memory message so that payload is
+ * copied only once, directly into receiving guest. The descriptor is
+ * returned to guest when last reference to message is dropped.
+ */
+static bool virtio_rpmsg_tx_guest_msg(struct virtio_rpmsg_dev *rdev,
+				      u16 head, u32 total_len,
+				      struct vmm_virtio_iovec *tiov,
+				      struct vmm_rpmsg_hdr *hdr)
+{
+	irq_flags_t flags;
+	struct virtio_rpmsg_txq *txq = rdev->txq;
+	struct virtio_rpmsg_tx_buf *tb;
+
+	if (VIRTIO_RPMSG_QUEUE_SIZE <= head) {
+		return FALSE;
+	}
+	tb = &txq->bufs[head];
+
+	/* Buffer can be busy only with a message from before reset */
+	vmm_spin_lock_irqsave(&txq->lock, flags);
+	if (tb->busy) {
+		vmm_spin_unlock_irqrestore(&txq->lock, flags);
+		return FALSE;
+	}
+	tb->busy = TRUE;
+	tb->gen = txq->gen;
+	vmm_spin_unlock_irqrestore(&txq->lock, flags);
+
+	tb->txq = txq;
+	tb->head = head;
+	tb->len = total_len;
+	arch_atomic_add(&txq->ref_count, 1);
+
+	INIT_VMSG_GUEST(&tb->msg, hdr->src, hdr->dst, rdev->vdev->guest,
+			tiov->addr, hdr->len, tb, virtio_rpmsg_tx_release);
+
+	vmm_vmsg_node_send(rdev->node, &tb->msg);
+	vmm_vmsg_put(&tb->msg);
+
+	return TRUE;
+}
+
+static bool virtio_rpmsg_tx_hdr(struct vmm_virtio_device *dev,
+				struct virtio_rpmsg_dev *rdev,
+				struct vmm_virtio_iovec *tiov,
+				struct vmm_rpmsg_hdr *hdr)
+{
+	u32 len;
+	void *local_addr;
+
+	if (tiov->len < sizeof(*hdr)) {
+		return FALSE;
+	}
+
+	len = vmm_virtio_iovec_to_buf_read(dev, tiov,
+					   1, hdr, sizeof(*hdr) - 1);
+	if (len != (sizeof(*hdr) - 1)) {
+		return FALSE;
+	}
+
+	tiov->addr += len;
+	tiov->len -= len;
+
+	if (!tiov->len ||
+	    (hdr->dst < VMM_VMSG_NODE_ADDR_MIN) ||
+	    (hdr->src < VMM_VMSG_NODE_ADDR_MIN) ||
+	    (hdr->len != tiov->len)) {
+		return FALSE;
+	}
+
+	local_addr = radix_tree_lookup(&rdev->global_to_local, hdr->dst);
+	if (!local_addr) {
+		local_addr = (void *)((unsigned long)hdr->src);
+		radix_tree_insert(&rdev->global_to_local,
+				  hdr->dst, local_addr);
+	}
+
+	return TRUE;
+}
+
 static int virtio_rpmsg_tx_msgs(struct vmm_virtio_device *dev,
 				struct virtio_rpmsg_dev *rdev)
 {
 	u16 head = 0;
-	void *local_addr;
+	bool handed_over;
 	u32 i, len, iov_cnt = 0, total_len = 0;
 	struct vmm_virtio_queue *vq = &rdev->vqs[VIRTIO_RPMSG_TX_QUEUE];
 	struct vmm_virtio_iovec *iov = rdev->tx_iov;
@@ -152,38 +307,26 @@ static int virtio_rpmsg_tx_msgs(struct vmm_virtio_device *dev,
 		head = vmm_virtio_queue_get_iovec(vq, iov,
 						  &iov_cnt, &total_len);
 
+		handed_over = FALSE;
 		for (i = 0; i < iov_cnt; i++) {
 			memcpy(&tiov, &iov[i], sizeof(tiov));
 
-			if (tiov.len < sizeof(hdr)) {
-				continue;
-			}
-
-			len = vmm_virtio_iovec_to_buf_read(dev, &tiov,
-						1, &hdr, sizeof(hdr) - 1);
-			if (len != (sizeof(hdr) - 1)) {
-				continue;
-			}
-
-			tiov.addr += len;
-			tiov.len -= len;
-
-			if (!tiov.len ||
-			    (hdr.dst < VMM_VMSG_NODE_ADDR_MIN) ||
-			    (hdr.src < VMM_VMSG_NODE_ADDR_MIN) ||
-			    (hdr.len != tiov.len)) {
+			if (!virtio_rpmsg_tx_hdr(dev, rdev, &tiov, &hdr)) {
 				continue;
 			}
 
-			local_addr = radix_tree_lookup(&rdev->global_to_local,
-							hdr.dst);
-			if (!local_addr) {
-				local_addr = (void *)((unsigned long)hdr.src);
-				radix_tree_insert(&rdev->global_to_local,
-						  hdr.dst, local_addr);
+			/* Usual case of one message per descriptor does
+			 * not copy payload here.
+			 */
+			if ((iov_cnt == 1) &&
+			    virtio_rpmsg_tx_guest_msg(rdev, head, total_len,
+						      &tiov, &hdr)) {
+				handed_over = TRUE;
+				break;
 			}
 
-			msg = vmm_vmsg_alloc(hdr.src, hdr.dst, hdr.len);
+			msg = vmm_vmsg_node_alloc(rdev->node,
+						  hdr.src, hdr.dst, hdr.len);
 			if (!msg) {
 				continue;
 			}
@@ -200,7 +343,9 @@ skip_msg:
 			vmm_vmsg_dref(msg);
 		}
 
-		vmm_virtio_queue_set_used_elem(vq, head, total_len);
+		if (!handed_over) {
+			vmm_virtio_queue_set_used_elem(vq, head, total_len);
+		}
 	}
 
 	if (vmm_virtio_queue_should_signal(vq)) {
@@ -252,12 +397,23 @@ static void virtio_rpmsg_status_changed(struct vmm_virtio_device *dev,
 	}
 }
 
+static void virtio_rpmsg_rx_signal(struct virtio_rpmsg_dev *rdev)
+{
+	struct vmm_virtio_queue *vq = &rdev->vqs[VIRTIO_RPMSG_RX_QUEUE];
+	struct vmm_virtio_device *dev = rdev->vdev;
+
+	if (vmm_virtio_queue_should_signal(vq)) {
+		dev->tra->notify(dev, VIRTIO_RPMSG_RX_QUEUE);
+	}
+}
+
 static int virtio_rpmsg_rx_msg(struct virtio_rpmsg_dev *rdev,
-			       u32 src, u32 dst, void *msg, u16 len,
-			       bool override_dst)
+			       struct vmm_vmsg *msg,
+			       bool override_dst, bool signal)
 {
 	u16 head = 0;
 	void *local_addr;
+	u32 src = msg->src, dst = msg->dst, len = msg->len;
 	u32 pos, iov_cnt = 0, total_len = 0;
 	struct vmm_virtio_queue *vq = &rdev->vqs[VIRTIO_RPMSG_RX_QUEUE];
 	struct vmm_virtio_iovec *iov = rdev->rx_iov;
@@ -294,12 +450,12 @@ static int virtio_rpmsg_rx_msg(struct virtio_rpmsg_dev *rdev,
 	iov[0].addr += pos;
 	iov[0].len -= pos;
 
-	vmm_virtio_buf_to_iovec_write(dev, &iov[0], 1, msg, len);
+	vmm_vmsg_copy_to_guest(msg, 0, dev->guest, iov[0].addr, len);
 
 	vmm_virtio_queue_set_used_elem(vq, head, 1);
 
-	if (vmm_virtio_queue_should_signal(vq)) {
-		dev->tra->notify(dev, VIRTIO_RPMSG_RX_QUEUE);
+	if (signal) {
+		virtio_rpmsg_rx_signal(rdev);
 	}
 
 	return VMM_OK;
@@ -309,6 +465,7 @@ static void virtio_rpmsg_peer_up(struct vmm_vmsg_node *node,
 				 const char *peer_name, u32 peer_addr)
 {
 	int rc;
+	struct vmm_vmsg msg;
 	struct vmm_rpmsg_ns_msg nsmsg;
 	struct virtio_rpmsg_dev *rdev = vmm_vmsg_node_priv(node);
 
@@ -324,10 +481,9 @@ static void virtio_rpmsg_peer_up(struct vmm_vmsg_node *node,
 	nsmsg.addr = peer_addr;
 	nsmsg.flags = VMM_VIRTIO_RPMSG_NS_CREATE;
 
-	rc = virtio_rpmsg_rx_msg(rdev,
-				 VMM_VIRTIO_RPMSG_NS_ADDR,
-				 VMM_VIRTIO_RPMSG_NS_ADDR,
-				 &nsmsg, sizeof(nsmsg), FALSE);
+	INIT_VMSG(&msg, VMM_VIRTIO_RPMSG_NS_ADDR, VMM_VIRTIO_RPMSG_NS_ADDR,
+		  &nsmsg, sizeof(nsmsg), NULL, NULL);
+	rc = virtio_rpmsg_rx_msg(rdev, &msg, FALSE, TRUE);
 	if (rc) {
 		vmm_printf("%s: Failed to rx message (error %d)\n",
 			   __func__, rc);
@@ -341,6 +497,7 @@ static void virtio_rpmsg_peer_down(struct vmm_vmsg_node *node,
 				   const char *peer_name, u32 peer_addr)
 {
 	int rc;
+	struct vmm_vmsg msg;
 	struct vmm_rpmsg_ns_msg nsmsg;
 	struct virtio_rpmsg_dev *rdev = vmm_vmsg_node_priv(node);
 
@@ -356,10 +513,9 @@ static void virtio_rpmsg_peer_down(struct vmm_vmsg_node *node,
 	nsmsg.addr = peer_addr;
 	nsmsg.flags = VMM_VIRTIO_RPMSG_NS_DESTROY;
 
-	rc = virtio_rpmsg_rx_msg(rdev,
-				 VMM_VIRTIO_RPMSG_NS_ADDR,
-				 VMM_VIRTIO_RPMSG_NS_ADDR,
-				 &nsmsg, sizeof(nsmsg), FALSE);
+	INIT_VMSG(&msg, VMM_VIRTIO_RPMSG_NS_ADDR, VMM_VIRTIO_RPMSG_NS_ADDR,
+		  &nsmsg, sizeof(nsmsg), NULL, NULL);
+	rc = virtio_rpmsg_rx_msg(rdev, &msg, FALSE, TRUE);
 	if (rc) {
 		vmm_printf("%s: Failed to rx message (error %d)\n",
 			   __func__, rc);
@@ -374,14 +530,19 @@ static void virtio_rpmsg_recv_msg(struct vmm_vmsg_node *node,
 	int rc;
 	struct virtio_rpmsg_dev *rdev = vmm_vmsg_node_priv(node);
 
-	rc = virtio_rpmsg_rx_msg(rdev, msg->src, msg->dst,
-				 msg->data, (u32)msg->len, TRUE);
+	/* Guest is signaled once per batch from recv_done() */
+	rc = virtio_rpmsg_rx_msg(rdev, msg, TRUE, FALSE);
 	if (rc) {
 		vmm_printf("%s: Failed to rx message (error %d)\n",
 			   __func__, rc);
 	}
 }
 
+static void virtio_rpmsg_recv_done(struct vmm_vmsg_node *node)
+{
+	virtio_rpmsg_rx_signal(vmm_vmsg_node_priv(node));
+}
+
 static int virtio_rpmsg_read_config(struct vmm_virtio_device *dev,
 				    u32 offset, void *dst, u32 dst_len)
 {
@@ -416,6 +577,8 @@ static int virtio_rpmsg_reset(struct vmm_virtio_device *dev)
 
 	vmm_vmsg_node_notready(rdev->node);
 
+	virtio_rpmsg_txq_reset(rdev->txq);
+
 	vmm_vmsg_domain_node_iterate(vmm_vmsg_node_get_domain(rdev->node),
 				     NULL, rdev, virtio_rpmsg_reset_iter);
 
@@ -432,10 +595,61 @@ static int virtio_rpmsg_reset(struct vmm_virtio_device *dev)
 	return VMM_OK;
 }
 
+static int virtio_rpmsg_save(struct vmm_virtio_device *dev,
+			     struct vmm_snapshot_stream *ss)
+{
+	int i, rc;
+	struct virtio_rpmsg_dev *rdev = dev->emu_data;
+
+	/* Note: Mapping of global to local addresses is not saved
+	 * because it is learned again from messages sent by guest.
+	 */
+	rc = vmm_snapshot_write_tag(ss, VIRTIO_RPMSG_SNAPSHOT_MAGIC,
+				    VIRTIO_RPMSG_SNAPSHOT_VERSION);
+	if (!rc) {
+		rc = vmm_snapshot_write_u32(ss, rdev->features);
+	}
+	for (i = 0; !rc && (i < VIRTIO_RPMSG_NUM_QUEUES); i++) {
+		rc = vmm_virtio_queue_save(&rdev->vqs[i], ss);
+	}
+
+	return rc;
+}
+
+static int virtio_rpmsg_restore(struct vmm_virtio_device *dev,
+				struct vmm_snapshot_stream *ss)
+{
+	int i, rc;
+	struct virtio_rpmsg_dev *rdev = dev->emu_data;
+
+	rc = vmm_snapshot_read_tag(ss, VIRTIO_RPMSG_SNAPSHOT_MAGIC,
+				   VIRTIO_RPMSG_SNAPSHOT_VERSION);
+	if (!rc) {
+		rc = vmm_snapshot_read_u32(ss, &rdev->features);
+	}
+	if (rc) {
+		return rc;
+	}
+
+	vmm_vmsg_node_stop_work(rdev->node, rdev, virtio_rpmsg_tx_work);
+	vmm_vmsg_node_notready(rdev->node);
+	virtio_rpmsg_txq_reset(rdev->txq);
+	vmm_vmsg_domain_node_iterate(vmm_vmsg_node_get_domain(rdev->node),
+				     NULL, rdev, virtio_rpmsg_reset_iter);
+
+	for (i = 0; !rc && (i < VIRTIO_RPMSG_NUM_QUEUES); i++) {
+		rc = vmm_virtio_queue_restore(&rdev->vqs[i], dev->guest, ss);
+	}
+
+	/* Note: Node is marked ready again by status_changed() */
+	return rc;
+}
+
 static struct vmm_vmsg_node_ops virtio_rpmsg_ops = {
 	.peer_up = virtio_rpmsg_peer_up,
 	.peer_down = virtio_rpmsg_peer_down,
 	.recv_msg = virtio_rpmsg_recv_msg,
+	.recv_done = virtio_rpmsg_recv_done,
 };
 
 static int virtio_rpmsg_connect(struct vmm_virtio_device *dev,
@@ -455,6 +669,15 @@ static int virtio_rpmsg_connect(struct vmm_virtio_device *dev,
 	}
 	rdev->vdev = dev;
 
+	rdev->txq = vmm_zalloc(sizeof(struct virtio_rpmsg_txq));
+	if (!rdev->txq) {
+		vmm_free(rdev);
+		return VMM_ENOMEM;
+	}
+	arch_atomic_write(&rdev->txq->ref_count, 1);
+	INIT_SPIN_LOCK(&rdev->txq->lock);
+	rdev->txq->rdev = rdev;
+
 	if (vmm_devtree_read_string(dev->edev->node,
 				    VMM_DEVTREE_DOMAIN_ATTR_NAME,
 				    &dom_name)) {
@@ -487,6 +710,7 @@ static int virtio_rpmsg_connect(struct vmm_virtio_device *dev,
 					  &virtio_rpmsg_ops,
 					  dom, rdev);
 	if (!rdev->node) {
+		virtio_rpmsg_txq_put(rdev->txq);
 		vmm_free(rdev);
 		return VMM_EFAIL;
 	}
@@ -500,9 +724,17 @@ static int virtio_rpmsg_connect(struct vmm_virtio_device *dev,
 
 static void virtio_rpmsg_disconnect(struct vmm_virtio_device *dev)
 {
+	irq_flags_t flags;
 	struct virtio_rpmsg_dev *rdev = dev->emu_data;
 
 	vmm_vmsg_node_destroy(rdev->node);
+
+	/* Messages still in-flight must not touch this device */
+	vmm_spin_lock_irqsave(&rdev->txq->lock, flags);
+	rdev->txq->rdev = NULL;
+	vmm_spin_unlock_irqrestore(&rdev->txq->lock, flags);
+	virtio_rpmsg_txq_put(rdev->txq);
+
 	vmm_free(rdev);
 }
 
@@ -531,6 +763,8 @@ struct vmm_virtio_emulator virtio_rpmsg = {
 	.reset = virtio_rpmsg_reset,
 	.connect = virtio_rpmsg_connect,
 	.disconnect = virtio_rpmsg_disconnect,
+	.save = virtio_rpmsg_save,
+	.restore = virtio_rpmsg_restore,
 };
 
 static int __init virtio_rpmsg_init(void)
@@ -37,6 +37,7 @@
 #include <vmm_timer.h>
 #include <vmm_wallclock.h>
 #include <vmm_devemu.h>
+#include <vmm_guest_snapshot.h>
 #include <libs/mathlib.h>
 
 #define MODULE_DESC			"PL031 RTC Emulator"
@@ -55,6 +56,10 @@
 #define RTC_MIS     0x18    /* Masked interrupt status register */
 #define RTC_ICR     0x1c    /* Interrupt clear register */
 
+#define PL031_SNAPSHOT_MAGIC	0x31334C50 /* "PL31" */
+#define PL031_SNAPSHOT_VERSION	1
+#define PL031_SNAPSHOT_NREGS	6
+
 struct pl031_state {
 	struct vmm_guest *guest;
 	struct vmm_timer_event event;
@@ -288,6 +293,67 @@ pl031_emulator_reset_done:
 	return rc;
 }
 
+static int pl031_emulator_save(struct vmm_emudev *edev,
+			       struct vmm_snapshot_stream *ss)
+{
+	int rc;
+	u32 regs[PL031_SNAPSHOT_NREGS];
+	struct pl031_state *s = edev->priv;
+
+	vmm_spin_lock(&s->lock);
+	regs[0] = pl031_get_count(s);
+	regs[1] = s->mr;
+	regs[2] = s->lr;
+	regs[3] = s->im;
+	regs[4] = s->is;
+	regs[5] = vmm_timer_event_pending(&s->event) ? 1 : 0;
+	vmm_spin_unlock(&s->lock);
+
+	rc = vmm_snapshot_write_tag(ss, PL031_SNAPSHOT_MAGIC,
+				    PL031_SNAPSHOT_VERSION);
+	if (rc) {
+		return rc;
+	}
+
+	return vmm_snapshot_write(ss, regs, sizeof(regs));
+}
+
+static int pl031_emulator_restore(struct vmm_emudev *edev,
+				  struct vmm_snapshot_stream *ss)
+{
+	int rc;
+	u32 regs[PL031_SNAPSHOT_NREGS];
+	struct pl031_state *s = edev->priv;
+
+	rc = vmm_snapshot_read_tag(ss, PL031_SNAPSHOT_MAGIC,
+				   PL031_SNAPSHOT_VERSION);
+	if (!rc) {
+		rc = vmm_snapshot_read(ss, regs, sizeof(regs));
+	}
+	if (rc) {
+		return rc;
+	}
+
+	vmm_spin_lock(&s->lock);
+
+	/* RTC count resumes from the saved value */
+	s->tick_offset = regs[0];
+	s->tick_tstamp = vmm_timer_timestamp();
+	s->mr = regs[1];
+	s->lr = regs[2];
+	s->im = regs[3];
+	s->is = regs[4];
+	vmm_timer_event_stop(&s->event);
+	if (regs[5]) {
+		pl031_set_alarm(s);
+	}
+	pl031_update(s);
+
+	vmm_spin_unlock(&s->lock);
+
+	return VMM_OK;
+}
+
 static int pl031_emulator_probe(struct vmm_guest *guest,
 				struct vmm_emudev *edev,
 				const struct vmm_devtree_nodeid *eid)
@@ -355,6 +421,8 @@ static struct vmm_emulator pl031_emulator = {
 	.read32 = pl031_emulator_read32,
 	.write32 = pl031_emulator_write32,
 	.reset = pl031_emulator_reset,
+	.save = pl031_emulator_save,
+	.restore = pl031_emulator_restore,
 	.remove = pl031_emulator_remove,
 };
 
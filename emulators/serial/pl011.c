@@ -36,6 +36,7 @@
 #include <vmm_modules.h>
 #include <vmm_devtree.h>
 #include <vmm_devemu.h>
+#include <vmm_guest_snapshot.h>
 #include <vio/vmm_vserial.h>
 #include <libs/fifo.h>
 #include <libs/stringlib.h>
@@ -381,6 +382,106 @@ static int pl011_emulator_reset(struct vmm_emudev *edev)
 	return VMM_OK;
 }
 
+#define PL011_SNAPSHOT_MAGIC	0x314C5050 /* "PPL1" */
+#define PL011_SNAPSHOT_VERSION	1
+#define PL011_SNAPSHOT_NREGS	11
+
+static int pl011_emulator_save(struct vmm_emudev *edev,
+			       struct vmm_snapshot_stream *ss)
+{
+	int rc;
+	u8 val;
+	u32 i, rd_count;
+	u32 regs[PL011_SNAPSHOT_NREGS];
+	struct pl011_state *s = edev->priv;
+
+	vmm_spin_lock(&s->lock);
+	regs[0] = s->flags;
+	regs[1] = s->lcr;
+	regs[2] = s->cr;
+	regs[3] = s->dmacr;
+	regs[4] = s->int_enabled;
+	regs[5] = s->int_level;
+	regs[6] = s->ilpr;
+	regs[7] = s->ibrd;
+	regs[8] = s->fbrd;
+	regs[9] = s->ifl;
+	regs[10] = s->rd_trig;
+	vmm_spin_unlock(&s->lock);
+
+	rc = vmm_snapshot_write_tag(ss, PL011_SNAPSHOT_MAGIC,
+				    PL011_SNAPSHOT_VERSION);
+	if (!rc) {
+		rc = vmm_snapshot_write(ss, regs, sizeof(regs));
+	}
+	if (rc) {
+		return rc;
+	}
+
+	/* Save unread characters of read FIFO */
+	rd_count = fifo_avail(s->rd_fifo);
+	rc = vmm_snapshot_write_u32(ss, rd_count);
+	for (i = 0; !rc && (i < rd_count); i++) {
+		val = 0;
+		fifo_getelement(s->rd_fifo, i, &val);
+		rc = vmm_snapshot_write(ss, &val, sizeof(val));
+	}
+
+	return rc;
+}
+
+static int pl011_emulator_restore(struct vmm_emudev *edev,
+				  struct vmm_snapshot_stream *ss)
+{
+	int rc;
+	u8 val;
+	u32 i, rd_count;
+	u32 regs[PL011_SNAPSHOT_NREGS];
+	struct pl011_state *s = edev->priv;
+
+	rc = vmm_snapshot_read_tag(ss, PL011_SNAPSHOT_MAGIC,
+				   PL011_SNAPSHOT_VERSION);
+	if (!rc) {
+		rc = vmm_snapshot_read(ss, regs, sizeof(regs));
+	}
+	if (!rc) {
+		rc = vmm_snapshot_read_u32(ss, &rd_count);
+	}
+	if (rc) {
+		return rc;
+	}
+	if (rd_count > s->fifo_sz) {
+		return VMM_EINVALID;
+	}
+
+	vmm_spin_lock(&s->lock);
+	s->flags = regs[0];
+	s->lcr = regs[1];
+	s->cr = regs[2];
+	s->dmacr = regs[3];
+	s->int_enabled = regs[4];
+	s->int_level = regs[5];
+	s->ilpr = regs[6];
+	s->ibrd = regs[7];
+	s->fbrd = regs[8];
+	s->ifl = regs[9];
+	s->rd_trig = regs[10];
+	vmm_spin_unlock(&s->lock);
+
+	fifo_clear(s->rd_fifo);
+	for (i = 0; i < rd_count; i++) {
+		rc = vmm_snapshot_read(ss, &val, sizeof(val));
+		if (rc) {
+			return rc;
+		}
+		fifo_enqueue(s->rd_fifo, &val, TRUE);
+	}
+
+	pl011_set_irq(s, s->int_level, s->int_enabled);
+
+	return VMM_OK;
+}
+
 static int pl011_emulator_probe(struct vmm_guest *guest,
 				struct vmm_emudev *edev,
 				const struct vmm_devtree_nodeid *eid)
@@ -512,6 +613,8 @@ static struct vmm_emulator pl011_emulator = {
 	.read32 = pl011_emulator_read32,
 	.write32 = pl011_emulator_write32,
 	.reset = pl011_emulator_reset,
+	.save = pl011_emulator_save,
+	.restore = pl011_emulator_restore,
 	.remove = pl011_emulator_remove,
 };
 
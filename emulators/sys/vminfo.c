@@ -312,16 +312,16 @@ static struct vmm_devtree_nodeid vminfo_emuid_table[] = {
 	{ /* end of list */ },
 };
 
-VMM_DECLARE_EMULATOR_SIMPLE(vminfo_emulator,
-			   "vminfo",
-			    vminfo_emuid_table,
-			    VMM_DEVEMU_LITTLE_ENDIAN,
-			    vminfo_emulator_probe,
-			    vminfo_emulator_remove,
-			    vminfo_emulator_reset,
-			    NULL,
-			    vminfo_emulator_read,
-			    vminfo_emulator_write);
+VMM_DECLARE_EMULATOR_STATELESS(vminfo_emulator,
+			       "vminfo",
+			       vminfo_emuid_table,
+			       VMM_DEVEMU_LITTLE_ENDIAN,
+			       vminfo_emulator_probe,
+			       vminfo_emulator_remove,
+			       vminfo_emulator_reset,
+			       NULL,
+			       vminfo_emulator_read,
+			       vminfo_emulator_write);
 
 static int __init vminfo_emulator_init(void)
 {
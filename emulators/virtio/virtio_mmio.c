@@ -26,6 +26,7 @@
 #include <vmm_stdio.h>
 #include <vmm_modules.h>
 #include <vmm_devemu.h>
+#include <vmm_guest_snapshot.h>
 #include <vio/vmm_virtio.h>
 #include <vio/vmm_virtio_mmio.h>
 
@@ -43,6 +44,10 @@ struct virtio_mmio_dev {
 	u32 irq;
 };
 
+#define VIRTIO_MMIO_SNAPSHOT_MAGIC	0x4F494D56 /* "VMIO" */
+#define VIRTIO_MMIO_SNAPSHOT_VERSION	1
+#define VIRTIO_MMIO_SNAPSHOT_NREGS	8
+
 static int virtio_mmio_notify(struct vmm_virtio_device *dev, u32 vq)
 {
 	struct virtio_mmio_dev *m = dev->tra_data;
@@ -260,6 +265,84 @@ static int virtio_mmio_reset(struct vmm_emudev *edev)
 	return vmm_virtio_reset(&m->dev);
 }
 
+static int virtio_mmio_save(struct vmm_emudev *edev,
+			    struct vmm_snapshot_stream *ss)
+{
+	int rc;
+	u32 regs[VIRTIO_MMIO_SNAPSHOT_NREGS];
+	struct virtio_mmio_dev *m = edev->priv;
+
+	regs[0] = m->config.host_features_sel;
+	regs[1] = m->config.guest_features_sel;
+	regs[2] = m->config.guest_page_size;
+	regs[3] = m->config.queue_sel;
+	regs[4] = m->config.queue_num;
+	regs[5] = m->config.queue_align;
+	regs[6] = m->config.interrupt_state;
+	regs[7] = m->config.status;
+
+	rc = vmm_snapshot_write_tag(ss, VIRTIO_MMIO_SNAPSHOT_MAGIC,
+				    VIRTIO_MMIO_SNAPSHOT_VERSION);
+	if (!rc) {
+		rc = vmm_snapshot_write_u32(ss, m->config.device_id);
+	}
+	if (!rc) {
+		rc = vmm_snapshot_write(ss, regs, sizeof(regs));
+	}
+	if (rc) {
+		return rc;
+	}
+
+	return vmm_virtio_save(&m->dev, ss);
+}
+
+static int virtio_mmio_restore(struct vmm_emudev *edev,
+			       struct vmm_snapshot_stream *ss)
+{
+	int rc;
+	u32 device_id, regs[VIRTIO_MMIO_SNAPSHOT_NREGS];
+	struct virtio_mmio_dev *m = edev->priv;
+
+	rc = vmm_snapshot_read_tag(ss, VIRTIO_MMIO_SNAPSHOT_MAGIC,
+				   VIRTIO_MMIO_SNAPSHOT_VERSION);
+	if (!rc) {
+		rc = vmm_snapshot_read_u32(ss, &device_id);
+	}
+	if (!rc) {
+		rc = vmm_snapshot_read(ss, regs, sizeof(regs));
+	}
+	if (rc) {
+		return rc;
+	}
+	if (device_id != m->config.device_id) {
+		return VMM_EINVALID;
+	}
+
+	m->config.host_features_sel = regs[0];
+	m->config.guest_features_sel = regs[1];
+	m->config.guest_page_size = regs[2];
+	m->config.queue_sel = regs[3];
+	m->config.queue_num = regs[4];
+	m->config.queue_align = regs[5];
+	m->config.interrupt_state = regs[6];
+	m->config.status = regs[7];
+
+	rc = vmm_virtio_restore(&m->dev, ss);
+	if (rc) {
+		return rc;
+	}
+
+	/* Let emulator act upon restored status as if written by guest */
+	if (m->dev.emu) {
+		m->dev.emu->status_changed(&m->dev, m->config.status);
+	}
+
+	vmm_devemu_emulate_irq(m->guest, m->irq,
+			       (m->config.interrupt_state) ? 1 : 0);
+
+	return VMM_OK;
+}
+
 static struct vmm_virtio_transport mmio_tra = {
 	.name = "virtio_mmio",
 	.notify = virtio_mmio_notify,
@@ -355,6 +438,8 @@ static struct vmm_emulator virtio_mmio = {
 	.read32 = virtio_mmio_read32,
 	.write32 = virtio_mmio_write32,
 	.reset = virtio_mmio_reset,
+	.save = virtio_mmio_save,
+	.restore = virtio_mmio_restore,
 	.remove = virtio_mmio_remove,
 };
 
@@ -32,6 +32,7 @@
 #include <vmm_stdio.h>
 #include <vmm_timer.h>
 #include <vmm_spinlocks.h>
+#include <vmm_guest_snapshot.h>
 #include <libs/mathlib.h>
 
 #define MODULE_DESC			"Sp805 Device Emulator"
@@ -54,6 +55,10 @@
 #define WDT_LOCK			0xC00
 #define WDT_LOCK_ACCESS			0x1ACCE551
 
+#define SP805_SNAPSHOT_MAGIC		0x35303853 /* "S805" */
+#define SP805_SNAPSHOT_VERSION		1
+#define SP805_SNAPSHOT_NREGS		6
+
 #define EMU_NAME(emudev)		((emudev)->node->name)
 
 #undef DEBUG
@@ -418,6 +423,69 @@ static int sp805_emulator_reset(struct vmm_emudev *edev)
 	return VMM_OK;
 }
 
+static int sp805_emulator_save(struct vmm_emudev *edev,
+			       struct vmm_snapshot_stream *ss)
+{
+	int rc;
+	u32 regs[SP805_SNAPSHOT_NREGS];
+	struct sp805_state *sp805 = edev->priv;
+
+	vmm_spin_lock(&sp805->lock);
+	regs[0] = sp805->load;
+	regs[1] = sp805->ctrl;
+	regs[2] = sp805->ris;
+	regs[3] = sp805->locked;
+	regs[4] = sp805->irq_level;
+	regs[5] = sp805->freezed_value;
+	vmm_spin_unlock(&sp805->lock);
+
+	rc = vmm_snapshot_write_tag(ss, SP805_SNAPSHOT_MAGIC,
+				    SP805_SNAPSHOT_VERSION);
+	if (rc) {
+		return rc;
+	}
+
+	return vmm_snapshot_write(ss, regs, sizeof(regs));
+}
+
+static int sp805_emulator_restore(struct vmm_emudev *edev,
+				  struct vmm_snapshot_stream *ss)
+{
+	int rc;
+	u32 regs[SP805_SNAPSHOT_NREGS];
+	struct sp805_state *sp805 = edev->priv;
+
+	rc = vmm_snapshot_read_tag(ss, SP805_SNAPSHOT_MAGIC,
+				   SP805_SNAPSHOT_VERSION);
+	if (!rc) {
+		rc = vmm_snapshot_read(ss, regs, sizeof(regs));
+	}
+	if (rc) {
+		return rc;
+	}
+
+	vmm_spin_lock(&sp805->lock);
+
+	sp805->load = regs[0];
+	sp805->ctrl = regs[1] & WDT_CTRL_MASK;
+	sp805->ris = regs[2];
+	sp805->locked = regs[3];
+	sp805->irq_level = regs[4];
+	sp805->freezed_value = regs[5];
+
+	/* Start a full watchdog period so that time spent
+	 * between save and restore does not count.
+	 */
+	vmm_timer_event_stop(&sp805->event);
+	_sp805_counter_reload(sp805);
+	vmm_devemu_emulate_irq(sp805->guest, sp805->irq,
+			       (sp805->irq_level) ? 1 : 0);
+
+	vmm_spin_unlock(&sp805->lock);
+
+	return VMM_OK;
+}
+
 static void sp805_emulator_event(struct vmm_timer_event *evt)
 {
 	struct sp805_state *sp805 = evt->priv;
@@ -515,6 +583,8 @@ static struct vmm_emulator sp805_emulator = {
 	.read32 = sp805_emulator_read32,
 	.write32 = sp805_emulator_write32,
 	.reset = sp805_emulator_reset,
+	.save = sp805_emulator_save,
+	.restore = sp805_emulator_restore,
 	.remove = sp805_emulator_remove,
 };
 
@@ -0,0 +1,226 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file lz4.c
+ * @author agent (agent@local)
+ * @brief Simple greedy compressor and safe decompressor for
+ * LZ4 block format
+ */
+
+#include <vmm_error.h>
+#include <vmm_modules.h>
+#include <libs/stringlib.h>
+#include <libs/lz4.h>
+
+#define LZ4_MIN_MATCH			4
+#define LZ4_LAST_LITERALS		5
+#define LZ4_MFLIMIT			12
+#define LZ4_MAX_OFFSET			0xFFFF
+#define LZ4_RUN_MASK			0xF
+
+static inline u32 lz4_read32(const u8 *p)
+{
+	u32 val;
+
+	memcpy(&val, p, sizeof(val));
+
+	return val;
+}
+
+static inline u32 lz4_hash(u32 val)
+{
+	return (val * 2654435761U) >> (32 - LZ4_HASH_BITS);
+}
+
+static u8 *lz4_emit(u8 *op, u8 *oend,
+		    const u8 *lit, u32 lit_len,
+		    u32 offset, u32 match_len)
+{
+	u8 *token;
+	u32 len;
+
+	/* Worst case space needed by this sequence */
+	if ((u32)(oend - op) < (1 + lit_len + (lit_len / 255) + 1 +
+				2 + (match_len / 255) + 1)) {
+		return NULL;
+	}
+
+	token = op++;
+	if (lit_len >= LZ4_RUN_MASK) {
+		*token = LZ4_RUN_MASK << 4;
+		for (len = lit_len - LZ4_RUN_MASK; len >= 255; len -= 255) {
+			*op++ = 255;
+		}
+		*op++ = (u8)len;
+	} else {
+		*token = (u8)(lit_len << 4);
+	}
+	memcpy(op, lit, lit_len);
+	op += lit_len;
+
+	/* Last sequence has literals only */
+	if (!match_len) {
+		return op;
+	}
+
+	*op++ = (u8)(offset & 0xFF);
+	*op++ = (u8)(offset >> 8);
+
+	len = match_len - LZ4_MIN_MATCH;
+	if (len >= LZ4_RUN_MASK) {
+		*token |= LZ4_RUN_MASK;
+		for (len -= LZ4_RUN_MASK; len >= 255; len -= 255) {
+			*op++ = 255;
+		}
+		*op++ = (u8)len;
+	} else {
+		*token |= (u8)len;
+	}
+
+	return op;
+}
+
+u32 lz4_compress(const void *src, u32 src_len,
+		 void *dst, u32 dst_len, void *wrkmem)
+{
+	u32 h, len, *htab = wrkmem;
+	const u8 *base = src, *ip = src, *anchor = src, *ref;
+	const u8 *iend = base + src_len;
+	const u8 *mflimit = iend - LZ4_MFLIMIT;
+	const u8 *matchlimit = iend - LZ4_LAST_LITERALS;
+	u8 *op = dst, *oend = op + dst_len;
+
+	if (!src || !dst || !wrkmem || (src_len > LZ4_MAX_INPUT_SIZE)) {
+		return 0;
+	}
+
+	memset(htab, 0, LZ4_MEM_COMPRESS);
+
+	while ((src_len > LZ4_MFLIMIT) && (ip < mflimit)) {
+		h = lz4_hash(lz4_read32(ip));
+		ref = base + htab[h];
+		htab[h] = (u32)(ip - base);
+
+		if ((ref >= ip) || ((ip - ref) > LZ4_MAX_OFFSET) ||
+		    (lz4_read32(ref) != lz4_read32(ip))) {
+			ip++;
+			continue;
+		}
+
+		/* Extend match backwards over pending literals */
+		while ((ip > anchor) && (ref > base) && (ip[-1] == ref[-1])) {
+			ip--;
+			ref--;
+		}
+
+		/* Extend match forwards */
+		len = LZ4_MIN_MATCH;
+		while (((ip + len) < matchlimit) && (ip[len] == ref[len])) {
+			len++;
+		}
+
+		op = lz4_emit(op, oend, anchor, (u32)(ip - anchor),
+			      (u32)(ip - ref), len);
+		if (!op) {
+			return 0;
+		}
+
+		ip += len;
+		anchor = ip;
+	}
+
+	op = lz4_emit(op, oend, anchor, (u32)(iend - anchor), 0, 0);
+	if (!op) {
+		return 0;
+	}
+
+	return (u32)(op - (u8 *)dst);
+}
+VMM_EXPORT_SYMBOL(lz4_compress);
+
+int lz4_decompress(const void *src, u32 src_len,
+		   void *dst, u32 dst_len)
+{
+	u8 b, token;
+	u32 len, offset;
+	const u8 *ip = src, *iend = ip + src_len, *ref;
+	u8 *op = dst, *oend = op + dst_len;
+
+	if (!src || !dst) {
+		return VMM_EINVALID;
+	}
+
+	while (ip < iend) {
+		token = *ip++;
+
+		len = token >> 4;
+		if (len == LZ4_RUN_MASK) {
+			do {
+				if (ip >= iend) {
+					return VMM_EINVALID;
+				}
+				b = *ip++;
+				len += b;
+			} while (b == 255);
+		}
+		if ((len > (u32)(iend - ip)) || (len > (u32)(oend - op))) {
+			return VMM_EINVALID;
+		}
+		memcpy(op, ip, len);
+		op += len;
+		ip += len;
+
+		/* Last sequence has literals only */
+		if (ip >= iend) {
+			break;
+		}
+
+		if ((iend - ip) < 2) {
+			return VMM_EINVALID;
+		}
+		offset = ip[0] | ((u32)ip[1] << 8);
+		ip += 2;
+		if (!offset || (offset > (u32)(op - (u8 *)dst))) {
+			return VMM_EINVALID;
+		}
+
+		len = token & LZ4_RUN_MASK;
+		if (len == LZ4_RUN_MASK) {
+			do {
+				if (ip >= iend) {
+					return VMM_EINVALID;
+				}
+				b = *ip++;
+				len += b;
+			} while (b == 255);
+		}
+		len += LZ4_MIN_MATCH;
+		if (len > (u32)(oend - op)) {
+			return VMM_EINVALID;
+		}
+
+		/* Byte-wise copy because match may overlap output */
+		ref = op - offset;
+		while (len--) {
+			*op++ = *ref++;
+		}
+	}
+
+	return (int)(op - (u8 *)dst);
+}
+VMM_EXPORT_SYMBOL(lz4_decompress);
@@ -464,7 +464,7 @@ void *memcpy_fromio(void *dest, const void *src, size_t count)
 	return dest;
 }
 
-void *memmove(void *dest, const void *src, size_t count)
+void *memmove_generic(void *dest, const void *src, size_t count)
 {
 	u8 *dst8 = (u8 *) dest;
 	const u8 *src8 = (u8 *) src;
@@ -507,8 +507,14 @@ void *memmove(void *dest, const void *src, size_t count)
 	return dest;
 }
 
-#if !defined(ARCH_HAS_MEMSET)
-void *memset(void *dest, int c, size_t count)
+#if !defined(ARCH_HAS_MEMMOVE)
+void *memmove(void *dest, const void *src, size_t count)
+{
+	return memmove_generic(dest, src, count);
+}
+#endif
+
+void *memset_generic(void *dest, int c, size_t count)
 {
 	u8 *dst8 = (u8 *) dest;
 	u8 ch = (u8) c;
@@ -527,6 +533,26 @@ void *memset(void *dest, int c, size_t count)
 
 	return dest;
 }
+
+#if !defined(ARCH_HAS_MEMSET)
+void *memset(void *dest, int c, size_t count)
+{
+	return memset_generic(dest, c, count);
+}
+#endif
+
+#if !defined(ARCH_HAS_MEMCPY_BASELINE)
+void *memcpy_baseline(void *dest, const void *src, size_t count)
+{
+	return memcpy(dest, src, count);
+}
+#endif
+
+#if !defined(ARCH_HAS_MEMSET_BASELINE)
+void *memset_baseline(void *dest, int c, size_t count)
+{
+	return memset(dest, c, count);
+}
 #endif
 
 void *memset_io(void *dest, int c, size_t count)
@@ -0,0 +1,49 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file lz4.h
+ * @author agent (agent@local)
+ * @brief Interface for LZ4 block format compression
+ */
+#ifndef __LZ4_H__
+#define __LZ4_H__
+
+#include <vmm_types.h>
+
+#define LZ4_HASH_BITS			12
+#define LZ4_MAX_INPUT_SIZE		0x7E000000
+
+/** Size of working memory required by lz4_compress() */
+#define LZ4_MEM_COMPRESS		((1 << LZ4_HASH_BITS) * sizeof(u32))
+
+/** Worst case compressed size for given input size */
+#define LZ4_COMPRESS_BOUND(isize)	((isize) + ((isize) / 255) + 16)
+
+/** Compress a buffer in LZ4 block format
+ *  @returns compressed size or 0 if output does not fit in dst_len
+ */
+u32 lz4_compress(const void *src, u32 src_len,
+		 void *dst, u32 dst_len, void *wrkmem);
+
+/** Decompress a LZ4 block format buffer
+ *  @returns decompressed size or negative error code for bad input
+ */
+int lz4_decompress(const void *src, u32 src_len,
+		   void *dst, u32 dst_len);
+
+#endif /* __LZ4_H__ */
@@ -103,6 +103,19 @@ void *memset(void *dest, int c, size_t count);
 
 void *memset_io(void *dest, int c, size_t count);
 
+/** Generic implementations used when arch does not provide its own */
+void *memmove_generic(void *dest, const void *src, size_t count);
+
+void *memset_generic(void *dest, int c, size_t count);
+
+/** Implementations before arch specific tuning (or same as memcpy()
+ *  and memset() if arch did not tune them) which are used as baseline
+ *  by memory bench command.
+ */
+void *memcpy_baseline(void *dest, const void *src, size_t count);
+
+void *memset_baseline(void *dest, int c, size_t count);
+
 int memcmp(const void *s1, const void *s2, size_t count);
 
 void *memchr(const void *s, int c, size_t n);
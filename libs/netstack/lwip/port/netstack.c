@@ -29,6 +29,8 @@
 #include <vmm_mutex.h>
 #include <vmm_completion.h>
 #include <vmm_modules.h>
+#include <vmm_host_aspace.h>
+#include <libs/mempool.h>
 #include <libs/netstack.h>
 
 #include "lwip/opt.h"
@@ -61,6 +63,9 @@
 
 #define MAX_FRAME_LEN			1518
 
+/** number of received frames lwIP can hold without copying */
+#define RX_PBUF_COUNT			128
+
 #undef PING_USE_SOCKETS
 
 /** ping receive timeout - in milliseconds */
@@ -72,9 +77,16 @@
 /** ping identifier - must fit on a u16_t */
 #define PING_ID				0xAFAF
 
+/** pbuf referring to data of received mbuf */
+struct lwip_rx_pbuf {
+	struct pbuf_custom pc;
+	struct vmm_mbuf *mbuf;
+};
+
 struct lwip_netstack {
 	struct netif nif;
 	struct vmm_netport *port;
+	struct mempool *rx_pool;
 #if !defined(PING_USE_SOCKETS)
 	struct vmm_mutex ping_lock;
 	ip_addr_t ping_addr;
@@ -705,6 +717,48 @@ static int lwip_can_receive(struct vmm_netport *port)
 	return FALSE;
 }
 
+static void lwip_rx_pbuf_free(struct pbuf *p)
+{
+	struct lwip_rx_pbuf *rp = (struct lwip_rx_pbuf *)p;
+
+	m_freem(rp->mbuf);
+	mempool_free(lns.rx_pool, rp);
+}
+
+/* Give received mbuf data to lwIP as PBUF_REF pbuf.
+ * Note: lwIP updates received frames in-place (e.g. byte-swaps
+ * headers and turns ARP request into ARP reply) so we only do this
+ * when we are the sole user of a writable single buffer. Frames
+ * flooded by netswitch share the buffer with other ports hence
+ * these are always copied.
+ */
+static struct pbuf *lwip_rx_pbuf_wrap(struct lwip_netstack *lns,
+				      struct vmm_mbuf *mbuf, u16 len)
+{
+	struct pbuf *p;
+	struct lwip_rx_pbuf *rp;
+
+	if (!lns->rx_pool || mbuf->m_next || (mbuf->m_len < len) ||
+	    (mbuf->m_ref != 1) || M_READONLY(mbuf)) {
+		return NULL;
+	}
+
+	rp = mempool_malloc(lns->rx_pool);
+	if (!rp) {
+		return NULL;
+	}
+
+	rp->mbuf = mbuf;
+	rp->pc.custom_free_function = lwip_rx_pbuf_free;
+	p = pbuf_alloced_custom(PBUF_RAW, len, PBUF_REF, &rp->pc,
+				mtod(mbuf, void *), len);
+	if (!p) {
+		mempool_free(lns->rx_pool, rp);
+	}
+
+	return p;
+}
+
 static int lwip_switch2port_xfer(struct vmm_netport *port,
 			 	 struct vmm_mbuf *mbuf)
 {
@@ -714,16 +768,26 @@ static int lwip_switch2port_xfer(struct vmm_netport *port,
 	struct lwip_netstack *lns = port->priv;
 	u32 lcopied = 0;
 
-	/* Move received packet into a new pbuf */
 	pbuf_len = min(MAX_FRAME_LEN, mbuf->m_pktlen);
-	p = pbuf_alloc(PBUF_LINK, pbuf_len, PBUF_POOL);
-	if (!p) {
-		return VMM_ENOMEM;
-	}
 
-	for (q = p; q != NULL; q = q->next) {
-		m_copydata(mbuf, lcopied, q->len, q->payload);
-		lcopied += q->len;
+	/* Try to use mbuf data in-place otherwise copy
+	 * received packet into a new pbuf.
+	 */
+	p = lwip_rx_pbuf_wrap(lns, mbuf, pbuf_len);
+	if (p) {
+		/* The pbuf owns mbuf now */
+		mbuf = NULL;
+	} else {
+		p = pbuf_alloc(PBUF_LINK, pbuf_len, PBUF_POOL);
+		if (!p) {
+			m_freem(mbuf);
+			return VMM_ENOMEM;
+		}
+
+		for (q = p; q != NULL; q = q->next) {
+			m_copydata(mbuf, lcopied, q->len, q->payload);
+			lcopied += q->len;
+		}
 	}
 
 	/* Points to packet ethernet header */
@@ -745,7 +809,9 @@ static int lwip_switch2port_xfer(struct vmm_netport *port,
 	}
 
 	/* Free the mbuf */
-	m_freem(mbuf);
+	if (mbuf) {
+		m_freem(mbuf);
+	}
 
 	/* Return success */
 	return VMM_OK;
@@ -877,6 +943,12 @@ static int __init lwip_netstack_init(void)
 		goto fail;
 	}
 
+	/* Pool of pbufs for zero-copy receive (copy if unavailable) */
+	lns.rx_pool = mempool_ram_create(sizeof(struct lwip_rx_pbuf),
+			VMM_SIZE_TO_PAGE(sizeof(struct lwip_rx_pbuf) *
+					 RX_PBUF_COUNT),
+			VMM_MEMORY_FLAGS_NORMAL);
+
 	/* Setup a netport */
 	lns.port->mtu = 1500;
 	lns.port->link_changed = lwip_set_link;
@@ -921,6 +993,9 @@ static int __init lwip_netstack_init(void)
 fail2:
 	vmm_netport_unregister(lns.port);
 fail1:
+	if (lns.rx_pool) {
+		mempool_destroy(lns.rx_pool);
+	}
 	vmm_netport_free(lns.port);
 fail:
 	return rc;
@@ -929,6 +1004,9 @@ fail:
 static void __exit lwip_netstack_exit(void)
 {
 	vmm_netport_unregister(lns.port);
+	if (lns.rx_pool) {
+		mempool_destroy(lns.rx_pool);
+	}
 	vmm_netport_free(lns.port);
 }
 
@@ -28,6 +28,7 @@
 #include <vmm_devdrv.h>
 #include <vmm_modules.h>
 #include <libs/stringlib.h>
+#include <libs/scatterlist.h>
 #include <libs/scsi_disk.h>
 
 #define MODULE_DESC			"SCSI Disk Library"
@@ -44,19 +45,17 @@
 #define DPRINTF(msg...)
 #endif
 
-static int scsi_disk_rq_read(struct vmm_blockrq *brq,
-			     struct vmm_request *r, void *priv)
+/* Max scatter-gather entries handled in one request */
+#define SCSI_DISK_MAX_SG_NENTS		64
+
+static int scsi_disk_rw_buf(struct scsi_disk *disk, unsigned long lba,
+			    unsigned long bcnt, void *data, bool write)
 {
-	void *data;
 	int rc, retry;
-	unsigned long lba, bcnt, blksz;
+	unsigned long blksz;
 	unsigned short blks;
 	struct scsi_request srb;
-	struct scsi_disk *disk = priv;
 
-	bcnt = (unsigned long)r->bcnt;
-	data = r->data;
-	lba = (unsigned long)r->lba;
 	blksz = disk->info.blksz;
 
 	while (bcnt) {
@@ -67,9 +66,14 @@ static int scsi_disk_rq_read(struct vmm_blockrq *brq,
 		rc = VMM_OK;
 		while (retry) {
 			INIT_SCSI_REQUEST(&srb, disk->info.lun,
-					 data, blks * blksz);
-			rc = scsi_read10(&srb, lba, blks,
-					 disk->tr, disk->tr_priv);
+					  data, blks * blksz);
+			if (write) {
+				rc = scsi_write10(&srb, lba, blks,
+						  disk->tr, disk->tr_priv);
+			} else {
+				rc = scsi_read10(&srb, lba, blks,
+						 disk->tr, disk->tr_priv);
+			}
 			if (rc == VMM_OK) {
 				break;
 			}
@@ -98,60 +102,46 @@ static int scsi_disk_rq_read(struct vmm_blockrq *brq,
 	return VMM_OK;
 }
 
-static int scsi_disk_rq_write(struct vmm_blockrq *brq,
-			      struct vmm_request *r, void *priv)
+static int scsi_disk_rq_rw(struct vmm_request *r,
+			   struct scsi_disk *disk, bool write)
 {
-	void *data;
-	int rc, retry;
-	unsigned long lba, bcnt, blksz;
-	unsigned short blks;
-	struct scsi_request srb;
-	struct scsi_disk *disk = priv;
+	int rc;
+	unsigned int i;
+	unsigned long lba, blks;
+	struct scatterlist *sg;
 
-	bcnt = (unsigned long)r->bcnt;
-	data = r->data;
 	lba = (unsigned long)r->lba;
-	blksz = disk->info.blksz;
-
-	while (bcnt) {
-		blks = (disk->blks_per_xfer < bcnt) ?
-					disk->blks_per_xfer : bcnt;
 
-		retry = 3;
-		rc = VMM_OK;
-		while (retry) {
-			INIT_SCSI_REQUEST(&srb, disk->info.lun,
-					  data, blks * blksz);
-			rc = scsi_write10(&srb, lba, blks,
-					  disk->tr, disk->tr_priv);
-			if (rc == VMM_OK) {
-				break;
-			}
-
-			rc = scsi_request_sense(&srb,
-						disk->tr, disk->tr_priv);
-			if (rc) {
-				return rc;
-			}
-			if ((srb.sense_buf[2] == 0x02) &&
-			    (srb.sense_buf[12] == 0x3a)) {
-				return VMM_ENODEV;
-			}
+	if (!r->sgl) {
+		return scsi_disk_rw_buf(disk, lba, (unsigned long)r->bcnt,
+					r->data, write);
+	}
 
-			retry--;
-		}
-		if (!retry && rc != VMM_OK) {
+	/* Each entry is multiple of block size (see sg limits) */
+	for_each_sg(r->sgl, sg, r->sg_nents, i) {
+		blks = sg->length / disk->info.blksz;
+		rc = scsi_disk_rw_buf(disk, lba, blks, sg_virt(sg), write);
+		if (rc) {
 			return rc;
 		}
-
 		lba += blks;
-		bcnt -= blks;
-		data += blks * blksz;
 	}
 
 	return VMM_OK;
 }
 
+static int scsi_disk_rq_read(struct vmm_blockrq *brq,
+			     struct vmm_request *r, void *priv)
+{
+	return scsi_disk_rq_rw(r, priv, FALSE);
+}
+
+static int scsi_disk_rq_write(struct vmm_blockrq *brq,
+			      struct vmm_request *r, void *priv)
+{
+	return scsi_disk_rq_rw(r, priv, TRUE);
+}
+
 static void scsi_disk_rq_flush(struct vmm_blockrq *brq, void *priv)
 {
 	/* Nothing to do here. */
@@ -222,6 +212,7 @@ struct scsi_disk *scsi_create_disk(const char *name,
 		vmm_free(disk);
 		return VMM_ERR_PTR(VMM_ENOMEM);
 	}
+	vmm_blockrq_set_sg_limits(disk->brq, SCSI_DISK_MAX_SG_NENTS, TRUE);
 	disk->bdev->rq = vmm_blockrq_to_rq(disk->brq);
 
 	/* Register block device instance */
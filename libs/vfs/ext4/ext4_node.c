@@ -51,6 +51,46 @@ void ext4fs_node_set_size(struct ext4fs_node *node, u64 size)
 	node->inode_dirty = TRUE;
 }
 
+static void ext4fs_node_extent_invalidate(struct ext4fs_node *node)
+{
+	int idx;
+
+	node->extent_victim = 0;
+	for (idx = 0; idx < EXT4_NODE_EXTENT_SIZE; idx++) {
+		node->extent[idx].blkcnt = 0;
+	}
+}
+
+static void ext4fs_node_ra_invalidate(struct ext4fs_node *node)
+{
+	node->ra_blkno = 0;
+	node->ra_blkcnt = 0;
+}
+
+/* Write-back cached block if it is dirty and within given blocks */
+static int ext4fs_node_flush_cached(struct ext4fs_node *node,
+				    u32 blkno, u32 blkcnt)
+{
+	int rc;
+	struct ext4fs_control *ctrl = node->ctrl;
+
+	if (!node->cached_block || !node->cached_dirty ||
+	    (node->cached_blkno < blkno) ||
+	    ((blkno + blkcnt) <= node->cached_blkno)) {
+		return VMM_OK;
+	}
+
+	rc = ext4fs_devwrite(ctrl, node->cached_blkno,
+			     0, ctrl->block_size,
+			     (char *)node->cached_block);
+	if (rc) {
+		return rc;
+	}
+	node->cached_dirty = FALSE;
+
+	return VMM_OK;
+}
+
 int ext4fs_node_read_blk(struct ext4fs_node *node,
 			 u32 blkno, u32 blkoff, u32 blklen, char *buf)
 {
@@ -117,6 +157,13 @@ int ext4fs_node_write_blk(struct ext4fs_node *node,
 		return VMM_OK;
 	}
 
+	/* Drop readahead buffer if it has old copy of this block */
+	if (node->ra_blkcnt &&
+	    (node->ra_blkno <= blkno) &&
+	    (blkno < (node->ra_blkno + node->ra_blkcnt))) {
+		ext4fs_node_ra_invalidate(node);
+	}
+
 	if (!node->cached_block) {
 		node->cached_block = vmm_zalloc(ctrl->block_size);
 		if (!node->cached_block) {
@@ -141,8 +188,8 @@ int ext4fs_node_write_blk(struct ext4fs_node *node,
 			if (rc) {
 				return rc;
 			}
-			node->cached_blkno = blkno;
 		}
+		node->cached_blkno = blkno;
 	}
 
 	memcpy(&node->cached_block[blkoff], buf, blklen);
@@ -292,6 +339,9 @@ int ext4fs_node_write_blkno(struct ext4fs_node *node, u32 blkpos, u32 blkno)
 	struct ext2_inode *inode = &node->inode;
 	struct ext4fs_control *ctrl = node->ctrl;
 
+	/* Block map is changing so drop cached block runs */
+	ext4fs_node_extent_invalidate(node);
+
 	if (blkpos < ctrl->dir_blklast) {
 		/* Direct blocks.  */
 		inode->b.blocks.dir_blocks[blkpos] = __le32(blkno);
@@ -382,14 +432,172 @@ int ext4fs_node_write_blkno(struct ext4fs_node *node, u32 blkpos, u32 blkno)
 	return VMM_OK;
 }
 
+/* Map file block to device block and also find count of blocks
+ * from there which are contiguous on device (or part of same hole)
+ */
+static int ext4fs_node_map_blkno(struct ext4fs_node *node, u32 blkpos,
+				 u32 *blkno, u32 *blkcnt)
+{
+	int rc, idx;
+	u32 b, cnt, maxcnt;
+	struct ext4fs_extent *e;
+	struct ext4fs_control *ctrl = node->ctrl;
+
+	/* Try to find in block map cache */
+	for (idx = 0; idx < EXT4_NODE_EXTENT_SIZE; idx++) {
+		e = &node->extent[idx];
+		if (e->blkcnt &&
+		    (e->blkpos <= blkpos) &&
+		    (blkpos < (e->blkpos + e->blkcnt))) {
+			*blkno = (e->blkno) ?
+				 e->blkno + (blkpos - e->blkpos) : 0;
+			*blkcnt = e->blkcnt - (blkpos - e->blkpos);
+			return VMM_OK;
+		}
+	}
+
+	rc = ext4fs_node_read_blkno(node, blkpos, blkno);
+	if (rc) {
+		return rc;
+	}
+
+	/* Scan following blocks upto end of file
+	 * Note: div result < 32-bit
+	 */
+	maxcnt = udiv64(ext4fs_node_get_size(node) + ctrl->block_size - 1,
+			ctrl->block_size);
+	maxcnt = (blkpos < maxcnt) ? (maxcnt - blkpos) : 1;
+	if (maxcnt > EXT4_NODE_EXTENT_MAX_BLKS) {
+		maxcnt = EXT4_NODE_EXTENT_MAX_BLKS;
+	}
+	for (cnt = 1; cnt < maxcnt; cnt++) {
+		if (ext4fs_node_read_blkno(node, blkpos + cnt, &b)) {
+			break;
+		}
+		if ((*blkno) ? (b != (*blkno + cnt)) : (b != 0)) {
+			break;
+		}
+	}
+
+	/* Add block run to block map cache */
+	e = &node->extent[node->extent_victim];
+	node->extent_victim++;
+	if (node->extent_victim == EXT4_NODE_EXTENT_SIZE) {
+		node->extent_victim = 0;
+	}
+	e->blkpos = blkpos;
+	e->blkno = *blkno;
+	e->blkcnt = cnt;
+
+	*blkcnt = cnt;
+
+	return VMM_OK;
+}
+
+/* Read contiguous full blocks directly into buffer */
+static int ext4fs_node_read_run(struct ext4fs_node *node,
+				u32 blkno, u32 blkcnt, char *buf)
+{
+	int rc;
+	struct ext4fs_control *ctrl = node->ctrl;
+
+	if (!blkno) {
+		memset(buf, 0, blkcnt * ctrl->block_size);
+		return VMM_OK;
+	}
+
+	/* Device must have latest contents of cached block */
+	rc = ext4fs_node_flush_cached(node, blkno, blkcnt);
+	if (rc) {
+		return rc;
+	}
+
+	return ext4fs_devread(ctrl, blkno, 0, blkcnt * ctrl->block_size, buf);
+}
+
+/* Read part of a block through readahead buffer where blkcnt is
+ * count of blocks contiguous on device starting from blkno.
+ * The readahead window doubles on every sequential miss and is
+ * reset on random access.
+ */
+static int ext4fs_node_read_ra(struct ext4fs_node *node,
+			       u32 blkpos, u32 blkno, u32 blkcnt,
+			       u32 blkoff, u32 blklen, char *buf)
+{
+	int rc;
+	bool seq;
+	struct ext4fs_control *ctrl = node->ctrl;
+
+	seq = (blkpos == node->ra_next_blkpos) ||
+	      ((blkpos + 1) == node->ra_next_blkpos);
+	if ((blkoff + blklen) == ctrl->block_size) {
+		node->ra_next_blkpos = blkpos + 1;
+	} else {
+		node->ra_next_blkpos = blkpos;
+	}
+	if (!seq) {
+		node->ra_size = 0;
+	}
+
+	/* Holes and cached block don't need readahead */
+	if (!blkno ||
+	    (node->cached_block && (node->cached_blkno == blkno))) {
+		return ext4fs_node_read_blk(node, blkno, blkoff, blklen, buf);
+	}
+
+	if (!node->ra_blkcnt ||
+	    (blkno < node->ra_blkno) ||
+	    ((node->ra_blkno + node->ra_blkcnt) <= blkno)) {
+		if (!seq || (blkcnt < 2)) {
+			return ext4fs_node_read_blk(node, blkno,
+						    blkoff, blklen, buf);
+		}
+
+		if (!node->ra_block) {
+			node->ra_block = vmm_malloc(EXT4_NODE_RA_MAX_BLKS *
+						    ctrl->block_size);
+			if (!node->ra_block) {
+				return VMM_ENOMEM;
+			}
+		}
+
+		node->ra_size = (node->ra_size) ?
+				(node->ra_size * 2) : EXT4_NODE_RA_MIN_BLKS;
+		if (node->ra_size > EXT4_NODE_RA_MAX_BLKS) {
+			node->ra_size = EXT4_NODE_RA_MAX_BLKS;
+		}
+		if (blkcnt > node->ra_size) {
+			blkcnt = node->ra_size;
+		}
+
+		rc = ext4fs_node_flush_cached(node, blkno, blkcnt);
+		if (rc) {
+			return rc;
+		}
+
+		ext4fs_node_ra_invalidate(node);
+		rc = ext4fs_devread(ctrl, blkno, 0,
+				    blkcnt * ctrl->block_size,
+				    (char *)node->ra_block);
+		if (rc) {
+			return rc;
+		}
+		node->ra_blkno = blkno;
+		node->ra_blkcnt = blkcnt;
+	}
+
+	memcpy(buf, &node->ra_block[(blkno - node->ra_blkno) *
+				    ctrl->block_size + blkoff], blklen);
+
+	return VMM_OK;
+}
+
 /* Note: Node position has to be 64-bit */
 u32 ext4fs_node_read(struct ext4fs_node *node, u64 pos, u32 len, char *buf)
 {
 	int rc;
 	u64 filesize = ext4fs_node_get_size(node);
-	u32 i, rlen, blkno, blkoff, blklen;
-	u32 last_blkpos, last_blklen;
-	u32 first_blkpos, first_blkoff, first_blklen;
+	u32 rlen, blkpos, blkno, blkcnt, blkoff, blklen;
 	struct ext4fs_control *ctrl = node->ctrl;
 
 	if (filesize <= pos) {
@@ -400,48 +608,51 @@ u32 ext4fs_node_read(struct ext4fs_node *node, u64 pos, u32 len, char *buf)
 	}
 
 	/* Note: div result < 32-bit */
-	first_blkpos = udiv64(pos, ctrl->block_size); 
-	first_blkoff = pos - (first_blkpos * ctrl->block_size);
-	first_blklen = ctrl->block_size - first_blkoff;
-	if (len < first_blklen) {
-		first_blklen = len;
-	}
-
-	/* Note: div result < 32-bit */
-	last_blkpos = udiv64((len + pos), ctrl->block_size); 
-	last_blklen = (len + pos) - (last_blkpos * ctrl->block_size);
+	blkpos = udiv64(pos, ctrl->block_size);
+	blkoff = pos - ((u64)blkpos * ctrl->block_size);
 
 	rlen = len;
-	i = first_blkpos;
 	while (rlen) {
-		rc = ext4fs_node_read_blkno(node, i, &blkno);
+		rc = ext4fs_node_map_blkno(node, blkpos, &blkno, &blkcnt);
 		if (rc) {
 			goto done;
 		}
 
-		if (i == first_blkpos) {
-			/* First block.  */
-			blkoff = first_blkoff;
-			blklen = first_blklen;
-		} else if (i == last_blkpos) {
-			/* Last block.  */
-			blkoff = 0;
-			blklen = last_blklen;
+		if (!blkoff && (blkcnt > 1) &&
+		    ((2 * ctrl->block_size) <= rlen)) {
+			/* Many full blocks contiguous on device */
+			blklen = udiv32(rlen, ctrl->block_size);
+			if (blklen < blkcnt) {
+				blkcnt = blklen;
+			}
+			blklen = blkcnt * ctrl->block_size;
+
+			rc = ext4fs_node_read_run(node, blkno, blkcnt, buf);
+			if (rc) {
+				goto done;
+			}
+
+			node->ra_next_blkpos = blkpos + blkcnt;
+			blkpos += blkcnt;
 		} else {
-			/* Middle block. */
-			blkoff = 0;
-			blklen = ctrl->block_size;
-		}
+			/* Single full or partial block */
+			blklen = ctrl->block_size - blkoff;
+			if (rlen < blklen) {
+				blklen = rlen;
+			}
 
-		/* Read cached block */
-		rc = ext4fs_node_read_blk(node, blkno, blkoff, blklen, buf);
-		if (rc) {
-			goto done;
+			rc = ext4fs_node_read_ra(node, blkpos, blkno, blkcnt,
+						 blkoff, blklen, buf);
+			if (rc) {
+				goto done;
+			}
+
+			blkpos++;
 		}
 
 		buf += blklen;
 		rlen -= blklen;
-		i++;
+		blkoff = 0;
 	}
 
 done:
@@ -610,6 +821,9 @@ int ext4fs_node_truncate(struct ext4fs_node *node, u64 pos)
 
 	/* FIXME: Free indirect & double indirect blocks */
 
+	/* Freed blocks may get reused so drop readahead buffer */
+	ext4fs_node_ra_invalidate(node);
+
 	if (pos != filesize) {
 		/* Update node mtime */
 		node->inode.mtime = __le32(ext4fs_current_timestamp());
@@ -651,6 +865,14 @@ int ext4fs_node_load(struct ext4fs_control *ctrl,
 	node->dindir2_blkno = 0;
 	node->dindir2_dirty = FALSE;
 
+	ext4fs_node_extent_invalidate(node);
+
+	node->ra_block = NULL;
+	node->ra_blkno = 0;
+	node->ra_blkcnt = 0;
+	node->ra_size = 0;
+	node->ra_next_blkpos = 0;
+
 	return VMM_OK;
 }
 
@@ -677,6 +899,14 @@ int ext4fs_node_init(struct ext4fs_node *node)
 	node->dindir2_blkno = 0;
 	node->dindir2_dirty = FALSE;
 
+	ext4fs_node_extent_invalidate(node);
+
+	node->ra_block = NULL;
+	node->ra_blkno = 0;
+	node->ra_blkcnt = 0;
+	node->ra_size = 0;
+	node->ra_next_blkpos = 0;
+
 	node->lookup_victim = 0;
 	for (idx = 0; idx < EXT4_NODE_LOOKUP_SIZE; idx++) {
 		node->lookup_name[idx][0] = '\0';
@@ -703,6 +933,10 @@ int ext4fs_node_exit(struct ext4fs_node *node)
 		vmm_free(node->dindir2_block);
 	}
 
+	if (node->ra_block) {
+		vmm_free(node->ra_block);
+	}
+
 	return VMM_OK;
 }
 
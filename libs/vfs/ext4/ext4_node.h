@@ -29,6 +29,23 @@
 
 #define EXT4_NODE_LOOKUP_SIZE		4
 
+/* Number of cached block runs per node and max blocks in one run */
+#define EXT4_NODE_EXTENT_SIZE		8
+#define EXT4_NODE_EXTENT_MAX_BLKS	1024
+
+/* Min and max readahead window (in blocks) for sequential reads */
+#define EXT4_NODE_RA_MIN_BLKS		4
+#define EXT4_NODE_RA_MAX_BLKS		32
+
+/* Run of contiguous file blocks mapped to contiguous device blocks
+ * (or to a hole when blkno is zero).
+ */
+struct ext4fs_extent {
+	u32 blkpos;
+	u32 blkno;
+	u32 blkcnt;
+};
+
 /* Information for accessing a ext4fs file/directory. */
 struct ext4fs_node {
 	/* Parent ext4fs control */
@@ -67,6 +84,21 @@ struct ext4fs_node {
 	u32 dindir2_blkno;
 	bool dindir2_dirty;
 
+	/* Block map cache
+	 * Must be invalidated whenever block map is updated
+	 */
+	u32 extent_victim;
+	struct ext4fs_extent extent[EXT4_NODE_EXTENT_SIZE];
+
+	/* Readahead buffer
+	 * Allocated on demand. Must be freed in vput()
+	 */
+	u8 *ra_block;
+	u32 ra_blkno;
+	u32 ra_blkcnt;
+	u32 ra_size;
+	u32 ra_next_blkpos;
+
 	/* Child directory entry lookup table */
 	u32 lookup_victim;
 	char lookup_name[EXT4_NODE_LOOKUP_SIZE][VFS_MAX_NAME];
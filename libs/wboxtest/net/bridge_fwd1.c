@@ -0,0 +1,331 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file bridge_fwd1.c
+ * @author agent (agent@local)
+ * @brief bridge_fwd1 test implementation
+ *
+ * This test measures forwarding rate of the bridge netswitch used by
+ * netstack for different number of learned MAC addresses. We attach
+ * a TX netport and an RX netport to the bridge. The RX netport first
+ * announces its MAC address so that bridge learns it and then the TX
+ * netport sends minimum sized frames to RX netport with source MAC
+ * address cycling over a given number of addresses. Every frame does
+ * one MAC table learn and one MAC table lookup in the bridge.
+ *
+ * Table sizes beyond bridge MAC table capacity are included to show
+ * the cost of replacing entries (frames are flooded when RX netport
+ * MAC address gets replaced).
+ */
+
+#include <vmm_error.h>
+#include <vmm_stdio.h>
+#include <vmm_timer.h>
+#include <vmm_scheduler.h>
+#include <vmm_modules.h>
+#include <arch_atomic.h>
+#include <net/vmm_protocol.h>
+#include <net/vmm_mbuf.h>
+#include <net/vmm_netport.h>
+#include <net/vmm_netswitch.h>
+#include <libs/mathlib.h>
+#include <libs/stringlib.h>
+#include <libs/netstack.h>
+#include <libs/wboxtest.h>
+
+#define MODULE_DESC			"bridge_fwd1 test"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		(WBOXTEST_IPRIORITY+1)
+#define MODULE_INIT			bridge_fwd1_init
+#define MODULE_EXIT			bridge_fwd1_exit
+
+/* Frames sent for each MAC table size */
+#define BRIDGE_FWD1_FRAMES		65536
+
+/* Minimum ethernet frame length (without FCS) */
+#define BRIDGE_FWD1_FRAME_LEN		60
+
+/* Local experimental ethertype used for test frames */
+#define BRIDGE_FWD1_ETH_P_TEST		0x88B5
+
+/* Maximum frames in-flight so that TX netport xfers never run out */
+#define BRIDGE_FWD1_WINDOW		(VMM_NETPORT_DEF_QUEUE_SIZE / 2)
+
+/* Timeout for each MAC table size */
+#define BRIDGE_FWD1_TIMEOUT_NSECS	60000000000ULL
+
+/* Number of source MAC addresses for each run */
+static const u32 bridge_fwd1_sizes[] = { 1, 16, 256, 1024, 4096 };
+
+/* Broadcast MAC address */
+static const u8 bridge_fwd1_bcast[6] = {
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+};
+
+/* Global data */
+static struct vmm_netport *txp;
+static struct vmm_netport *rxp;
+static atomic_t rx_frames;
+
+static void bridge_fwd1_link_changed(struct vmm_netport *port)
+{
+	/* Nothing to do here. */
+}
+
+static int bridge_fwd1_can_receive(struct vmm_netport *port)
+{
+	return TRUE;
+}
+
+static int bridge_fwd1_tx_xfer(struct vmm_netport *port,
+			       struct vmm_mbuf *mbuf)
+{
+	/* Drop everything flooded to TX netport */
+	m_freem(mbuf);
+
+	return VMM_OK;
+}
+
+static int bridge_fwd1_rx_xfer(struct vmm_netport *port,
+			       struct vmm_mbuf *mbuf)
+{
+	u8 *frame = mtod(mbuf, u8 *);
+
+	if ((ETHER_HLEN <= mbuf->m_len) &&
+	    (ether_type(frame) == BRIDGE_FWD1_ETH_P_TEST) &&
+	    !compare_ether_addr(ether_dstmac(frame), port->macaddr)) {
+		arch_atomic_inc(&rx_frames);
+	}
+	m_freem(mbuf);
+
+	return VMM_OK;
+}
+
+static int bridge_fwd1_send(struct vmm_netport *port,
+			    const u8 *dstmac, const u8 *srcmac)
+{
+	u8 *frame;
+	struct vmm_mbuf *m;
+
+	MGETHDR(m, 0, 0);
+	if (!m) {
+		return VMM_ENOMEM;
+	}
+	MEXTMALLOC(m, BRIDGE_FWD1_FRAME_LEN, 0);
+	if (!m->m_extbuf) {
+		m_freem(m);
+		return VMM_ENOMEM;
+	}
+	m->m_len = m->m_pktlen = BRIDGE_FWD1_FRAME_LEN;
+
+	frame = mtod(m, u8 *);
+	memset(frame, 0, BRIDGE_FWD1_FRAME_LEN);
+	memcpy(ether_dstmac(frame), dstmac, 6);
+	memcpy(ether_srcmac(frame), srcmac, 6);
+	((struct eth_header *)frame)->ethertype =
+			vmm_cpu_to_be16(BRIDGE_FWD1_ETH_P_TEST);
+
+	return vmm_port2switch_xfer_mbuf(port, m);
+}
+
+static int bridge_fwd1_find_port(struct vmm_netport *port, void *data)
+{
+	struct vmm_netport **found = data;
+	u8 hwaddr[6];
+
+	netstack_get_hwaddr(hwaddr);
+	if (!memcmp(port->macaddr, hwaddr, 6)) {
+		*found = port;
+		return 1;
+	}
+
+	return VMM_OK;
+}
+
+static struct vmm_netport *bridge_fwd1_port_create(const char *name,
+			int (*xfer)(struct vmm_netport *, struct vmm_mbuf *),
+			struct vmm_netswitch *nsw)
+{
+	struct vmm_netport *port;
+
+	port = vmm_netport_alloc((char *)name, VMM_NETPORT_DEF_QUEUE_SIZE);
+	if (!port) {
+		return NULL;
+	}
+	port->mtu = 1500;
+	random_ether_addr(port->macaddr);
+	port->link_changed = bridge_fwd1_link_changed;
+	port->can_receive = bridge_fwd1_can_receive;
+	port->switch2port_xfer = xfer;
+
+	if (vmm_netport_register(port)) {
+		goto fail_free;
+	}
+
+	if (vmm_netswitch_port_add(nsw, port)) {
+		goto fail_unreg;
+	}
+
+	return port;
+
+fail_unreg:
+	vmm_netport_unregister(port);
+fail_free:
+	vmm_netport_free(port);
+	return NULL;
+}
+
+static void bridge_fwd1_port_destroy(struct vmm_netport *port)
+{
+	vmm_netswitch_port_remove(port);
+	vmm_netport_unregister(port);
+	vmm_netport_free(port);
+}
+
+static int bridge_fwd1_do_size(struct vmm_chardev *cdev, u32 size)
+{
+	int rc;
+	u8 srcmac[6];
+	u32 i, idx, sent = 0;
+	u64 tstamp, tout;
+
+	/* Make bridge learn MAC address of RX netport */
+	rc = bridge_fwd1_send(rxp, bridge_fwd1_bcast, rxp->macaddr);
+	if (rc) {
+		return rc;
+	}
+
+	/* Locally administered source MAC addresses */
+	srcmac[0] = 0x02;
+	srcmac[1] = 0x62;
+	srcmac[2] = 0x66;
+
+	arch_atomic_write(&rx_frames, 0);
+	tstamp = vmm_timer_timestamp();
+	tout = tstamp + BRIDGE_FWD1_TIMEOUT_NSECS;
+	while (sent < BRIDGE_FWD1_FRAMES) {
+		while ((sent - (u32)arch_atomic_read(&rx_frames)) >=
+							BRIDGE_FWD1_WINDOW) {
+			if (tout < vmm_timer_timestamp()) {
+				return VMM_ETIMEDOUT;
+			}
+			vmm_scheduler_yield();
+		}
+
+		idx = sent % size;
+		srcmac[3] = (idx >> 16) & 0xff;
+		srcmac[4] = (idx >> 8) & 0xff;
+		srcmac[5] = idx & 0xff;
+		rc = bridge_fwd1_send(txp, rxp->macaddr, srcmac);
+		if (rc) {
+			return rc;
+		}
+		sent++;
+	}
+
+	/* Wait for remaining frames */
+	while ((u32)arch_atomic_read(&rx_frames) < sent) {
+		if (tout < vmm_timer_timestamp()) {
+			return VMM_ETIMEDOUT;
+		}
+		vmm_scheduler_yield();
+	}
+	tstamp = vmm_timer_timestamp() - tstamp;
+
+	i = udiv64((u64)sent * 1000000000ULL, (tstamp) ? tstamp : 1);
+	vmm_cprintf(cdev, "%s: %d macs: %d frames in %"PRIu64" ns "
+		    "(%d frames/s)\n", txp->nsw->name, size, sent, tstamp, i);
+
+	return VMM_OK;
+}
+
+static int bridge_fwd1_run(struct wboxtest *test, struct vmm_chardev *cdev,
+			   u32 test_hcpu)
+{
+	int ret = VMM_OK;
+	u32 i;
+	struct vmm_netport *port = NULL;
+
+	/* Find bridge used by netstack */
+	vmm_netport_iterate(NULL, &port, bridge_fwd1_find_port);
+	if (!port || !port->nsw) {
+		vmm_cprintf(cdev, "netstack netport not found\n");
+		return VMM_ENODEV;
+	}
+	if (!port->nsw->dev.parent ||
+	    !port->nsw->dev.parent->driver ||
+	    strcmp(port->nsw->dev.parent->driver->name, "bridge")) {
+		vmm_cprintf(cdev, "%s is not a bridge\n", port->nsw->name);
+		return VMM_ENODEV;
+	}
+
+	/* Create TX and RX netports */
+	txp = bridge_fwd1_port_create("bridge_fwd1-tx",
+				      bridge_fwd1_tx_xfer, port->nsw);
+	if (!txp) {
+		return VMM_ENOMEM;
+	}
+	rxp = bridge_fwd1_port_create("bridge_fwd1-rx",
+				      bridge_fwd1_rx_xfer, port->nsw);
+	if (!rxp) {
+		ret = VMM_ENOMEM;
+		goto destroy_txp;
+	}
+
+	/* Do the test for each MAC table size */
+	for (i = 0; i < array_size(bridge_fwd1_sizes); i++) {
+		ret = bridge_fwd1_do_size(cdev, bridge_fwd1_sizes[i]);
+		if (ret) {
+			vmm_cprintf(cdev, "%d macs: failed (error %d)\n",
+				    bridge_fwd1_sizes[i], ret);
+			break;
+		}
+	}
+
+	/* Destroy TX and RX netports */
+	bridge_fwd1_port_destroy(rxp);
+	rxp = NULL;
+destroy_txp:
+	bridge_fwd1_port_destroy(txp);
+	txp = NULL;
+
+	return ret;
+}
+
+static struct wboxtest bridge_fwd1 = {
+	.name = "bridge_fwd1",
+	.run = bridge_fwd1_run,
+};
+
+static int __init bridge_fwd1_init(void)
+{
+	return wboxtest_register("net", &bridge_fwd1);
+}
+
+static void __exit bridge_fwd1_exit(void)
+{
+	wboxtest_unregister(&bridge_fwd1);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+			MODULE_AUTHOR,
+			MODULE_LICENSE,
+			MODULE_IPRIORITY,
+			MODULE_INIT,
+			MODULE_EXIT);
@@ -0,0 +1,428 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file tcp_tput1.c
+ * @author agent (agent@local)
+ * @brief tcp_tput1 test implementation
+ *
+ * This test measures TCP throughput of netstack sockets through the
+ * netswitch. We attach a peer netport to the netswitch of netstack
+ * which answers ARP for an unused address of netstack subnet and sends
+ * back every IPv4 frame for this address with source and destination
+ * addresses swapped. A connection to the peer address from netstack
+ * therefore ends up on a local listening socket with both directions
+ * going through netport transmit, netswitch and netport receive path.
+ *
+ * A worker thread accepts the connection and receives data till we
+ * have sent TCP_TPUT1_TOTAL_BYTES.
+ */
+
+#include <vmm_error.h>
+#include <vmm_heap.h>
+#include <vmm_stdio.h>
+#include <vmm_timer.h>
+#include <vmm_scheduler.h>
+#include <vmm_threads.h>
+#include <vmm_completion.h>
+#include <vmm_modules.h>
+#include <net/vmm_protocol.h>
+#include <net/vmm_mbuf.h>
+#include <net/vmm_netport.h>
+#include <net/vmm_netswitch.h>
+#include <libs/mathlib.h>
+#include <libs/stringlib.h>
+#include <libs/netstack.h>
+#include <libs/wboxtest.h>
+
+#define MODULE_DESC			"tcp_tput1 test"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		(WBOXTEST_IPRIORITY+1)
+#define MODULE_INIT			tcp_tput1_init
+#define MODULE_EXIT			tcp_tput1_exit
+
+/* TCP port used by the test */
+#define TCP_TPUT1_PORT			5001
+
+/* Size of each write */
+#define TCP_TPUT1_CHUNK_SIZE		1024
+
+/* Total bytes to transfer */
+#define TCP_TPUT1_TOTAL_BYTES		(4 * 1024 * 1024)
+
+/* Timeout in milliseconds for receive and for whole test */
+#define TCP_TPUT1_RECV_TIMEOUT_MSECS	5000
+#define TCP_TPUT1_TIMEOUT_NSECS		60000000000ULL
+
+/* Ethernet frame types and ARP operations handled by peer port */
+#define TCP_TPUT1_ETH_P_IP		0x0800
+#define TCP_TPUT1_ETH_P_ARP		0x0806
+#define TCP_TPUT1_ARP_REQUEST		1
+#define TCP_TPUT1_ARP_REPLY		2
+
+/* Largest frame sent back by peer port */
+#define TCP_TPUT1_MAX_FRAME_LEN		1518
+
+/* Global data */
+static struct vmm_netport *peer;
+static u8 peer_ipaddr[4];
+static struct vmm_thread *worker;
+static struct vmm_completion worker_ready;
+static struct vmm_completion worker_done;
+static u32 worker_bytes;
+static int worker_rc;
+
+static int tcp_tput1_worker_thread_main(void *data)
+{
+	int rc;
+	struct netstack_socket *sk, *csk = NULL;
+	struct netstack_socket_buf buf;
+
+	worker_bytes = 0;
+
+	sk = netstack_socket_alloc(NETSTACK_SOCKET_TCP);
+	if (!sk) {
+		rc = VMM_ENOMEM;
+		vmm_completion_complete(&worker_ready);
+		goto done;
+	}
+
+	rc = netstack_socket_bind(sk, NULL, TCP_TPUT1_PORT);
+	if (!rc) {
+		rc = netstack_socket_listen(sk);
+	}
+	vmm_completion_complete(&worker_ready);
+	if (rc) {
+		goto free_sk;
+	}
+
+	rc = netstack_socket_accept(sk, &csk);
+	if (rc) {
+		goto close_sk;
+	}
+
+	while (worker_bytes < TCP_TPUT1_TOTAL_BYTES) {
+		rc = netstack_socket_recv(csk, &buf,
+					  TCP_TPUT1_RECV_TIMEOUT_MSECS);
+		if (rc) {
+			break;
+		}
+		do {
+			worker_bytes += buf.len;
+		} while (netstack_socket_nextbuf(&buf) == VMM_OK);
+		netstack_socket_freebuf(&buf);
+	}
+
+	netstack_socket_close(csk);
+	netstack_socket_free(csk);
+close_sk:
+	netstack_socket_close(sk);
+free_sk:
+	netstack_socket_free(sk);
+done:
+	worker_rc = rc;
+	vmm_completion_complete(&worker_done);
+
+	return 0;
+}
+
+static void tcp_tput1_peer_link_changed(struct vmm_netport *port)
+{
+	/* Nothing to do here. */
+}
+
+static int tcp_tput1_peer_can_receive(struct vmm_netport *port)
+{
+	return TRUE;
+}
+
+static int tcp_tput1_peer_xfer(struct vmm_netport *port,
+			       struct vmm_mbuf *mbuf)
+{
+	u8 *frame, *arp, *ip;
+	struct vmm_mbuf *m;
+	u32 len = mbuf->m_pktlen;
+
+	if ((len < ETHER_HLEN) || (TCP_TPUT1_MAX_FRAME_LEN < len)) {
+		m_freem(mbuf);
+		return VMM_OK;
+	}
+
+	/* Reply in a new mbuf because received one may be shared */
+	MGETHDR(m, 0, 0);
+	MEXTMALLOC(m, len, 0);
+	m_copydata(mbuf, 0, len, M_BUFADDR(m));
+	m->m_len = m->m_pktlen = len;
+	m_freem(mbuf);
+
+	frame = mtod(m, u8 *);
+	switch (ether_type(frame)) {
+	case TCP_TPUT1_ETH_P_ARP:
+		arp = ether_payload(frame);
+		if ((len < (ETHER_HLEN + ARP_HLEN)) ||
+		    (arp_oper(arp) != TCP_TPUT1_ARP_REQUEST) ||
+		    memcmp(arp_tpa(arp), peer_ipaddr, 4)) {
+			goto drop;
+		}
+		((struct arp_header *)arp)->oper =
+				vmm_cpu_to_be16(TCP_TPUT1_ARP_REPLY);
+		memcpy(arp_tha(arp), arp_sha(arp), 6);
+		memcpy(arp_tpa(arp), arp_spa(arp), 4);
+		memcpy(arp_sha(arp), port->macaddr, 6);
+		memcpy(arp_spa(arp), peer_ipaddr, 4);
+		break;
+	case TCP_TPUT1_ETH_P_IP:
+		/* Swapping addresses keeps IP and TCP checksums valid */
+		ip = ether_payload(frame);
+		if ((len < (ETHER_HLEN + IP4_HLEN)) ||
+		    memcmp(ip_dstaddr(ip), peer_ipaddr, 4)) {
+			goto drop;
+		}
+		memcpy(ip_dstaddr(ip), ip_srcaddr(ip), 4);
+		memcpy(ip_srcaddr(ip), peer_ipaddr, 4);
+		break;
+	default:
+		goto drop;
+	};
+
+	memcpy(ether_dstmac(frame), ether_srcmac(frame), 6);
+	memcpy(ether_srcmac(frame), port->macaddr, 6);
+	vmm_port2switch_xfer_mbuf(port, m);
+
+	return VMM_OK;
+
+drop:
+	m_freem(m);
+	return VMM_OK;
+}
+
+static int tcp_tput1_find_port(struct vmm_netport *port, void *data)
+{
+	struct vmm_netport **found = data;
+	u8 hwaddr[6];
+
+	netstack_get_hwaddr(hwaddr);
+	if (!memcmp(port->macaddr, hwaddr, 6)) {
+		*found = port;
+		return 1;
+	}
+
+	return VMM_OK;
+}
+
+static int tcp_tput1_peer_create(struct vmm_chardev *cdev)
+{
+	int rc;
+	u32 i;
+	u8 ipaddr[4], ipmask[4];
+	struct vmm_netport *port = NULL;
+
+	/* Find netswitch used by netstack */
+	vmm_netport_iterate(NULL, &port, tcp_tput1_find_port);
+	if (!port || !port->nsw) {
+		vmm_cprintf(cdev, "netstack netport not found\n");
+		return VMM_ENODEV;
+	}
+
+	/* Use last unicast address of netstack subnet
+	 * (or one before if it belongs to netstack)
+	 */
+	netstack_get_ipaddr(ipaddr);
+	netstack_get_ipmask(ipmask);
+	for (i = 0; i < 4; i++) {
+		peer_ipaddr[i] = (ipaddr[i] & ipmask[i]) | ~ipmask[i];
+	}
+	peer_ipaddr[3]--;
+	if (!memcmp(peer_ipaddr, ipaddr, 4)) {
+		peer_ipaddr[3]--;
+	}
+
+	peer = vmm_netport_alloc("tcp_tput1-peer",
+				 VMM_NETPORT_DEF_QUEUE_SIZE);
+	if (!peer) {
+		return VMM_ENOMEM;
+	}
+	peer->mtu = 1500;
+	random_ether_addr(peer->macaddr);
+	peer->link_changed = tcp_tput1_peer_link_changed;
+	peer->can_receive = tcp_tput1_peer_can_receive;
+	peer->switch2port_xfer = tcp_tput1_peer_xfer;
+
+	rc = vmm_netport_register(peer);
+	if (rc) {
+		goto fail_free;
+	}
+
+	rc = vmm_netswitch_port_add(port->nsw, peer);
+	if (rc) {
+		goto fail_unreg;
+	}
+
+	return VMM_OK;
+
+fail_unreg:
+	vmm_netport_unregister(peer);
+fail_free:
+	vmm_netport_free(peer);
+	peer = NULL;
+	return rc;
+}
+
+static void tcp_tput1_peer_destroy(void)
+{
+	vmm_netswitch_port_remove(peer);
+	vmm_netport_unregister(peer);
+	vmm_netport_free(peer);
+	peer = NULL;
+}
+
+static int tcp_tput1_do_test(struct vmm_chardev *cdev)
+{
+	int rc;
+	u8 *data;
+	u32 i, sent = 0;
+	u64 tstamp, timeout = TCP_TPUT1_TIMEOUT_NSECS;
+	struct netstack_socket *sk;
+
+	data = vmm_malloc(TCP_TPUT1_CHUNK_SIZE);
+	if (!data) {
+		return VMM_ENOMEM;
+	}
+	for (i = 0; i < TCP_TPUT1_CHUNK_SIZE; i++) {
+		data[i] = i & 0xff;
+	}
+
+	/* Start worker and wait for it to listen */
+	vmm_threads_start(worker);
+	vmm_completion_wait(&worker_ready);
+
+	sk = netstack_socket_alloc(NETSTACK_SOCKET_TCP);
+	if (!sk) {
+		rc = VMM_ENOMEM;
+		goto free_data;
+	}
+
+	rc = netstack_socket_connect(sk, peer_ipaddr, TCP_TPUT1_PORT);
+	if (rc) {
+		vmm_cprintf(cdev, "connect failed (error %d)\n", rc);
+		goto free_sk;
+	}
+
+	tstamp = vmm_timer_timestamp();
+	while (sent < TCP_TPUT1_TOTAL_BYTES) {
+		rc = netstack_socket_write(sk, data, TCP_TPUT1_CHUNK_SIZE);
+		if (rc) {
+			vmm_cprintf(cdev, "write failed (error %d)\n", rc);
+			break;
+		}
+		sent += TCP_TPUT1_CHUNK_SIZE;
+	}
+
+	/* Wait for worker to receive everything */
+	vmm_completion_wait_timeout(&worker_done, &timeout);
+	tstamp = vmm_timer_timestamp() - tstamp;
+
+	if (!rc) {
+		rc = worker_rc;
+	}
+	if (!rc && (worker_bytes != sent)) {
+		vmm_cprintf(cdev, "sent %d bytes but received %d bytes\n",
+			    sent, worker_bytes);
+		rc = VMM_EFAIL;
+	}
+	if (!rc) {
+		vmm_cprintf(cdev, "%s: sent %d bytes in %"PRIu64" ns "
+			    "(%"PRIu64" KB/s)\n", netstack_get_name(), sent,
+			    tstamp, udiv64((u64)sent * 1000000000ULL,
+					   (tstamp) ? tstamp : 1) / 1024);
+	}
+
+	netstack_socket_disconnect(sk);
+	netstack_socket_close(sk);
+free_sk:
+	netstack_socket_free(sk);
+free_data:
+	vmm_free(data);
+
+	return rc;
+}
+
+static int tcp_tput1_run(struct wboxtest *test, struct vmm_chardev *cdev,
+			 u32 test_hcpu)
+{
+	int ret;
+	u8 current_priority = vmm_scheduler_current_priority();
+
+	/* Initialise global data */
+	INIT_COMPLETION(&worker_ready);
+	INIT_COMPLETION(&worker_done);
+	worker_bytes = 0;
+	worker_rc = VMM_OK;
+
+	/* Create worker thread */
+	worker = vmm_threads_create("tcp_tput1_worker",
+				    tcp_tput1_worker_thread_main,
+				    NULL, current_priority,
+				    VMM_THREAD_DEF_TIME_SLICE);
+	if (!worker) {
+		return VMM_EFAIL;
+	}
+	vmm_threads_set_affinity(worker, vmm_cpumask_of(test_hcpu));
+
+	/* Create peer netport */
+	ret = tcp_tput1_peer_create(cdev);
+	if (ret) {
+		goto destroy_worker;
+	}
+
+	/* Do the test */
+	ret = tcp_tput1_do_test(cdev);
+
+	/* Destroy peer netport */
+	tcp_tput1_peer_destroy();
+
+destroy_worker:
+	/* Destroy worker thread */
+	vmm_threads_stop(worker);
+	vmm_threads_destroy(worker);
+	worker = NULL;
+
+	return ret;
+}
+
+static struct wboxtest tcp_tput1 = {
+	.name = "tcp_tput1",
+	.run = tcp_tput1_run,
+};
+
+static int __init tcp_tput1_init(void)
+{
+	return wboxtest_register("net", &tcp_tput1);
+}
+
+static void __exit tcp_tput1_exit(void)
+{
+	wboxtest_unregister(&tcp_tput1);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+			MODULE_AUTHOR,
+			MODULE_LICENSE,
+			MODULE_IPRIORITY,
+			MODULE_INIT,
+			MODULE_EXIT);
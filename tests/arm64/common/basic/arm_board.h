@@ -60,4 +60,9 @@ void arm_board_serial_putc(char ch);
 bool arm_board_serial_can_getc(void);
 char arm_board_serial_getc(void);
 
+virtual_addr_t arm_board_shmdb_base(void);
+virtual_addr_t arm_board_shmdb_mem_base(void);
+virtual_size_t arm_board_shmdb_mem_size(void);
+u32 arm_board_shmdb_irq(void);
+
 #endif
@@ -30,6 +30,7 @@
 #include <arm_string.h>
 #include <arm_stdio.h>
 #include <arm_board.h>
+#include <sys/shmdb.h>
 #include <dhry.h>
 #include <libfdt/libfdt.h>
 #include <libfdt/fdt_support.h>
@@ -124,6 +125,13 @@ void arm_cmd_help(int argc, char **argv)
 	arm_puts("            Usage: go <addr>\n");
 	arm_puts("            <addr>  = jump address in hex\n");
 	arm_puts("\n");
+	arm_puts("shmdb_test  - Shared memory doorbell ping-pong test\n");
+	arm_puts("            Usage: shmdb_test <pong|ping> [<count>] [<size>]\n");
+	arm_puts("            <pong>   = echo messages of ping peer\n");
+	arm_puts("            <ping>   = measure latency and throughput\n");
+	arm_puts("            <count>  = number of messages (default 1000)\n");
+	arm_puts("            <size>   = message size in bytes (default 64)\n");
+	arm_puts("\n");
 	arm_puts("reset       - Reset the system\n");
 	arm_puts("\n");
 }
@@ -717,6 +725,252 @@ void arm_cmd_reset(int argc, char **argv)
 	while (1);
 }
 
+#define SHMDB_TEST_RING_OFFSET(n)	((n) * 0x10000)
+#define SHMDB_TEST_RING_NUM		32
+#define SHMDB_TEST_SLOT_SIZE		1024
+#define SHMDB_TEST_SPIN_COUNT		256
+#define SHMDB_TEST_FLAG_ECHO		0x1
+#define SHMDB_TEST_FLAG_STOP		0x2
+
+static volatile u32 shmdb_test_irq_count;
+
+static int shmdb_test_irq_handler(u32 irq_no, struct pt_regs *regs)
+{
+	virtual_addr_t base = arm_board_shmdb_base();
+
+	shmdb_int_clear(base, shmdb_int_status(base));
+	shmdb_test_irq_count++;
+
+	return 0;
+}
+
+static u32 shmdb_test_peer(virtual_addr_t base)
+{
+	u32 i, mask;
+
+	mask = shmdb_peer_mask(base) & ~(1U << shmdb_peer_id(base));
+	for (i = 0; i < SHMDB_MAX_PEERS; i++) {
+		if (mask & (1U << i)) {
+			return i;
+		}
+	}
+
+	return SHMDB_MAX_PEERS;
+}
+
+static void shmdb_test_kick(virtual_addr_t base)
+{
+	u32 peer = shmdb_test_peer(base);
+
+	if (peer < SHMDB_MAX_PEERS) {
+		shmdb_doorbell(base, peer, 0);
+	}
+}
+
+/* Spin for a while and then sleep till doorbell (or timer) interrupt */
+static struct shmdb_ring_slot *shmdb_test_cons_wait(struct shmdb_ring *r)
+{
+	u32 spin = 0;
+	struct shmdb_ring_slot *slot;
+
+	while (!(slot = shmdb_ring_cons_slot(r))) {
+		if (spin++ < SHMDB_TEST_SPIN_COUNT) {
+			continue;
+		}
+		arm_irq_disable();
+		if (shmdb_ring_cons_wait_begin(r)) {
+			arm_irq_wfi();
+		}
+		shmdb_ring_cons_wait_end(r);
+		arm_irq_enable();
+	}
+
+	return slot;
+}
+
+static struct shmdb_ring_slot *shmdb_test_prod_wait(struct shmdb_ring *r)
+{
+	u32 spin = 0;
+	struct shmdb_ring_slot *slot;
+
+	while (!(slot = shmdb_ring_prod_slot(r))) {
+		if (spin++ < SHMDB_TEST_SPIN_COUNT) {
+			continue;
+		}
+		arm_irq_disable();
+		if (shmdb_ring_prod_wait_begin(r)) {
+			arm_irq_wfi();
+		}
+		shmdb_ring_prod_wait_end(r);
+		arm_irq_enable();
+	}
+
+	return slot;
+}
+
+static void shmdb_test_pong(virtual_addr_t base,
+			    struct shmdb_ring *rx, struct shmdb_ring *tx)
+{
+	u32 len, flags, count = 0;
+	struct shmdb_ring_slot *rslot, *tslot;
+
+	shmdb_ring_init(rx, SHMDB_TEST_RING_NUM, SHMDB_TEST_SLOT_SIZE);
+	shmdb_ring_init(tx, SHMDB_TEST_RING_NUM, SHMDB_TEST_SLOT_SIZE);
+
+	arm_printf("shmdb_test: peer %d waiting for ping\n",
+		   shmdb_peer_id(base));
+
+	do {
+		rslot = shmdb_test_cons_wait(rx);
+		len = rslot->len;
+		flags = rslot->flags;
+		if (flags & SHMDB_TEST_FLAG_ECHO) {
+			tslot = shmdb_test_prod_wait(tx);
+			arm_memcpy(tslot + 1, rslot + 1, len);
+			tslot->len = len;
+			tslot->flags = flags;
+			if (shmdb_ring_produce(tx)) {
+				shmdb_test_kick(base);
+			}
+		}
+		if (shmdb_ring_consume(rx)) {
+			shmdb_test_kick(base);
+		}
+		count++;
+	} while (!(flags & SHMDB_TEST_FLAG_STOP));
+
+	arm_printf("shmdb_test: received %d messages\n", count);
+}
+
+static void shmdb_test_send(virtual_addr_t base, struct shmdb_ring *tx,
+			    const u8 *buf, u32 len, u32 flags)
+{
+	struct shmdb_ring_slot *slot = shmdb_test_prod_wait(tx);
+
+	arm_memcpy(slot + 1, buf, len);
+	slot->len = len;
+	slot->flags = flags;
+	if (shmdb_ring_produce(tx)) {
+		shmdb_test_kick(base);
+	}
+}
+
+static bool shmdb_test_recv(virtual_addr_t base, struct shmdb_ring *rx,
+			    u32 len)
+{
+	bool ret;
+	struct shmdb_ring_slot *slot = shmdb_test_cons_wait(rx);
+
+	ret = (slot->len == len) ? TRUE : FALSE;
+	if (shmdb_ring_consume(rx)) {
+		shmdb_test_kick(base);
+	}
+
+	return ret;
+}
+
+static void shmdb_test_ping(virtual_addr_t base,
+			    struct shmdb_ring *rx, struct shmdb_ring *tx,
+			    u32 count, u32 len)
+{
+	u32 i, irqs;
+	u64 t, tmin = ~0ULL, tmax = 0, tsum = 0, tstamp;
+	static u8 buf[SHMDB_TEST_SLOT_SIZE];
+
+	if (!shmdb_ring_ready(rx) || !shmdb_ring_ready(tx)) {
+		arm_puts("shmdb_test: rings not ready (start pong first)\n");
+		return;
+	}
+
+	for (i = 0; i < len; i++) {
+		buf[i] = i & 0xff;
+	}
+
+	/* Round-trip latency */
+	irqs = shmdb_test_irq_count;
+	for (i = 0; i < count; i++) {
+		tstamp = arm_board_timer_timestamp();
+		shmdb_test_send(base, tx, buf, len, SHMDB_TEST_FLAG_ECHO);
+		if (!shmdb_test_recv(base, rx, len)) {
+			arm_printf("shmdb_test: bad echo for message %d\n", i);
+			return;
+		}
+		t = arm_board_timer_timestamp() - tstamp;
+		tmin = (t < tmin) ? t : tmin;
+		tmax = (t > tmax) ? t : tmax;
+		tsum += t;
+	}
+	arm_printf("shmdb_test: round-trip min=%llu avg=%llu max=%llu nsecs "
+		   "(%d doorbell irqs)\n", tmin, arm_udiv64(tsum, count),
+		   tmax, shmdb_test_irq_count - irqs);
+
+	/* Streaming throughput (only last message is echoed) */
+	irqs = shmdb_test_irq_count;
+	tstamp = arm_board_timer_timestamp();
+	for (i = 0; i < count; i++) {
+		shmdb_test_send(base, tx, buf, len,
+			(i == (count - 1)) ? SHMDB_TEST_FLAG_ECHO : 0);
+	}
+	shmdb_test_recv(base, rx, len);
+	t = arm_board_timer_timestamp() - tstamp;
+	arm_printf("shmdb_test: streamed %d x %d bytes in %llu nsecs "
+		   "(%llu KB/s, %d doorbell irqs)\n", count, len, t,
+		   arm_udiv64((u64)count * len * 1000000ULL, t ? t : 1),
+		   shmdb_test_irq_count - irqs);
+
+	shmdb_test_send(base, tx, buf, 0, SHMDB_TEST_FLAG_STOP);
+}
+
+void arm_cmd_shmdb_test(int argc, char **argv)
+{
+	u32 count = 1000, len = 64;
+	virtual_addr_t base = arm_board_shmdb_base();
+	virtual_addr_t shm = arm_board_shmdb_mem_base();
+	struct shmdb_ring *ping2pong, *pong2ping;
+
+	if ((argc < 2) || (argc > 4)) {
+		arm_puts("shmdb_test: must provide <pong|ping>\n");
+		return;
+	}
+	if (argc > 2) {
+		count = arm_str2int(argv[2]);
+	}
+	if (argc > 3) {
+		len = arm_str2int(argv[3]);
+	}
+	if (!count ||
+	    ((SHMDB_TEST_SLOT_SIZE - sizeof(struct shmdb_ring_slot)) < len)) {
+		arm_puts("shmdb_test: invalid <count> or <size>\n");
+		return;
+	}
+
+	if (shmdb_magic(base) != SHMDB_MAGIC_VALUE) {
+		arm_puts("shmdb_test: doorbell device not found\n");
+		return;
+	}
+	if ((shmdb_shm_size(base) < SHMDB_TEST_RING_OFFSET(2)) ||
+	    (arm_board_shmdb_mem_size() < SHMDB_TEST_RING_OFFSET(2))) {
+		arm_puts("shmdb_test: shared memory too small\n");
+		return;
+	}
+
+	ping2pong = (struct shmdb_ring *)(shm + SHMDB_TEST_RING_OFFSET(0));
+	pong2ping = (struct shmdb_ring *)(shm + SHMDB_TEST_RING_OFFSET(1));
+
+	arm_irq_register(arm_board_shmdb_irq(), shmdb_test_irq_handler);
+	shmdb_int_mask(base, 0x1);
+
+	if (arm_strcmp(argv[1], "pong") == 0) {
+		shmdb_test_pong(base, ping2pong, pong2ping);
+	} else if (arm_strcmp(argv[1], "ping") == 0) {
+		shmdb_test_ping(base, pong2ping, ping2pong, count, len);
+	} else {
+		arm_puts("shmdb_test: unknown role\n");
+	}
+
+	shmdb_int_mask(base, 0x0);
+}
+
 #define ARM_MAX_ARG_SIZE	32
 
 void arm_exec(char *line)
@@ -786,6 +1040,8 @@ void arm_exec(char *line)
 			arm_cmd_autoexec(argc, argv);
 		} else if (arm_strcmp(argv[0], "go") == 0) {
 			arm_cmd_go(argc, argv);
+		} else if (arm_strcmp(argv[0], "shmdb_test") == 0) {
+			arm_cmd_shmdb_test(argc, argv);
 		} else if (arm_strcmp(argv[0], "reset") == 0) {
 			arm_cmd_reset(argc, argv);
 		} else {
@@ -0,0 +1,197 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file shmdb.c
+ * @author agent (agent@local)
+ * @brief Shared memory doorbell driver source
+ */
+
+#include <arm_io.h>
+#include <sys/shmdb.h>
+
+#define SHMDB_MAGIC_OFFSET		0x00
+#define SHMDB_VERSION_OFFSET		0x04
+#define SHMDB_PEER_ID_OFFSET		0x08
+#define SHMDB_PEER_MASK_OFFSET		0x0C
+#define SHMDB_SHM_SIZE_LO_OFFSET	0x10
+#define SHMDB_SHM_SIZE_HI_OFFSET	0x14
+#define SHMDB_INT_STATUS_OFFSET		0x18
+#define SHMDB_INT_MASK_OFFSET		0x1C
+#define SHMDB_DOORBELL_OFFSET		0x20
+
+#define shmdb_mb()		asm volatile("dmb ish":::"memory")
+#define shmdb_wmb()		asm volatile("dmb ishst":::"memory")
+#define shmdb_rmb()		asm volatile("dmb ishld":::"memory")
+
+#define SHMDB_READ_ONCE(x)	(*(volatile typeof(x) *)&(x))
+#define SHMDB_WRITE_ONCE(x, v)	(*(volatile typeof(x) *)&(x) = (v))
+
+u32 shmdb_magic(virtual_addr_t base)
+{
+	return arm_readl((void *)(base + SHMDB_MAGIC_OFFSET));
+}
+
+u32 shmdb_peer_id(virtual_addr_t base)
+{
+	return arm_readl((void *)(base + SHMDB_PEER_ID_OFFSET));
+}
+
+u32 shmdb_peer_mask(virtual_addr_t base)
+{
+	return arm_readl((void *)(base + SHMDB_PEER_MASK_OFFSET));
+}
+
+u64 shmdb_shm_size(virtual_addr_t base)
+{
+	u64 ret;
+
+	ret = arm_readl((void *)(base + SHMDB_SHM_SIZE_HI_OFFSET));
+	ret = (ret << 32) |
+		arm_readl((void *)(base + SHMDB_SHM_SIZE_LO_OFFSET));
+
+	return ret;
+}
+
+u32 shmdb_int_status(virtual_addr_t base)
+{
+	return arm_readl((void *)(base + SHMDB_INT_STATUS_OFFSET));
+}
+
+void shmdb_int_clear(virtual_addr_t base, u32 status)
+{
+	arm_writel(status, (void *)(base + SHMDB_INT_STATUS_OFFSET));
+}
+
+void shmdb_int_mask(virtual_addr_t base, u32 mask)
+{
+	arm_writel(mask, (void *)(base + SHMDB_INT_MASK_OFFSET));
+}
+
+void shmdb_doorbell(virtual_addr_t base, u32 peer, u32 vector)
+{
+	arm_writel((peer << 16) | (vector & 0x1F),
+		   (void *)(base + SHMDB_DOORBELL_OFFSET));
+}
+
+void shmdb_ring_init(struct shmdb_ring *r, u32 num, u32 slot_size)
+{
+	SHMDB_WRITE_ONCE(r->magic, 0x0);
+	shmdb_mb();
+
+	SHMDB_WRITE_ONCE(r->num, num);
+	SHMDB_WRITE_ONCE(r->slot_size, slot_size);
+	SHMDB_WRITE_ONCE(r->prod_idx, 0);
+	SHMDB_WRITE_ONCE(r->prod_wait, 0);
+	SHMDB_WRITE_ONCE(r->cons_idx, 0);
+	SHMDB_WRITE_ONCE(r->cons_wait, 0);
+
+	shmdb_wmb();
+	SHMDB_WRITE_ONCE(r->magic, SHMDB_RING_MAGIC);
+	shmdb_mb();
+}
+
+bool shmdb_ring_ready(struct shmdb_ring *r)
+{
+	if (SHMDB_READ_ONCE(r->magic) != SHMDB_RING_MAGIC) {
+		return FALSE;
+	}
+	shmdb_rmb();
+
+	return TRUE;
+}
+
+static inline struct shmdb_ring_slot *shmdb_ring_slot(struct shmdb_ring *r,
+						      u32 idx)
+{
+	return (struct shmdb_ring_slot *)((u8 *)r + sizeof(*r) +
+				(idx & (r->num - 1)) * r->slot_size);
+}
+
+struct shmdb_ring_slot *shmdb_ring_prod_slot(struct shmdb_ring *r)
+{
+	u32 prod = SHMDB_READ_ONCE(r->prod_idx);
+
+	if ((prod - SHMDB_READ_ONCE(r->cons_idx)) >= r->num) {
+		return NULL;
+	}
+
+	/* Don't write slot before seeing consumer release it */
+	shmdb_mb();
+
+	return shmdb_ring_slot(r, prod);
+}
+
+bool shmdb_ring_produce(struct shmdb_ring *r)
+{
+	shmdb_wmb();
+	SHMDB_WRITE_ONCE(r->prod_idx, r->prod_idx + 1);
+	shmdb_mb();
+
+	return SHMDB_READ_ONCE(r->cons_wait) ? TRUE : FALSE;
+}
+
+struct shmdb_ring_slot *shmdb_ring_cons_slot(struct shmdb_ring *r)
+{
+	u32 cons = SHMDB_READ_ONCE(r->cons_idx);
+
+	if (SHMDB_READ_ONCE(r->prod_idx) == cons) {
+		return NULL;
+	}
+	shmdb_rmb();
+
+	return shmdb_ring_slot(r, cons);
+}
+
+bool shmdb_ring_consume(struct shmdb_ring *r)
+{
+	shmdb_mb();
+	SHMDB_WRITE_ONCE(r->cons_idx, r->cons_idx + 1);
+	shmdb_mb();
+
+	return SHMDB_READ_ONCE(r->prod_wait) ? TRUE : FALSE;
+}
+
+bool shmdb_ring_cons_wait_begin(struct shmdb_ring *r)
+{
+	SHMDB_WRITE_ONCE(r->cons_wait, 1);
+	shmdb_mb();
+
+	return (SHMDB_READ_ONCE(r->prod_idx) ==
+		SHMDB_READ_ONCE(r->cons_idx)) ? TRUE : FALSE;
+}
+
+void shmdb_ring_cons_wait_end(struct shmdb_ring *r)
+{
+	SHMDB_WRITE_ONCE(r->cons_wait, 0);
+	shmdb_mb();
+}
+
+bool shmdb_ring_prod_wait_begin(struct shmdb_ring *r)
+{
+	SHMDB_WRITE_ONCE(r->prod_wait, 1);
+	shmdb_mb();
+
+	return ((SHMDB_READ_ONCE(r->prod_idx) -
+		 SHMDB_READ_ONCE(r->cons_idx)) >= r->num) ? TRUE : FALSE;
+}
+
+void shmdb_ring_prod_wait_end(struct shmdb_ring *r)
+{
+	SHMDB_WRITE_ONCE(r->prod_wait, 0);
+	shmdb_mb();
+}
@@ -0,0 +1,85 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file shmdb.h
+ * @author agent (agent@local)
+ * @brief Shared memory doorbell driver header
+ *
+ * Register and ring layout must match emulators/include/emu/shmem_doorbell.h
+ */
+#ifndef __SHMDB_H__
+#define __SHMDB_H__
+
+#include <arm_types.h>
+
+#define SHMDB_MAGIC_VALUE		0x53484442
+#define SHMDB_MAX_PEERS			32
+#define SHMDB_VECTOR_PEER_CHANGE	31
+
+#define SHMDB_RING_MAGIC		0x53524E47
+#define SHMDB_RING_CACHELINE		64
+
+struct shmdb_ring {
+	u32 magic;
+	u32 num;
+	u32 slot_size;
+	u32 reserved;
+	u8 pad0[SHMDB_RING_CACHELINE - 16];
+	u32 prod_idx;
+	u32 prod_wait;
+	u8 pad1[SHMDB_RING_CACHELINE - 8];
+	u32 cons_idx;
+	u32 cons_wait;
+	u8 pad2[SHMDB_RING_CACHELINE - 8];
+} __attribute__((packed));
+
+struct shmdb_ring_slot {
+	u32 len;
+	u32 flags;
+} __attribute__((packed));
+
+u32 shmdb_magic(virtual_addr_t base);
+u32 shmdb_peer_id(virtual_addr_t base);
+u32 shmdb_peer_mask(virtual_addr_t base);
+u64 shmdb_shm_size(virtual_addr_t base);
+u32 shmdb_int_status(virtual_addr_t base);
+void shmdb_int_clear(virtual_addr_t base, u32 status);
+void shmdb_int_mask(virtual_addr_t base, u32 mask);
+void shmdb_doorbell(virtual_addr_t base, u32 peer, u32 vector);
+
+/* Ring creator */
+void shmdb_ring_init(struct shmdb_ring *r, u32 num, u32 slot_size);
+bool shmdb_ring_ready(struct shmdb_ring *r);
+
+/* Producer side: returns NULL when ring is full */
+struct shmdb_ring_slot *shmdb_ring_prod_slot(struct shmdb_ring *r);
+/* Publish produced slot and return TRUE if consumer wants doorbell */
+bool shmdb_ring_produce(struct shmdb_ring *r);
+
+/* Consumer side: returns NULL when ring is empty */
+struct shmdb_ring_slot *shmdb_ring_cons_slot(struct shmdb_ring *r);
+/* Release consumed slot and return TRUE if producer wants doorbell */
+bool shmdb_ring_consume(struct shmdb_ring *r);
+
+/* Set wait flag and return TRUE if caller should still sleep */
+bool shmdb_ring_cons_wait_begin(struct shmdb_ring *r);
+void shmdb_ring_cons_wait_end(struct shmdb_ring *r);
+bool shmdb_ring_prod_wait_begin(struct shmdb_ring *r);
+void shmdb_ring_prod_wait_end(struct shmdb_ring *r);
+
+#endif
@@ -103,7 +103,7 @@ u32 arm_board_boot_delay(void)
 
 u32 arm_board_iosection_count(void)
 {
-	return 8;
+	return 9;
 }
 
 physical_addr_t arm_board_iosection_addr(int num)
@@ -143,6 +143,10 @@ physical_addr_t arm_board_iosection_addr(int num)
 		/* virtio-con */
 		ret = VIRT_V8_VIRTIO_CON;
 		break;
+	case 8:
+		/* shmem-doorbell */
+		ret = VIRT_V8_SHMDB;
+		break;
 	default:
 		while (1);
 		break;
@@ -265,3 +269,23 @@ char arm_board_serial_getc(void)
 	return ch;
 }
 
+
+virtual_addr_t arm_board_shmdb_base(void)
+{
+	return VIRT_V8_SHMDB;
+}
+
+virtual_addr_t arm_board_shmdb_mem_base(void)
+{
+	return VIRT_V8_SHMEM;
+}
+
+virtual_size_t arm_board_shmdb_mem_size(void)
+{
+	return VIRT_V8_SHMEM_SIZE;
+}
+
+u32 arm_board_shmdb_irq(void)
+{
+	return IRQ_VIRT_V8_SHMDB;
+}
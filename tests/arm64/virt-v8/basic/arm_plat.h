@@ -36,6 +36,10 @@
 #define VIRT_V8_VIRTIO_BLK_SIZE		(0x00001000)
 #define VIRT_V8_VIRTIO_CON		(0x0A002000)
 #define VIRT_V8_VIRTIO_CON_SIZE		(0x00001000)
+#define VIRT_V8_SHMDB			(0x0A004000)
+#define VIRT_V8_SHMDB_SIZE		(0x00001000)
+#define VIRT_V8_SHMEM			(0x0B000000)
+#define VIRT_V8_SHMEM_SIZE		(0x00100000)
 #define VIRT_V8_PCI			(0x10000000)
 #define VIRT_V8_PCI_SIZE		(0x30000000)
 #define VIRT_V8_RAM0			(0x40000000)
@@ -54,6 +58,7 @@
 #define IRQ_VIRT_V8_VIRTIO_NET		48
 #define IRQ_VIRT_V8_VIRTIO_BLK		49
 #define IRQ_VIRT_V8_VIRTIO_CON		50
+#define IRQ_VIRT_V8_SHMDB		52
 
 #define IRQ_VIRT_V8_GIC_START		16
 #define NR_IRQS_VIRT_V8			128
@@ -0,0 +1,79 @@
+#!/usr/bin/python
+#/**
+# Copyright (c) 2026 agent.
+# All rights reserved.
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2, or (at your option)
+# any later version.
+# 
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+#
+# @file trace2json.py
+# @author agent (agent@local)
+# @brief Convert output of "trace dump" command to Chrome trace JSON
+# */
+
+import sys
+import json
+from optparse import OptionParser
+
+usage = "Usage: %prog [options] <trace_dump_file>"
+parser = OptionParser(usage=usage)
+parser.add_option("-o", "--output", dest="output",
+                  help="Output JSON file (default: stdout)", metavar="FILE")
+
+(options, args) = parser.parse_args()
+
+if len(args) != 1:
+	parser.print_help()
+	sys.exit(1)
+
+entries = []
+for line in open(args[0]):
+	f = line.split()
+	if len(f) != 6 or line.startswith("#"):
+		continue
+	try:
+		entries.append((int(f[1]), int(f[0]), f[2],
+				int(f[3]), int(f[4], 16), int(f[5], 16)))
+	except ValueError:
+		continue
+entries.sort()
+
+events = []
+running = {}
+for (ts, cpu, name, a0, a1, a2) in entries:
+	ev = { "pid": 0, "tid": cpu, "ts": ts / 1000.0 }
+	if name == "sched_switch":
+		if cpu in running:
+			events.append(dict(ev, ph="E", name=running[cpu]))
+		running[cpu] = "vcpu%d" % a1
+		ev.update(ph="B", name=running[cpu], cat="sched")
+	elif name == "host_irq_enter" or name == "host_irq_exit":
+		ev.update(ph="B" if name.endswith("enter") else "E",
+			  name="irq%d" % a0, cat="irq")
+	elif name == "timer_expire_enter" or name == "timer_expire_exit":
+		ev.update(ph="B" if name.endswith("enter") else "E",
+			  name="timer", cat="timer",
+			  args={ "event": hex(a1), "handler": hex(a2) })
+	else:
+		ev.update(ph="i", s="t", name=name, cat=name.split("_")[0],
+			  args={ "arg0": a0, "arg1": hex(a1), "arg2": hex(a2) })
+	events.append(ev)
+
+for cpu in sorted(set([e[1] for e in entries])):
+	events.append({ "pid": 0, "tid": cpu, "ph": "M",
+			"name": "thread_name", "args": { "name": "hcpu%d" % cpu }})
+
+out = open(options.output, "w") if options.output else sys.stdout
+json.dump({ "traceEvents": events, "displayTimeUnit": "ns" }, out)
+out.write("\n")